@@ -1,13 +1,14 @@
-Texture2D tex : register(t0);
+Texture2D textures[] : register(t0);
 SamplerState smp : register(s0);
 
 struct VS_OUTPUT
 {
     float4 pos : SV_POSITION;
     float2 uv : TEXCOORD;
+    nointerpolation uint materialIndex : MATERIAL;
 };
 
 float4 main(VS_OUTPUT input) : SV_TARGET
 {
-    return tex.Sample(smp, input.uv);
+    return textures[input.materialIndex].Sample(smp, input.uv);
 }
@@ -8,17 +8,32 @@ struct VS_OUTPUT
 {
     float4 pos : SV_POSITION;
     float2 uv : TEXCOORD;
+    nointerpolation uint materialIndex : MATERIAL;
 };
 
-cbuffer ConstantBuffer : register(b0)
+// matches InstanceData
+struct Instance
 {
     float4x4 wvpMat;
+    uint materialIndex;
+};
+
+StructuredBuffer<Instance> instances : register(t0, space1);
+
+// SV_InstanceID counts from 0 in every draw, the batch's instances start
+// at firstInstance
+cbuffer DrawConstants : register(b1)
+{
+    uint firstInstance;
 }
 
-VS_OUTPUT main(VS_INPUT input)
+VS_OUTPUT main(VS_INPUT input, uint instanceID : SV_InstanceID)
 {
+    const Instance instance = instances[firstInstance + instanceID];
+
     VS_OUTPUT output;
-    output.pos = mul(float4(input.pos, 1.0f), wvpMat);
+    output.pos = mul(float4(input.pos, 1.0f), instance.wvpMat);
     output.uv = input.uv;
+    output.materialIndex = instance.materialIndex;
     return output;
 }
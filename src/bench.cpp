@@ -0,0 +1,541 @@
+#include "bvh.h"
+#include "command_recording.h"
+#include "descriptor_allocator.h"
+#include "draw_sort.h"
+#include "dynamic_aabb_tree.h"
+#include "frame_pacing.h"
+#include "frame_pipeline.h"
+#include "frustum_culling.h"
+#include "instancing.h"
+#include "job_system.h"
+#include "matrix_batch.h"
+#include "mesh_lod.h"
+#include "occlusion_culling.h"
+#include "profiler.h"
+#include "render_graph.h"
+#include "render_packets.h"
+#include "residency.h"
+#include "transform_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// Runs the CPU benchmarks of the renderer's subsystems and prints what they
+// measured. Exits with 1 if a benchmark's own check of its results failed,
+// so the numbers can be reproduced and gated the same way.
+//
+// usage: dx12_bench [--threads count] [name ...]
+
+struct BenchOptions
+{
+    uint32_t threads; // workers besides the calling thread
+};
+
+// false if the benchmark's results did not check out
+typedef bool (*BenchFunction)(const BenchOptions& options);
+
+static bool benchBvh(const BenchOptions& options)
+{
+    bool passed = true;
+    const uint32_t primitiveCounts[] = { 10000, 100000, 1000000 };
+    for (uint32_t primitives : primitiveCounts) {
+        const BvhBenchmark result = measureBvh(primitives, options.threads, 10000);
+        printf("  %7u primitives, %u threads: build %.2f ms, %u nodes, depth %u, cull %.1f us (%u visible), brute force %.1f us, %.2fx, %.2f M rays/s, %.2f M box queries/s, %u mismatches\n",
+            result.primitives, result.threads, result.buildSeconds * 1e3, result.nodes, result.depth, result.cullSeconds * 1e6, result.visible,
+            result.bruteCullSeconds * 1e6, result.bruteCullSeconds / result.cullSeconds, result.raysPerSecond * 1e-6, result.boxQueriesPerSecond * 1e-6,
+            result.mismatches);
+
+        if (result.mismatches != 0)
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchCulling(const BenchOptions& options)
+{
+    bool passed = true;
+    const uint32_t objectCounts[] = { 10000, 100000, 1000000 };
+    for (uint32_t objects : objectCounts) {
+        const CullingBenchmark result = measureFrustumCulling(objects, options.threads, 20);
+        printf("  %7u objects, %u threads: boxes %.1f us (%u visible), spheres %.1f us (%u visible), scalar boxes %.1f us, %.2fx, %u mismatches\n",
+            result.objects, result.threads, result.boxSeconds * 1e6, result.visibleBoxes, result.sphereSeconds * 1e6, result.visibleSpheres,
+            result.scalarSeconds * 1e6, result.scalarSeconds / result.boxSeconds, result.mismatches);
+
+        if (result.mismatches != 0)
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchDescriptors(const BenchOptions& options)
+{
+    (void)options;
+
+    const DescriptorFreeListBenchmark result = measureDescriptorFreeList(8192, 1000000);
+    printf("  free list: %u descriptors, %u operations, %.1f ns per operation, %u failed, %u ranges at most, %u mismatches\n",
+        result.capacity, result.operations, result.secondsPerOperation * 1e9, result.failedAllocations, result.maxRanges, result.mismatches);
+
+    return result.mismatches == 0;
+}
+
+static bool benchDrawSort(const BenchOptions& options)
+{
+    bool passed = true;
+    const uint32_t keyCounts[] = { 10000, 100000, 1000000 };
+    for (uint32_t keys : keyCounts) {
+        const DrawSortBenchmark result = measureDrawSort(keys, options.threads, 20);
+        printf("  %7u keys: radix %.1f us, %u threads %.1f us (%.1f M keys/s), std::stable_sort %.1f us, %u passes, state changes %u -> %u, %u mismatches\n",
+            result.keys, result.radixSeconds * 1e6, result.threads, result.parallelRadixSeconds * 1e6, result.keysPerSecond / 1e6,
+            result.stdSortSeconds * 1e6, result.passes, result.stateChangesBefore, result.stateChangesAfter, result.mismatches);
+
+        if (result.mismatches != 0)
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchDynamicTree(const BenchOptions& options)
+{
+    (void)options;
+
+    // everything moving down to a tenth of it
+    bool passed = true;
+    const uint32_t objects = 100000;
+    const uint32_t movingCounts[] = { 1000, 10000, 100000 };
+    for (uint32_t moving : movingCounts) {
+        const DynamicTreeBenchmark result = measureDynamicTree(objects, moving, 60);
+        printf("  %u objects, %6u moving: move %.1f us (%u reinserted), refit %.1f us, rebuild %.1f us, height %u, area ratio %.2f after moves, %.2f after refits, %u mismatches\n",
+            result.objects, result.moving, result.moveSeconds * 1e6, result.reinserted, result.refitSeconds * 1e6, result.rebuildSeconds * 1e6,
+            result.heightAfterMoves, result.areaRatioAfterMoves, result.areaRatioAfterRefits, result.mismatches);
+
+        if (result.mismatches != 0)
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchGraph(const BenchOptions& options)
+{
+    (void)options;
+
+    bool passed = true;
+    const uint32_t passCounts[] = { 100, 300, 1000 };
+    for (uint32_t passes : passCounts) {
+        const RenderGraphBenchmark result = measureRenderGraph(passes, 20);
+        const RenderGraphStats& stats = result.stats;
+        printf("  %4u passes: build %.1f us, compile %.1f us, %u culled, %u barriers (%u aliasing), transients %.1f MB in a %.1f MB heap, %.1f MB saved, %u failed, %u mismatches\n",
+            stats.passCount, result.buildMicroseconds, stats.compileMicroseconds, stats.culledPassCount, stats.barrierCount, stats.aliasingBarrierCount,
+            stats.transientBytes / 1048576.0, stats.aliasedHeapBytes / 1048576.0, stats.savedBytes / 1048576.0, result.failedCompiles, result.mismatches);
+
+        if (result.failedCompiles != 0 || result.mismatches != 0 || stats.savedBytes == 0)
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchInstancing(const BenchOptions& options)
+{
+    (void)options;
+
+    // 10k draws over few meshes and materials up to as many as there are draws
+    bool passed = true;
+    const uint32_t variety[] = { 16, 256, 4096 };
+    for (uint32_t count : variety) {
+        const InstancingBenchmark result = measureInstancing(10000, count, count, 100);
+        printf("  %u objects, %4u meshes and materials: %6u batches, build %.1f us, per draw %.1f us, upload %.1f KB instanced, %.1f KB per draw, %u mismatches\n",
+            result.objects, count, result.batches, result.buildSeconds * 1e6, result.perDrawSeconds * 1e6,
+            static_cast<double>(result.instanceBytes) / 1024.0, static_cast<double>(result.perDrawBytes) / 1024.0, result.mismatches);
+
+        if (result.mismatches != 0)
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchJobs(const BenchOptions& options)
+{
+    (void)options;
+
+    // threads in total, the calling thread included, past the core count
+    // to show what oversubscription costs
+    const uint32_t itemCount = 1 << 20;
+    const uint32_t minGrain = 256;
+
+    bool passed = true;
+    double oneThread = 0.0;
+    for (uint32_t threads = 1; threads <= 64; threads *= 2) {
+        const JobBenchmark result = measureParallelFor(threads - 1, itemCount, minGrain);
+        if (threads == 1)
+            oneThread = result.seconds;
+
+        printf("  %2u threads: %u items, %.2f ms, %.2fx of one thread, %u mismatches\n",
+            result.threads, itemCount, result.seconds * 1e3, oneThread / result.seconds, result.mismatches);
+
+        if (result.mismatches != 0)
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchLod(const BenchOptions& options)
+{
+    bool passed = true;
+    const uint32_t instanceCounts[] = { 10000, 100000 };
+    for (uint32_t instances : instanceCounts) {
+        const LodBenchmark result = measureLodSelection(instances, 64, options.threads, 100);
+        printf("  %6u instances, %u meshes, %u threads: %u visible, select %.1f us, scalar %.1f us, index ratio %.2f, %.1f switches per frame, %.1f without hysteresis, %u mismatches\n",
+            result.instances, result.meshes, result.threads, result.visible, result.selectSeconds * 1e6, result.scalarSeconds * 1e6,
+            result.indexRatio, result.switches, result.switchesNoHysteresis, result.mismatches);
+
+        // the batched selection has to pick what one at a time does
+        if (result.mismatches != 0)
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchMatrices(const BenchOptions& options)
+{
+    (void)options;
+
+    bool passed = true;
+    const uint32_t matrixCounts[] = { 1000, 10000, 100000 };
+    for (uint32_t matrices : matrixCounts) {
+        const MatrixBatchBenchmark result = measureMatrixBatch(matrices, 20);
+        printf("  %6u matrices, %u lanes: multiply %.1f us (%.2fx), view projection %.1f us (%.2fx), transpose %.1f us (%.2fx), inverse %.1f us (%.2fx), max error %g\n",
+            result.matrices, result.width, result.multiplySeconds * 1e6, result.scalarMultiplySeconds / result.multiplySeconds,
+            result.viewProjectionSeconds * 1e6, result.scalarViewProjectionSeconds / result.viewProjectionSeconds,
+            result.transposeSeconds * 1e6, result.scalarTransposeSeconds / result.transposeSeconds,
+            result.inverseSeconds * 1e6, result.scalarInverseSeconds / result.inverseSeconds, result.maxError);
+
+        // the kernels compute the scalar products in another order
+        if (!(result.maxError < 1e-4f))
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchOcclusion(const BenchOptions& options)
+{
+    // a city block by block larger, the props spread over all of it
+    bool passed = true;
+    const uint32_t buildingsPerSide[] = { 8, 16, 32 };
+    for (uint32_t side : buildingsPerSide) {
+        const OcclusionBenchmark result = measureOcclusionCulling(side, 20000, options.threads, 60);
+        printf("  %4u buildings, %u objects, %u threads: %u triangles, visible %u frustum, %u occlusion, %u reference, rasterize %.1f us, test %.1f us, %u false culls\n",
+            result.buildings, result.objects, result.threads, result.triangles, result.frustumVisible, result.occlusionVisible,
+            result.referenceVisible, result.rasterizeSeconds * 1e6, result.testSeconds * 1e6, result.falseCulls);
+
+        // occlusion culling has to be conservative
+        if (result.falseCulls != 0)
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchPacing(const BenchOptions& options)
+{
+    (void)options;
+
+    // a GPU bound frame with 20% variance, limited and unlimited, with one
+    // to three frames in flight
+    FrameSimulationParams params = {};
+    params.frameCount = 6000;
+    params.cpuFrameTime = 0.008;
+    params.gpuFrameTime = 0.012;
+    params.variance = 0.2;
+    params.sleepOvershoot = 0.001;
+
+    bool passed = true;
+    const double targets[] = { 0.0, 1.0 / 60.0 };
+    for (double target : targets) {
+        for (uint32_t framesInFlight = 1; framesInFlight <= 3; ++framesInFlight) {
+            FramePacerSettings settings = {};
+            settings.framesInFlight = framesInFlight;
+            settings.targetFrameTime = target;
+            settings.spinThreshold = 0.002;
+
+            const FrameSimulationResult result = simulateFramePacing(settings, params);
+            printf("  limit %5.1f ms, %u in flight: %.2f ms per frame, %.2f ms jitter, %.2f ms latency, %.2f ms at most, %.1f ms CPU wait per frame\n",
+                target * 1e3, framesInFlight, result.averageFrameTime * 1e3, result.frameTimeDeviation * 1e3,
+                result.averageLatency * 1e3, result.maxLatency * 1e3, result.cpuWaitTime / params.frameCount * 1e3);
+
+            // once CPU and GPU overlap the limiter is above the slower of
+            // the two, so it has to set the rate
+            if (target > 0.0 && framesInFlight > 1 && (result.averageFrameTime < target * 0.999 || result.averageFrameTime > target * 1.001))
+                passed = false;
+        }
+    }
+
+    return passed;
+}
+
+static bool benchPackets(const BenchOptions& options)
+{
+    // one to all of the threads push a frame's draws at the same time
+    bool passed = true;
+    for (uint32_t producers = 1; producers <= std::max(options.threads, 1u); producers *= 2) {
+        const RenderPacketBenchmark result = measureRenderPacketQueue(producers, 200, 10000);
+        printf("  %2u producers: %.1f M packets per second, %llu missing draws, wakeup %.1f us on average, %.1f us at most\n",
+            producers, result.packetsPerSecond * 1e-6, static_cast<unsigned long long>(result.missingDraws),
+            result.averageWakeupLatency * 1e6, result.maxWakeupLatency * 1e6);
+
+        if (result.missingDraws != 0)
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchPipeline(const BenchOptions& options)
+{
+    (void)options;
+
+    // update, build render packets, record: the frame time should approach
+    // the slowest stage once there is a slot per stage, given enough cores
+    const double stageTimes[] = { 0.002, 0.003, 0.004 };
+    const uint32_t stageCount = 3;
+    const double slowestStage = 0.004;
+
+    bool passed = true;
+    for (uint32_t slots = 1; slots <= stageCount; ++slots) {
+        const FramePipelineBenchmark result = measureFramePipeline(stageTimes, stageCount, slots, 100);
+        printf("  %u slots: %.2f ms per frame, %.2f ms sequential, %.2fx\n",
+            slots, result.pipelinedFrameTime * 1e3, result.sequentialFrameTime * 1e3, result.sequentialFrameTime / result.pipelinedFrameTime);
+
+        // every frame goes through the slowest stage
+        if (result.pipelinedFrameTime < slowestStage)
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchProfiler(const BenchOptions& options)
+{
+    (void)options;
+
+    const double overhead = measureProfileZoneOverhead(10000000);
+    printf("  %.1f ns per zone\n", overhead * 1e9);
+
+    return overhead > 0.0;
+}
+
+static bool benchRecording(const BenchOptions& options)
+{
+    (void)options;
+
+    // threads in total, the calling thread included, chunks of at least 256
+    // draws like the main pass
+    const uint32_t drawCounts[] = { 50000, 200000 };
+    const uint32_t minDrawsPerChunk = 256;
+
+    bool passed = true;
+    for (uint32_t draws : drawCounts) {
+        double oneThread = 0.0;
+        for (uint32_t threads = 1; threads <= 16; threads *= 2) {
+            const RecordingBenchmark result = measureParallelRecording(draws, threads - 1, minDrawsPerChunk);
+            if (threads == 1)
+                oneThread = result.seconds;
+
+            printf("  %6u draws, %2u threads: %2u chunks, %.2f ms, %.2fx of one thread, %u mismatches\n",
+                draws, result.threads, result.chunkCount, result.seconds * 1e3, oneThread / result.seconds, result.mismatches);
+
+            if (result.mismatches != 0)
+                passed = false;
+        }
+    }
+
+    return passed;
+}
+
+static bool benchResidency(const BenchOptions& options)
+{
+    (void)options;
+
+    // a streaming trace: 512 textures, every frame uses a window of 64 that
+    // moves through them plus a few random ones, a quarter has high priority
+    const uint32_t textureCount = 512;
+    const uint32_t frameCount = 2000;
+    const uint32_t framesInFlight = 2;
+
+    ResidencyTrace trace;
+    uint64_t totalBytes = 0;
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < textureCount; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        const uint32_t size = 256u << ((seed >> 16) % 4);
+        const uint64_t bytes = estimateTextureSize(size, size, 1, 9, 32);
+        trace.resources.push_back({ bytes, i % 4 == 0 ? ResidencyPriorityHigh : ResidencyPriorityNormal });
+        totalBytes += bytes;
+    }
+
+    for (uint32_t frame = 1; frame <= frameCount; ++frame) {
+        const uint32_t window = frame / 8;
+        for (uint32_t i = 0; i < 64; ++i)
+            trace.uses.push_back({ frame, (window + i) % textureCount });
+        for (uint32_t i = 0; i < 4; ++i) {
+            seed = seed * 1664525u + 1013904223u;
+            trace.uses.push_back({ frame, (seed >> 16) % textureCount });
+        }
+    }
+
+    bool passed = true;
+    const uint32_t budgetPercents[] = { 100, 50, 25 };
+    for (uint32_t percent : budgetPercents) {
+        const uint64_t budget = totalBytes * percent / 100;
+
+        typedef std::chrono::duration<double> Seconds;
+        const auto start = std::chrono::steady_clock::now();
+        const ResidencySimulationResult result = simulateResidency(trace, budget, framesInFlight);
+        const double seconds = Seconds(std::chrono::steady_clock::now() - start).count();
+
+        printf("  budget %3u%%: %llu frames, %.1f us per frame, %llu evictions, %llu page ins, %.1f MB paged in, peak %.1f MB of %.1f MB, %llu frames over budget\n",
+            percent, static_cast<unsigned long long>(result.frames), seconds / static_cast<double>(result.frames) * 1e6,
+            static_cast<unsigned long long>(result.evictions), static_cast<unsigned long long>(result.pageIns),
+            static_cast<double>(result.pagedInBytes) / (1024.0 * 1024.0), static_cast<double>(result.peakResidentBytes) / (1024.0 * 1024.0),
+            static_cast<double>(budget) / (1024.0 * 1024.0), static_cast<unsigned long long>(result.overBudgetFrames));
+
+        // only evicted textures come back, and the working set fits every
+        // budget once the frames in flight at the start are done
+        if (result.frames != frameCount || result.pageIns > result.evictions || result.overBudgetFrames > framesInFlight)
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchRotations(const BenchOptions& options)
+{
+    // a minute of spinning at 60 steps a second
+    bool passed = true;
+    const uint32_t nodeCounts[] = { 1000, 10000 };
+    for (uint32_t nodes : nodeCounts) {
+        const RotationBenchmark result = measureRotationIntegration(nodes, options.threads, 3600);
+        printf("  %6u nodes, %u steps, %u threads: %.1f us per step, scalar %.1f us, %.2fx, max norm error %g, max angle error %g\n",
+            result.nodes, result.steps, result.threads, result.secondsPerStep * 1e6, result.scalarSecondsPerStep * 1e6,
+            result.scalarSecondsPerStep / result.secondsPerStep, result.maxNormError, result.maxAngleError);
+
+        // renormalized every step, and a minute of rounding stays well
+        // under a thousandth of a radian
+        if (!(result.maxNormError < 1e-5f) || !(result.maxAngleError < 1e-3f))
+            passed = false;
+    }
+
+    return passed;
+}
+
+static bool benchTransforms(const BenchOptions& options)
+{
+    // hierarchies of a few levels, as wide as scenes get
+    bool passed = true;
+    const uint32_t nodeCounts[] = { 1000, 10000, 100000 };
+    for (uint32_t nodes : nodeCounts) {
+        const TransformBenchmark result = measureTransformUpdate(nodes, options.threads, 100);
+        printf("  %6u nodes, %u levels, %u threads: %.1f us per update, scalar %.1f us, %.2fx, max error %g\n",
+            result.nodes, result.levels, result.threads, result.secondsPerUpdate * 1e6, result.scalarSecondsPerUpdate * 1e6,
+            result.scalarSecondsPerUpdate / result.secondsPerUpdate, result.maxError);
+
+        // the SIMD path computes the same products in another order
+        if (!(result.maxError < 1e-4f))
+            passed = false;
+    }
+
+    return passed;
+}
+
+struct Bench
+{
+    const char* name;
+    BenchFunction function;
+};
+
+static const Bench benches_[] = {
+    { "bvh", benchBvh },
+    { "culling", benchCulling },
+    { "descriptors", benchDescriptors },
+    { "drawsort", benchDrawSort },
+    { "dynamictree", benchDynamicTree },
+    { "graph", benchGraph },
+    { "instancing", benchInstancing },
+    { "jobs", benchJobs },
+    { "lod", benchLod },
+    { "matrices", benchMatrices },
+    { "occlusion", benchOcclusion },
+    { "pacing", benchPacing },
+    { "packets", benchPackets },
+    { "pipeline", benchPipeline },
+    { "profiler", benchProfiler },
+    { "recording", benchRecording },
+    { "residency", benchResidency },
+    { "rotations", benchRotations },
+    { "transforms", benchTransforms },
+};
+
+static const uint32_t benchCount_ = sizeof(benches_) / sizeof(benches_[0]);
+
+static void printUsage()
+{
+    printf("usage: dx12_bench [--threads count] [name ...]\n");
+    printf("benchmarks:");
+    for (uint32_t i = 0; i < benchCount_; ++i)
+        printf(" %s", benches_[i].name);
+    printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options = {};
+    const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    options.threads = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+
+    bool selected[benchCount_] = {};
+    bool any = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+            continue;
+        }
+
+        uint32_t bench = 0;
+        while (bench < benchCount_ && strcmp(argv[i], benches_[bench].name) != 0)
+            bench++;
+
+        if (bench == benchCount_) {
+            printUsage();
+            return 2;
+        }
+
+        selected[bench] = true;
+        any = true;
+    }
+
+    bool passed = true;
+    for (uint32_t i = 0; i < benchCount_; ++i) {
+        if (any && !selected[i])
+            continue;
+
+        printf("%s\n", benches_[i].name);
+        if (!benches_[i].function(options)) {
+            printf("  FAILED\n");
+            passed = false;
+        }
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+#include "bindless_table.h"
+
+#include <cstddef>
+
+BindlessTable::BindlessTable()
+    : frame_(0)
+    , framesInFlight_(0)
+    , liveCount_(0)
+{
+}
+
+void BindlessTable::reset(uint32_t capacity, uint32_t framesInFlight)
+{
+    generations_.assign(capacity, 0);
+    pending_.clear();
+    frame_ = 0;
+    framesInFlight_ = framesInFlight;
+    liveCount_ = 0;
+
+    // hand out low indices first, so the used part of the table stays dense
+    freeIndices_.resize(capacity);
+    for (uint32_t i = 0; i < capacity; ++i)
+        freeIndices_[i] = capacity - 1 - i;
+}
+
+BindlessHandle BindlessTable::allocate()
+{
+    if (freeIndices_.empty())
+        return { InvalidBindlessIndex, 0 };
+
+    const uint32_t index = freeIndices_.back();
+    freeIndices_.pop_back();
+    generations_[index]++;
+    liveCount_++;
+
+    return { index, generations_[index] };
+}
+
+void BindlessTable::release(BindlessHandle handle)
+{
+    if (!isAlive(handle))
+        return;
+
+    // bump the generation right away, so stale handles are caught even
+    // before the slot is recycled
+    generations_[handle.index]++;
+    pending_.push_back({ handle.index, frame_ });
+    liveCount_--;
+}
+
+bool BindlessTable::isAlive(BindlessHandle handle) const
+{
+    return handle.index < generations_.size() && (handle.generation & 1) != 0 && generations_[handle.index] == handle.generation;
+}
+
+void BindlessTable::beginFrame()
+{
+    frame_++;
+
+    size_t retired = 0;
+    while (retired < pending_.size() && pending_[retired].frame + framesInFlight_ <= frame_) {
+        freeIndices_.push_back(pending_[retired].index);
+        retired++;
+    }
+
+    pending_.erase(pending_.begin(), pending_.begin() + retired);
+}
@@ -0,0 +1,62 @@
+#if !defined(BINDLESS_TABLE_H)
+#define BINDLESS_TABLE_H
+
+#include <cstdint>
+#include <vector>
+
+// Index allocator for the global bindless SRV table. Shaders address
+// resources by the index returned from allocate(), the index stays the same
+// for the whole lifetime of the resource. Released indices are only handed
+// out again once every frame that could still reference them has retired.
+//
+// A slot's generation is bumped when it is allocated and again when it is
+// released, so it is odd while the slot is in use. Handles of released or
+// never allocated slots are not alive and releasing them does nothing.
+
+struct BindlessHandle
+{
+    uint32_t index;
+    uint32_t generation;
+};
+
+constexpr uint32_t InvalidBindlessIndex = 0xffffffff;
+
+class BindlessTable
+{
+public:
+    BindlessTable();
+
+    // framesInFlight is the number of frames the GPU may lag behind the CPU
+    void reset(uint32_t capacity, uint32_t framesInFlight);
+
+    // index is InvalidBindlessIndex if the table is full
+    BindlessHandle allocate();
+
+    // index is reusable after framesInFlight more calls to beginFrame()
+    void release(BindlessHandle handle);
+
+    // true if the handle came from allocate() and was not released since
+    bool isAlive(BindlessHandle handle) const;
+
+    void beginFrame();
+
+    uint32_t capacity() const { return static_cast<uint32_t>(generations_.size()); }
+    uint32_t liveCount() const { return liveCount_; }
+    uint32_t pendingCount() const { return static_cast<uint32_t>(pending_.size()); }
+
+private:
+    struct PendingRelease
+    {
+        uint32_t index;
+        uint64_t frame;
+    };
+
+    std::vector<uint32_t> generations_;
+    std::vector<uint32_t> freeIndices_;
+    std::vector<PendingRelease> pending_; // in release order, so frames are ascending
+    uint64_t frame_;
+    uint32_t framesInFlight_;
+    uint32_t liveCount_;
+};
+
+#endif // BINDLESS_TABLE_H
@@ -0,0 +1,873 @@
+#include "bvh.h"
+
+#include "frustum_culling.h"
+#include "job_system.h"
+#include "profiler.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+// split candidates per axis, small ranges use one per primitive down to
+// the minimum
+static const uint32_t binCount_ = 16;
+static const uint32_t minBinCount_ = 4;
+
+// leaves never hold more, larger ranges are split even if SAH would not
+static const uint32_t maxLeafSize_ = 4;
+
+// ranges at least this large build their two halves as separate jobs
+static const uint32_t minPrimitivesPerTask_ = 4096;
+
+// ranges at least this large are binned across workers, in pieces of at
+// least the second
+static const uint32_t minPrimitivesToSplitBinning_ = 65536;
+static const uint32_t minPrimitivesPerBinJob_ = 16384;
+
+// past this depth ranges are split at the median, so a bad distribution
+// cannot grow the tree deeper than about maxSahDepth_ + log2(count)
+static const uint32_t maxSahDepth_ = 48;
+
+// traversal stacks, a node pushes at most four children after popping
+// itself so this covers trees 80 levels deep
+static const uint32_t stackSize_ = 256;
+
+// Builds a binary tree top down, then collapses it into the four wide
+// nodes of a Bvh.
+struct BvhBuilder
+{
+    // leaves have no children, the right child always follows the left one
+    struct Node
+    {
+        Aabb bounds;
+        uint32_t left;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    // partitioned in place, so every level reads its range front to back
+    // instead of chasing indices into the input. The index follows the
+    // bounds so max loads as four floats.
+    struct Primitive
+    {
+        Aabb bounds;
+        uint32_t index;
+    };
+
+    // the bounds of the boxes and of their centroids, children get theirs
+    // from the bins so a level takes a single pass. Each is x, y, z and an
+    // unused lane.
+    struct Bin
+    {
+        SimdFloat min, max;
+        SimdFloat centroidMin, centroidMax;
+        uint32_t count;
+        uint32_t padding[3]; // spelled out, MSVC warns about implicit padding
+    };
+
+    struct Binning
+    {
+        Bin bins[3][binCount_];
+    };
+
+    BvhBuilder(const Aabb* bounds, uint32_t count, JobSystem* jobSystem);
+
+    void buildNode(uint32_t node, uint32_t first, uint32_t count, const Aabb& centroids, uint32_t depth);
+    uint32_t collapse(Bvh& bvh, uint32_t node, uint32_t depth) const;
+
+    void computeBounds(uint32_t first, uint32_t count, Bin& result);
+    void bin(uint32_t first, uint32_t count, const Aabb& centroids, uint32_t binCount, Binning& result);
+
+    JobSystem* jobs;
+
+    std::vector<Primitive> primitives;
+
+    // a binary tree over n primitives has at most 2n - 1 nodes, children
+    // take slots from the counter so subtrees can be built concurrently
+    std::vector<Node> nodes;
+    std::atomic<uint32_t> nodeCount;
+};
+
+static float axisMin(const Aabb& box, uint32_t axis)
+{
+    return axis == 0 ? box.min.x : axis == 1 ? box.min.y : box.min.z;
+}
+
+static float axisMax(const Aabb& box, uint32_t axis)
+{
+    return axis == 0 ? box.max.x : axis == 1 ? box.max.y : box.max.z;
+}
+
+static Aabb toAabb(SimdFloat min, SimdFloat max)
+{
+    float low[4], high[4];
+    simdStore(low, min);
+    simdStore(high, max);
+    return { { low[0], low[1], low[2] }, { high[0], high[1], high[2] } };
+}
+
+static BvhBuilder::Bin emptyBin()
+{
+    const SimdFloat low = simdSplat(-FLT_MAX);
+    const SimdFloat high = simdSplat(FLT_MAX);
+    return { high, low, high, low, 0, { 0, 0, 0 } };
+}
+
+static void growBin(BvhBuilder::Bin& bin, const BvhBuilder::Bin& other)
+{
+    bin.min = simdMin(bin.min, other.min);
+    bin.max = simdMax(bin.max, other.max);
+    bin.centroidMin = simdMin(bin.centroidMin, other.centroidMin);
+    bin.centroidMax = simdMax(bin.centroidMax, other.centroidMax);
+    bin.count += other.count;
+}
+
+// adds a box whose centroid, scaled by two, is min + max
+static void growBin(BvhBuilder::Bin& bin, SimdFloat min, SimdFloat max, SimdFloat centroid)
+{
+    bin.min = simdMin(bin.min, min);
+    bin.max = simdMax(bin.max, max);
+    bin.centroidMin = simdMin(bin.centroidMin, centroid);
+    bin.centroidMax = simdMax(bin.centroidMax, centroid);
+    bin.count++;
+}
+
+// maps centroids of a range to bins along each axis, the same way during
+// binning and partitioning
+struct BinMapping
+{
+    BinMapping(const Aabb& centroids, uint32_t binCount)
+        : last(binCount - 1)
+    {
+        low = centroids.min;
+        const float bins = static_cast<float>(binCount);
+        const Float3 extent = { centroids.max.x - low.x, centroids.max.y - low.y, centroids.max.z - low.z };
+        scale.x = extent.x > 0.0f ? bins / extent.x : 0.0f;
+        scale.y = extent.y > 0.0f ? bins / extent.y : 0.0f;
+        scale.z = extent.z > 0.0f ? bins / extent.z : 0.0f;
+    }
+
+    uint32_t index(float value, float axisLow, float axisScale) const
+    {
+        return std::min(static_cast<uint32_t>((value - axisLow) * axisScale), last);
+    }
+
+    uint32_t index(const Aabb& box, uint32_t axis) const
+    {
+        return axis == 0 ? index(box.min.x + box.max.x, low.x, scale.x) : axis == 1 ? index(box.min.y + box.max.y, low.y, scale.y) : index(box.min.z + box.max.z, low.z, scale.z);
+    }
+
+    uint32_t last;
+    Float3 low;
+    Float3 scale;
+};
+
+// half the surface area, all the cost comparisons need
+static float halfArea(const Aabb& box)
+{
+    const float x = box.max.x - box.min.x, y = box.max.y - box.min.y, z = box.max.z - box.min.z;
+    return x < 0.0f ? 0.0f : x * y + y * z + z * x;
+}
+
+BvhBuilder::BvhBuilder(const Aabb* bounds, uint32_t count, JobSystem* jobSystem)
+    : jobs(jobSystem)
+    , primitives(count)
+    , nodes(std::max(2 * count, 1u))
+    , nodeCount(1)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        primitives[i] = { bounds[i], i };
+}
+
+void BvhBuilder::computeBounds(uint32_t first, uint32_t count, Bin& result)
+{
+    result = emptyBin();
+    for (uint32_t i = first; i < first + count; ++i) {
+        const SimdFloat min = simdLoad(&primitives[i].bounds.min.x);
+        const SimdFloat max = simdLoad(&primitives[i].bounds.max.x);
+        growBin(result, min, max, simdAdd(min, max));
+    }
+}
+
+void BvhBuilder::bin(uint32_t first, uint32_t count, const Aabb& centroids, uint32_t binCount, Binning& result)
+{
+    const Bin empty = emptyBin();
+    const BinMapping mapping(centroids, binCount);
+
+    auto body = [&](uint32_t begin, uint32_t end, Binning& binning) {
+        for (uint32_t axis = 0; axis < 3; ++axis)
+            std::fill(binning.bins[axis], binning.bins[axis] + binCount, empty);
+
+        for (uint32_t i = begin; i < end; ++i) {
+            const SimdFloat min = simdLoad(&primitives[i].bounds.min.x);
+            const SimdFloat max = simdLoad(&primitives[i].bounds.max.x);
+            const SimdFloat centroid = simdAdd(min, max);
+
+            float values[4];
+            simdStore(values, centroid);
+
+            growBin(binning.bins[0][mapping.index(values[0], mapping.low.x, mapping.scale.x)], min, max, centroid);
+            growBin(binning.bins[1][mapping.index(values[1], mapping.low.y, mapping.scale.y)], min, max, centroid);
+            growBin(binning.bins[2][mapping.index(values[2], mapping.low.z, mapping.scale.z)], min, max, centroid);
+        }
+    };
+
+    if (!jobs || count < minPrimitivesToSplitBinning_) {
+        body(first, first + count, result);
+        return;
+    }
+
+    for (uint32_t axis = 0; axis < 3; ++axis)
+        std::fill(result.bins[axis], result.bins[axis] + binCount, empty);
+
+    std::mutex mutex;
+    jobs->parallelFor(first, first + count, minPrimitivesPerBinJob_, [&](uint32_t begin, uint32_t end) {
+        Binning local;
+        body(begin, end, local);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            for (uint32_t i = 0; i < binCount; ++i)
+                growBin(result.bins[axis][i], local.bins[axis][i]);
+        }
+    });
+}
+
+void BvhBuilder::buildNode(uint32_t node, uint32_t first, uint32_t count, const Aabb& centroids, uint32_t depth)
+{
+    nodes[node].left = Bvh::InvalidChild;
+    nodes[node].first = first;
+    nodes[node].count = count;
+
+    if (count <= 1)
+        return;
+
+    const Float3 extent = { centroids.max.x - centroids.min.x, centroids.max.y - centroids.min.y, centroids.max.z - centroids.min.z };
+    const uint32_t widestAxis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+    const float area = halfArea(nodes[node].bounds);
+
+    Primitive* const begin = primitives.data() + first;
+    Primitive* const end = begin + count;
+    Primitive* middle = begin;
+
+    Bin left = emptyBin();
+    Bin right = emptyBin();
+
+    if (depth < maxSahDepth_ && area > 0.0f && axisMax(centroids, widestAxis) > axisMin(centroids, widestAxis)) {
+        Binning binning;
+        const uint32_t binCount = std::min(std::max(count, minBinCount_), binCount_);
+        bin(first, count, centroids, binCount, binning);
+
+        // cost of splitting after each bin, sweeping in from the right and
+        // then from the left
+        float bestCost = FLT_MAX;
+        uint32_t bestAxis = 0;
+        uint32_t bestBin = 0;
+
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            const Bin* bins = binning.bins[axis];
+
+            float rightCost[binCount_];
+            Bin rightBins = emptyBin();
+            for (uint32_t i = binCount - 1; i > 0; --i) {
+                growBin(rightBins, bins[i]);
+                rightCost[i - 1] = halfArea(toAabb(rightBins.min, rightBins.max)) * static_cast<float>(rightBins.count);
+            }
+
+            Bin leftBins = emptyBin();
+            for (uint32_t i = 0; i + 1 < binCount; ++i) {
+                growBin(leftBins, bins[i]);
+                if (leftBins.count == 0 || leftBins.count == count)
+                    continue;
+
+                const float cost = halfArea(toAabb(leftBins.min, leftBins.max)) * static_cast<float>(leftBins.count) + rightCost[i];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = i;
+                }
+            }
+        }
+
+        // a traversal step costs as much as a primitive test
+        const float splitCost = 1.0f + bestCost / area;
+        if (count <= maxLeafSize_ && static_cast<float>(count) <= splitCost)
+            return;
+
+        if (bestCost < FLT_MAX) {
+            const BinMapping mapping(centroids, binCount);
+            middle = std::partition(begin, end, [&](const Primitive& primitive) {
+                return mapping.index(primitive.bounds, bestAxis) <= bestBin;
+            });
+
+            for (uint32_t i = 0; i < binCount; ++i)
+                growBin(i <= bestBin ? left : right, binning.bins[bestAxis][i]);
+        }
+    } else if (count <= maxLeafSize_) {
+        return;
+    }
+
+    // identical centroids or too deep, halve at the median. The halves are
+    // found by sorting and need their bounds computed.
+    if (middle == begin || middle == end) {
+        middle = begin + count / 2;
+        std::nth_element(begin, middle, end, [widestAxis](const Primitive& a, const Primitive& b) {
+            return axisMin(a.bounds, widestAxis) + axisMax(a.bounds, widestAxis) < axisMin(b.bounds, widestAxis) + axisMax(b.bounds, widestAxis);
+        });
+        computeBounds(first, count / 2, left);
+        computeBounds(first + count / 2, count - count / 2, right);
+    }
+
+    const uint32_t child = nodeCount.fetch_add(2);
+    nodes[node].left = child;
+    nodes[child].bounds = toAabb(left.min, left.max);
+    nodes[child + 1].bounds = toAabb(right.min, right.max);
+
+    const uint32_t leftCount = left.count;
+    const uint32_t rightCount = right.count;
+    const Aabb leftCentroids = toAabb(left.centroidMin, left.centroidMax);
+    const Aabb rightCentroids = toAabb(right.centroidMin, right.centroidMax);
+
+    if (jobs && count >= minPrimitivesPerTask_) {
+        JobCounter counter;
+        jobs->run([this, child, first, leftCount, leftCentroids, depth]() { buildNode(child, first, leftCount, leftCentroids, depth + 1); }, &counter);
+        buildNode(child + 1, first + leftCount, rightCount, rightCentroids, depth + 1);
+        jobs->wait(counter);
+    } else {
+        buildNode(child, first, leftCount, leftCentroids, depth + 1);
+        buildNode(child + 1, first + leftCount, rightCount, rightCentroids, depth + 1);
+    }
+}
+
+uint32_t BvhBuilder::collapse(Bvh& bvh, uint32_t node, uint32_t depth) const
+{
+    // keep opening the largest inner child until there are four, only a
+    // root that is a leaf ends up with a single one
+    uint32_t children[4] = { node };
+    uint32_t childCount = 1;
+    while (childCount < 4) {
+        uint32_t open = 4;
+        float openArea = -1.0f;
+        for (uint32_t i = 0; i < childCount; ++i) {
+            const Node& child = nodes[children[i]];
+            const float childArea = aabbSurfaceArea(child.bounds);
+            if (child.left != Bvh::InvalidChild && childArea > openArea) {
+                open = i;
+                openArea = childArea;
+            }
+        }
+        if (open == 4)
+            break;
+
+        const uint32_t left = nodes[children[open]].left;
+        children[open] = left;
+        children[childCount++] = left + 1;
+    }
+
+    const uint32_t index = static_cast<uint32_t>(bvh.nodes_.size());
+    bvh.nodes_.push_back({});
+    bvh.depth_ = std::max(bvh.depth_, depth + 1);
+
+    // children first, pushing them may move the node
+    uint32_t wideChildren[4] = { Bvh::InvalidChild, Bvh::InvalidChild, Bvh::InvalidChild, Bvh::InvalidChild };
+    for (uint32_t i = 0; i < childCount; ++i)
+        wideChildren[i] = nodes[children[i]].left == Bvh::InvalidChild ? Bvh::LeafChild : collapse(bvh, children[i], depth + 1);
+
+    // empty slots get zero bounds, queries skip them by their child
+    Bvh::Node& result = bvh.nodes_[index];
+    for (uint32_t i = 0; i < childCount; ++i) {
+        const Node& child = nodes[children[i]];
+        result.minX[i] = child.bounds.min.x;
+        result.minY[i] = child.bounds.min.y;
+        result.minZ[i] = child.bounds.min.z;
+        result.maxX[i] = child.bounds.max.x;
+        result.maxY[i] = child.bounds.max.y;
+        result.maxZ[i] = child.bounds.max.z;
+        result.first[i] = child.first;
+        result.count[i] = child.count;
+    }
+    for (uint32_t i = 0; i < 4; ++i)
+        result.child[i] = wideChildren[i];
+
+    return index;
+}
+
+Bvh::Bvh()
+    : depth_(0)
+{
+}
+
+void Bvh::clear()
+{
+    nodes_.clear();
+    primitives_.clear();
+    primitiveBounds_.clear();
+    depth_ = 0;
+}
+
+void Bvh::build(const Aabb* bounds, uint32_t count, JobSystem* jobs)
+{
+    PROFILE_FUNCTION();
+
+    clear();
+    if (count == 0)
+        return;
+
+    BvhBuilder builder(bounds, count, jobs);
+    BvhBuilder::Bin root;
+    builder.computeBounds(0, count, root);
+    builder.nodes[0].bounds = toAabb(root.min, root.max);
+    builder.buildNode(0, 0, count, toAabb(root.centroidMin, root.centroidMax), 0);
+
+    // one wide node for every two or three binary ones, roughly
+    nodes_.reserve(builder.nodeCount.load() / 2 + 1);
+    builder.collapse(*this, 0, 0);
+
+    primitives_.resize(count);
+    primitiveBounds_.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        primitives_[i] = builder.primitives[i].index;
+        primitiveBounds_[i] = builder.primitives[i].bounds;
+    }
+}
+
+void Bvh::appendRange(uint32_t first, uint32_t count, std::vector<uint32_t>& result) const
+{
+    result.insert(result.end(), primitives_.begin() + first, primitives_.begin() + first + count);
+}
+
+void Bvh::cullFrustum(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+    if (nodes_.empty())
+        return;
+
+    SimdFloat normal[6][3];
+    SimdFloat absNormal[6][3];
+    SimdFloat distance[6];
+    for (uint32_t p = 0; p < 6; ++p) {
+        const Float4& plane = frustum.planes[p];
+        normal[p][0] = simdSplat(plane.x);
+        normal[p][1] = simdSplat(plane.y);
+        normal[p][2] = simdSplat(plane.z);
+        absNormal[p][0] = simdSplat(std::fabs(plane.x));
+        absNormal[p][1] = simdSplat(std::fabs(plane.y));
+        absNormal[p][2] = simdSplat(std::fabs(plane.z));
+        distance[p] = simdSplat(plane.w);
+    }
+
+    const SimdFloat zero = simdSplat(0.0f);
+    const SimdFloat half = simdSplat(0.5f);
+
+    // a node inside a plane has all of its children inside it, so each
+    // entry carries the planes that are still worth testing
+    struct Entry
+    {
+        uint32_t node;
+        uint32_t planes;
+    };
+    Entry stack[stackSize_];
+    uint32_t size = 0;
+    stack[size++] = { 0, 0x3f };
+
+    while (size > 0) {
+        const Entry entry = stack[--size];
+        const Node& node = nodes_[entry.node];
+
+        const SimdFloat minX = simdLoad(node.minX), maxX = simdLoad(node.maxX);
+        const SimdFloat minY = simdLoad(node.minY), maxY = simdLoad(node.maxY);
+        const SimdFloat minZ = simdLoad(node.minZ), maxZ = simdLoad(node.maxZ);
+        const SimdFloat x = simdMul(simdAdd(minX, maxX), half);
+        const SimdFloat y = simdMul(simdAdd(minY, maxY), half);
+        const SimdFloat z = simdMul(simdAdd(minZ, maxZ), half);
+        const SimdFloat ex = simdMul(simdSub(maxX, minX), half);
+        const SimdFloat ey = simdMul(simdSub(maxY, minY), half);
+        const SimdFloat ez = simdMul(simdSub(maxZ, minZ), half);
+
+        SimdFloat outside = zero;
+        uint32_t crossing[4] = {};
+
+        for (uint32_t p = 0; p < 6; ++p) {
+            if ((entry.planes & (1u << p)) == 0)
+                continue;
+
+            SimdFloat d = simdMulAdd(x, normal[p][0], distance[p]);
+            d = simdMulAdd(y, normal[p][1], d);
+            d = simdMulAdd(z, normal[p][2], d);
+
+            SimdFloat r = simdMul(ex, absNormal[p][0]);
+            r = simdMulAdd(ey, absNormal[p][1], r);
+            r = simdMulAdd(ez, absNormal[p][2], r);
+
+            outside = simdOr(outside, simdLess(simdAdd(d, r), zero));
+
+            const uint32_t crossed = simdMask(simdLess(simdSub(d, r), zero));
+            for (uint32_t lane = 0; lane < 4; ++lane)
+                crossing[lane] |= ((crossed >> lane) & 1) << p;
+        }
+
+        const uint32_t inside = ~simdMask(outside);
+        for (uint32_t lane = 0; lane < 4; ++lane) {
+            const uint32_t child = node.child[lane];
+            if (child == InvalidChild || (inside & (1u << lane)) == 0)
+                continue;
+
+            if (crossing[lane] == 0) {
+                appendRange(node.first[lane], node.count[lane], visible);
+            } else if (child != LeafChild) {
+                stack[size++] = { child, crossing[lane] };
+            } else {
+                // the same test cullObjects() does, against the planes the
+                // leaf crosses
+                const uint32_t end = node.first[lane] + node.count[lane];
+                for (uint32_t i = node.first[lane]; i < end; ++i) {
+                    const Aabb& box = primitiveBounds_[i];
+                    const Float3 center = aabbCenter(box);
+                    const Float3 extents = { (box.max.x - box.min.x) * 0.5f, (box.max.y - box.min.y) * 0.5f, (box.max.z - box.min.z) * 0.5f };
+
+                    bool primitiveInside = true;
+                    for (uint32_t p = 0; p < 6 && primitiveInside; ++p) {
+                        if ((crossing[lane] & (1u << p)) == 0)
+                            continue;
+
+                        const Float4& plane = frustum.planes[p];
+                        const float d = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+                        const float r = std::fabs(plane.x) * extents.x + std::fabs(plane.y) * extents.y + std::fabs(plane.z) * extents.z;
+                        primitiveInside = d + r >= 0.0f;
+                    }
+
+                    if (primitiveInside)
+                        visible.push_back(primitives_[i]);
+                }
+            }
+        }
+    }
+}
+
+// clips [near, far] to the slab of one axis
+static void clipSlab(float low, float high, float origin, float inverse, float& nearDistance, float& farDistance)
+{
+    const float t0 = (low - origin) * inverse;
+    const float t1 = (high - origin) * inverse;
+    nearDistance = std::max(nearDistance, std::min(t0, t1));
+    farDistance = std::min(farDistance, std::max(t0, t1));
+}
+
+static bool rayHitsBox(const Aabb& box, const Float3& origin, const Float3& inverse, float maxDistance, float& distance)
+{
+    float nearDistance = 0.0f;
+    float farDistance = maxDistance;
+    clipSlab(box.min.x, box.max.x, origin.x, inverse.x, nearDistance, farDistance);
+    clipSlab(box.min.y, box.max.y, origin.y, inverse.y, nearDistance, farDistance);
+    clipSlab(box.min.z, box.max.z, origin.z, inverse.z, nearDistance, farDistance);
+
+    distance = nearDistance;
+    return nearDistance <= farDistance;
+}
+
+bool Bvh::raycast(const Float3& origin, const Float3& direction, float maxDistance, uint32_t& primitive, float& distance) const
+{
+    if (nodes_.empty())
+        return false;
+
+    // a zero component gives an infinite inverse, which the slab tests
+    // handle as a ray parallel to that slab
+    const Float3 inverse = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+
+    const SimdFloat originX = simdSplat(origin.x), inverseX = simdSplat(inverse.x);
+    const SimdFloat originY = simdSplat(origin.y), inverseY = simdSplat(inverse.y);
+    const SimdFloat originZ = simdSplat(origin.z), inverseZ = simdSplat(inverse.z);
+    const SimdFloat zero = simdSplat(0.0f);
+
+    float closest = maxDistance;
+    bool found = false;
+
+    struct Entry
+    {
+        uint32_t node;
+        float distance;
+    };
+    Entry stack[stackSize_];
+    uint32_t size = 0;
+    stack[size++] = { 0, 0.0f };
+
+    while (size > 0) {
+        const Entry entry = stack[--size];
+        if (entry.distance > closest)
+            continue;
+
+        const Node& node = nodes_[entry.node];
+
+        const SimdFloat x0 = simdMul(simdSub(simdLoad(node.minX), originX), inverseX);
+        const SimdFloat x1 = simdMul(simdSub(simdLoad(node.maxX), originX), inverseX);
+        const SimdFloat y0 = simdMul(simdSub(simdLoad(node.minY), originY), inverseY);
+        const SimdFloat y1 = simdMul(simdSub(simdLoad(node.maxY), originY), inverseY);
+        const SimdFloat z0 = simdMul(simdSub(simdLoad(node.minZ), originZ), inverseZ);
+        const SimdFloat z1 = simdMul(simdSub(simdLoad(node.maxZ), originZ), inverseZ);
+
+        const SimdFloat nearDistance = simdMax(simdMax(simdMin(x0, x1), simdMin(y0, y1)), simdMax(simdMin(z0, z1), zero));
+        const SimdFloat farDistance = simdMin(simdMin(simdMax(x0, x1), simdMax(y0, y1)), simdMin(simdMax(z0, z1), simdSplat(closest)));
+        const uint32_t hit = ~simdMask(simdLess(farDistance, nearDistance));
+
+        float nearDistances[4];
+        simdStore(nearDistances, nearDistance);
+
+        // inner children are pushed farthest first so the nearest is
+        // visited next and shrinks closest for the others
+        Entry inner[4];
+        uint32_t innerCount = 0;
+
+        for (uint32_t lane = 0; lane < 4; ++lane) {
+            const uint32_t child = node.child[lane];
+            if (child == InvalidChild || (hit & (1u << lane)) == 0)
+                continue;
+
+            if (child != LeafChild) {
+                inner[innerCount++] = { child, nearDistances[lane] };
+                continue;
+            }
+
+            const uint32_t end = node.first[lane] + node.count[lane];
+            for (uint32_t i = node.first[lane]; i < end; ++i) {
+                float hitDistance;
+                if (rayHitsBox(primitiveBounds_[i], origin, inverse, closest, hitDistance) && (!found || hitDistance < closest)) {
+                    closest = hitDistance;
+                    primitive = primitives_[i];
+                    found = true;
+                }
+            }
+        }
+
+        for (uint32_t i = 1; i < innerCount; ++i) {
+            for (uint32_t j = i; j > 0 && inner[j - 1].distance < inner[j].distance; --j)
+                std::swap(inner[j - 1], inner[j]);
+        }
+        for (uint32_t i = 0; i < innerCount; ++i)
+            stack[size++] = inner[i];
+    }
+
+    if (found)
+        distance = closest;
+    return found;
+}
+
+static bool boxesOverlap(const Aabb& a, const Aabb& b)
+{
+    return a.min.x <= b.max.x && b.min.x <= a.max.x
+        && a.min.y <= b.max.y && b.min.y <= a.max.y
+        && a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+void Bvh::queryBox(const Aabb& box, std::vector<uint32_t>& result) const
+{
+    if (nodes_.empty())
+        return;
+
+    const SimdFloat queryMinX = simdSplat(box.min.x), queryMaxX = simdSplat(box.max.x);
+    const SimdFloat queryMinY = simdSplat(box.min.y), queryMaxY = simdSplat(box.max.y);
+    const SimdFloat queryMinZ = simdSplat(box.min.z), queryMaxZ = simdSplat(box.max.z);
+
+    uint32_t stack[stackSize_];
+    uint32_t size = 0;
+    stack[size++] = 0;
+
+    while (size > 0) {
+        const Node& node = nodes_[stack[--size]];
+
+        const SimdFloat minX = simdLoad(node.minX), maxX = simdLoad(node.maxX);
+        const SimdFloat minY = simdLoad(node.minY), maxY = simdLoad(node.maxY);
+        const SimdFloat minZ = simdLoad(node.minZ), maxZ = simdLoad(node.maxZ);
+
+        SimdFloat apart = simdOr(simdLess(maxX, queryMinX), simdLess(queryMaxX, minX));
+        apart = simdOr(apart, simdOr(simdLess(maxY, queryMinY), simdLess(queryMaxY, minY)));
+        apart = simdOr(apart, simdOr(simdLess(maxZ, queryMinZ), simdLess(queryMaxZ, minZ)));
+
+        SimdFloat sticksOut = simdOr(simdLess(minX, queryMinX), simdLess(queryMaxX, maxX));
+        sticksOut = simdOr(sticksOut, simdOr(simdLess(minY, queryMinY), simdLess(queryMaxY, maxY)));
+        sticksOut = simdOr(sticksOut, simdOr(simdLess(minZ, queryMinZ), simdLess(queryMaxZ, maxZ)));
+
+        const uint32_t overlapping = ~simdMask(apart);
+        const uint32_t contained = ~simdMask(sticksOut);
+
+        for (uint32_t lane = 0; lane < 4; ++lane) {
+            const uint32_t child = node.child[lane];
+            if (child == InvalidChild || (overlapping & (1u << lane)) == 0)
+                continue;
+
+            if (contained & (1u << lane)) {
+                appendRange(node.first[lane], node.count[lane], result);
+            } else if (child != LeafChild) {
+                stack[size++] = child;
+            } else {
+                const uint32_t end = node.first[lane] + node.count[lane];
+                for (uint32_t i = node.first[lane]; i < end; ++i) {
+                    if (boxesOverlap(primitiveBounds_[i], box))
+                        result.push_back(primitives_[i]);
+                }
+            }
+        }
+    }
+}
+
+// counts the entries of two sorted lists that are only in one of them
+static uint32_t countDifferences(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+    uint32_t differences = 0;
+    size_t i = 0, j = 0;
+    while (i < a.size() || j < b.size()) {
+        if (j == b.size() || (i < a.size() && a[i] < b[j])) {
+            ++differences;
+            ++i;
+        } else if (i == a.size() || b[j] < a[i]) {
+            ++differences;
+            ++j;
+        } else {
+            ++i;
+            ++j;
+        }
+    }
+    return differences;
+}
+
+BvhBenchmark measureBvh(uint32_t primitiveCount, uint32_t threadCount, uint32_t queryCount)
+{
+    BvhBenchmark result = {};
+    result.primitives = primitiveCount;
+    result.threads = threadCount + 1;
+    if (primitiveCount == 0)
+        return result;
+
+    // fixed seed lcg, every run builds the same scene
+    uint32_t seed = 0x12345678;
+    auto random = [&seed](float low, float high) {
+        seed = seed * 1664525u + 1013904223u;
+        return low + (high - low) * static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+    };
+
+    // a square kilometre of boxes, the same layout measureFrustumCulling()
+    // uses. CullingBounds gets the centers and extents the tree derives.
+    std::vector<Aabb> bounds(primitiveCount);
+    CullingBounds cullingBounds;
+    cullingBounds.resize(primitiveCount);
+    for (uint32_t i = 0; i < primitiveCount; ++i) {
+        const Float3 center = { random(-500.0f, 500.0f), random(-50.0f, 50.0f), random(-500.0f, 500.0f) };
+        const Float3 extents = { random(0.5f, 5.0f), random(0.5f, 5.0f), random(0.5f, 5.0f) };
+        bounds[i] = { { center.x - extents.x, center.y - extents.y, center.z - extents.z }, { center.x + extents.x, center.y + extents.y, center.z + extents.z } };
+
+        const Aabb& box = bounds[i];
+        const Float3 halfSize = { (box.max.x - box.min.x) * 0.5f, (box.max.y - box.min.y) * 0.5f, (box.max.z - box.min.z) * 0.5f };
+        cullingBounds.setBox(i, aabbCenter(box), halfSize);
+    }
+
+    JobSystem jobs;
+    jobs.start(threadCount);
+    JobSystem* buildJobs = threadCount > 0 ? &jobs : nullptr;
+
+    typedef std::chrono::duration<double> Seconds;
+
+    Bvh bvh;
+    auto start = std::chrono::steady_clock::now();
+    bvh.build(bounds.data(), primitiveCount, buildJobs);
+    result.buildSeconds = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+    result.nodes = bvh.nodeCount();
+    result.depth = bvh.depth();
+
+    // camera at the origin looking down z
+    const Float3 eye = { 0.0f, 0.0f, 0.0f };
+    const Float3 target = { 0.0f, 0.0f, 1.0f };
+    const Float3 up = { 0.0f, 1.0f, 0.0f };
+    const Float4x4 viewProjection = matrixMultiply(matrixLookAtLH(eye, target, up), matrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.1f, 500.0f));
+    const Frustum frustum = frustumFromMatrix(viewProjection);
+
+    const uint32_t cullIterations = 16;
+    std::vector<uint32_t> visible;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < cullIterations; ++i) {
+        visible.clear();
+        bvh.cullFrustum(frustum, visible);
+    }
+    result.cullSeconds = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count() / cullIterations;
+    result.visible = static_cast<uint32_t>(visible.size());
+
+    std::vector<uint32_t> bruteVisible;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < cullIterations; ++i)
+        cullObjects(frustum, cullingBounds, CullBoxes, buildJobs, bruteVisible);
+    result.bruteCullSeconds = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count() / cullIterations;
+
+    jobs.stop();
+
+    std::sort(visible.begin(), visible.end());
+    result.mismatches += countDifferences(visible, bruteVisible);
+
+    if (queryCount == 0)
+        return result;
+
+    // rays from anywhere in the scene in any direction, a kilometre long
+    std::vector<Float3> origins(queryCount);
+    std::vector<Float3> directions(queryCount);
+    for (uint32_t i = 0; i < queryCount; ++i) {
+        origins[i] = { random(-500.0f, 500.0f), random(-50.0f, 50.0f), random(-500.0f, 500.0f) };
+        directions[i] = { random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f) };
+    }
+    const float rayLength = 1000.0f;
+
+    std::vector<uint8_t> hits(queryCount);
+    std::vector<float> hitDistances(queryCount);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < queryCount; ++i) {
+        uint32_t primitive;
+        hits[i] = static_cast<uint8_t>(bvh.raycast(origins[i], directions[i], rayLength, primitive, hitDistances[i]));
+    }
+    result.raysPerSecond = queryCount / std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<Aabb> queries(queryCount);
+    for (uint32_t i = 0; i < queryCount; ++i) {
+        const Float3 center = { random(-500.0f, 500.0f), random(-50.0f, 50.0f), random(-500.0f, 500.0f) };
+        const Float3 extents = { random(5.0f, 25.0f), random(5.0f, 25.0f), random(5.0f, 25.0f) };
+        queries[i] = { { center.x - extents.x, center.y - extents.y, center.z - extents.z }, { center.x + extents.x, center.y + extents.y, center.z + extents.z } };
+    }
+
+    std::vector<uint32_t> found;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < queryCount; ++i) {
+        found.clear();
+        bvh.queryBox(queries[i], found);
+    }
+    result.boxQueriesPerSecond = queryCount / std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+
+    // brute force over every box is slow, a few of each is enough. Ties
+    // may pick a different box, so rays compare distances.
+    const uint32_t checks = std::min(queryCount, 32u);
+    for (uint32_t i = 0; i < checks; ++i) {
+        const Float3 inverse = { 1.0f / directions[i].x, 1.0f / directions[i].y, 1.0f / directions[i].z };
+        bool bruteFound = false;
+        float closest = rayLength;
+        for (uint32_t primitive = 0; primitive < primitiveCount; ++primitive) {
+            float hitDistance;
+            if (rayHitsBox(bounds[primitive], origins[i], inverse, closest, hitDistance) && (!bruteFound || hitDistance < closest)) {
+                closest = hitDistance;
+                bruteFound = true;
+            }
+        }
+        const bool hit = hits[i] != 0;
+        if (hit != bruteFound || (hit && hitDistances[i] != closest))
+            result.mismatches++;
+
+        found.clear();
+        bvh.queryBox(queries[i], found);
+        std::sort(found.begin(), found.end());
+
+        std::vector<uint32_t> bruteFoundBoxes;
+        for (uint32_t primitive = 0; primitive < primitiveCount; ++primitive) {
+            if (boxesOverlap(bounds[primitive], queries[i]))
+                bruteFoundBoxes.push_back(primitive);
+        }
+        result.mismatches += countDifferences(found, bruteFoundBoxes);
+    }
+
+    return result;
+}
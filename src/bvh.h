@@ -0,0 +1,95 @@
+#if !defined(BVH_H)
+#define BVH_H
+
+#include "scene_math.h"
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+struct Frustum;
+
+// Bounding volume hierarchy over object bounds for culling, picking and
+// range queries. It is built top down with binned SAH, subtrees are built
+// as jobs, and then collapsed into nodes of four children whose bounds are
+// stored as structure of arrays so one node is tested with a single SIMD
+// pass. Primitives are the indices of the boxes it was built from.
+//
+// The tree does not change after build(), moving objects need a rebuild.
+class Bvh
+{
+public:
+    Bvh();
+
+    // bounds must stay valid during the call only, jobs may be null to
+    // build on the calling thread
+    void build(const Aabb* bounds, uint32_t count, JobSystem* jobs);
+    void clear();
+
+    uint32_t primitiveCount() const { return static_cast<uint32_t>(primitives_.size()); }
+    uint32_t nodeCount() const { return static_cast<uint32_t>(nodes_.size()); }
+    uint32_t depth() const { return depth_; }
+
+    // primitives whose box intersects the frustum, the same ones
+    // cullObjects() keeps with CullBoxes. Subtrees entirely inside are
+    // taken without testing their primitives. Appends in tree order.
+    void cullFrustum(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+    // closest box the ray hits within maxDistance, the direction does not
+    // need unit length and distances are in multiples of it. A ray
+    // starting inside a box hits it at 0.
+    bool raycast(const Float3& origin, const Float3& direction, float maxDistance, uint32_t& primitive, float& distance) const;
+
+    // primitives whose box overlaps the box, touching counts. Appends in
+    // tree order.
+    void queryBox(const Aabb& box, std::vector<uint32_t>& result) const;
+
+private:
+    static const uint32_t InvalidChild = 0xffffffff;
+    static const uint32_t LeafChild = 0xfffffffe;
+
+    // children are another node, a leaf or an empty slot. Every child also
+    // has the range of primitives under it, so a subtree can be taken
+    // whole. 144 bytes.
+    struct Node
+    {
+        float minX[4], minY[4], minZ[4];
+        float maxX[4], maxY[4], maxZ[4];
+        uint32_t child[4];
+        uint32_t first[4];
+        uint32_t count[4];
+    };
+
+    friend struct BvhBuilder;
+
+    void appendRange(uint32_t first, uint32_t count, std::vector<uint32_t>& result) const;
+
+    std::vector<Node> nodes_;
+
+    // in tree order, the primitives of a subtree are contiguous
+    std::vector<uint32_t> primitives_;
+    std::vector<Aabb> primitiveBounds_;
+
+    uint32_t depth_;
+};
+
+struct BvhBenchmark
+{
+    uint32_t primitives;
+    uint32_t threads;
+    uint32_t nodes;
+    uint32_t depth;
+    double buildSeconds;
+    double cullSeconds;        // per frustum cull of the whole tree
+    double bruteCullSeconds;   // cullObjects() over every box
+    uint32_t visible;
+    double raysPerSecond;      // closest hit, one thread
+    double boxQueriesPerSecond;
+    uint32_t mismatches;       // queries brute force answers differently
+};
+
+// builds over primitiveCount random boxes of a city sized scene and runs
+// culls, rays and box queries against it
+BvhBenchmark measureBvh(uint32_t primitiveCount, uint32_t threadCount, uint32_t queryCount);
+
+#endif // BVH_H
@@ -0,0 +1,139 @@
+#include "command_capture.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Replays a command capture written by the renderer and reports what each
+// frame recorded, no GPU or graphics debugger needed. --repeat replays the
+// capture several times and reports the replay rate, a baseline for CPU
+// side benchmarks fed with captured frames.
+//
+// usage: dx12_capture_replay capture [--frames] [--repeat count]
+
+static void printUsage()
+{
+    printf("usage: dx12_capture_replay capture [--frames] [--repeat count]\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = nullptr;
+    bool printFrames = false;
+    uint32_t repeatCount = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--frames") == 0) {
+            printFrames = true;
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeatCount = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            printUsage();
+            return 2;
+        }
+    }
+
+    if (!path || repeatCount == 0) {
+        printUsage();
+        return 2;
+    }
+
+    CaptureReader reader;
+    if (!reader.load(path)) {
+        printf("%s is not a command capture\n", path);
+        return 1;
+    }
+
+    // records and bytes per op over the whole capture
+    uint64_t opRecords[CaptureOpCount] = {};
+    uint64_t opBytes[CaptureOpCount] = {};
+    uint64_t recordCount = 0;
+
+    CaptureRecord record;
+    while (reader.next(record)) {
+        if (record.op < CaptureOpCount) {
+            opRecords[record.op]++;
+            opBytes[record.op] += sizeof(CaptureRecordHeader) + record.size;
+        }
+        recordCount++;
+    }
+
+    typedef std::chrono::duration<double> Seconds;
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<CaptureFrameStats> frames;
+    for (uint32_t repeat = 0; repeat < repeatCount; ++repeat) {
+        if (!analyzeCapture(reader, frames)) {
+            printf("%s is malformed\n", path);
+            return 1;
+        }
+    }
+
+    const double seconds = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+
+    if (printFrames) {
+        printf("%10s %6s %8s %10s %8s %10s %8s %8s %10s\n", "frame", "lists", "draws", "instances", "states", "redundant", "barriers", "clears", "bytes");
+        for (const CaptureFrameStats& frame : frames) {
+            printf("%10llu %6u %8u %10llu %8u %10u %8u %8u %10u\n",
+                static_cast<unsigned long long>(frame.frame),
+                frame.commandLists,
+                frame.draws,
+                static_cast<unsigned long long>(frame.instances),
+                frame.stateChanges,
+                frame.redundantStateChanges,
+                frame.barriers,
+                frame.clears,
+                frame.bytes);
+        }
+    }
+
+    CaptureFrameStats total = {};
+    for (const CaptureFrameStats& frame : frames) {
+        total.commandLists += frame.commandLists;
+        total.draws += frame.draws;
+        total.instances += frame.instances;
+        total.indices += frame.indices;
+        total.stateChanges += frame.stateChanges;
+        total.redundantStateChanges += frame.redundantStateChanges;
+        total.barriers += frame.barriers;
+        total.clears += frame.clears;
+        total.bytes += frame.bytes;
+    }
+
+    const double frameCount = frames.empty() ? 1.0 : static_cast<double>(frames.size());
+
+    printf("%u frames, per frame: %.1f lists, %.1f draws, %.1f instances, %.1f indices\n",
+        static_cast<uint32_t>(frames.size()),
+        total.commandLists / frameCount,
+        total.draws / frameCount,
+        static_cast<double>(total.instances) / frameCount,
+        static_cast<double>(total.indices) / frameCount);
+    printf("  %.1f state changes, %.1f redundant (%.1f%%), %.1f barriers, %.1f clears, %.0f bytes\n",
+        total.stateChanges / frameCount,
+        total.redundantStateChanges / frameCount,
+        total.stateChanges > 0 ? 100.0 * total.redundantStateChanges / total.stateChanges : 0.0,
+        total.barriers / frameCount,
+        total.clears / frameCount,
+        total.bytes / frameCount);
+
+    for (uint32_t op = 0; op < CaptureOpCount; ++op) {
+        if (opRecords[op] == 0)
+            continue;
+        printf("  %-24s %10llu records %12llu bytes\n",
+            captureOpName(op),
+            static_cast<unsigned long long>(opRecords[op]),
+            static_cast<unsigned long long>(opBytes[op]));
+    }
+
+    printf("replayed %llu records %u times in %.3f s, %.1f M records/s\n",
+        static_cast<unsigned long long>(recordCount),
+        repeatCount,
+        seconds,
+        seconds > 0.0 ? static_cast<double>(recordCount) * repeatCount / seconds / 1000000.0 : 0.0);
+
+    return 0;
+}
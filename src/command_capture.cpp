@@ -0,0 +1,500 @@
+#include "command_capture.h"
+
+#include <cstddef>
+#include <cstring>
+#include <map>
+
+namespace {
+
+const char captureMagic[4] = { 'D', 'X', 'C', 'S' };
+
+const char* opNames[CaptureOpCount] = {
+    "FrameBegin",
+    "FrameEnd",
+    "ListBegin",
+    "ListEnd",
+    "SetPipelineState",
+    "SetRootSignature",
+    "SetDescriptorHeaps",
+    "SetRootDescriptorTable",
+    "SetRootConstantBuffer",
+    "SetRootShaderResource",
+    "SetRootConstants",
+    "SetRenderTargets",
+    "SetViewports",
+    "SetScissorRects",
+    "SetPrimitiveTopology",
+    "SetVertexBuffer",
+    "SetIndexBuffer",
+    "ClearRenderTarget",
+    "ClearDepthStencil",
+    "Barrier",
+    "DrawIndexed",
+};
+
+// grows the vector and copies into the new end, inserting a byte range
+// makes gcc warn about the source bounds at -O2
+template <typename T>
+void put(std::vector<uint8_t>& data, const T& value)
+{
+    const size_t oldSize = data.size();
+    data.resize(oldSize + sizeof(T));
+    memcpy(data.data() + oldSize, &value, sizeof(T));
+}
+
+void putBytes(std::vector<uint8_t>& data, const void* bytes, size_t size)
+{
+    if (size == 0)
+        return;
+
+    const size_t oldSize = data.size();
+    data.resize(oldSize + size);
+    memcpy(data.data() + oldSize, bytes, size);
+}
+
+template <typename T>
+T get(const uint8_t* bytes)
+{
+    T value;
+    memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+// the size is patched in by endRecord once the payload is known
+size_t beginRecord(std::vector<uint8_t>& data, CaptureOp op)
+{
+    const size_t record = data.size();
+
+    CaptureRecordHeader header = {};
+    header.op = op;
+    put(data, header);
+
+    return record;
+}
+
+void endRecord(std::vector<uint8_t>& data, size_t record)
+{
+    const uint16_t size = static_cast<uint16_t>(data.size() - record - sizeof(CaptureRecordHeader));
+    memcpy(&data[record + offsetof(CaptureRecordHeader, size)], &size, sizeof(size));
+}
+
+FILE* openFile(const char* path, const char* mode)
+{
+#if defined(_MSC_VER)
+    FILE* file = nullptr;
+    return fopen_s(&file, path, mode) == 0 ? file : nullptr;
+#else
+    return fopen(path, mode);
+#endif
+}
+
+bool isStateOp(uint32_t op)
+{
+    return op >= CaptureOpSetPipelineState && op <= CaptureOpSetIndexBuffer;
+}
+
+bool isRootParameterOp(uint32_t op)
+{
+    return op == CaptureOpSetRootDescriptorTable || op == CaptureOpSetRootConstantBuffer || op == CaptureOpSetRootShaderResource
+        || op == CaptureOpSetRootConstants;
+}
+
+// what a state op binds to, root parameters and vertex buffer slots are
+// bound independently of each other
+uint32_t stateKey(const CaptureRecord& record)
+{
+    if ((isRootParameterOp(record.op) || record.op == CaptureOpSetVertexBuffer) && record.size >= sizeof(uint32_t))
+        return (record.op << 8) | (get<uint32_t>(record.payload) & 0xff);
+    return record.op << 8;
+}
+
+} // namespace
+
+const char* captureOpName(uint32_t op)
+{
+    return op < CaptureOpCount ? opNames[op] : "Unknown";
+}
+
+void CommandCapture::reset(uint64_t pipelineState)
+{
+    data_.clear();
+
+    const size_t record = beginRecord(data_, CaptureOpListBegin);
+    put(data_, pipelineState);
+    endRecord(data_, record);
+}
+
+void CommandCapture::close()
+{
+    endRecord(data_, beginRecord(data_, CaptureOpListEnd));
+}
+
+void CommandCapture::setPipelineState(uint64_t pipelineState)
+{
+    const size_t record = beginRecord(data_, CaptureOpSetPipelineState);
+    put(data_, pipelineState);
+    endRecord(data_, record);
+}
+
+void CommandCapture::setRootSignature(uint64_t rootSignature)
+{
+    const size_t record = beginRecord(data_, CaptureOpSetRootSignature);
+    put(data_, rootSignature);
+    endRecord(data_, record);
+}
+
+void CommandCapture::setDescriptorHeaps(const uint64_t* heaps, uint32_t count)
+{
+    const size_t record = beginRecord(data_, CaptureOpSetDescriptorHeaps);
+    putBytes(data_, heaps, count * sizeof(uint64_t));
+    endRecord(data_, record);
+}
+
+void CommandCapture::setRootDescriptorTable(uint32_t parameter, uint64_t descriptor)
+{
+    const size_t record = beginRecord(data_, CaptureOpSetRootDescriptorTable);
+    put(data_, parameter);
+    put(data_, descriptor);
+    endRecord(data_, record);
+}
+
+void CommandCapture::setRootConstantBuffer(uint32_t parameter, uint64_t address)
+{
+    const size_t record = beginRecord(data_, CaptureOpSetRootConstantBuffer);
+    put(data_, parameter);
+    put(data_, address);
+    endRecord(data_, record);
+}
+
+void CommandCapture::setRootShaderResource(uint32_t parameter, uint64_t address)
+{
+    const size_t record = beginRecord(data_, CaptureOpSetRootShaderResource);
+    put(data_, parameter);
+    put(data_, address);
+    endRecord(data_, record);
+}
+
+void CommandCapture::setRootConstants(uint32_t parameter, const void* values, uint32_t count, uint32_t offset)
+{
+    const size_t record = beginRecord(data_, CaptureOpSetRootConstants);
+    put(data_, parameter);
+    put(data_, offset);
+    putBytes(data_, values, count * sizeof(uint32_t));
+    endRecord(data_, record);
+}
+
+void CommandCapture::setRenderTargets(const uint64_t* targets, uint32_t count, uint64_t depthStencil)
+{
+    const size_t record = beginRecord(data_, CaptureOpSetRenderTargets);
+    put(data_, count);
+    putBytes(data_, targets, count * sizeof(uint64_t));
+    put(data_, depthStencil);
+    endRecord(data_, record);
+}
+
+void CommandCapture::setViewports(const float* viewports, uint32_t count)
+{
+    const size_t record = beginRecord(data_, CaptureOpSetViewports);
+    putBytes(data_, viewports, count * 6 * sizeof(float));
+    endRecord(data_, record);
+}
+
+void CommandCapture::setScissorRects(const int32_t* rects, uint32_t count)
+{
+    const size_t record = beginRecord(data_, CaptureOpSetScissorRects);
+    putBytes(data_, rects, count * 4 * sizeof(int32_t));
+    endRecord(data_, record);
+}
+
+void CommandCapture::setPrimitiveTopology(uint32_t topology)
+{
+    const size_t record = beginRecord(data_, CaptureOpSetPrimitiveTopology);
+    put(data_, topology);
+    endRecord(data_, record);
+}
+
+void CommandCapture::setVertexBuffer(uint32_t slot, uint64_t address, uint32_t size, uint32_t stride)
+{
+    const size_t record = beginRecord(data_, CaptureOpSetVertexBuffer);
+    put(data_, slot);
+    put(data_, address);
+    put(data_, size);
+    put(data_, stride);
+    endRecord(data_, record);
+}
+
+void CommandCapture::setIndexBuffer(uint64_t address, uint32_t size, uint32_t format)
+{
+    const size_t record = beginRecord(data_, CaptureOpSetIndexBuffer);
+    put(data_, address);
+    put(data_, size);
+    put(data_, format);
+    endRecord(data_, record);
+}
+
+void CommandCapture::clearRenderTarget(uint64_t target, const float* color)
+{
+    const size_t record = beginRecord(data_, CaptureOpClearRenderTarget);
+    put(data_, target);
+    putBytes(data_, color, 4 * sizeof(float));
+    endRecord(data_, record);
+}
+
+void CommandCapture::clearDepthStencil(uint64_t target, uint32_t flags, float depth, uint32_t stencil)
+{
+    const size_t record = beginRecord(data_, CaptureOpClearDepthStencil);
+    put(data_, target);
+    put(data_, flags);
+    put(data_, depth);
+    put(data_, stencil);
+    endRecord(data_, record);
+}
+
+void CommandCapture::barrier(uint32_t type, uint64_t resource, uint32_t stateBefore, uint32_t stateAfter)
+{
+    const size_t record = beginRecord(data_, CaptureOpBarrier);
+    put(data_, type);
+    put(data_, resource);
+    put(data_, stateBefore);
+    put(data_, stateAfter);
+    endRecord(data_, record);
+}
+
+void CommandCapture::drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance)
+{
+    const size_t record = beginRecord(data_, CaptureOpDrawIndexed);
+    put(data_, indexCount);
+    put(data_, instanceCount);
+    put(data_, firstIndex);
+    put(data_, baseVertex);
+    put(data_, firstInstance);
+    endRecord(data_, record);
+}
+
+CaptureFile::CaptureFile()
+    : file_(nullptr)
+{
+}
+
+CaptureFile::~CaptureFile()
+{
+    close();
+}
+
+bool CaptureFile::open(const char* path)
+{
+    close();
+
+    file_ = openFile(path, "wb");
+    if (!file_)
+        return false;
+
+    CaptureFileHeader header;
+    memcpy(header.magic, captureMagic, sizeof(header.magic));
+    header.version = captureVersion;
+
+    if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void CaptureFile::close()
+{
+    if (file_)
+        fclose(file_);
+    file_ = nullptr;
+}
+
+void CaptureFile::beginFrame(uint64_t frame)
+{
+    frame_.clear();
+
+    const size_t record = beginRecord(frame_, CaptureOpFrameBegin);
+    put(frame_, frame);
+    endRecord(frame_, record);
+}
+
+void CaptureFile::submit(const CommandCapture* const* lists, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        frame_.insert(frame_.end(), lists[i]->data().begin(), lists[i]->data().end());
+}
+
+bool CaptureFile::endFrame()
+{
+    endRecord(frame_, beginRecord(frame_, CaptureOpFrameEnd));
+
+    if (!file_)
+        return false;
+
+    // one write per frame, the stdio buffer takes care of the rest
+    return fwrite(frame_.data(), 1, frame_.size(), file_) == frame_.size();
+}
+
+CaptureReader::CaptureReader()
+    : offset_(0)
+{
+}
+
+bool CaptureReader::load(const char* path)
+{
+    FILE* file = openFile(path, "rb");
+    if (!file)
+        return false;
+
+    std::vector<uint8_t> data;
+    uint8_t buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.insert(data.end(), buffer, buffer + read);
+
+    const bool failed = ferror(file) != 0;
+    fclose(file);
+
+    return !failed && setData(std::move(data));
+}
+
+bool CaptureReader::setData(std::vector<uint8_t> data)
+{
+    data_ = std::move(data);
+    offset_ = 0;
+
+    if (data_.size() < sizeof(CaptureFileHeader))
+        return false;
+
+    const CaptureFileHeader header = get<CaptureFileHeader>(data_.data());
+    if (memcmp(header.magic, captureMagic, sizeof(header.magic)) != 0 || header.version != captureVersion)
+        return false;
+
+    rewind();
+    return true;
+}
+
+bool CaptureReader::next(CaptureRecord& record)
+{
+    if (offset_ + sizeof(CaptureRecordHeader) > data_.size())
+        return false;
+
+    const CaptureRecordHeader header = get<CaptureRecordHeader>(&data_[offset_]);
+    const size_t payload = offset_ + sizeof(CaptureRecordHeader);
+    if (payload + header.size > data_.size())
+        return false;
+
+    record.op = header.op;
+    record.payload = data_.data() + payload;
+    record.size = header.size;
+
+    offset_ = payload + header.size;
+    return true;
+}
+
+void CaptureReader::rewind()
+{
+    offset_ = data_.size() < sizeof(CaptureFileHeader) ? data_.size() : sizeof(CaptureFileHeader);
+}
+
+bool analyzeCapture(CaptureReader& reader, std::vector<CaptureFrameStats>& frames)
+{
+    frames.clear();
+    reader.rewind();
+
+    // what the current list has bound, lists do not inherit state
+    std::map<uint32_t, std::vector<uint8_t>> bound;
+    CaptureFrameStats* frame = nullptr;
+    bool inList = false;
+
+    CaptureRecord record;
+    while (reader.next(record)) {
+        if (record.op == CaptureOpFrameBegin) {
+            if (frame || record.size < sizeof(uint64_t))
+                return false;
+
+            frames.push_back(CaptureFrameStats());
+            frame = &frames.back();
+            frame->frame = get<uint64_t>(record.payload);
+        }
+
+        if (!frame)
+            return false;
+        frame->bytes += static_cast<uint32_t>(sizeof(CaptureRecordHeader) + record.size);
+
+        switch (record.op) {
+        case CaptureOpFrameBegin:
+            break;
+
+        case CaptureOpFrameEnd:
+            if (inList)
+                return false;
+            frame = nullptr;
+            break;
+
+        case CaptureOpListBegin:
+            if (inList || record.size < sizeof(uint64_t))
+                return false;
+            inList = true;
+            frame->commandLists++;
+
+            // the pipeline state the list was reset with counts as bound
+            bound.clear();
+            bound[CaptureOpSetPipelineState << 8].assign(record.payload, record.payload + record.size);
+            break;
+
+        case CaptureOpListEnd:
+            if (!inList)
+                return false;
+            inList = false;
+            break;
+
+        case CaptureOpClearRenderTarget:
+        case CaptureOpClearDepthStencil:
+            frame->clears++;
+            break;
+
+        case CaptureOpBarrier:
+            frame->barriers++;
+            break;
+
+        case CaptureOpDrawIndexed:
+            if (record.size < 2 * sizeof(uint32_t))
+                return false;
+            frame->draws++;
+            frame->instances += get<uint32_t>(record.payload + sizeof(uint32_t));
+            frame->indices += static_cast<uint64_t>(get<uint32_t>(record.payload)) * get<uint32_t>(record.payload + sizeof(uint32_t));
+            break;
+
+        default:
+            if (!isStateOp(record.op))
+                return false;
+
+            frame->stateChanges++;
+
+            std::vector<uint8_t>& current = bound[stateKey(record)];
+            if (current.size() == record.size && memcmp(current.data(), record.payload, record.size) == 0)
+                frame->redundantStateChanges++;
+            current.assign(record.payload, record.payload + record.size);
+
+            // a new root signature resets every root parameter
+            if (record.op == CaptureOpSetRootSignature) {
+                for (auto it = bound.begin(); it != bound.end();) {
+                    if (isRootParameterOp(it->first >> 8))
+                        it = bound.erase(it);
+                    else
+                        ++it;
+                }
+            }
+            break;
+        }
+
+        if (!inList && record.op != CaptureOpFrameBegin && record.op != CaptureOpFrameEnd && record.op != CaptureOpListEnd)
+            return false;
+    }
+
+    // a capture cut short loses its last frame, the rest is still fine
+    if (frame)
+        frames.pop_back();
+
+    return true;
+}
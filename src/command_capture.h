@@ -0,0 +1,164 @@
+#if !defined(COMMAND_CAPTURE_H)
+#define COMMAND_CAPTURE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Binary capture of recorded commands. Every command list records into its
+// own CommandCapture, lists are appended to the file in submission order.
+// Resources, descriptors and pipeline objects are stored as the 64-bit
+// handle values the API used, which identify them within one capture.
+//
+// File layout: CaptureFileHeader, then records of a CaptureRecordHeader
+// followed by size bytes of payload. Payloads are little-endian and packed.
+
+enum CaptureOp : uint8_t
+{
+    CaptureOpFrameBegin = 0,         // u64 frame
+    CaptureOpFrameEnd,
+    CaptureOpListBegin,              // u64 initial pipeline state
+    CaptureOpListEnd,
+    CaptureOpSetPipelineState,       // u64 pipeline state
+    CaptureOpSetRootSignature,       // u64 root signature
+    CaptureOpSetDescriptorHeaps,     // u64 heap per heap
+    CaptureOpSetRootDescriptorTable, // u32 parameter, u64 gpu descriptor
+    CaptureOpSetRootConstantBuffer,  // u32 parameter, u64 gpu address
+    CaptureOpSetRootShaderResource,  // u32 parameter, u64 gpu address
+    CaptureOpSetRootConstants,       // u32 parameter, u32 offset, u32 per value
+    CaptureOpSetRenderTargets,       // u32 count, u64 per target, u64 depth stencil
+    CaptureOpSetViewports,           // 6 floats per viewport
+    CaptureOpSetScissorRects,        // 4 i32 per rect
+    CaptureOpSetPrimitiveTopology,   // u32 topology
+    CaptureOpSetVertexBuffer,        // u32 slot, u64 address, u32 size, u32 stride
+    CaptureOpSetIndexBuffer,         // u64 address, u32 size, u32 format
+    CaptureOpClearRenderTarget,      // u64 target, 4 floats color
+    CaptureOpClearDepthStencil,      // u64 target, u32 flags, f32 depth, u32 stencil
+    CaptureOpBarrier,                // u32 type, u64 resource, u32 state before, u32 state after
+    CaptureOpDrawIndexed,            // u32 indices, u32 instances, u32 first index, i32 base vertex, u32 first instance
+    CaptureOpCount,
+};
+
+const char* captureOpName(uint32_t op);
+
+#pragma pack(push, 1)
+struct CaptureFileHeader
+{
+    char magic[4]; // "DXCS"
+    uint32_t version;
+};
+
+struct CaptureRecordHeader
+{
+    uint8_t op;
+    uint8_t reserved;
+    uint16_t size;
+};
+#pragma pack(pop)
+
+constexpr uint32_t captureVersion = 2;
+
+// commands of one command list. Lists are recorded on any thread, but one
+// list only ever on one thread at a time.
+class CommandCapture
+{
+public:
+    // starts over for a list reset with the pipeline state
+    void reset(uint64_t pipelineState);
+    void close();
+
+    void setPipelineState(uint64_t pipelineState);
+    void setRootSignature(uint64_t rootSignature);
+    void setDescriptorHeaps(const uint64_t* heaps, uint32_t count);
+    void setRootDescriptorTable(uint32_t parameter, uint64_t descriptor);
+    void setRootConstantBuffer(uint32_t parameter, uint64_t address);
+    void setRootShaderResource(uint32_t parameter, uint64_t address);
+    void setRootConstants(uint32_t parameter, const void* values, uint32_t count, uint32_t offset);
+    void setRenderTargets(const uint64_t* targets, uint32_t count, uint64_t depthStencil);
+    void setViewports(const float* viewports, uint32_t count);
+    void setScissorRects(const int32_t* rects, uint32_t count);
+    void setPrimitiveTopology(uint32_t topology);
+    void setVertexBuffer(uint32_t slot, uint64_t address, uint32_t size, uint32_t stride);
+    void setIndexBuffer(uint64_t address, uint32_t size, uint32_t format);
+    void clearRenderTarget(uint64_t target, const float* color);
+    void clearDepthStencil(uint64_t target, uint32_t flags, float depth, uint32_t stencil);
+    void barrier(uint32_t type, uint64_t resource, uint32_t stateBefore, uint32_t stateAfter);
+    void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance);
+
+    const std::vector<uint8_t>& data() const { return data_; }
+
+private:
+    std::vector<uint8_t> data_;
+};
+
+// writes frames to disk, a frame is buffered and written in one go when it
+// ends. Only one thread may use it.
+class CaptureFile
+{
+public:
+    CaptureFile();
+    ~CaptureFile();
+
+    bool open(const char* path);
+    void close();
+    bool isOpen() const { return file_ != nullptr; }
+
+    void beginFrame(uint64_t frame);
+
+    // lists in the order they were submitted
+    void submit(const CommandCapture* const* lists, uint32_t count);
+
+    bool endFrame();
+
+private:
+    CaptureFile(const CaptureFile&) = delete;
+    CaptureFile& operator=(const CaptureFile&) = delete;
+
+    FILE* file_;
+    std::vector<uint8_t> frame_;
+};
+
+struct CaptureFrameStats
+{
+    uint64_t frame;
+    uint32_t commandLists;
+    uint32_t draws;
+    uint64_t instances;
+    uint64_t indices;
+    uint32_t stateChanges;
+    uint32_t redundantStateChanges; // set to what the list already had bound
+    uint32_t barriers;
+    uint32_t clears;
+    uint32_t bytes;
+};
+
+struct CaptureRecord
+{
+    uint32_t op;
+    const uint8_t* payload;
+    uint32_t size;
+};
+
+// walks the records of a capture held in memory
+class CaptureReader
+{
+public:
+    CaptureReader();
+
+    bool load(const char* path);
+    bool setData(std::vector<uint8_t> data);
+
+    // false at the end, a record cut short ends the stream as well
+    bool next(CaptureRecord& record);
+    void rewind();
+
+private:
+    std::vector<uint8_t> data_;
+    size_t offset_;
+};
+
+// replays the records into per frame statistics, false if the stream is
+// malformed. A frame the capture ended in the middle of is dropped.
+bool analyzeCapture(CaptureReader& reader, std::vector<CaptureFrameStats>& frames);
+
+#endif // COMMAND_CAPTURE_H
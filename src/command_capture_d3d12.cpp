@@ -0,0 +1,175 @@
+#include "command_capture_d3d12.h"
+
+uint64_t captureHandle(const void* object)
+{
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(object));
+}
+
+D3D12CapturedList::D3D12CapturedList(ID3D12GraphicsCommandList* list, CommandCapture* capture)
+    : list_(list)
+    , capture_(capture)
+{
+}
+
+HRESULT D3D12CapturedList::close()
+{
+    if (capture_)
+        capture_->close();
+    return list_->Close();
+}
+
+void D3D12CapturedList::setPipelineState(ID3D12PipelineState* pipelineState)
+{
+    if (capture_)
+        capture_->setPipelineState(captureHandle(pipelineState));
+    list_->SetPipelineState(pipelineState);
+}
+
+void D3D12CapturedList::setRootSignature(ID3D12RootSignature* rootSignature)
+{
+    if (capture_)
+        capture_->setRootSignature(captureHandle(rootSignature));
+    list_->SetGraphicsRootSignature(rootSignature);
+}
+
+void D3D12CapturedList::setDescriptorHeaps(UINT count, ID3D12DescriptorHeap* const* heaps)
+{
+    if (capture_) {
+        // shader visible heaps, one per type at most
+        uint64_t handles[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
+        const UINT captured = count < D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES ? count : D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES;
+        for (UINT i = 0; i < captured; ++i)
+            handles[i] = captureHandle(heaps[i]);
+        capture_->setDescriptorHeaps(handles, captured);
+    }
+    list_->SetDescriptorHeaps(count, heaps);
+}
+
+void D3D12CapturedList::setRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE descriptor)
+{
+    if (capture_)
+        capture_->setRootDescriptorTable(parameter, descriptor.ptr);
+    list_->SetGraphicsRootDescriptorTable(parameter, descriptor);
+}
+
+void D3D12CapturedList::setRootConstantBufferView(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    if (capture_)
+        capture_->setRootConstantBuffer(parameter, address);
+    list_->SetGraphicsRootConstantBufferView(parameter, address);
+}
+
+void D3D12CapturedList::setRootShaderResourceView(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    if (capture_)
+        capture_->setRootShaderResource(parameter, address);
+    list_->SetGraphicsRootShaderResourceView(parameter, address);
+}
+
+void D3D12CapturedList::setRoot32BitConstants(UINT parameter, UINT count, const void* values, UINT offset)
+{
+    if (capture_)
+        capture_->setRootConstants(parameter, values, count, offset);
+    list_->SetGraphicsRoot32BitConstants(parameter, count, values, offset);
+}
+
+void D3D12CapturedList::setRenderTargets(UINT count, const D3D12_CPU_DESCRIPTOR_HANDLE* targets, const D3D12_CPU_DESCRIPTOR_HANDLE* depthStencil)
+{
+    if (capture_) {
+        uint64_t handles[D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT];
+        const UINT captured = count < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT ? count : D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT;
+        for (UINT i = 0; i < captured; ++i)
+            handles[i] = targets[i].ptr;
+        capture_->setRenderTargets(handles, captured, depthStencil ? depthStencil->ptr : 0);
+    }
+    list_->OMSetRenderTargets(count, targets, false, depthStencil);
+}
+
+void D3D12CapturedList::setViewports(UINT count, const D3D12_VIEWPORT* viewports)
+{
+    // D3D12_VIEWPORT is six floats, so is the captured viewport
+    if (capture_)
+        capture_->setViewports(&viewports->TopLeftX, count);
+    list_->RSSetViewports(count, viewports);
+}
+
+void D3D12CapturedList::setScissorRects(UINT count, const D3D12_RECT* rects)
+{
+    if (capture_) {
+        int32_t captured[D3D12_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE * 4];
+        const UINT capturedCount = count < D3D12_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE ? count : D3D12_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+        for (UINT i = 0; i < capturedCount; ++i) {
+            captured[i * 4 + 0] = rects[i].left;
+            captured[i * 4 + 1] = rects[i].top;
+            captured[i * 4 + 2] = rects[i].right;
+            captured[i * 4 + 3] = rects[i].bottom;
+        }
+        capture_->setScissorRects(captured, capturedCount);
+    }
+    list_->RSSetScissorRects(count, rects);
+}
+
+void D3D12CapturedList::setPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+    if (capture_)
+        capture_->setPrimitiveTopology(static_cast<uint32_t>(topology));
+    list_->IASetPrimitiveTopology(topology);
+}
+
+void D3D12CapturedList::setVertexBuffers(UINT firstSlot, UINT count, const D3D12_VERTEX_BUFFER_VIEW* views)
+{
+    if (capture_) {
+        for (UINT i = 0; i < count; ++i)
+            capture_->setVertexBuffer(firstSlot + i, views[i].BufferLocation, views[i].SizeInBytes, views[i].StrideInBytes);
+    }
+    list_->IASetVertexBuffers(firstSlot, count, views);
+}
+
+void D3D12CapturedList::setIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view)
+{
+    if (capture_)
+        capture_->setIndexBuffer(view->BufferLocation, view->SizeInBytes, static_cast<uint32_t>(view->Format));
+    list_->IASetIndexBuffer(view);
+}
+
+void D3D12CapturedList::clearRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE target, const FLOAT* color)
+{
+    if (capture_)
+        capture_->clearRenderTarget(target.ptr, color);
+    list_->ClearRenderTargetView(target, color, 0, nullptr);
+}
+
+void D3D12CapturedList::clearDepthStencil(D3D12_CPU_DESCRIPTOR_HANDLE target, D3D12_CLEAR_FLAGS flags, FLOAT depth, UINT8 stencil)
+{
+    if (capture_)
+        capture_->clearDepthStencil(target.ptr, static_cast<uint32_t>(flags), depth, stencil);
+    list_->ClearDepthStencilView(target, flags, depth, stencil, 0, nullptr);
+}
+
+void D3D12CapturedList::resourceBarrier(UINT count, const D3D12_RESOURCE_BARRIER* barriers)
+{
+    if (capture_) {
+        for (UINT i = 0; i < count; ++i) {
+            const D3D12_RESOURCE_BARRIER& barrier = barriers[i];
+            switch (barrier.Type) {
+            case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+                capture_->barrier(barrier.Type, captureHandle(barrier.Transition.pResource), barrier.Transition.StateBefore, barrier.Transition.StateAfter);
+                break;
+            case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+                capture_->barrier(barrier.Type, captureHandle(barrier.Aliasing.pResourceAfter), 0, 0);
+                break;
+            default:
+                capture_->barrier(barrier.Type, captureHandle(barrier.UAV.pResource), 0, 0);
+                break;
+            }
+        }
+    }
+    list_->ResourceBarrier(count, barriers);
+}
+
+void D3D12CapturedList::drawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT firstIndex, INT baseVertex, UINT firstInstance)
+{
+    if (capture_)
+        capture_->drawIndexed(indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+    list_->DrawIndexedInstanced(indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+}
@@ -0,0 +1,48 @@
+#if !defined(COMMAND_CAPTURE_D3D12_H)
+#define COMMAND_CAPTURE_D3D12_H
+
+#include "command_capture.h"
+
+#include <d3d12.h>
+
+// objects are captured by their address, descriptors and buffers by the
+// handle or GPU address the list was given
+uint64_t captureHandle(const void* object);
+
+// Forwards to a command list and records every call into a capture as
+// well. Without a capture it only forwards, so recording code can use it
+// whether or not a capture is running.
+class D3D12CapturedList
+{
+public:
+    D3D12CapturedList(ID3D12GraphicsCommandList* list, CommandCapture* capture);
+
+    ID3D12GraphicsCommandList* list() const { return list_; }
+    CommandCapture* capture() const { return capture_; }
+
+    HRESULT close();
+
+    void setPipelineState(ID3D12PipelineState* pipelineState);
+    void setRootSignature(ID3D12RootSignature* rootSignature);
+    void setDescriptorHeaps(UINT count, ID3D12DescriptorHeap* const* heaps);
+    void setRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE descriptor);
+    void setRootConstantBufferView(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address);
+    void setRootShaderResourceView(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address);
+    void setRoot32BitConstants(UINT parameter, UINT count, const void* values, UINT offset);
+    void setRenderTargets(UINT count, const D3D12_CPU_DESCRIPTOR_HANDLE* targets, const D3D12_CPU_DESCRIPTOR_HANDLE* depthStencil);
+    void setViewports(UINT count, const D3D12_VIEWPORT* viewports);
+    void setScissorRects(UINT count, const D3D12_RECT* rects);
+    void setPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology);
+    void setVertexBuffers(UINT firstSlot, UINT count, const D3D12_VERTEX_BUFFER_VIEW* views);
+    void setIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view);
+    void clearRenderTarget(D3D12_CPU_DESCRIPTOR_HANDLE target, const FLOAT* color);
+    void clearDepthStencil(D3D12_CPU_DESCRIPTOR_HANDLE target, D3D12_CLEAR_FLAGS flags, FLOAT depth, UINT8 stencil);
+    void resourceBarrier(UINT count, const D3D12_RESOURCE_BARRIER* barriers);
+    void drawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT firstIndex, INT baseVertex, UINT firstInstance);
+
+private:
+    ID3D12GraphicsCommandList* list_;
+    CommandCapture* capture_;
+};
+
+#endif // COMMAND_CAPTURE_D3D12_H
@@ -0,0 +1,127 @@
+#include "command_recording.h"
+
+#include <algorithm>
+#include <chrono>
+
+void partitionDraws(uint32_t drawCount, uint32_t maxChunks, uint32_t minDrawsPerChunk, std::vector<DrawRange>& chunks)
+{
+    chunks.clear();
+    if (drawCount == 0)
+        return;
+
+    const uint32_t chunkLimit = std::max(drawCount / std::max(minDrawsPerChunk, 1u), 1u);
+    const uint32_t chunkCount = std::min(std::max(maxChunks, 1u), chunkLimit);
+
+    // the first drawCount % chunkCount chunks get one extra draw
+    const uint32_t size = drawCount / chunkCount;
+    const uint32_t remainder = drawCount % chunkCount;
+
+    uint32_t begin = 0;
+    for (uint32_t i = 0; i < chunkCount; ++i) {
+        const uint32_t end = begin + size + (i < remainder ? 1 : 0);
+        chunks.push_back({ begin, end });
+        begin = end;
+    }
+}
+
+ParallelRecorder::ParallelRecorder(JobSystem& jobs)
+    : jobs_(jobs)
+{
+}
+
+uint32_t ParallelRecorder::currentWorker() const
+{
+    const uint32_t worker = jobs_.currentWorker();
+    return worker != JobSystem::ExternalThread ? worker : jobs_.workerCount();
+}
+
+void ParallelRecorder::record(const DrawRange* chunks, uint32_t chunkCount, CommandRecordingBackend& backend)
+{
+    // one chunk per job, a slow chunk does not hold up the others
+    jobs_.parallelFor(0, chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+        const uint32_t worker = currentWorker();
+        for (uint32_t chunk = begin; chunk < end; ++chunk)
+            backend.recordChunk(chunk, chunks[chunk], worker);
+    });
+}
+
+// writes a fixed size command per draw into a per-chunk stream, which is
+// roughly what recording a draw into a command list costs
+class MemoryRecordingBackend : public CommandRecordingBackend
+{
+public:
+    MemoryRecordingBackend(uint32_t chunkCount, uint32_t workerCount)
+        : streams_(chunkCount)
+        , workers_(chunkCount, 0)
+        , workerCount_(workerCount)
+    {
+    }
+
+    void recordChunk(uint32_t chunk, const DrawRange& range, uint32_t worker) override
+    {
+        workers_[chunk] = worker;
+
+        std::vector<uint32_t>& stream = streams_[chunk];
+        stream.clear();
+        stream.reserve((range.end - range.begin) * commandSize);
+
+        for (uint32_t draw = range.begin; draw < range.end; ++draw) {
+            // root constant buffer view, root constants and the draw itself
+            for (uint32_t word = 0; word < commandSize; ++word)
+                stream.push_back(command(draw, word));
+        }
+    }
+
+    // the streams in chunk order have to be the draws in order
+    uint32_t mismatches(uint32_t drawCount) const
+    {
+        uint32_t wrong = 0;
+        uint32_t draw = 0;
+        for (size_t chunk = 0; chunk < streams_.size(); ++chunk) {
+            const std::vector<uint32_t>& stream = streams_[chunk];
+            wrong += workers_[chunk] >= workerCount_;
+            wrong += stream.size() % commandSize != 0;
+
+            for (size_t at = 0; at + commandSize <= stream.size(); at += commandSize, ++draw)
+                wrong += stream[at] != command(draw, 0) || stream[at + commandSize - 1] != command(draw, commandSize - 1);
+        }
+
+        return wrong + (draw > drawCount ? draw - drawCount : drawCount - draw);
+    }
+
+private:
+    static const uint32_t commandSize = 16;
+
+    static uint32_t command(uint32_t draw, uint32_t word) { return draw * 2654435761u + word; }
+
+    std::vector<std::vector<uint32_t>> streams_;
+    std::vector<uint32_t> workers_;
+    uint32_t workerCount_;
+};
+
+RecordingBenchmark measureParallelRecording(uint32_t drawCount, uint32_t threadCount, uint32_t minDrawsPerChunk)
+{
+    RecordingBenchmark result = {};
+
+    JobSystem jobs;
+    jobs.start(threadCount);
+
+    ParallelRecorder recorder(jobs);
+
+    std::vector<DrawRange> chunks;
+    partitionDraws(drawCount, recorder.workerCount(), minDrawsPerChunk, chunks);
+
+    MemoryRecordingBackend backend(static_cast<uint32_t>(chunks.size()), recorder.workerCount());
+
+    typedef std::chrono::duration<double> Seconds;
+    const auto start = std::chrono::steady_clock::now();
+
+    recorder.record(chunks.data(), static_cast<uint32_t>(chunks.size()), backend);
+
+    result.seconds = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+    result.threads = jobs.workerCount();
+    result.chunkCount = static_cast<uint32_t>(chunks.size());
+    result.mismatches = backend.mismatches(drawCount);
+
+    return result;
+}
@@ -0,0 +1,71 @@
+#if !defined(COMMAND_RECORDING_H)
+#define COMMAND_RECORDING_H
+
+#include "job_system.h"
+
+#include <cstdint>
+#include <vector>
+
+// Splits a draw list into contiguous chunks and records them in parallel,
+// one command list per chunk. Submitting the lists in chunk order keeps the
+// draw order. The backend does the actual recording, so partitioning and
+// threading can be measured without a device.
+
+struct DrawRange
+{
+    uint32_t begin;
+    uint32_t end;
+};
+
+// at most maxChunks chunks of at least minDrawsPerChunk draws each, chunk
+// sizes differ by one draw at most
+void partitionDraws(uint32_t drawCount, uint32_t maxChunks, uint32_t minDrawsPerChunk, std::vector<DrawRange>& chunks);
+
+class CommandRecordingBackend
+{
+public:
+    virtual ~CommandRecordingBackend() {}
+
+    // called on any worker, worker identifies the thread so per-thread
+    // resources (allocators) need no locking
+    virtual void recordChunk(uint32_t chunk, const DrawRange& range, uint32_t worker) = 0;
+};
+
+// runs the chunks as jobs. Workers are the job system's workers plus one
+// for a thread outside of it calling record(), only one such thread may
+// record at a time.
+class ParallelRecorder
+{
+public:
+    explicit ParallelRecorder(JobSystem& jobs);
+
+    uint32_t workerCount() const { return jobs_.workerCount() + 1; }
+
+    // worker the calling thread records with
+    uint32_t currentWorker() const;
+
+    // returns once every chunk is recorded, the calling thread records
+    // chunks too
+    void record(const DrawRange* chunks, uint32_t chunkCount, CommandRecordingBackend& backend);
+
+private:
+    ParallelRecorder(const ParallelRecorder&) = delete;
+    ParallelRecorder& operator=(const ParallelRecorder&) = delete;
+
+    JobSystem& jobs_;
+};
+
+struct RecordingBenchmark
+{
+    uint32_t threads;    // the calling thread included
+    uint32_t chunkCount; // one per recorder worker
+    double seconds;
+    uint32_t mismatches; // draws recorded out of order, twice or not at all, and bad worker ids
+};
+
+// records drawCount draws into memory with a backend that mimics command
+// list writes, nothing is submitted. The streams are then checked against
+// the draw order.
+RecordingBenchmark measureParallelRecording(uint32_t drawCount, uint32_t threadCount, uint32_t minDrawsPerChunk);
+
+#endif // COMMAND_RECORDING_H
@@ -0,0 +1,67 @@
+#include "command_recording_d3d12.h"
+
+D3D12CommandListPool::D3D12CommandListPool()
+    : device_(nullptr)
+    , type_(D3D12_COMMAND_LIST_TYPE_DIRECT)
+{
+}
+
+bool D3D12CommandListPool::init(ID3D12Device* device, D3D12_COMMAND_LIST_TYPE type, uint32_t workerCount)
+{
+    if (!device || workerCount == 0)
+        return false;
+
+    device_ = device;
+    type_ = type;
+    workers_.clear();
+    workers_.resize(workerCount);
+
+    return true;
+}
+
+ID3D12GraphicsCommandList* D3D12CommandListPool::acquire(uint32_t worker, ID3D12PipelineState* initialState)
+{
+    Worker& w = workers_[worker];
+
+    // tickets complete in order, only the oldest one has to be checked
+    if (!w.retired.empty() && isComplete(w.retired.front().ticket)) {
+        Entry entry = w.retired.front();
+        w.retired.pop_front();
+
+        HRESULT result = entry.allocator->Reset();
+        if (FAILED(result))
+            return nullptr;
+
+        result = entry.list->Reset(entry.allocator.Get(), initialState);
+        if (FAILED(result))
+            return nullptr;
+
+        w.open.push_back(entry);
+        return entry.list.Get();
+    }
+
+    Entry entry;
+    entry.ticket = FenceTicket();
+
+    HRESULT result = device_->CreateCommandAllocator(type_, IID_PPV_ARGS(entry.allocator.GetAddressOf()));
+    if (FAILED(result))
+        return nullptr;
+
+    result = device_->CreateCommandList(0, type_, entry.allocator.Get(), initialState, IID_PPV_ARGS(entry.list.GetAddressOf()));
+    if (FAILED(result))
+        return nullptr;
+
+    w.open.push_back(entry);
+    return entry.list.Get();
+}
+
+void D3D12CommandListPool::retire(const FenceTicket& ticket)
+{
+    for (Worker& w : workers_) {
+        for (Entry& entry : w.open) {
+            entry.ticket = ticket;
+            w.retired.push_back(entry);
+        }
+        w.open.clear();
+    }
+}
@@ -0,0 +1,52 @@
+#if !defined(COMMAND_RECORDING_D3D12_H)
+#define COMMAND_RECORDING_D3D12_H
+
+#include "timeline_fence.h"
+
+#include <deque>
+#include <vector>
+
+#include <d3d12.h>
+#include <wrl/client.h>
+
+// Allocator and command list pairs per worker thread. Pairs go back to the
+// pool with the ticket of the submission that used them and are reset once
+// the ticket completed, so an allocator is never reset while the GPU still
+// reads from it.
+class D3D12CommandListPool
+{
+public:
+    D3D12CommandListPool();
+
+    bool init(ID3D12Device* device, D3D12_COMMAND_LIST_TYPE type, uint32_t workerCount);
+
+    // returns an open list, nullptr on failure. Only call from the thread
+    // that owns worker.
+    ID3D12GraphicsCommandList* acquire(uint32_t worker, ID3D12PipelineState* initialState);
+
+    // everything acquired since the last retire() was submitted with ticket,
+    // must not run concurrently with acquire()
+    void retire(const FenceTicket& ticket);
+
+    uint32_t workerCount() const { return static_cast<uint32_t>(workers_.size()); }
+
+private:
+    struct Entry
+    {
+        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator;
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> list;
+        FenceTicket ticket;
+    };
+
+    struct Worker
+    {
+        std::vector<Entry> open;
+        std::deque<Entry> retired; // in ticket order
+    };
+
+    ID3D12Device* device_;
+    D3D12_COMMAND_LIST_TYPE type_;
+    std::vector<Worker> workers_;
+};
+
+#endif // COMMAND_RECORDING_D3D12_H
@@ -0,0 +1,116 @@
+#include "cube_mesh.h"
+
+#include <algorithm>
+#include <cmath>
+
+// quads along a face's edge on the full mesh
+static const uint32_t fullMeshQuads_ = 8;
+
+// how far the full mesh is pulled towards the sphere around the cube, 0 is
+// the cube itself and 1 the sphere
+static const float roundness_ = 0.25f;
+
+// a face is its outward normal and the axes that are up and right when it
+// is looked at from outside
+struct CubeFace
+{
+    Float3 normal;
+    Float3 up;
+    Float3 right;
+};
+
+static const CubeFace cubeFaces_[] = {
+    { { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f } },  // front
+    { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } },   // right
+    { { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f } }, // left
+    { { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f }, { -1.0f, 0.0f, 0.0f } },  // back
+    { { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f } },   // top
+    { { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 1.0f, 0.0f, 0.0f } }, // bottom
+};
+
+// a point on the unit cube moved part of the way to the sphere of radius
+// 0.5, the cube's corners end up where the sphere's are
+static Float3 roundPoint(const Float3& p)
+{
+    const float length = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+    const float sphere = 0.5f / length * roundness_;
+    const float cube = 1.0f - roundness_;
+    const Float3 result = { p.x * (cube + sphere), p.y * (cube + sphere), p.z * (cube + sphere) };
+    return result;
+}
+
+// one level, every face a grid of quads x quads, clockwise seen from outside
+static void addLevel(CubeMesh& mesh, uint32_t quads)
+{
+    MeshLod lod = {};
+    lod.firstIndex = static_cast<uint32_t>(mesh.indices.size());
+    lod.baseVertex = static_cast<int32_t>(mesh.vertices.size());
+
+    uint32_t vertex = 0;
+    for (const CubeFace& face : cubeFaces_) {
+        const uint32_t first = vertex;
+
+        // u goes right and v down, like the texture
+        for (uint32_t row = 0; row <= quads; ++row) {
+            for (uint32_t column = 0; column <= quads; ++column) {
+                const float u = static_cast<float>(column) / static_cast<float>(quads);
+                const float v = static_cast<float>(row) / static_cast<float>(quads);
+                const float right = u - 0.5f;
+                const float up = 0.5f - v;
+                const Float3 p = {
+                    0.5f * face.normal.x + right * face.right.x + up * face.up.x,
+                    0.5f * face.normal.y + right * face.right.y + up * face.up.y,
+                    0.5f * face.normal.z + right * face.right.z + up * face.up.z,
+                };
+
+                const MeshVertex meshVertex = { roundPoint(p), { u, v } };
+                mesh.vertices.push_back(meshVertex);
+                vertex++;
+            }
+        }
+
+        for (uint32_t row = 0; row < quads; ++row) {
+            for (uint32_t column = 0; column < quads; ++column) {
+                const uint32_t topLeft = first + row * (quads + 1) + column;
+                const uint32_t topRight = topLeft + 1;
+                const uint32_t bottomLeft = topLeft + quads + 1;
+                const uint32_t bottomRight = bottomLeft + 1;
+
+                const uint32_t quad[] = { topLeft, bottomRight, bottomLeft, topLeft, topRight, bottomRight };
+                mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+            }
+        }
+    }
+
+    lod.indexCount = static_cast<uint32_t>(mesh.indices.size()) - lod.firstIndex;
+    mesh.lods.push_back(lod);
+}
+
+void buildCubeMesh(CubeMesh& mesh)
+{
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.lods.clear();
+
+    addLevel(mesh, fullMeshQuads_);
+    addLevel(mesh, 1);
+
+    // the full mesh reaches 0.5 at the face centers, the box only as far as
+    // the corners
+    const Float3 corner = roundPoint({ 0.5f, 0.5f, 0.5f });
+    mesh.extents = { 0.5f, 0.5f, 0.5f };
+    mesh.innerExtents = corner;
+
+    // every vertex of the full mesh is on or outside the box, its error is
+    // how far the furthest one is from it
+    const uint32_t fullVertices = static_cast<uint32_t>(mesh.lods[1].baseVertex - mesh.lods[0].baseVertex);
+    float error = 0.0f;
+    for (uint32_t i = 0; i < fullVertices; ++i) {
+        const Float3& p = mesh.vertices[mesh.lods[0].baseVertex + i].position;
+        const float dx = std::max(std::fabs(p.x) - corner.x, 0.0f);
+        const float dy = std::max(std::fabs(p.y) - corner.y, 0.0f);
+        const float dz = std::max(std::fabs(p.z) - corner.z, 0.0f);
+        error = std::max(error, std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+    mesh.lods[1].error = error;
+}
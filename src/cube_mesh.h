@@ -0,0 +1,35 @@
+#if !defined(CUBE_MESH_H)
+#define CUBE_MESH_H
+
+#include "mesh_lod.h"
+#include "scene_math.h"
+
+#include <cstdint>
+#include <vector>
+
+// The scene's cube as a chain of levels of detail. The full mesh is a cube
+// with rounded edges, every face a grid of quads, the coarser level is a box
+// of two triangles per face. Its corners are where the rounded cube's are,
+// so it is the largest box that fits inside the full mesh.
+//
+// Every level has its own vertices, its indices start at 0 and its
+// baseVertex says where its vertices are in the vertex buffer.
+
+struct MeshVertex
+{
+    Float3 position;
+    float uv[2];
+};
+
+struct CubeMesh
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshLod> lods;
+    Float3 extents;      // half extents of the full mesh
+    Float3 innerExtents; // half extents of the coarsest level, which is inside every other
+};
+
+void buildCubeMesh(CubeMesh& mesh);
+
+#endif // CUBE_MESH_H
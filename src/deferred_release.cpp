@@ -0,0 +1,66 @@
+#include "deferred_release.h"
+
+#include <algorithm>
+
+DeferredReleaseQueue::DeferredReleaseQueue()
+    : incoming_(nullptr)
+{
+}
+
+DeferredReleaseQueue::~DeferredReleaseQueue()
+{
+    releaseAll();
+}
+
+void DeferredReleaseQueue::retire(void* object, ReleaseFn release, uint64_t fenceValue)
+{
+    Node* node = new Node;
+    node->object = object;
+    node->release = release;
+    node->fenceValue = fenceValue;
+    node->next = incoming_.load(std::memory_order_relaxed);
+
+    while (!incoming_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+uint32_t DeferredReleaseQueue::collect(uint64_t completedFenceValue)
+{
+    drainIncoming();
+
+    uint32_t released = 0;
+    size_t kept = 0;
+
+    for (size_t i = 0; i < pending_.size(); ++i) {
+        Node* node = pending_[i];
+        if (node->fenceValue > completedFenceValue) {
+            pending_[kept++] = node;
+            continue;
+        }
+
+        node->release(node->object);
+        delete node;
+        released++;
+    }
+
+    pending_.resize(kept);
+
+    return released;
+}
+
+uint32_t DeferredReleaseQueue::releaseAll()
+{
+    return collect(UINT64_MAX);
+}
+
+void DeferredReleaseQueue::drainIncoming()
+{
+    Node* node = incoming_.exchange(nullptr, std::memory_order_acquire);
+
+    // the stack is newest first, flip it so objects go out in retire order
+    const size_t start = pending_.size();
+    for (; node; node = node->next)
+        pending_.push_back(node);
+
+    std::reverse(pending_.begin() + start, pending_.end());
+}
@@ -0,0 +1,53 @@
+#if !defined(DEFERRED_RELEASE_H)
+#define DEFERRED_RELEASE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Objects the GPU may still use are retired together with the fence value
+// of their last use and released once the fence has passed it. Any thread
+// can retire (lock-free push), collect() must only be called from one
+// thread at a time.
+class DeferredReleaseQueue
+{
+public:
+    typedef void (*ReleaseFn)(void* object);
+
+    DeferredReleaseQueue();
+    ~DeferredReleaseQueue();
+
+    void retire(void* object, ReleaseFn release, uint64_t fenceValue);
+
+    // releases every object whose fence value is <= completedFenceValue and
+    // returns how many were released
+    uint32_t collect(uint64_t completedFenceValue);
+
+    // only safe once the GPU is idle
+    uint32_t releaseAll();
+
+    // objects seen by the consumer that are still waiting for their fence
+    size_t pendingCount() const { return pending_.size(); }
+
+private:
+    DeferredReleaseQueue(const DeferredReleaseQueue&) = delete;
+    DeferredReleaseQueue& operator=(const DeferredReleaseQueue&) = delete;
+
+    struct Node
+    {
+        Node* next;
+        void* object;
+        ReleaseFn release;
+        uint64_t fenceValue;
+    };
+
+    void drainIncoming();
+
+    // producers push onto this stack, the consumer takes the whole stack at
+    // once, so there is no ABA problem to worry about
+    std::atomic<Node*> incoming_;
+    std::vector<Node*> pending_;
+};
+
+#endif // DEFERRED_RELEASE_H
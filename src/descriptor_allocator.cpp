@@ -0,0 +1,224 @@
+#include "descriptor_allocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+DescriptorFreeList::DescriptorFreeList(uint32_t capacity)
+    : capacity_(0)
+    , freeCount_(0)
+{
+    reset(capacity);
+}
+
+void DescriptorFreeList::reset(uint32_t capacity)
+{
+    freeRanges_.clear();
+    capacity_ = capacity;
+    freeCount_ = capacity;
+
+    if (capacity > 0)
+        freeRanges_.push_back({ 0, capacity });
+}
+
+uint32_t DescriptorFreeList::allocate(uint32_t count)
+{
+    if (count == 0 || count > freeCount_)
+        return InvalidDescriptorOffset;
+
+    // first fit - keeps the low end of the heap dense, which is what we want
+    // for a heap that is mostly filled with single descriptors
+    for (size_t i = 0; i < freeRanges_.size(); ++i) {
+        Range& range = freeRanges_[i];
+        if (range.count < count)
+            continue;
+
+        const uint32_t offset = range.offset;
+        range.offset += count;
+        range.count -= count;
+        if (range.count == 0)
+            freeRanges_.erase(freeRanges_.begin() + i);
+
+        freeCount_ -= count;
+        return offset;
+    }
+
+    return InvalidDescriptorOffset;
+}
+
+void DescriptorFreeList::release(uint32_t offset, uint32_t count)
+{
+    if (count == 0)
+        return;
+
+    assert(offset + count <= capacity_);
+
+    auto next = std::lower_bound(freeRanges_.begin(), freeRanges_.end(), offset,
+        [](const Range& range, uint32_t value) { return range.offset < value; });
+
+    assert(next == freeRanges_.end() || offset + count <= next->offset);
+
+    const bool mergePrev = next != freeRanges_.begin() && (next - 1)->offset + (next - 1)->count == offset;
+    const bool mergeNext = next != freeRanges_.end() && offset + count == next->offset;
+
+    if (mergePrev && mergeNext) {
+        (next - 1)->count += count + next->count;
+        freeRanges_.erase(next);
+    } else if (mergePrev) {
+        (next - 1)->count += count;
+    } else if (mergeNext) {
+        next->offset = offset;
+        next->count += count;
+    } else {
+        freeRanges_.insert(next, { offset, count });
+    }
+
+    freeCount_ += count;
+}
+
+DescriptorRing::DescriptorRing()
+    : head_(0)
+    , tail_(0)
+    , baseOffset_(0)
+    , capacity_(0)
+{
+}
+
+void DescriptorRing::reset(uint32_t baseOffset, uint32_t capacity)
+{
+    head_ = 0;
+    tail_ = 0;
+    baseOffset_ = baseOffset;
+    capacity_ = capacity;
+    frames_.clear();
+}
+
+uint32_t DescriptorRing::allocate(uint32_t count)
+{
+    if (count == 0 || count > capacity_)
+        return InvalidDescriptorOffset;
+
+    // tables have to be contiguous, so skip the tail end of the ring if the
+    // allocation does not fit before wrapping around
+    const uint32_t position = static_cast<uint32_t>(head_ % capacity_);
+    const uint32_t padding = position + count > capacity_ ? capacity_ - position : 0;
+
+    if (head_ - tail_ + padding + count > capacity_)
+        return InvalidDescriptorOffset;
+
+    head_ += padding;
+    const uint32_t offset = baseOffset_ + static_cast<uint32_t>(head_ % capacity_);
+    head_ += count;
+
+    return offset;
+}
+
+void DescriptorRing::endFrame(uint64_t fenceValue)
+{
+    // a frame that allocated nothing has nothing to give back
+    const uint64_t start = frames_.empty() ? tail_ : frames_.back().end;
+    if (head_ == start)
+        return;
+
+    frames_.push_back({ fenceValue, head_ });
+}
+
+void DescriptorRing::collect(uint64_t completedFenceValue)
+{
+    while (!frames_.empty() && frames_.front().fenceValue <= completedFenceValue) {
+        tail_ = frames_.front().end;
+        frames_.pop_front();
+    }
+}
+
+DescriptorFreeListBenchmark measureDescriptorFreeList(uint32_t capacity, uint32_t operations)
+{
+    DescriptorFreeListBenchmark result = {};
+    result.capacity = capacity;
+    result.operations = operations;
+    if (capacity == 0 || operations == 0)
+        return result;
+
+    struct Allocation
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // the same operations twice with a fixed seed lcg, once timed and once
+    // checking every descriptor is owned by at most one allocation
+    auto run = [capacity, operations, &result](bool check) {
+        uint32_t seed = 0x12345678;
+        auto random = [&seed](uint32_t count) {
+            seed = seed * 1664525u + 1013904223u;
+            return static_cast<uint32_t>((static_cast<uint64_t>(seed >> 8) * count) >> 24);
+        };
+
+        DescriptorFreeList list(capacity);
+        std::vector<Allocation> live;
+        std::vector<bool> owned(check ? capacity : 0, false);
+        uint32_t failed = 0;
+        uint32_t maxRanges = 0;
+
+        for (uint32_t i = 0; i < operations; ++i) {
+            const bool allocate = live.empty() || (list.freeCount() > capacity / 4 && random(2) == 0);
+
+            if (allocate) {
+                // one in four is a material table
+                const uint32_t count = random(4) == 0 ? 2 + random(31) : 1;
+                const uint32_t offset = list.allocate(count);
+                if (offset == InvalidDescriptorOffset) {
+                    failed++;
+                    continue;
+                }
+
+                if (check) {
+                    for (uint32_t d = offset; d < offset + count; ++d) {
+                        if (d >= capacity || owned[d])
+                            result.mismatches++;
+                        else
+                            owned[d] = true;
+                    }
+                }
+
+                live.push_back({ offset, count });
+            } else {
+                const uint32_t index = random(static_cast<uint32_t>(live.size()));
+                const Allocation allocation = live[index];
+                live[index] = live.back();
+                live.pop_back();
+
+                if (check) {
+                    for (uint32_t d = allocation.offset; d < allocation.offset + allocation.count; ++d)
+                        owned[d] = false;
+                }
+
+                list.release(allocation.offset, allocation.count);
+            }
+
+            maxRanges = std::max(maxRanges, list.rangeCount());
+        }
+
+        if (check) {
+            for (const Allocation& allocation : live)
+                list.release(allocation.offset, allocation.count);
+
+            // everything merges back into one range
+            if (list.freeCount() != capacity || list.rangeCount() != 1)
+                result.mismatches++;
+
+            result.failedAllocations = failed;
+            result.maxRanges = maxRanges;
+        }
+    };
+
+    typedef std::chrono::duration<double> Seconds;
+
+    const auto start = std::chrono::steady_clock::now();
+    run(false);
+    result.secondsPerOperation = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count() / operations;
+
+    run(true);
+
+    return result;
+}
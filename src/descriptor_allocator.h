@@ -0,0 +1,98 @@
+#if !defined(DESCRIPTOR_ALLOCATOR_H)
+#define DESCRIPTOR_ALLOCATOR_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Bookkeeping for descriptor heaps. Nothing in here talks to D3D12, the
+// allocators only hand out offsets (in descriptors) into a heap, so the
+// heap wrappers in descriptor_heap.h can turn them into handles.
+
+constexpr uint32_t InvalidDescriptorOffset = 0xffffffff;
+
+// Free-list allocator for long lived descriptors. Free space is kept as a
+// list of [offset, offset + count) ranges sorted by offset, adjacent ranges
+// are merged on release so contiguous tables can be carved out again.
+class DescriptorFreeList
+{
+public:
+    explicit DescriptorFreeList(uint32_t capacity = 0);
+
+    void reset(uint32_t capacity);
+
+    // returns offset of first descriptor or InvalidDescriptorOffset
+    uint32_t allocate(uint32_t count);
+    void release(uint32_t offset, uint32_t count);
+
+    uint32_t capacity() const { return capacity_; }
+    uint32_t freeCount() const { return freeCount_; }
+    uint32_t rangeCount() const { return static_cast<uint32_t>(freeRanges_.size()); }
+
+private:
+    struct Range
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    std::vector<Range> freeRanges_;
+    uint32_t capacity_;
+    uint32_t freeCount_;
+};
+
+// Ring allocator for descriptors that only live until the GPU is done with
+// the frame that used them. Every allocation is contiguous, so it can be
+// bound as a table. endFrame() tags what was allocated since the last call
+// with the fence value the frame signals, collect() takes back the space of
+// every frame whose fence value has completed. Frames complete in order, so
+// space comes back in the order it was handed out and the ring wraps around.
+class DescriptorRing
+{
+public:
+    DescriptorRing();
+
+    // ring covers [baseOffset, baseOffset + capacity) of the owning heap
+    void reset(uint32_t baseOffset, uint32_t capacity);
+
+    // returns heap offset of first descriptor or InvalidDescriptorOffset
+    // while the frames in flight hold too much of the ring
+    uint32_t allocate(uint32_t count);
+
+    void endFrame(uint64_t fenceValue);
+    void collect(uint64_t completedFenceValue);
+
+    uint32_t capacity() const { return capacity_; }
+    uint32_t usedCount() const { return static_cast<uint32_t>(head_ - tail_); }
+    uint32_t pendingFrames() const { return static_cast<uint32_t>(frames_.size()); }
+
+private:
+    struct FrameEnd
+    {
+        uint64_t fenceValue;
+        uint64_t end; // head_ when the frame ended
+    };
+
+    // head_ and tail_ are monotonic positions, the physical slot is pos % capacity_
+    uint64_t head_;
+    uint64_t tail_;
+    uint32_t baseOffset_;
+    uint32_t capacity_;
+    std::deque<FrameEnd> frames_;
+};
+
+struct DescriptorFreeListBenchmark
+{
+    uint32_t capacity;
+    uint32_t operations;        // allocations and releases
+    double secondsPerOperation;
+    uint32_t failedAllocations; // no free range was large enough
+    uint32_t maxRanges;         // free ranges at the most fragmented point
+    uint32_t mismatches;        // overlapping allocations or lost descriptors, should be 0
+};
+
+// a heap kept about three quarters full with single descriptors and the
+// occasional material table, allocated and released in random order
+DescriptorFreeListBenchmark measureDescriptorFreeList(uint32_t capacity, uint32_t operations);
+
+#endif // DESCRIPTOR_ALLOCATOR_H
@@ -0,0 +1,166 @@
+#include "descriptor_heap.h"
+
+#include <cassert>
+
+static DescriptorHandle invalidHandle()
+{
+    DescriptorHandle handle = {};
+    handle.offset = InvalidDescriptorOffset;
+    return handle;
+}
+
+StagingDescriptorHeap::StagingDescriptorHeap()
+    : cpuStart_{ 0 }
+    , handleSize_(0)
+{
+}
+
+bool StagingDescriptorHeap::init(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t capacity, const wchar_t* name)
+{
+    D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+    heapDesc.NumDescriptors = capacity;
+    heapDesc.Type = type;
+    heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+    HRESULT result = device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(heap_.ReleaseAndGetAddressOf()));
+    if (FAILED(result))
+        return false;
+    heap_->SetName(name);
+
+    cpuStart_ = heap_->GetCPUDescriptorHandleForHeapStart();
+    handleSize_ = device->GetDescriptorHandleIncrementSize(type);
+    freeList_.reset(capacity);
+
+    return true;
+}
+
+DescriptorHandle StagingDescriptorHeap::allocate(uint32_t count)
+{
+    const uint32_t offset = freeList_.allocate(count);
+    if (offset == InvalidDescriptorOffset)
+        return invalidHandle();
+
+    DescriptorHandle handle = {};
+    handle.cpu.ptr = cpuStart_.ptr + static_cast<SIZE_T>(offset) * handleSize_;
+    handle.offset = offset;
+    handle.count = count;
+
+    return handle;
+}
+
+void StagingDescriptorHeap::release(const DescriptorHandle& handle)
+{
+    if (handle.isValid())
+        freeList_.release(handle.offset, handle.count);
+}
+
+void DescriptorCopyBatch::add(D3D12_CPU_DESCRIPTOR_HANDLE dest, const D3D12_CPU_DESCRIPTOR_HANDLE* sources, uint32_t count, uint32_t handleSize)
+{
+    if (count == 0)
+        return;
+
+    destStarts_.push_back(dest);
+    destSizes_.push_back(count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (i > 0 && sources[i].ptr == srcStarts_.back().ptr + static_cast<SIZE_T>(srcSizes_.back()) * handleSize) {
+            srcSizes_.back()++;
+            continue;
+        }
+
+        srcStarts_.push_back(sources[i]);
+        srcSizes_.push_back(1);
+    }
+}
+
+void DescriptorCopyBatch::flush(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type)
+{
+    if (destStarts_.empty())
+        return;
+
+    device->CopyDescriptors(
+        static_cast<UINT>(destStarts_.size()), destStarts_.data(), destSizes_.data(),
+        static_cast<UINT>(srcStarts_.size()), srcStarts_.data(), srcSizes_.data(),
+        type);
+
+    destStarts_.clear();
+    destSizes_.clear();
+    srcStarts_.clear();
+    srcSizes_.clear();
+}
+
+ShaderVisibleDescriptorHeap::ShaderVisibleDescriptorHeap()
+    : cpuStart_{ 0 }
+    , gpuStart_{ 0 }
+    , handleSize_(0)
+{
+}
+
+bool ShaderVisibleDescriptorHeap::init(ID3D12Device* device, uint32_t persistentCount, uint32_t ringCount, const wchar_t* name)
+{
+    D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+    heapDesc.NumDescriptors = persistentCount + ringCount;
+    heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+    HRESULT result = device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(heap_.ReleaseAndGetAddressOf()));
+    if (FAILED(result))
+        return false;
+    heap_->SetName(name);
+
+    cpuStart_ = heap_->GetCPUDescriptorHandleForHeapStart();
+    gpuStart_ = heap_->GetGPUDescriptorHandleForHeapStart();
+    handleSize_ = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    persistent_.reset(persistentCount);
+    ring_.reset(persistentCount, ringCount);
+
+    return true;
+}
+
+DescriptorHandle ShaderVisibleDescriptorHeap::allocatePersistent(uint32_t count)
+{
+    return handleAt(persistent_.allocate(count), count);
+}
+
+void ShaderVisibleDescriptorHeap::releasePersistent(const DescriptorHandle& handle)
+{
+    if (handle.isValid())
+        persistent_.release(handle.offset, handle.count);
+}
+
+DescriptorHandle ShaderVisibleDescriptorHeap::allocateTable(uint32_t count)
+{
+    return handleAt(ring_.allocate(count), count);
+}
+
+DescriptorHandle ShaderVisibleDescriptorHeap::stageTable(const D3D12_CPU_DESCRIPTOR_HANDLE* sources, uint32_t count, DescriptorCopyBatch& batch)
+{
+    DescriptorHandle table = allocateTable(count);
+    if (table.isValid())
+        batch.add(table.cpu, sources, count, handleSize_);
+
+    return table;
+}
+
+void ShaderVisibleDescriptorHeap::endFrame(uint64_t fenceValue)
+{
+    ring_.endFrame(fenceValue);
+}
+
+void ShaderVisibleDescriptorHeap::collectTables(uint64_t completedFenceValue)
+{
+    ring_.collect(completedFenceValue);
+}
+
+DescriptorHandle ShaderVisibleDescriptorHeap::handleAt(uint32_t offset, uint32_t count) const
+{
+    if (offset == InvalidDescriptorOffset)
+        return invalidHandle();
+
+    DescriptorHandle handle = {};
+    handle.cpu.ptr = cpuStart_.ptr + static_cast<SIZE_T>(offset) * handleSize_;
+    handle.gpu.ptr = gpuStart_.ptr + static_cast<UINT64>(offset) * handleSize_;
+    handle.offset = offset;
+    handle.count = count;
+
+    return handle;
+}
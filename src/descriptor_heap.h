@@ -0,0 +1,100 @@
+#if !defined(DESCRIPTOR_HEAP_H)
+#define DESCRIPTOR_HEAP_H
+
+#include "descriptor_allocator.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <d3d12.h>
+#include <wrl/client.h>
+
+struct DescriptorHandle
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE cpu;
+    D3D12_GPU_DESCRIPTOR_HANDLE gpu; // zero for non shader visible heaps
+    uint32_t offset;
+    uint32_t count;
+
+    bool isValid() const { return offset != InvalidDescriptorOffset; }
+};
+
+// CPU only heap. Views are created here once and then copied into the
+// shader visible heap when they need to be bound.
+class StagingDescriptorHeap
+{
+public:
+    StagingDescriptorHeap();
+
+    bool init(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t capacity, const wchar_t* name);
+
+    DescriptorHandle allocate(uint32_t count = 1);
+    void release(const DescriptorHandle& handle);
+
+    ID3D12DescriptorHeap* heap() const { return heap_.Get(); }
+    uint32_t handleSize() const { return handleSize_; }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> heap_;
+    D3D12_CPU_DESCRIPTOR_HANDLE cpuStart_;
+    uint32_t handleSize_;
+    DescriptorFreeList freeList_;
+};
+
+// Collects descriptor copies and issues them as one CopyDescriptors call.
+// Source descriptors that sit next to each other in the staging heap are
+// coalesced into a single source range.
+class DescriptorCopyBatch
+{
+public:
+    void add(D3D12_CPU_DESCRIPTOR_HANDLE dest, const D3D12_CPU_DESCRIPTOR_HANDLE* sources, uint32_t count, uint32_t handleSize);
+    void flush(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type);
+
+    bool empty() const { return destStarts_.empty(); }
+
+private:
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> destStarts_;
+    std::vector<UINT> destSizes_;
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> srcStarts_;
+    std::vector<UINT> srcSizes_;
+};
+
+// The single CBV/SRV/UAV heap bound with SetDescriptorHeaps. The front part
+// holds persistent descriptors (free-list), the rest is a ring for tables
+// that are only valid until the GPU finishes the frame they were built in.
+class ShaderVisibleDescriptorHeap
+{
+public:
+    ShaderVisibleDescriptorHeap();
+
+    bool init(ID3D12Device* device, uint32_t persistentCount, uint32_t ringCount, const wchar_t* name);
+
+    DescriptorHandle allocatePersistent(uint32_t count = 1);
+    void releasePersistent(const DescriptorHandle& handle);
+
+    DescriptorHandle allocateTable(uint32_t count);
+
+    // copies staged descriptors into a fresh ring table, the copy itself is
+    // deferred until the batch is flushed
+    DescriptorHandle stageTable(const D3D12_CPU_DESCRIPTOR_HANDLE* sources, uint32_t count, DescriptorCopyBatch& batch);
+
+    // tables allocated since the last call stay alive until fenceValue
+    // completes, collectTables reclaims them after that
+    void endFrame(uint64_t fenceValue);
+    void collectTables(uint64_t completedFenceValue);
+
+    ID3D12DescriptorHeap* heap() const { return heap_.Get(); }
+    uint32_t handleSize() const { return handleSize_; }
+
+private:
+    DescriptorHandle handleAt(uint32_t offset, uint32_t count) const;
+
+    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> heap_;
+    D3D12_CPU_DESCRIPTOR_HANDLE cpuStart_;
+    D3D12_GPU_DESCRIPTOR_HANDLE gpuStart_;
+    uint32_t handleSize_;
+    DescriptorFreeList persistent_;
+    DescriptorRing ring_;
+};
+
+#endif // DESCRIPTOR_HEAP_H
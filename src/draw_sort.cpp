@@ -0,0 +1,290 @@
+#include "draw_sort.h"
+
+#include "job_system.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+// field widths of the key layout
+static const uint32_t layerShift_ = 60;
+static const uint32_t rootSignatureBits_ = 4;
+static const uint32_t pipelineBits_ = 10;
+static const uint32_t materialBits_ = 16;
+static const uint32_t meshBits_ = 14;
+static const uint32_t depthBits_ = 16;
+static const uint32_t stateBits_ = rootSignatureBits_ + pipelineBits_ + materialBits_ + meshBits_;
+
+static const uint64_t depthMask_ = (1ull << depthBits_) - 1;
+
+static const uint32_t radixBits_ = 8;
+static const uint32_t radixSize_ = 1 << radixBits_;
+static const uint32_t passCount_ = 64 / radixBits_;
+
+// smaller blocks cost more in job overhead than they save
+static const uint32_t minKeysPerBlock_ = 16384;
+
+// kinds of object in the benchmark scene
+static const uint32_t objectKinds_ = 1000;
+
+static uint64_t field(uint32_t value, uint32_t bits)
+{
+    return value & ((1u << bits) - 1);
+}
+
+static uint64_t quantizeDepth(float depth)
+{
+    // NaN ends up at the camera
+    const float clamped = depth > 0.0f ? (depth < 1.0f ? depth : 1.0f) : 0.0f;
+    return static_cast<uint64_t>(clamped * static_cast<float>(depthMask_) + 0.5f);
+}
+
+uint64_t encodeDrawKey(const DrawKey& key)
+{
+    const uint64_t layer = field(key.layer, 64 - layerShift_);
+    const uint64_t state = (field(key.rootSignature, rootSignatureBits_) << (pipelineBits_ + materialBits_ + meshBits_))
+        | (field(key.pipeline, pipelineBits_) << (materialBits_ + meshBits_))
+        | (field(key.material, materialBits_) << meshBits_)
+        | field(key.mesh, meshBits_);
+    const uint64_t depth = quantizeDepth(key.depth);
+
+    // transparent draws blend in the order they are drawn, distance has to
+    // come before state
+    if (layer == DrawLayerTransparent)
+        return (layer << layerShift_) | ((depthMask_ - depth) << stateBits_) | state;
+
+    return (layer << layerShift_) | (state << depthBits_) | depth;
+}
+
+uint64_t drawKeyState(uint64_t key)
+{
+    if ((key >> layerShift_) == DrawLayerTransparent)
+        return key & ~(depthMask_ << stateBits_);
+    return key & ~depthMask_;
+}
+
+// calls body with every block, in parallel when there is more than one
+template <typename Body>
+static void forEachBlock(uint32_t blockCount, JobSystem* jobs, const Body& body)
+{
+    if (blockCount == 1) {
+        body(0);
+        return;
+    }
+
+    jobs->parallelFor(0, blockCount, 1, [&body](uint32_t begin, uint32_t end) {
+        for (uint32_t block = begin; block < end; ++block)
+            body(block);
+    });
+}
+
+uint32_t RadixSorter::sort(uint64_t* keys, uint32_t* values, uint32_t count, JobSystem* jobs)
+{
+    PROFILE_FUNCTION();
+
+    if (count < 2)
+        return 0;
+
+    uint32_t blockCount = 1;
+    if (jobs)
+        blockCount = std::max(1u, std::min(jobs->workerCount(), count / minKeysPerBlock_));
+    const uint32_t blockSize = (count + blockCount - 1) / blockCount;
+
+    keyScratch_.resize(count);
+    valueScratch_.resize(count);
+    counts_.resize(blockCount * radixSize_);
+    differences_.resize(blockCount);
+
+    // bits that differ from the first key, digits without any need no pass
+    const uint64_t firstKey = keys[0];
+    uint64_t* differences = differences_.data();
+
+    forEachBlock(blockCount, jobs, [keys, count, blockSize, firstKey, differences](uint32_t block) {
+        const uint32_t end = std::min(count, (block + 1) * blockSize);
+
+        uint64_t difference = 0;
+        for (uint32_t i = block * blockSize; i < end; ++i)
+            difference |= keys[i] ^ firstKey;
+        differences[block] = difference;
+    });
+
+    uint64_t difference = 0;
+    for (uint32_t block = 0; block < blockCount; ++block)
+        difference |= differences_[block];
+
+    uint64_t* sourceKeys = keys;
+    uint32_t* sourceValues = values;
+    uint64_t* targetKeys = keyScratch_.data();
+    uint32_t* targetValues = valueScratch_.data();
+    uint32_t* counts = counts_.data();
+    uint32_t passes = 0;
+
+    for (uint32_t pass = 0; pass < passCount_; ++pass) {
+        const uint32_t shift = pass * radixBits_;
+        if (((difference >> shift) & (radixSize_ - 1)) == 0)
+            continue;
+
+        forEachBlock(blockCount, jobs, [sourceKeys, count, blockSize, shift, counts](uint32_t block) {
+            uint32_t* blockCounts = counts + block * radixSize_;
+            std::fill(blockCounts, blockCounts + radixSize_, 0);
+
+            const uint32_t end = std::min(count, (block + 1) * blockSize);
+            for (uint32_t i = block * blockSize; i < end; ++i)
+                blockCounts[(sourceKeys[i] >> shift) & (radixSize_ - 1)]++;
+        });
+
+        // digits first, then blocks, so every block scatters into a range of
+        // its own and keys keep their order
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < radixSize_; ++digit) {
+            for (uint32_t block = 0; block < blockCount; ++block) {
+                const uint32_t digitCount = counts[block * radixSize_ + digit];
+                counts[block * radixSize_ + digit] = offset;
+                offset += digitCount;
+            }
+        }
+
+        forEachBlock(blockCount, jobs, [sourceKeys, sourceValues, targetKeys, targetValues, count, blockSize, shift, counts](uint32_t block) {
+            uint32_t* offsets = counts + block * radixSize_;
+
+            const uint32_t end = std::min(count, (block + 1) * blockSize);
+            for (uint32_t i = block * blockSize; i < end; ++i) {
+                const uint64_t key = sourceKeys[i];
+                const uint32_t target = offsets[(key >> shift) & (radixSize_ - 1)]++;
+                targetKeys[target] = key;
+                targetValues[target] = sourceValues[i];
+            }
+        });
+
+        std::swap(sourceKeys, targetKeys);
+        std::swap(sourceValues, targetValues);
+        passes++;
+    }
+
+    // an odd number of passes left the result in the scratch arrays
+    if (sourceKeys != keys) {
+        memcpy(keys, sourceKeys, count * sizeof(uint64_t));
+        memcpy(values, sourceValues, count * sizeof(uint32_t));
+    }
+
+    return passes;
+}
+
+static uint32_t countStateChanges(const uint64_t* keys, uint32_t count)
+{
+    uint32_t changes = 0;
+    for (uint32_t i = 1; i < count; ++i) {
+        if (drawKeyState(keys[i]) != drawKeyState(keys[i - 1]))
+            changes++;
+    }
+    return changes;
+}
+
+DrawSortBenchmark measureDrawSort(uint32_t keyCount, uint32_t threadCount, uint32_t iterations)
+{
+    DrawSortBenchmark result = {};
+    result.keys = keyCount;
+    result.threads = threadCount + 1;
+    if (keyCount == 0 || iterations == 0)
+        return result;
+
+    // fixed seed lcg, every run sorts the same draws
+    uint32_t seed = 0x12345678;
+    auto random = [&seed](uint32_t count) {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<uint32_t>((static_cast<uint64_t>(seed >> 8) * count) >> 24);
+    };
+
+    // draws are instances of a thousand kinds of object, each with its own
+    // state, scattered over the view
+    std::vector<DrawKey> kinds(objectKinds_);
+    for (DrawKey& kind : kinds) {
+        kind.layer = random(10) == 0 ? DrawLayerTransparent : DrawLayerOpaque;
+        kind.rootSignature = random(2);
+        kind.pipeline = random(8);
+        kind.material = random(2000);
+        kind.mesh = random(500);
+        kind.depth = 0.0f;
+    }
+
+    std::vector<uint64_t> generated(keyCount);
+    for (uint32_t i = 0; i < keyCount; ++i) {
+        DrawKey key = kinds[random(objectKinds_)];
+        key.depth = static_cast<float>(random(1 << 20)) / static_cast<float>(1 << 20);
+        generated[i] = encodeDrawKey(key);
+    }
+
+    result.stateChangesBefore = countStateChanges(generated.data(), keyCount);
+
+    std::vector<uint64_t> keys(keyCount);
+    std::vector<uint32_t> values(keyCount);
+    auto reset = [&generated, &keys, &values, keyCount]() {
+        memcpy(keys.data(), generated.data(), keyCount * sizeof(uint64_t));
+        for (uint32_t i = 0; i < keyCount; ++i)
+            values[i] = i;
+    };
+
+    typedef std::chrono::duration<double> Seconds;
+
+    RadixSorter sorter;
+    double radixSeconds = 0.0;
+
+    for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        reset();
+
+        const auto start = std::chrono::steady_clock::now();
+        sorter.sort(keys.data(), values.data(), keyCount, nullptr);
+        radixSeconds += std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    JobSystem jobs;
+    jobs.start(threadCount);
+
+    double parallelRadixSeconds = 0.0;
+
+    for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        reset();
+
+        const auto start = std::chrono::steady_clock::now();
+        result.passes = sorter.sort(keys.data(), values.data(), keyCount, &jobs);
+        parallelRadixSeconds += std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    jobs.stop();
+
+    // sorted, stable and nothing lost
+    std::vector<bool> seen(keyCount, false);
+    for (uint32_t i = 0; i < keyCount; ++i) {
+        const bool ordered = i == 0 || keys[i - 1] < keys[i] || (keys[i - 1] == keys[i] && values[i - 1] < values[i]);
+        if (!ordered || values[i] >= keyCount || seen[values[i]] || generated[values[i]] != keys[i]) {
+            result.mismatches++;
+            continue;
+        }
+        seen[values[i]] = true;
+    }
+
+    result.stateChangesAfter = countStateChanges(keys.data(), keyCount);
+
+    std::vector<std::pair<uint64_t, uint32_t>> pairs(keyCount);
+    double stdSortSeconds = 0.0;
+
+    for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        for (uint32_t i = 0; i < keyCount; ++i)
+            pairs[i] = std::make_pair(generated[i], i);
+
+        const auto start = std::chrono::steady_clock::now();
+        std::stable_sort(pairs.begin(), pairs.end(), [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) {
+            return a.first < b.first;
+        });
+        stdSortSeconds += std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    result.radixSeconds = radixSeconds / iterations;
+    result.parallelRadixSeconds = parallelRadixSeconds / iterations;
+    result.stdSortSeconds = stdSortSeconds / iterations;
+    result.keysPerSecond = result.parallelRadixSeconds > 0.0 ? keyCount / result.parallelRadixSeconds : 0.0;
+
+    return result;
+}
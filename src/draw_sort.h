@@ -0,0 +1,84 @@
+#if !defined(DRAW_SORT_H)
+#define DRAW_SORT_H
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// 64-bit sort keys for draws and a radix sort for them. Sorting the draws
+// of a frame by key puts draws that share state next to each other, so
+// submission only changes state where the state bits of the key change,
+// and orders opaque draws front to back and transparent ones back to
+// front.
+//
+// Key layout, most significant bits first:
+//   opaque, overlay: layer 4 | root signature 4 | pipeline 10 | material 16 | mesh 14 | depth 16
+//   transparent:     layer 4 | inverted depth 16 | root signature 4 | pipeline 10 | material 16 | mesh 14
+
+// layers are drawn in this order
+enum DrawLayer : uint32_t
+{
+    DrawLayerOpaque = 0,
+    DrawLayerTransparent,
+    DrawLayerOverlay,
+};
+
+// fields are cut to the width the layout has for them, depth is clamped to
+// [0, 1] with 0 at the camera
+struct DrawKey
+{
+    uint32_t layer;
+    uint32_t rootSignature;
+    uint32_t pipeline;
+    uint32_t material;
+    uint32_t mesh;
+    float depth;
+};
+
+uint64_t encodeDrawKey(const DrawKey& key);
+
+// the key without its depth, two draws next to each other need a state
+// change between them if this differs
+uint64_t drawKeyState(uint64_t key);
+
+// LSD radix sort of 64-bit keys with a 32-bit value each, eight bits per
+// pass. Passes over digits that are the same for every key are skipped,
+// which for draw keys are most of them. Stable, so draws with equal keys
+// keep their order.
+//
+// With a job system large arrays are split into one block per worker, the
+// blocks count their digits and scatter in parallel.
+class RadixSorter
+{
+public:
+    // jobs may be null to sort on the calling thread, returns how many
+    // digit passes it took
+    uint32_t sort(uint64_t* keys, uint32_t* values, uint32_t count, JobSystem* jobs);
+
+private:
+    std::vector<uint64_t> keyScratch_;
+    std::vector<uint32_t> valueScratch_;
+    std::vector<uint32_t> counts_; // 256 per block
+    std::vector<uint64_t> differences_; // per block
+};
+
+struct DrawSortBenchmark
+{
+    uint32_t keys;
+    uint32_t threads;
+    double radixSeconds;         // on one thread
+    double parallelRadixSeconds; // on every thread
+    double stdSortSeconds;       // std::stable_sort of the same pairs
+    double keysPerSecond;        // parallel radix sort
+    uint32_t passes;             // digit passes that were not skipped
+    uint32_t stateChangesBefore; // in the order the draws were generated
+    uint32_t stateChangesAfter;
+    uint32_t mismatches;         // pairs out of order or lost
+};
+
+// keyCount draw keys of a scene with a few pipelines, many materials and
+// meshes and a tenth of the objects transparent, sorted several times
+DrawSortBenchmark measureDrawSort(uint32_t keyCount, uint32_t threadCount, uint32_t iterations);
+
+#endif // DRAW_SORT_H
@@ -1,7 +1,22 @@
 #include "dx.h"
 
+#include "bindless_table.h"
+#include "command_capture_d3d12.h"
+#include "command_recording_d3d12.h"
+#include "command_recording.h"
 #include "config.h"
+#include "cube_mesh.h"
+#include "deferred_release.h"
+#include "descriptor_heap.h"
 #include "image.h"
+#include "instancing.h"
+#include "job_system.h"
+#include "mesh_lod.h"
+#include "profiler.h"
+#include "render_graph_d3d12.h"
+#include "render_packets.h"
+#include "residency_d3d12.h"
+#include "timeline_fence_d3d12.h"
 
 #pragma warning(push)
 #pragma warning(disable : 4324)
@@ -10,9 +25,16 @@
 
 #include "DirectXMath.h"
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
 #include <cstdint>
 #include <cstdio>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <d3d12.h>
 #include <d3dcompiler.h>
@@ -36,21 +58,56 @@ const D3D12_INPUT_ELEMENT_DESC Vertex::inputLayout[] =
 
 const size_t Vertex::inputLayoutSize = sizeof(Vertex::inputLayout) / sizeof(Vertex::inputLayout[0]);
 
-struct ConstantBuffer
+// per-draw root constants, the only thing that changes between instanced
+// draws. SV_InstanceID starts at 0 whatever the draw's start instance, so
+// the vertex shader adds the batch's first instance itself.
+struct DrawConstants
 {
-    DirectX::XMFLOAT4X4 wvpMatrix;
+    uint32_t firstInstance;
 
-    static const size_t GPUAlignedSize;
+    static const UINT num32BitValues;
 };
 
-const size_t ConstantBuffer::GPUAlignedSize = (sizeof(ConstantBuffer) + 255) & ~255;
+const UINT DrawConstants::num32BitValues = sizeof(DrawConstants) / sizeof(uint32_t);
+
+// draws of a frame slot, translated by the render thread from the packets
+// the scene queued and grouped into instanced batches
+struct FrameSlot
+{
+    InstanceBatcher instances;
+};
+
+// root signature layout
+enum RootParameter
+{
+    RootParameterInstanceSRV = 0,
+    RootParameterDrawConstants,
+    RootParameterBindlessSRVs,
+    RootParameterCount,
+};
 
 using Microsoft::WRL::ComPtr;
 
 constexpr int framebufferCount_ = 3;
 
+// descriptor heap sizes, the shader visible heap is split into a persistent
+// part and a ring for tables that live until their frame's fence completes
+constexpr uint32_t stagingDescriptorCount_ = 4096;
+constexpr uint32_t persistentDescriptorCount_ = 8192;
+constexpr uint32_t ringDescriptorCount_ = 8192;
+
+// number of persistent descriptors reserved for the bindless SRV table
+constexpr uint32_t bindlessTableSize_ = 4096;
+
+// smaller chunks cost more in per-list state setup than they save
+constexpr uint32_t minDrawsPerChunk_ = 256;
+
+// instances each back buffer's instance buffer has room for
+constexpr uint32_t maxInstances_ = 65536;
+
 // general device/present variables
 ComPtr<IDXGIFactory4> dxgiFactory_;
+ComPtr<IDXGIAdapter3> adapter_;
 ComPtr<ID3D12Device> device_;
 ComPtr<IDXGISwapChain3> swapChain_;
 D3D12_VIEWPORT viewport_;
@@ -59,11 +116,57 @@ ComPtr<ID3D12Debug> debugController_;
 
 // command resources
 ComPtr<ID3D12CommandQueue> commandQueue_;
-ComPtr<ID3D12CommandAllocator> commandAllocators_[framebufferCount_];
-ComPtr<ID3D12GraphicsCommandList> commandList_;
-ComPtr<ID3D12Fence> fences_[framebufferCount_];
-uint64_t fenceValues_[framebufferCount_];
-HANDLE fenceEvent_;
+
+// allocator/list pairs per recording thread, recycled by fence ticket
+D3D12CommandListPool commandListPool_;
+
+// list the render thread currently records into, taken from the pool
+// worker of the thread recording
+ID3D12GraphicsCommandList* commandList_;
+
+// work-stealing workers for engine jobs, the thread calling initd3d is
+// worker 0 and helps out whenever it waits on jobs
+JobSystem jobSystem_;
+
+// draws of the main pass are split into chunks and recorded in parallel as
+// jobs, the lists of a frame are submitted in order with one
+// ExecuteCommandLists
+ParallelRecorder drawRecorder_(jobSystem_);
+std::vector<DrawRange> drawChunks_;
+std::vector<ID3D12CommandList*> frameCommandLists_;
+
+// command capture, requested from any thread and started by the render
+// thread with its next frame
+std::mutex captureMutex_;
+std::string captureRequestPath_;
+uint32_t captureRequestFrames_ = 0;
+std::atomic<bool> captureRequested_(false);
+CaptureFile captureFile_;
+uint32_t captureFramesLeft_ = 0;
+
+// while capturing every list of the frame records into its own capture,
+// frameCaptures_ holds them in the order of frameCommandLists_. Captures
+// are reused from frame to frame.
+std::vector<std::unique_ptr<CommandCapture>> listCaptures_;
+size_t listCapturesUsed_ = 0;
+std::vector<const CommandCapture*> frameCaptures_;
+
+// capture of commandList_, null while not capturing
+CommandCapture* commandCapture_ = nullptr;
+
+// signaled after every submission, objects retired to deferredRelease_ are
+// released once it passes the value of their last use
+D3D12TimelineFence queueFence_;
+DeferredReleaseQueue deferredRelease_;
+
+// last submission that used each back buffer slot (allocator, constant
+// buffer, depth buffer and descriptor ring part)
+FenceTicket backBufferTickets_[framebufferCount_];
+
+// submission of each of the last frames, indexed by
+// frameNumber_ % framebufferCount_
+FenceTicket frameTickets_[framebufferCount_];
+std::atomic<int> framesInFlight_(framebufferCount_ - 1);
 
 // graphics pipeline state config
 ComPtr<ID3D12PipelineState> pipelineState_;
@@ -76,41 +179,56 @@ D3D12_VERTEX_BUFFER_VIEW vertexBufferView_;
 D3D12_INDEX_BUFFER_VIEW indexBufferView_;
 
 // Render target variables
-ComPtr<ID3D12DescriptorHeap> rtvDescriptorHeap_;
+StagingDescriptorHeap rtvDescriptorHeap_;
 ComPtr<ID3D12Resource> renderTargets_[framebufferCount_];
-uint32_t rtvHandleSize_;
+DescriptorHandle rtvHandles_[framebufferCount_];
 
 // Depth stencil variables
 ComPtr<ID3D12Resource> depthStencilBuffer_[framebufferCount_];
-ComPtr<ID3D12DescriptorHeap> dsvDescriptorHeap_;
-uint32_t dsHandleSize_;
+StagingDescriptorHeap dsvDescriptorHeap_;
+DescriptorHandle dsvHandles_[framebufferCount_];
 
-// Constant buffer variables;
-ComPtr<ID3D12Resource> constBuffers_[framebufferCount_];
-ConstantBuffer cbuf_;
+// per-instance data of the frame, read by the vertex shader as a
+// structured buffer
+ComPtr<ID3D12Resource> instanceBuffers_[framebufferCount_];
 
 // Texture variables
 ComPtr<ID3D12Resource> textureBuffer_;
-ComPtr<ID3D12DescriptorHeap> mainDescriptorHeap_;
+BindlessHandle textureIndex_;
+
+// Descriptor heaps for shader resources
+StagingDescriptorHeap srvStagingHeap_;
+ShaderVisibleDescriptorHeap mainDescriptorHeap_;
 
-// matrices
-DirectX::XMFLOAT4X4 cameraProjMat;
-DirectX::XMFLOAT4X4 cameraViewMat;
+// global SRV table, shaders index it with InstanceData::materialIndex
+BindlessTable bindlessTable_;
+DescriptorHandle bindlessDescriptors_;
 
-DirectX::XMFLOAT4 cameraPos;
-DirectX::XMFLOAT4 cameraUp;
-DirectX::XMFLOAT4 cameraTarget;
+// views staged for the bindless table, copied in one CopyDescriptors call
+// before the next frame records, together with the staging descriptors
+// they are copied from
+DescriptorCopyBatch descriptorCopies_;
+std::vector<DescriptorHandle> stagedDescriptors_;
 
-DirectX::XMFLOAT4X4 cube1WorldMat;
-DirectX::XMFLOAT4X4 cube1RotMat;
-DirectX::XMFLOAT4 cube1Pos;
+// frame graph, rebuilt every frame
+RenderGraph frameGraph_;
+D3D12TransientHeap transientHeap_;
 
-DirectX::XMFLOAT4X4 cube2WorldMat;
-DirectX::XMFLOAT4X4 cube2RotMat;
-DirectX::XMFLOAT4 cube2PosOffset;
+// GPU memory accounting
+ResidencyManager residency_;
+ResidencyHandle vertexBufferResidency_;
+ResidencyHandle indexBufferResidency_;
+ResidencyHandle textureResidency_;
+
+FrameSlot frameSlots_[frameSlotCount_];
+
+// index ranges of the geometry in the vertex and index buffers, by the
+// mesh id batches carry. The scene only has the cube, its levels are
+// numbered the way its MeshLodTable numbers them.
+std::vector<MeshLod> geometries_;
 
-int numCubeIndices_;
 int frameIdx_;
+uint64_t frameNumber_;
 
 OnErrorCallback errorCallback_;
 
@@ -119,8 +237,22 @@ static const std::string projectRoot_(PROJECT_SRC_DIR);
 static const std::wstring wprojectRoot_(projectRoot_.begin(), projectRoot_.end());
 
 // static (private) functions
-static void updatePipeline();
-static void waitForPreviousFrame(bool isShutdown = false);
+static bool translateRenderPackets(RenderPacketQueue& packets, UINT slot);
+static bool updatePipeline(UINT slot);
+static void uploadInstances(const FrameSlot& frameSlot);
+static void recordMainPass(UINT slot, D3D12RenderGraphExecutor& executor);
+static void bindMainPassState(D3D12CapturedList& commandList);
+static void recordDraws(D3D12CapturedList& commandList, UINT slot, const DrawRange& range);
+static void submitList(ID3D12GraphicsCommandList* commandList, const CommandCapture* capture);
+static void beginCaptureFrame();
+static void endCaptureFrame();
+static CommandCapture* acquireCapture(ID3D12PipelineState* initialState);
+static void waitForPreviousFrame();
+static void waitForFence(const FenceTicket& ticket);
+static bool beginUpload();
+static FenceTicket submitUpload();
+static void updateResidency();
+static ResidencyHandle trackResidency(ID3D12Resource* resource, uint32_t priority);
 
 static bool createDxgiFactory();
 static bool createDevice();
@@ -128,17 +260,20 @@ static bool createSwapChain(HWND window, int width, int height, bool fullscreen)
 static bool createCommandQueue();
 static bool createRTVDescHeap();
 static bool createDSVDescHeap(int width, int height);
+static bool createSRVDescHeaps();
 static bool createCommandResources();
 static bool createRootSignature();
-static bool createConstBuffers();
+static bool createInstanceBuffers();
 static bool compileShader(const std::wstring& name, const char* shaderType, ID3DBlob** outShaderBytecode);
 static bool createPSO(ID3DBlob* vertexShader, ID3DBlob* pixelShader);
 static bool setupGeometry();
 static bool setupTexture();
+static BindlessHandle createBindlessSRV(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC& srvDesc);
+static void flushDescriptorCopies();
 
 bool initd3d(HWND window, int width, int height, bool fullscreen, OnErrorCallback errorCallback)
 {
-    using namespace DirectX;
+    PROFILE_FUNCTION();
 
     errorCallback_ = errorCallback;
 
@@ -160,7 +295,10 @@ bool initd3d(HWND window, int width, int height, bool fullscreen, OnErrorCallbac
     if (!createDSVDescHeap(width, height))
         return false;
 
-    if (!createConstBuffers())
+    if (!createSRVDescHeaps())
+        return false;
+
+    if (!createInstanceBuffers())
         return false;
 
     if (!createCommandResources())
@@ -170,11 +308,11 @@ bool initd3d(HWND window, int width, int height, bool fullscreen, OnErrorCallbac
         return false;
 
     ComPtr<ID3DBlob> vertexShader;
-    if (!compileShader(std::wstring(L"vertex.hlsl"), "vs_5_0", vertexShader.GetAddressOf()))
+    if (!compileShader(std::wstring(L"vertex.hlsl"), "vs_5_1", vertexShader.GetAddressOf()))
         return false;
 
     ComPtr<ID3DBlob> pixelShader;
-    if (!compileShader(std::wstring(L"pixel.hlsl"), "ps_5_0", pixelShader.GetAddressOf()))
+    if (!compileShader(std::wstring(L"pixel.hlsl"), "ps_5_1", pixelShader.GetAddressOf()))
         return false;
 
     if (!createPSO(vertexShader.Get(), pixelShader.Get()))
@@ -186,6 +324,8 @@ bool initd3d(HWND window, int width, int height, bool fullscreen, OnErrorCallbac
     if (!setupTexture())
         return false;
 
+    flushDescriptorCopies();
+
     viewport_.TopLeftX = 0;
     viewport_.TopLeftY = 0;
     viewport_.Width = (float)width;
@@ -198,232 +338,489 @@ bool initd3d(HWND window, int width, int height, bool fullscreen, OnErrorCallbac
     scissors_.bottom = height;
     scissors_.right = width;
 
-    // build projection and view matrix
-    XMMATRIX tmpMat = XMMatrixPerspectiveFovLH(45.0f*(3.14f / 180.0f), (float)width / (float)height, 0.1f, 1000.0f);
-    XMStoreFloat4x4(&cameraProjMat, tmpMat);
+    return true;
+}
 
-    // set starting camera state
-    cameraPos = XMFLOAT4(0.0f, 2.0f, -4.0f, 0.0f);
-    cameraTarget = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
-    cameraUp = XMFLOAT4(0.0f, 1.0f, 0.0f, 0.0f);
+void render(RenderPacketQueue& packets, UINT slot)
+{
+    PROFILE_FUNCTION();
 
-    // build view matrix
-    XMVECTOR cPos = XMLoadFloat4(&cameraPos);
-    XMVECTOR cTarg = XMLoadFloat4(&cameraTarget);
-    XMVECTOR cUp = XMLoadFloat4(&cameraUp);
-    tmpMat = XMMatrixLookAtLH(cPos, cTarg, cUp);
-    XMStoreFloat4x4(&cameraViewMat, tmpMat);
+    HRESULT result;
 
-    // set starting cubes position
-    // first cube
-    cube1Pos = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f); // set cube 1's position
-    XMVECTOR posVec = XMLoadFloat4(&cube1Pos); // create xmvector for cube1's position
+    if (!translateRenderPackets(packets, slot) || !updatePipeline(slot)) {
+        errorCallback_();
+        return;
+    }
 
-    tmpMat = XMMatrixTranslationFromVector(posVec); // create translation matrix from cube1's position vector
-    XMStoreFloat4x4(&cube1RotMat, XMMatrixIdentity()); // initialize cube1's rotation matrix to identity matrix
-    XMStoreFloat4x4(&cube1WorldMat, tmpMat); // store cube1's world matrix
+    {
+        PROFILE_ZONE("ExecuteCommandLists");
+        commandQueue_->ExecuteCommandLists(static_cast<UINT>(frameCommandLists_.size()), frameCommandLists_.data());
+    }
+    endCaptureFrame();
 
-                                             // second cube
-    cube2PosOffset = XMFLOAT4(1.5f, 0.0f, 0.0f, 0.0f);
-    posVec = XMLoadFloat4(&cube2PosOffset) + XMLoadFloat4(&cube1Pos); // create xmvector for cube2's position
-                                                                                // we are rotating around cube1 here, so add cube2's position to cube1
+    const FenceTicket frameTicket = queueFence_.signal();
+    if (!frameTicket.isValid())
+        errorCallback_();
+    commandListPool_.retire(frameTicket);
+    mainDescriptorHeap_.endFrame(frameTicket.value);
+    backBufferTickets_[frameIdx_] = frameTicket;
+    frameTickets_[frameNumber_ % framebufferCount_] = frameTicket;
+
+    {
+        PROFILE_ZONE("Present");
+        result = swapChain_->Present(0, 0);
+    }
+    if (FAILED(result))
+        errorCallback_();
+}
 
-    tmpMat = XMMatrixTranslationFromVector(posVec); // create translation matrix from cube2's position offset vector
-    XMStoreFloat4x4(&cube2RotMat, XMMatrixIdentity()); // initialize cube2's rotation matrix to identity matrix
-    XMStoreFloat4x4(&cube2WorldMat, tmpMat); // store cube2's world matrix
+void cleanupd3d()
+{
+    waitForFence(queueFence_.lastSignaled());
+    deferredRelease_.releaseAll();
+    jobSystem_.stop();
+    captureFile_.close();
 
-    return true;
+    BOOL fullscreen = false;
+    HRESULT result = swapChain_->GetFullscreenState(&fullscreen, NULL);
+    if (FAILED(result))
+        errorCallback_();
+
+    if (fullscreen)
+        swapChain_->SetFullscreenState(false, NULL);
 }
 
-void update()
+void setFramesInFlight(int count)
 {
-    using DirectX::XMMATRIX;
-    using DirectX::XMMatrixRotationX;
-    using DirectX::XMMatrixRotationY;
-    using DirectX::XMMatrixRotationZ;
-    using DirectX::XMLoadFloat4x4;
-    using DirectX::XMLoadFloat4;
-    using DirectX::XMMatrixTranslationFromVector;
-    using DirectX::XMMatrixScaling;
-
-    // map and copy constant buffer
-    CD3DX12_RANGE readRange{ 0, 0 };
-    CD3DX12_RANGE writeRange{ 0, 2 * sizeof(ConstantBuffer::GPUAlignedSize) };
-    uint8_t* cbufGpuAddr;
+    framesInFlight_ = count < 1 ? 1 : (count > framebufferCount_ ? framebufferCount_ : count);
+}
 
-    constBuffers_[frameIdx_]->Map(0, &readRange, reinterpret_cast<void**>(&cbufGpuAddr));
+void captureCommands(const char* path, uint32_t frameCount)
+{
+    std::lock_guard<std::mutex> lock(captureMutex_);
+    captureRequestPath_ = path;
+    captureRequestFrames_ = frameCount;
+    captureRequested_ = true;
+}
 
-    // create rotation matrices
-    XMMATRIX rotXMat = XMMatrixRotationX(0.0001f);
-    XMMATRIX rotYMat = XMMatrixRotationY(0.0002f);
-    XMMATRIX rotZMat = XMMatrixRotationZ(0.0003f);
+uint32_t defaultMaterialIndex()
+{
+    return textureIndex_.index;
+}
 
-    // add rotation to cube1's rotation matrix and store it
-    XMMATRIX rotMat = XMLoadFloat4x4(&cube1RotMat) * rotXMat * rotYMat * rotZMat;
-    XMStoreFloat4x4(&cube1RotMat, rotMat);
+// blocks until the GPU is far enough along to start another frame, only
+// called from the render thread before it reuses a frame slot
+static void waitForFrameLatency()
+{
+    PROFILE_FUNCTION();
 
-    // create translation matrix for cube 1 from cube 1's position vector
-    XMMATRIX translationMat = XMMatrixTranslationFromVector(XMLoadFloat4(&cube1Pos));
+    // the next frame may start once frame (next - framesInFlight) is done
+    const uint64_t framesInFlight = static_cast<uint64_t>(framesInFlight_.load());
+    const uint64_t nextFrame = frameNumber_ + 1;
+    if (nextFrame <= framesInFlight)
+        return;
 
-    // create cube1's world matrix by first rotating the cube, then positioning the rotated cube
-    XMMATRIX worldMat = rotMat * translationMat;
+    waitForFence(frameTickets_[(nextFrame - framesInFlight) % framebufferCount_]);
+}
 
-    // store cube1's world matrix
-    XMStoreFloat4x4(&cube1WorldMat, worldMat);
+// turns the queued packets of a frame into the instanced batches the
+// recording reads, in sort key order
+class DrawPacketTranslator : public RenderPacketTranslator
+{
+public:
+    DrawPacketTranslator()
+        : instances_(nullptr)
+    {
+    }
 
-    // update constant buffer for cube1
-    // create the wvp matrix and store in constant buffer
-    XMMATRIX viewMat = XMLoadFloat4x4(&cameraViewMat); // load view matrix
-    XMMATRIX projMat = XMLoadFloat4x4(&cameraProjMat); // load projection matrix
-    XMMATRIX wvpMat = XMLoadFloat4x4(&cube1WorldMat) * viewMat * projMat; // create wvp matrix
-    XMMATRIX transposed = XMMatrixTranspose(wvpMat); // must transpose wvp matrix for the gpu
-    XMStoreFloat4x4(&cbuf_.wvpMatrix, transposed); // store transposed wvp matrix in constant buffer
+    void beginFrame(uint32_t frameSlot) override
+    {
+        instances_ = &frameSlots_[frameSlot].instances;
+        instances_->clear();
+    }
 
-    // copy our ConstantBuffer instance to the mapped constant buffer resource
-    memcpy(cbufGpuAddr, &cbuf_, sizeof(cbuf_));
+    void draw(const RenderPacket& packet) override
+    {
+        instances_->add(packet.sortKey, packet.meshIndex, packet.materialIndex, packet.worldViewProjection);
+    }
 
-    // now do cube2's world matrix
-    // create rotation matrices for cube2
-    rotXMat = XMMatrixRotationX(0.0003f);
-    rotYMat = XMMatrixRotationY(0.0002f);
-    rotZMat = XMMatrixRotationZ(0.0001f);
+    void endFrame() override
+    {
+        // the recording that uses the jobs comes after translation
+        instances_->build(&jobSystem_);
+        instances_ = nullptr;
+    }
 
-    // add rotation to cube2's rotation matrix and store it
-    rotMat = rotZMat * (XMLoadFloat4x4(&cube2RotMat) * (rotXMat * rotYMat));
-    XMStoreFloat4x4(&cube2RotMat, rotMat);
+private:
+    InstanceBatcher* instances_;
+};
 
-    // create translation matrix for cube 2 to offset it from cube 1 (its position relative to cube1
-    XMMATRIX translationOffsetMat = XMMatrixTranslationFromVector(XMLoadFloat4(&cube2PosOffset));
+static bool translateRenderPackets(RenderPacketQueue& packets, UINT slot)
+{
+    PROFILE_FUNCTION();
 
-    // we want cube 2 to be half the size of cube 1, so we scale it by .5 in all dimensions
-    XMMATRIX scaleMat = XMMatrixScaling(0.5f, 0.5f, 0.5f);
+    // frames are queued in the order they are rendered, anything else means
+    // a stage got out of step
+    DrawPacketTranslator translator;
+    return translateFrame(packets, translator) == slot;
+}
 
-    // reuse worldMat. 
-    // first we scale cube2. scaling happens relative to point 0,0,0, so you will almost always want to scale first
-    // then we translate it. 
-    // then we rotate it. rotation always rotates around point 0,0,0
-    // finally we move it to cube 1's position, which will cause it to rotate around cube 1
-    worldMat = scaleMat * translationOffsetMat * rotMat * translationMat;
+static bool updatePipeline(UINT slot)
+{
+    PROFILE_FUNCTION();
 
-    wvpMat = XMLoadFloat4x4(&cube2WorldMat) * viewMat * projMat; // create wvp matrix
-    transposed = XMMatrixTranspose(wvpMat); // must transpose wvp matrix for the gpu
-    XMStoreFloat4x4(&cbuf_.wvpMatrix, transposed); // store transposed wvp matrix in constant buffer
+    HRESULT result;
 
-    // copy our ConstantBuffer instance to the mapped constant buffer resource
-    memcpy(cbufGpuAddr + ConstantBuffer::GPUAlignedSize, &cbuf_, sizeof(cbuf_));
+    waitForFrameLatency();
+    waitForPreviousFrame();
 
-    // store cube2's world matrix
-    XMStoreFloat4x4(&cube2WorldMat, worldMat);
+    // GPU is done with this frame slot, so indices it released can be
+    // reused, and views created since the last frame go into the table
+    bindlessTable_.beginFrame();
+    flushDescriptorCopies();
+    deferredRelease_.collect(queueFence_.completedValue());
+    mainDescriptorHeap_.collectTables(queueFence_.completedValue());
 
-    constBuffers_[frameIdx_]->Unmap(0, &writeRange);
-}
+    frameNumber_++;
+    updateResidency();
+    uploadInstances(frameSlots_[slot]);
 
-void render()
-{
-    HRESULT result;
+    frameCommandLists_.clear();
+    beginCaptureFrame();
 
-    updatePipeline();
+    commandList_ = commandListPool_.acquire(drawRecorder_.currentWorker(), pipelineState_.Get());
+    if (!commandList_)
+        return false;
+    commandCapture_ = acquireCapture(pipelineState_.Get());
 
-    ID3D12CommandList* commandLists[] = { commandList_.Get() };
+    // describe the frame, the graph works out the barriers between passes
+    // and back to the states the swap chain expects
+    frameGraph_.reset();
 
-    commandQueue_->ExecuteCommandLists(1, commandLists);
+    const RenderGraphResource backBuffer = frameGraph_.importResource("BackBuffer", renderTargets_[frameIdx_].Get(), ResourceStatePresent, ResourceStatePresent);
+    const RenderGraphResource depthBuffer = frameGraph_.importResource("DepthBuffer", depthStencilBuffer_[frameIdx_].Get(), ResourceStateDepthWrite, ResourceStateDepthWrite);
 
-    result = commandQueue_->Signal(fences_[frameIdx_].Get(), fenceValues_[frameIdx_]);
-    if (FAILED(result))
-        errorCallback_();
+    D3D12RenderGraphExecutor executor(commandList_, commandCapture_);
+
+    const RenderGraphPass mainPass = frameGraph_.addPass("MainPass", [slot, &executor]() { recordMainPass(slot, executor); });
+    frameGraph_.write(mainPass, backBuffer, ResourceStateRenderTarget);
+    frameGraph_.write(mainPass, depthBuffer, ResourceStateDepthWrite);
+
+    if (!frameGraph_.compile() || !transientHeap_.realize(device_.Get(), frameGraph_, deferredRelease_, queueFence_.lastSignaled().value))
+        return false;
+
+    frameGraph_.execute(executor);
+
+    // a pass that failed to get its lists leaves commandList_ null
+    if (!commandList_)
+        return false;
 
-    result = swapChain_->Present(0, 0);
+    result = D3D12CapturedList(commandList_, commandCapture_).close();
     if (FAILED(result))
-        errorCallback_();
+        return false;
+    submitList(commandList_, commandCapture_);
+
+    return true;
 }
 
-void cleanupd3d()
+static void submitList(ID3D12GraphicsCommandList* commandList, const CommandCapture* capture)
 {
-    for (int i = 0; i < framebufferCount_; ++i) {
-        frameIdx_ = i;
-        waitForPreviousFrame(true);
+    frameCommandLists_.push_back(commandList);
+    if (capture)
+        frameCaptures_.push_back(capture);
+}
+
+static void beginCaptureFrame()
+{
+    if (captureRequested_.exchange(false)) {
+        std::lock_guard<std::mutex> lock(captureMutex_);
+        if (captureRequestFrames_ > 0 && captureFile_.open(captureRequestPath_.c_str()))
+            captureFramesLeft_ = captureRequestFrames_;
+        else
+            captureFile_.close();
     }
 
-    BOOL fullscreen = false;
-    HRESULT result = swapChain_->GetFullscreenState(&fullscreen, NULL);
-    if (FAILED(result))
-        errorCallback_();
+    listCapturesUsed_ = 0;
+    frameCaptures_.clear();
 
-    if (fullscreen)
-        swapChain_->SetFullscreenState(false, NULL);
+    if (captureFile_.isOpen())
+        captureFile_.beginFrame(frameNumber_);
+}
+
+static void endCaptureFrame()
+{
+    if (!captureFile_.isOpen())
+        return;
+
+    PROFILE_FUNCTION();
 
-    CloseHandle(fenceEvent_);
+    // lists in the order they were submitted
+    captureFile_.submit(frameCaptures_.data(), static_cast<uint32_t>(frameCaptures_.size()));
+
+    // a failed write ends the capture, the frames so far are still usable
+    if (!captureFile_.endFrame() || --captureFramesLeft_ == 0)
+        captureFile_.close();
 }
 
-static void updatePipeline()
+// only call from the render thread, lists recorded on workers get their
+// capture before the jobs start
+static CommandCapture* acquireCapture(ID3D12PipelineState* initialState)
 {
-    HRESULT result;
+    if (!captureFile_.isOpen())
+        return nullptr;
 
-    waitForPreviousFrame();
+    if (listCapturesUsed_ == listCaptures_.size())
+        listCaptures_.emplace_back(new CommandCapture());
 
-    result = commandAllocators_[frameIdx_]->Reset();
-    if (FAILED(result))
-        errorCallback_();
+    CommandCapture* capture = listCaptures_[listCapturesUsed_++].get();
+    capture->reset(captureHandle(initialState));
 
-    result = commandList_->Reset(commandAllocators_[frameIdx_].Get(), pipelineState_.Get());
-    if (FAILED(result))
+    return capture;
+}
+
+static void uploadInstances(const FrameSlot& frameSlot)
+{
+    PROFILE_FUNCTION();
+
+    // the instance buffer of this back buffer slot is no longer used by the
+    // GPU, write the instances in batch order. Instances beyond its
+    // capacity are dropped.
+    const uint32_t instanceCount = std::min(frameSlot.instances.drawCount(), maxInstances_);
+
+    CD3DX12_RANGE readRange{ 0, 0 };
+    CD3DX12_RANGE writeRange{ 0, instanceCount * sizeof(InstanceData) };
+    InstanceData* instances;
+
+    HRESULT result = instanceBuffers_[frameIdx_]->Map(0, &readRange, reinterpret_cast<void**>(&instances));
+    if (FAILED(result)) {
         errorCallback_();
+        return;
+    }
+
+    frameSlot.instances.writeInstances(instances, instanceCount);
+
+    instanceBuffers_[frameIdx_]->Unmap(0, &writeRange);
+}
 
-    const auto presentToRenderTarget = CD3DX12_RESOURCE_BARRIER::Transition(renderTargets_[frameIdx_].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-    const auto renderTargetToPresent = CD3DX12_RESOURCE_BARRIER::Transition(renderTargets_[frameIdx_].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+// records a chunk of the main pass draws into its own list from the pool
+class MainPassChunkRecorder : public CommandRecordingBackend
+{
+public:
+    MainPassChunkRecorder(UINT slot, size_t chunkCount)
+        : slot_(slot)
+        , lists_(chunkCount, nullptr)
+        , captures_(chunkCount, nullptr)
+    {
+        for (CommandCapture*& capture : captures_)
+            capture = acquireCapture(pipelineState_.Get());
+    }
+
+    void recordChunk(uint32_t chunk, const DrawRange& range, uint32_t worker) override
+    {
+        PROFILE_ZONE("RecordMainPassChunk");
+
+        ID3D12GraphicsCommandList* commandList = commandListPool_.acquire(worker, pipelineState_.Get());
+        if (!commandList)
+            return;
 
-    commandList_->ResourceBarrier(1, &presentToRenderTarget);
+        D3D12CapturedList capturedList(commandList, captures_[chunk]);
+        bindMainPassState(capturedList);
+        recordDraws(capturedList, slot_, range);
+
+        if (SUCCEEDED(capturedList.close()))
+            lists_[chunk] = commandList;
+    }
+
+    // submits the lists in chunk order, false if any chunk failed
+    bool submitLists() const
+    {
+        for (ID3D12GraphicsCommandList* list : lists_) {
+            if (!list)
+                return false;
+        }
+
+        for (size_t chunk = 0; chunk < lists_.size(); ++chunk)
+            submitList(lists_[chunk], captures_[chunk]);
+
+        return true;
+    }
+
+private:
+    UINT slot_;
+    std::vector<ID3D12GraphicsCommandList*> lists_;
+    std::vector<CommandCapture*> captures_;
+};
+
+static void recordMainPass(UINT slot, D3D12RenderGraphExecutor& executor)
+{
+    PROFILE_FUNCTION();
 
-    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle{ rtvDescriptorHeap_->GetCPUDescriptorHandleForHeapStart(), frameIdx_, rtvHandleSize_ };
-    CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle{ dsvDescriptorHeap_->GetCPUDescriptorHandleForHeapStart(), frameIdx_, dsHandleSize_ };
+    const D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = rtvHandles_[frameIdx_].cpu;
+    const D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = dsvHandles_[frameIdx_].cpu;
 
-    commandList_->OMSetRenderTargets(1, &rtvHandle, false, &dsvHandle);
+    D3D12CapturedList commandList(commandList_, commandCapture_);
+    commandList.setRenderTargets(1, &rtvHandle, &dsvHandle);
 
     const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
-    commandList_->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
-    commandList_->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+    commandList.clearRenderTarget(rtvHandle, clearColor);
+    commandList.clearDepthStencil(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0);
+
+    // chunks are ranges of batches, each one a draw
+    const uint32_t drawCount = static_cast<uint32_t>(frameSlots_[slot].instances.batches().size());
+    partitionDraws(drawCount, drawRecorder_.workerCount(), minDrawsPerChunk_, drawChunks_);
+
+    // not worth another list, record right after the clear
+    if (drawChunks_.size() <= 1) {
+        bindMainPassState(commandList);
+        recordDraws(commandList, slot, { 0, drawCount });
+        return;
+    }
+
+    // the clear goes first, then the chunks in order, whatever the graph
+    // records after the pass continues in a new list
+    HRESULT result = commandList.close();
+    if (FAILED(result)) {
+        commandList_ = nullptr;
+        return;
+    }
+    submitList(commandList_, commandCapture_);
+
+    MainPassChunkRecorder chunkRecorder(slot, drawChunks_.size());
+    drawRecorder_.record(drawChunks_.data(), static_cast<uint32_t>(drawChunks_.size()), chunkRecorder);
+
+    commandList_ = nullptr;
+    if (!chunkRecorder.submitLists())
+        return;
+
+    commandList_ = commandListPool_.acquire(drawRecorder_.currentWorker(), pipelineState_.Get());
+    commandCapture_ = acquireCapture(pipelineState_.Get());
+    executor.setCommandList(commandList_, commandCapture_);
+}
 
-    commandList_->RSSetViewports(1, &viewport_);
-    commandList_->RSSetScissorRects(1, &scissors_);
-    commandList_->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    commandList_->IASetVertexBuffers(0, 1, &vertexBufferView_);
-    commandList_->IASetIndexBuffer(&indexBufferView_);
+static void bindMainPassState(D3D12CapturedList& commandList)
+{
+    // lists do not inherit state from each other, every chunk sets it up
+    const D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = rtvHandles_[frameIdx_].cpu;
+    const D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = dsvHandles_[frameIdx_].cpu;
+
+    commandList.setRenderTargets(1, &rtvHandle, &dsvHandle);
+    commandList.setViewports(1, &viewport_);
+    commandList.setScissorRects(1, &scissors_);
+    commandList.setPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    commandList.setVertexBuffers(0, 1, &vertexBufferView_);
+    commandList.setIndexBuffer(&indexBufferView_);
+
+    ID3D12DescriptorHeap* descriptorHeaps[] = { mainDescriptorHeap_.heap() };
+
+    // heap, bindless table and instance buffer are bound once per list,
+    // draws only switch their first instance
+    commandList.setRootSignature(rootSignature_.Get());
+    commandList.setDescriptorHeaps(sizeof(descriptorHeaps) / sizeof(descriptorHeaps[0]), descriptorHeaps);
+    commandList.setRootDescriptorTable(RootParameterBindlessSRVs, bindlessDescriptors_.gpu);
+    commandList.setRootShaderResourceView(RootParameterInstanceSRV, instanceBuffers_[frameIdx_]->GetGPUVirtualAddress());
+}
 
-    ID3D12DescriptorHeap* descriptorHeaps[] = { mainDescriptorHeap_.Get() };
+static void recordDraws(D3D12CapturedList& commandList, UINT slot, const DrawRange& range)
+{
+    const std::vector<InstanceBatch>& batches = frameSlots_[slot].instances.batches();
 
-    commandList_->SetGraphicsRootSignature(rootSignature_.Get());
-    commandList_->SetDescriptorHeaps(sizeof(descriptorHeaps) / sizeof(descriptorHeaps[0]), descriptorHeaps);
-    commandList_->SetGraphicsRootConstantBufferView(0, constBuffers_[frameIdx_]->GetGPUVirtualAddress());
-    commandList_->SetGraphicsRootDescriptorTable(1, mainDescriptorHeap_->GetGPUDescriptorHandleForHeapStart());
+    for (uint32_t i = range.begin; i < range.end; ++i) {
+        // the upload dropped whatever did not fit the instance buffer
+        const InstanceBatch& batch = batches[i];
+        if (batch.firstInstance >= maxInstances_)
+            break;
 
-    commandList_->DrawIndexedInstanced(numCubeIndices_, 1, 0, 0, 0);
+        // a mesh the buffers do not have is not drawn
+        if (batch.mesh >= geometries_.size())
+            continue;
+        const MeshLod& geometry = geometries_[batch.mesh];
 
-    commandList_->SetGraphicsRootConstantBufferView(0, constBuffers_[frameIdx_]->GetGPUVirtualAddress() + ConstantBuffer::GPUAlignedSize);
-    commandList_->DrawIndexedInstanced(numCubeIndices_, 1, 0, 0, 0);
+        DrawConstants drawConstants;
+        drawConstants.firstInstance = batch.firstInstance;
+        const uint32_t instanceCount = std::min(batch.instanceCount, maxInstances_ - batch.firstInstance);
 
-    commandList_->ResourceBarrier(1, &renderTargetToPresent);
+        commandList.setRoot32BitConstants(RootParameterDrawConstants, DrawConstants::num32BitValues, &drawConstants, 0);
+        commandList.drawIndexedInstanced(geometry.indexCount, instanceCount, geometry.firstIndex, geometry.baseVertex, 0);
+    }
+}
 
-    result = commandList_->Close();
+static void waitForFence(const FenceTicket& ticket)
+{
+    if (!waitForTicket(ticket))
+        errorCallback_();
+}
+
+static void releaseComObject(void* object)
+{
+    static_cast<IUnknown*>(object)->Release();
+}
+
+// hands the reference over to deferredRelease_, object is null afterwards
+template <typename T>
+static void retire(ComPtr<T>& object, const FenceTicket& ticket)
+{
+    IUnknown* unknown = object.Detach();
+    if (unknown)
+        deferredRelease_.retire(unknown, releaseComObject, ticket.value);
+}
+
+static bool beginUpload()
+{
+    // uploads take a list from the pool like frames do, so they never have
+    // to wait for a frame slot
+    commandList_ = commandListPool_.acquire(drawRecorder_.currentWorker(), nullptr);
+
+    return commandList_ != nullptr;
+}
+
+static FenceTicket submitUpload()
+{
+    HRESULT result = commandList_->Close();
     if (FAILED(result))
+        return FenceTicket();
+
+    ID3D12CommandList* cmdLists[] = { commandList_ };
+    commandQueue_->ExecuteCommandLists(1, cmdLists);
+
+    const FenceTicket ticket = queueFence_.signal();
+    commandListPool_.retire(ticket);
+
+    return ticket;
+}
+
+static void updateResidency()
+{
+    PROFILE_FUNCTION();
+
+    // budget changes as other processes come and go, so keep following it
+    const uint64_t budget = queryVideoMemoryBudget(adapter_.Get());
+    if (budget > 0)
+        residency_.setBudget(budget);
+
+    residency_.markUsed(vertexBufferResidency_, frameNumber_);
+    residency_.markUsed(indexBufferResidency_, frameNumber_);
+    residency_.markUsed(textureResidency_, frameNumber_);
+
+    D3D12ResidencyBackend backend(device_.Get());
+    if (!residency_.update(frameNumber_, backend))
         errorCallback_();
 }
 
-static void waitForPreviousFrame(bool isShutdown)
+static ResidencyHandle trackResidency(ID3D12Resource* resource, uint32_t priority)
 {
-    HRESULT result;
+    const D3D12_RESOURCE_DESC desc = resource->GetDesc();
+    ID3D12Pageable* pageable = resource;
 
-    if (!isShutdown)
-        frameIdx_ = swapChain_->GetCurrentBackBufferIndex();
+    return residency_.track(pageable, resourceSize(device_.Get(), desc), priority);
+}
 
-    if (fences_[frameIdx_]->GetCompletedValue() < fenceValues_[frameIdx_]) {
-        result = fences_[frameIdx_]->SetEventOnCompletion(fenceValues_[frameIdx_], fenceEvent_);
-        if (FAILED(result))
-            errorCallback_();
+static void waitForPreviousFrame()
+{
+    PROFILE_FUNCTION();
 
-        WaitForSingleObject(fenceEvent_, INFINITE);
-    }
+    frameIdx_ = swapChain_->GetCurrentBackBufferIndex();
 
-    fenceValues_[frameIdx_]++;
+    waitForFence(backBufferTickets_[frameIdx_]);
 }
 
 
@@ -468,10 +865,20 @@ static bool createDevice()
     if (!adapterFound)
         return false;
 
+    // IDXGIAdapter3 is needed for video memory budget queries
+    result = adapter.As(&adapter_);
+    if (FAILED(result))
+        return false;
+
     result = D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(device_.GetAddressOf()));
     if (FAILED(result))
         return false;
 
+    // anything used by the last framesInFlight frames is never evicted, if
+    // the budget can not be queried nothing is evicted at all
+    const uint64_t budget = queryVideoMemoryBudget(adapter_.Get());
+    residency_.reset(budget > 0 ? budget : UINT64_MAX, framebufferCount_);
+
     return true;
 }
 
@@ -521,29 +928,21 @@ static bool createRTVDescHeap()
     // create render target view (rtv) descriptor memory. This is basically a
     // memory/buffer, that will hold handles to the backbuffers to which
     // the GPU will write
-    D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-    rtvHeapDesc.NumDescriptors = framebufferCount_;
-    rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-    rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-    HRESULT result = device_->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(rtvDescriptorHeap_.GetAddressOf()));
-    if (FAILED(result))
+    if (!rtvDescriptorHeap_.init(device_.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_RTV, framebufferCount_, L"RenderTargetDescriptorHeap"))
         return false;
 
-    rtvHandleSize_ = device_->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-
-    // handle to the beginning of memory buffer (or descriptor heap in dx12 terms)
-    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle{ rtvDescriptorHeap_->GetCPUDescriptorHandleForHeapStart() };
-
     // for each buffer in swap chain create render target view (a handle to
-    // backbuffer) in the buffer location described by rtvHandle
+    // backbuffer) in a slot allocated from the rtv heap
     for (int i = 0; i < framebufferCount_; ++i) {
-        result = swapChain_->GetBuffer(i, IID_PPV_ARGS(renderTargets_[i].GetAddressOf()));
+        HRESULT result = swapChain_->GetBuffer(i, IID_PPV_ARGS(renderTargets_[i].GetAddressOf()));
         if (FAILED(result))
             return false;
 
-        device_->CreateRenderTargetView(renderTargets_[i].Get(), nullptr, rtvHandle);
+        rtvHandles_[i] = rtvDescriptorHeap_.allocate();
+        if (!rtvHandles_[i].isValid())
+            return false;
 
-        rtvHandle.Offset(1, rtvHandleSize_);
+        device_->CreateRenderTargetView(renderTargets_[i].Get(), nullptr, rtvHandles_[i].cpu);
     }
 
     return true;
@@ -551,16 +950,8 @@ static bool createRTVDescHeap()
 
 static bool createDSVDescHeap(int width, int height)
 {
-    D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
-    dsvHeapDesc.NumDescriptors = framebufferCount_;
-    dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-    dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-    HRESULT result = device_->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(dsvDescriptorHeap_.GetAddressOf()));
-    if (FAILED(result))
+    if (!dsvDescriptorHeap_.init(device_.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_DSV, framebufferCount_, L"DepthStencilDescriptorHeap"))
         return false;
-    dsvDescriptorHeap_->SetName(L"DepthStencilDescriptorHeap");
-
-    dsHandleSize_ = device_->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
 
     D3D12_DEPTH_STENCIL_VIEW_DESC depthStencilDesc = {};
     depthStencilDesc.Format = DXGI_FORMAT_D32_FLOAT;
@@ -574,10 +965,9 @@ static bool createDSVDescHeap(int width, int height)
 
     const auto dsvHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
     const auto dsvTexDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, width, height, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
-    CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle { dsvDescriptorHeap_->GetCPUDescriptorHandleForHeapStart() };
 
     for (int i = 0; i < framebufferCount_; ++i) {
-        result = device_->CreateCommittedResource(
+        HRESULT result = device_->CreateCommittedResource(
             &dsvHeapProps,
             D3D12_HEAP_FLAG_NONE,
             &dsvTexDesc,
@@ -586,22 +976,46 @@ static bool createDSVDescHeap(int width, int height)
             IID_PPV_ARGS(depthStencilBuffer_[i].GetAddressOf()));
         if (FAILED(result))
             return false;
+        trackResidency(depthStencilBuffer_[i].Get(), ResidencyPriorityMaximum);
 
-        device_->CreateDepthStencilView(depthStencilBuffer_[i].Get(), &depthStencilDesc, dsvHandle);
-        dsvHandle.Offset(1, dsHandleSize_);
+        dsvHandles_[i] = dsvDescriptorHeap_.allocate();
+        if (!dsvHandles_[i].isValid())
+            return false;
+
+        device_->CreateDepthStencilView(depthStencilBuffer_[i].Get(), &depthStencilDesc, dsvHandles_[i].cpu);
     }
 
     return true;
 }
 
-static bool createConstBuffers()
+static bool createSRVDescHeaps()
+{
+    // views are created in the CPU only staging heap and copied into the
+    // shader visible heap, so the shader visible one never has to be read
+    // by the CPU and can be shared by every material
+    if (!srvStagingHeap_.init(device_.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, stagingDescriptorCount_, L"StagingDescriptorHeap"))
+        return false;
+
+    if (!mainDescriptorHeap_.init(device_.Get(), persistentDescriptorCount_, ringDescriptorCount_, L"MainDescriptorHeap"))
+        return false;
+
+    // the bindless table is one contiguous persistent range, so a single
+    // descriptor table covers every resource for the lifetime of the app
+    bindlessDescriptors_ = mainDescriptorHeap_.allocatePersistent(bindlessTableSize_);
+    if (!bindlessDescriptors_.isValid())
+        return false;
+
+    bindlessTable_.reset(bindlessTableSize_, framebufferCount_);
+
+    return true;
+}
+
+static bool createInstanceBuffers()
 {
     HRESULT result;
 
     const auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    const auto bufferProps = CD3DX12_RESOURCE_DESC::Buffer(1024 * 64);
-
-    memset(&cbuf_, 0, sizeof(cbuf_));
+    const auto bufferProps = CD3DX12_RESOURCE_DESC::Buffer(maxInstances_ * sizeof(InstanceData));
 
     for (int i = 0; i < framebufferCount_; ++i) {
         result = device_->CreateCommittedResource(
@@ -610,26 +1024,12 @@ static bool createConstBuffers()
             &bufferProps,
             D3D12_RESOURCE_STATE_GENERIC_READ,
             nullptr,
-            IID_PPV_ARGS(constBuffers_[i].GetAddressOf()));
+            IID_PPV_ARGS(instanceBuffers_[i].GetAddressOf()));
 
         if (FAILED(result))
             return false;
-        constBuffers_[i]->SetName(L"ConstantBufferHeap");
-
-        D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-        cbvDesc.BufferLocation = constBuffers_[i]->GetGPUVirtualAddress();
-        cbvDesc.SizeInBytes = (sizeof(ConstantBuffer) + 255) & ~255;
-
-        CD3DX12_RANGE readRange{ 0, 0 };
-        CD3DX12_RANGE writeRange{ 0, 2 * sizeof(ConstantBuffer::GPUAlignedSize) };
-        uint8_t* cbufGpuAddr;
-
-        constBuffers_[i]->Map(0, &readRange, reinterpret_cast<void**>(&cbufGpuAddr));
-
-        memcpy(cbufGpuAddr, &cbuf_, sizeof(cbuf_));
-        memcpy(cbufGpuAddr + ConstantBuffer::GPUAlignedSize, &cbuf_, sizeof(cbuf_));
-
-        constBuffers_[i]->Unmap(0, &readRange);
+        instanceBuffers_[i]->SetName(L"InstanceBuffer");
+        trackResidency(instanceBuffers_[i].Get(), ResidencyPriorityMaximum);
     }
 
     return true;
@@ -637,37 +1037,18 @@ static bool createConstBuffers()
 
 static bool createCommandResources()
 {
-    HRESULT result;
-
-    // create command allocators - this is kind of a interface to the GPU
-    // memory which holds the commands to be executed by the GPU.
-    for (int i = 0; i < framebufferCount_; ++i) {
-        result = device_->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(commandAllocators_[i].GetAddressOf()));
-        if (FAILED(result))
-            return false;
-    }
+    // one job worker per core, the render thread records with the pool
+    // worker past the job system's. Allocators and lists are created on
+    // demand by the pool, one set per worker and frame in flight.
+    const unsigned int cores = std::thread::hardware_concurrency();
+    jobSystem_.start(cores > 1 ? cores - 1 : 0);
 
-    // CPU buffer which records GPU commands. The commands are then submitted
-    // to GPU memory through the use of commandAllocators_. There only needs to
-    // be a single command list (for single threaded apps), since the CPU memory
-    // can be everwritten as soon as we exequte commandList on command queue.
-    result = device_->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocators_[0].Get(), nullptr, IID_PPV_ARGS(commandList_.GetAddressOf()));
-    if (FAILED(result))
+    if (!commandListPool_.init(device_.Get(), D3D12_COMMAND_LIST_TYPE_DIRECT, drawRecorder_.workerCount()))
         return false;
-    commandList_->Close();
 
-    // Create a fence that will be used by each commandAllocator to check if
-    // all the commands in allocator have already been finished or not yet
-    for (int i = 0; i < framebufferCount_; ++i) {
-        result = device_->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(fences_[i].GetAddressOf()));
-        if (FAILED(result))
-            return false;
-        fenceValues_[i] = 0;
-    }
-
-    // CPU fence used to wait for command completion on GPU
-    fenceEvent_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-    if (!fenceEvent_)
+    // single timeline for the queue, every submission signals the next value
+    // and whoever needs to know when the GPU is done keeps the ticket
+    if (!queueFence_.init(device_.Get(), commandQueue_.Get(), L"QueueFence"))
         return false;
 
     return true;
@@ -675,29 +1056,42 @@ static bool createCommandResources()
 
 static bool createRootSignature()
 {
-    D3D12_ROOT_DESCRIPTOR rootCBVDesc;
-    rootCBVDesc.RegisterSpace = 0;
-    rootCBVDesc.ShaderRegister = 0;
-
+    // structured buffer in a space of its own, t0 of space 0 is taken by
+    // the unbounded bindless range
+    D3D12_ROOT_DESCRIPTOR rootInstanceSRVDesc;
+    rootInstanceSRVDesc.RegisterSpace = 1;
+    rootInstanceSRVDesc.ShaderRegister = 0;
+
+    D3D12_ROOT_CONSTANTS drawConstantsDesc;
+    drawConstantsDesc.RegisterSpace = 0;
+    drawConstantsDesc.ShaderRegister = 1;
+    drawConstantsDesc.Num32BitValues = DrawConstants::num32BitValues;
+
+    // single unbounded range - every SRV in the bindless table is visible,
+    // shaders pick one with the material index of the instance
     D3D12_DESCRIPTOR_RANGE srvRanges[1] = {};
     srvRanges[0].BaseShaderRegister = 0;
-    srvRanges[0].NumDescriptors = 1;
+    srvRanges[0].NumDescriptors = UINT_MAX;
     srvRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
     srvRanges[0].RegisterSpace = 0;
-    srvRanges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+    srvRanges[0].OffsetInDescriptorsFromTableStart = 0;
 
     D3D12_ROOT_DESCRIPTOR_TABLE rootSRVDescTable;
     rootSRVDescTable.NumDescriptorRanges = sizeof(srvRanges) / sizeof(srvRanges[0]);
     rootSRVDescTable.pDescriptorRanges = srvRanges;
 
-    D3D12_ROOT_PARAMETER rootParams[2] = {};
-    rootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
-    rootParams[0].Descriptor = rootCBVDesc;
-    rootParams[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+    D3D12_ROOT_PARAMETER rootParams[RootParameterCount] = {};
+    rootParams[RootParameterInstanceSRV].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+    rootParams[RootParameterInstanceSRV].Descriptor = rootInstanceSRVDesc;
+    rootParams[RootParameterInstanceSRV].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+    rootParams[RootParameterDrawConstants].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+    rootParams[RootParameterDrawConstants].Constants = drawConstantsDesc;
+    rootParams[RootParameterDrawConstants].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
 
-    rootParams[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-    rootParams[1].DescriptorTable = rootSRVDescTable;
-    rootParams[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+    rootParams[RootParameterBindlessSRVs].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    rootParams[RootParameterBindlessSRVs].DescriptorTable = rootSRVDescTable;
+    rootParams[RootParameterBindlessSRVs].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
     D3D12_STATIC_SAMPLER_DESC samplerDescs[1] = {};
     samplerDescs[0].Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
@@ -809,72 +1203,18 @@ static bool createPSO(ID3DBlob* vertexShader, ID3DBlob* pixelShader)
 
 static bool setupGeometry()
 {
-    Vertex vertices[] = {
-        // front face
-        { { -0.5f,  0.5f, -0.5f }, { 0.0f, 0.0f } },
-        { { 0.5f, -0.5f, -0.5f }, { 1.0f, 1.0f } },
-        { { -0.5f, -0.5f, -0.5f }, { 0.0f, 1.0f } },
-        { { 0.5f,  0.5f, -0.5f }, { 1.0f, 0.0f } },
-
-        // right side face
-        { { 0.5f, -0.5f, -0.5f }, { 0.0f, 1.0f } },
-        { { 0.5f,  0.5f,  0.5f }, { 1.0f, 0.0f } },
-        { { 0.5f, -0.5f,  0.5f }, { 1.0f, 1.0f } },
-        { { 0.5f,  0.5f, -0.5f }, { 0.0f, 0.0f } },
-
-        // left side face
-        { { -0.5f,  0.5f,  0.5f }, { 0.0f, 0.0f } },
-        { { -0.5f, -0.5f, -0.5f }, { 1.0f, 1.0f } },
-        { { -0.5f, -0.5f,  0.5f }, { 0.0f, 1.0f } },
-        { { -0.5f,  0.5f, -0.5f }, { 1.0f, 0.0f } },
-
-        // back face
-        { { 0.5f,  0.5f,  0.5f }, { 0.0f, 0.0f, } },
-        { { -0.5f, -0.5f,  0.5f }, { 1.0f, 1.0f } },
-        { { 0.5f, -0.5f,  0.5f }, { 0.0f, 1.0f } },
-        { { -0.5f,  0.5f,  0.5f }, { 1.0f, 0.0f } },
-
-        // top face
-        { { -0.5f,  0.5f, -0.5f }, { 0.0f, 1.0f } },
-        { { 0.5f,  0.5f,  0.5f }, { 1.0f, 0.0f } },
-        { { 0.5f,  0.5f, -0.5f }, { 1.0f, 1.0f } },
-        { { -0.5f,  0.5f,  0.5f }, { 0.0f, 0.0f } },
-
-        // bottom face
-        { { 0.5f, -0.5f,  0.5f }, { 0.0f, 0.0f } },
-        { { -0.5f, -0.5f, -0.5f }, { 1.0f, 1.0f } },
-        { { 0.5f, -0.5f, -0.5f }, { 0.0f, 1.0f } },
-        { { -0.5f, -0.5f,  0.5f }, { 1.0f, 0.0f } },
-    };
-    uint32_t vertBufSize = sizeof(vertices);
-
-    uint32_t indices[] = {
-        // ffront face
-        0, 1, 2, // first triangle
-        0, 3, 1, // second triangle
-
-        // left face
-        4, 5, 6, // first triangle
-        4, 7, 5, // second triangle
-
-        // right face
-        8, 9, 10, // first triangle
-        8, 11, 9, // second triangle
-
-        // back face
-        12, 13, 14, // first triangle
-        12, 15, 13, // second triangle
-
-        // top face
-        16, 17, 18, // first triangle
-        16, 19, 17, // second triangle
-
-        // bottom face
-        20, 21, 22, // first triangle
-        20, 23, 21, // second triangle
-    };
-    uint32_t indexBufSize = sizeof(indices);
-    numCubeIndices_ = sizeof(indices) / sizeof(indices[0]);
+    CubeMesh cube;
+    buildCubeMesh(cube);
+
+    std::vector<Vertex> vertices(cube.vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        const MeshVertex& vertex = cube.vertices[i];
+        vertices[i].pos = DirectX::XMFLOAT3(vertex.position.x, vertex.position.y, vertex.position.z);
+        vertices[i].uv = DirectX::XMFLOAT2(vertex.uv[0], vertex.uv[1]);
+    }
+    uint32_t vertBufSize = static_cast<uint32_t>(vertices.size() * sizeof(Vertex));
+    uint32_t indexBufSize = static_cast<uint32_t>(cube.indices.size() * sizeof(uint32_t));
+    geometries_ = cube.lods;
 
     const auto defaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
     const auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
@@ -920,7 +1260,7 @@ static bool setupGeometry()
     result = device_->CreateCommittedResource(
         &uploadHeapProps,
         D3D12_HEAP_FLAG_NONE,
-        &vertBufferDesc,
+        &indexBufferDesc,
         D3D12_RESOURCE_STATE_GENERIC_READ,
         nullptr,
         IID_PPV_ARGS(indexBufferUploadRes.GetAddressOf()));
@@ -929,34 +1269,38 @@ static bool setupGeometry()
     indexBufferUploadRes->SetName(L"IndexBufferUploadResource");
 
     D3D12_SUBRESOURCE_DATA vertexData = {};
-    vertexData.pData = reinterpret_cast<BYTE*>(vertices);
+    vertexData.pData = reinterpret_cast<BYTE*>(vertices.data());
     vertexData.RowPitch = vertBufSize;
     vertexData.SlicePitch = vertBufSize;
 
     D3D12_SUBRESOURCE_DATA indexData = {};
-    indexData.pData = reinterpret_cast<BYTE*>(indices);
+    indexData.pData = reinterpret_cast<BYTE*>(cube.indices.data());
     indexData.RowPitch = indexBufSize;
     indexData.SlicePitch = indexBufSize;
 
     const auto vertexTransition = CD3DX12_RESOURCE_BARRIER::Transition(vertexBuffer_.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
     const auto indexTransition = CD3DX12_RESOURCE_BARRIER::Transition(indexBuffer_.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 
-    commandAllocators_[frameIdx_]->Reset();
-    commandList_->Reset(commandAllocators_[frameIdx_].Get(), nullptr);
+    if (!beginUpload())
+        return false;
 
-    UpdateSubresources(commandList_.Get(), vertexBuffer_.Get(), vertBufferUploadRes.Get(), 0, 0, 1, &vertexData);
+    UpdateSubresources(commandList_, vertexBuffer_.Get(), vertBufferUploadRes.Get(), 0, 0, 1, &vertexData);
     commandList_->ResourceBarrier(1, &vertexTransition);
-    UpdateSubresources(commandList_.Get(), indexBuffer_.Get(), indexBufferUploadRes.Get(), 0, 0, 1, &indexData);
+    UpdateSubresources(commandList_, indexBuffer_.Get(), indexBufferUploadRes.Get(), 0, 0, 1, &indexData);
     commandList_->ResourceBarrier(1, &indexTransition);
 
-    commandList_->Close();
-    ID3D12CommandList* cmdLists[] = { commandList_.Get() };
-    commandQueue_->ExecuteCommandLists(1, cmdLists);
-
-    result = commandQueue_->Signal(fences_[frameIdx_].Get(), fenceValues_[frameIdx_]);
-    if (FAILED(result))
+    const FenceTicket uploadTicket = submitUpload();
+    if (!uploadTicket.isValid())
         return false;
 
+    // no need to wait for the copy, the upload resources are released as
+    // soon as the GPU is done with them
+    retire(vertBufferUploadRes, uploadTicket);
+    retire(indexBufferUploadRes, uploadTicket);
+
+    vertexBufferResidency_ = trackResidency(vertexBuffer_.Get(), ResidencyPriorityNormal);
+    indexBufferResidency_ = trackResidency(indexBuffer_.Get(), ResidencyPriorityNormal);
+
     vertexBufferView_.BufferLocation = vertexBuffer_->GetGPUVirtualAddress();
     vertexBufferView_.SizeInBytes = vertBufSize;
     vertexBufferView_.StrideInBytes = sizeof(Vertex);
@@ -965,10 +1309,6 @@ static bool setupGeometry()
     indexBufferView_.SizeInBytes = indexBufSize;
     indexBufferView_.Format = DXGI_FORMAT_R32_UINT;
 
-    waitForPreviousFrame();
-    // TODO: super ugly hack!!! Rework wait for previous frame!
-    fenceValues_[frameIdx_]--;
-
     return true;
 }
 
@@ -1002,6 +1342,7 @@ static bool setupTexture()
         return false;
 
     textureBuffer_->SetName(L"TextureBufferResourceHeap");
+    textureResidency_ = trackResidency(textureBuffer_.Get(), ResidencyPriorityNormal);
 
     uint64_t texUploadBufferSize;
     device_->GetCopyableFootprints(&textureDesc, 0, 1, 0, nullptr, nullptr, nullptr, &texUploadBufferSize);
@@ -1029,28 +1370,17 @@ static bool setupTexture()
 
     const auto texTransition = CD3DX12_RESOURCE_BARRIER::Transition(textureBuffer_.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 
-    commandAllocators_[frameIdx_]->Reset();
-    commandList_->Reset(commandAllocators_[frameIdx_].Get(), nullptr);
+    if (!beginUpload())
+        return false;
 
-    UpdateSubresources(commandList_.Get(), textureBuffer_.Get(), texUploadBuffer.Get(), 0, 0, 1, &texUploadDesc);
+    UpdateSubresources(commandList_, textureBuffer_.Get(), texUploadBuffer.Get(), 0, 0, 1, &texUploadDesc);
     commandList_->ResourceBarrier(1, &texTransition);
 
-    commandList_->Close();
-    ID3D12CommandList* cmdLists[] = { commandList_.Get() };
-    commandQueue_->ExecuteCommandLists(1, cmdLists);
-
-    result = commandQueue_->Signal(fences_[frameIdx_].Get(), fenceValues_[frameIdx_]);
-    if (FAILED(result))
+    const FenceTicket uploadTicket = submitUpload();
+    if (!uploadTicket.isValid())
         return false;
 
-    D3D12_DESCRIPTOR_HEAP_DESC  heapDesc = {};
-    heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-    heapDesc.NumDescriptors = 1;
-    heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-    
-    result = device_->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(mainDescriptorHeap_.GetAddressOf()));
-    if (FAILED(result))
-        return false;
+    retire(texUploadBuffer, uploadTicket);
 
     D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
     srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -1058,11 +1388,43 @@ static bool setupTexture()
     srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
     srvDesc.Texture2D.MipLevels = 1;
 
-    device_->CreateShaderResourceView(textureBuffer_.Get(), &srvDesc, mainDescriptorHeap_->GetCPUDescriptorHandleForHeapStart());
-
-    waitForPreviousFrame();
-    // TODO: super ugly hack!!! Rework wait for previous frame!
-    fenceValues_[frameIdx_]--;
+    textureIndex_ = createBindlessSRV(textureBuffer_.Get(), srvDesc);
+    if (textureIndex_.index == InvalidBindlessIndex)
+        return false;
 
     return true;
 }
+
+static BindlessHandle createBindlessSRV(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC& srvDesc)
+{
+    BindlessHandle handle = bindlessTable_.allocate();
+    if (handle.index == InvalidBindlessIndex)
+        return handle;
+
+    // the view is built in the staging heap and copied into its bindless
+    // slot with the other views of the frame, the staging descriptor is
+    // released after the copy
+    DescriptorHandle staging = srvStagingHeap_.allocate();
+    if (!staging.isValid()) {
+        bindlessTable_.release(handle);
+        return { InvalidBindlessIndex, 0 };
+    }
+
+    device_->CreateShaderResourceView(resource, &srvDesc, staging.cpu);
+
+    D3D12_CPU_DESCRIPTOR_HANDLE dest = bindlessDescriptors_.cpu;
+    dest.ptr += static_cast<SIZE_T>(handle.index) * mainDescriptorHeap_.handleSize();
+    descriptorCopies_.add(dest, &staging.cpu, 1, srvStagingHeap_.handleSize());
+    stagedDescriptors_.push_back(staging);
+
+    return handle;
+}
+
+static void flushDescriptorCopies()
+{
+    descriptorCopies_.flush(device_.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    for (const DescriptorHandle& staging : stagedDescriptors_)
+        srvStagingHeap_.release(staging);
+    stagedDescriptors_.clear();
+}
@@ -1,6 +1,10 @@
 #if !defined(DX_H)
 #define DX_H
 
+#include "render_backend.h"
+
+#include <cstdint>
+
 #define NOMINMAX
 
 #include <windows.h>
@@ -11,10 +15,22 @@ typedef void (*OnErrorCallback)();
 
 bool initd3d(HWND window, int width, int height, bool fullscreen, OnErrorCallback errorCallback);
 
-void update();
-
-void render();
+// translates the next frame of packets and renders it, errors are reported
+// through the callback passed to initd3d
+void render(RenderPacketQueue& packets, UINT slot);
 
 void cleanupd3d();
 
+// frames the CPU may queue ahead of the GPU, clamped to the swap chain
+// buffer count
+void setFramesInFlight(int count);
+
+// records the commands of the next frameCount frames into a capture file,
+// see command_capture.h. Safe to call from any thread, the capture starts
+// with the next frame render() records.
+void captureCommands(const char* path, uint32_t frameCount);
+
+// index of the texture in the bindless table
+uint32_t defaultMaterialIndex();
+
 #endif // defined(DX_H)
@@ -0,0 +1,518 @@
+#include "dynamic_aabb_tree.h"
+
+#include "bvh.h"
+#include "frustum_culling.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// fat boxes also stretch this many times the displacement passed to
+// move(), so an object moving steadily is not reinserted every frame
+static const float displacementScale_ = 2.0f;
+
+static Aabb unionOf(const Aabb& a, const Aabb& b)
+{
+    return {
+        { std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z) },
+        { std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z) },
+    };
+}
+
+static Aabb fatten(const Aabb& bounds, float margin)
+{
+    return {
+        { bounds.min.x - margin, bounds.min.y - margin, bounds.min.z - margin },
+        { bounds.max.x + margin, bounds.max.y + margin, bounds.max.z + margin },
+    };
+}
+
+static bool contains(const Aabb& outer, const Aabb& inner)
+{
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+        && inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+}
+
+static bool overlaps(const Aabb& a, const Aabb& b)
+{
+    return a.min.x <= b.max.x && b.min.x <= a.max.x
+        && a.min.y <= b.max.y && b.min.y <= a.max.y
+        && a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+DynamicAabbTree::DynamicAabbTree(float margin)
+    : margin_(margin)
+{
+    clear();
+}
+
+void DynamicAabbTree::clear()
+{
+    nodes_.clear();
+    root_ = InvalidProxy;
+    freeList_ = InvalidProxy;
+    leafCount_ = 0;
+}
+
+uint32_t DynamicAabbTree::allocateNode()
+{
+    uint32_t node = freeList_;
+    if (node != InvalidProxy) {
+        freeList_ = nodes_[node].parent;
+    } else {
+        node = static_cast<uint32_t>(nodes_.size());
+        nodes_.push_back({});
+    }
+
+    Node& result = nodes_[node];
+    result.parent = InvalidProxy;
+    result.child1 = InvalidProxy;
+    result.child2 = InvalidProxy;
+    result.height = 0;
+    result.userData = InvalidProxy;
+    result.dirty = false;
+    return node;
+}
+
+void DynamicAabbTree::freeNode(uint32_t node)
+{
+    nodes_[node].parent = freeList_;
+    nodes_[node].height = -1;
+    freeList_ = node;
+}
+
+uint32_t DynamicAabbTree::insert(const Aabb& bounds, uint32_t userData)
+{
+    const uint32_t proxy = allocateNode();
+
+    Node& leaf = nodes_[proxy];
+    leaf.bounds = fatten(bounds, margin_);
+    leaf.userData = userData;
+
+    insertLeaf(proxy);
+    ++leafCount_;
+    return proxy;
+}
+
+void DynamicAabbTree::remove(uint32_t proxy)
+{
+    removeLeaf(proxy);
+    freeNode(proxy);
+    --leafCount_;
+}
+
+bool DynamicAabbTree::move(uint32_t proxy, const Aabb& bounds, const Float3& displacement)
+{
+    if (contains(nodes_[proxy].bounds, bounds))
+        return false;
+
+    removeLeaf(proxy);
+
+    Aabb fat = fatten(bounds, margin_);
+    const Float3 stretch = { displacement.x * displacementScale_, displacement.y * displacementScale_, displacement.z * displacementScale_ };
+    if (stretch.x < 0.0f)
+        fat.min.x += stretch.x;
+    else
+        fat.max.x += stretch.x;
+    if (stretch.y < 0.0f)
+        fat.min.y += stretch.y;
+    else
+        fat.max.y += stretch.y;
+    if (stretch.z < 0.0f)
+        fat.min.z += stretch.z;
+    else
+        fat.max.z += stretch.z;
+    nodes_[proxy].bounds = fat;
+
+    insertLeaf(proxy);
+    return true;
+}
+
+uint32_t DynamicAabbTree::refit(const uint32_t* proxies, const Aabb* bounds, uint32_t count)
+{
+    PROFILE_FUNCTION();
+
+    // every ancestor of a changed leaf once, stopping where the path of an
+    // earlier leaf already went
+    dirty_.clear();
+    uint32_t changed = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t proxy = proxies[i];
+        if (contains(nodes_[proxy].bounds, bounds[i]))
+            continue;
+
+        nodes_[proxy].bounds = fatten(bounds[i], margin_);
+        ++changed;
+
+        for (uint32_t node = nodes_[proxy].parent; node != InvalidProxy && !nodes_[node].dirty; node = nodes_[node].parent) {
+            nodes_[node].dirty = true;
+            dirty_.push_back(node);
+        }
+    }
+
+    // children are lower than their parents, so refitting by height does
+    // every child before its parent
+    std::sort(dirty_.begin(), dirty_.end(), [this](uint32_t a, uint32_t b) { return nodes_[a].height < nodes_[b].height; });
+
+    for (uint32_t node : dirty_) {
+        Node& inner = nodes_[node];
+        inner.bounds = unionOf(nodes_[inner.child1].bounds, nodes_[inner.child2].bounds);
+        inner.dirty = false;
+    }
+
+    return changed;
+}
+
+void DynamicAabbTree::insertLeaf(uint32_t leaf)
+{
+    if (root_ == InvalidProxy) {
+        root_ = leaf;
+        nodes_[leaf].parent = InvalidProxy;
+        return;
+    }
+
+    // walk down to the sibling that makes the tree grow the least. Pairing
+    // with a node costs the area of the new parent, and every ancestor of
+    // it grows as well.
+    const Aabb bounds = nodes_[leaf].bounds;
+    uint32_t sibling = root_;
+    while (nodes_[sibling].child1 != InvalidProxy) {
+        const Node& node = nodes_[sibling];
+
+        const float area = aabbSurfaceArea(node.bounds);
+        const float combinedArea = aabbSurfaceArea(unionOf(node.bounds, bounds));
+        const float pairCost = 2.0f * combinedArea;
+        const float inheritedCost = 2.0f * (combinedArea - area);
+
+        float childCost[2];
+        const uint32_t children[2] = { node.child1, node.child2 };
+        for (uint32_t i = 0; i < 2; ++i) {
+            const Node& child = nodes_[children[i]];
+            const float grownArea = aabbSurfaceArea(unionOf(child.bounds, bounds));
+            childCost[i] = inheritedCost + (child.child1 == InvalidProxy ? grownArea : grownArea - aabbSurfaceArea(child.bounds));
+        }
+
+        if (pairCost < childCost[0] && pairCost < childCost[1])
+            break;
+        sibling = childCost[0] < childCost[1] ? children[0] : children[1];
+    }
+
+    const uint32_t oldParent = nodes_[sibling].parent;
+    const uint32_t newParent = allocateNode();
+
+    Node& parent = nodes_[newParent];
+    parent.parent = oldParent;
+    parent.child1 = sibling;
+    parent.child2 = leaf;
+    parent.bounds = unionOf(bounds, nodes_[sibling].bounds);
+    parent.height = nodes_[sibling].height + 1;
+
+    if (oldParent == InvalidProxy)
+        root_ = newParent;
+    else if (nodes_[oldParent].child1 == sibling)
+        nodes_[oldParent].child1 = newParent;
+    else
+        nodes_[oldParent].child2 = newParent;
+
+    nodes_[sibling].parent = newParent;
+    nodes_[leaf].parent = newParent;
+
+    fixUpwards(oldParent);
+}
+
+void DynamicAabbTree::removeLeaf(uint32_t leaf)
+{
+    if (leaf == root_) {
+        root_ = InvalidProxy;
+        return;
+    }
+
+    // the sibling takes the parent's place
+    const uint32_t parent = nodes_[leaf].parent;
+    const uint32_t grandParent = nodes_[parent].parent;
+    const uint32_t sibling = nodes_[parent].child1 == leaf ? nodes_[parent].child2 : nodes_[parent].child1;
+
+    nodes_[sibling].parent = grandParent;
+    freeNode(parent);
+
+    if (grandParent == InvalidProxy) {
+        root_ = sibling;
+        return;
+    }
+
+    if (nodes_[grandParent].child1 == parent)
+        nodes_[grandParent].child1 = sibling;
+    else
+        nodes_[grandParent].child2 = sibling;
+
+    fixUpwards(grandParent);
+}
+
+void DynamicAabbTree::fixUpwards(uint32_t node)
+{
+    while (node != InvalidProxy) {
+        node = balance(node);
+
+        Node& inner = nodes_[node];
+        inner.height = 1 + std::max(nodes_[inner.child1].height, nodes_[inner.child2].height);
+        inner.bounds = unionOf(nodes_[inner.child1].bounds, nodes_[inner.child2].bounds);
+
+        node = inner.parent;
+    }
+}
+
+uint32_t DynamicAabbTree::balance(uint32_t node)
+{
+    Node& a = nodes_[node];
+    if (a.child1 == InvalidProxy || a.height < 2)
+        return node;
+
+    const int32_t difference = nodes_[a.child2].height - nodes_[a.child1].height;
+    if (difference >= -1 && difference <= 1)
+        return node;
+
+    // the taller child moves up into the node's place and takes the node
+    // and its own taller child as children. The node keeps its shorter
+    // child and gets the other one of the child that moved up.
+    const uint32_t up = difference > 0 ? a.child2 : a.child1;
+    Node& b = nodes_[up];
+
+    const uint32_t taller = nodes_[b.child1].height > nodes_[b.child2].height ? b.child1 : b.child2;
+    const uint32_t shorter = taller == b.child1 ? b.child2 : b.child1;
+
+    b.parent = a.parent;
+    if (b.parent == InvalidProxy)
+        root_ = up;
+    else if (nodes_[b.parent].child1 == node)
+        nodes_[b.parent].child1 = up;
+    else
+        nodes_[b.parent].child2 = up;
+
+    if (a.child1 == up)
+        a.child1 = shorter;
+    else
+        a.child2 = shorter;
+    nodes_[shorter].parent = node;
+
+    b.child1 = node;
+    b.child2 = taller;
+    a.parent = up;
+
+    a.bounds = unionOf(nodes_[a.child1].bounds, nodes_[a.child2].bounds);
+    a.height = 1 + std::max(nodes_[a.child1].height, nodes_[a.child2].height);
+    b.bounds = unionOf(a.bounds, nodes_[taller].bounds);
+    b.height = 1 + std::max(a.height, nodes_[taller].height);
+
+    return up;
+}
+
+float DynamicAabbTree::areaRatio() const
+{
+    if (root_ == InvalidProxy)
+        return 0.0f;
+
+    float area = 0.0f;
+    for (const Node& node : nodes_) {
+        if (node.height > 0)
+            area += aabbSurfaceArea(node.bounds);
+    }
+
+    const float rootArea = aabbSurfaceArea(nodes_[root_].bounds);
+    return rootArea > 0.0f ? area / rootArea : 0.0f;
+}
+
+void DynamicAabbTree::queryBox(const Aabb& box, std::vector<uint32_t>& result) const
+{
+    if (root_ == InvalidProxy)
+        return;
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(root_);
+
+    while (!stack.empty()) {
+        const Node& node = nodes_[stack.back()];
+        stack.pop_back();
+
+        if (!overlaps(node.bounds, box))
+            continue;
+
+        if (node.child1 == InvalidProxy) {
+            result.push_back(node.userData);
+        } else {
+            stack.push_back(node.child2);
+            stack.push_back(node.child1);
+        }
+    }
+}
+
+void DynamicAabbTree::cullFrustum(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+    if (root_ == InvalidProxy)
+        return;
+
+    // the planes a node is not entirely inside of, its children only need
+    // to be tested against those
+    struct Entry
+    {
+        uint32_t node;
+        uint32_t planes;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    stack.push_back({ root_, 0x3f });
+
+    while (!stack.empty()) {
+        const Entry entry = stack.back();
+        stack.pop_back();
+
+        const Node& node = nodes_[entry.node];
+        const Float3 center = aabbCenter(node.bounds);
+        const Float3 extents = { (node.bounds.max.x - node.bounds.min.x) * 0.5f, (node.bounds.max.y - node.bounds.min.y) * 0.5f, (node.bounds.max.z - node.bounds.min.z) * 0.5f };
+
+        uint32_t crossing = 0;
+        bool outside = false;
+        for (uint32_t p = 0; p < 6 && !outside; ++p) {
+            if ((entry.planes & (1u << p)) == 0)
+                continue;
+
+            const Float4& plane = frustum.planes[p];
+            const float d = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+            const float r = std::fabs(plane.x) * extents.x + std::fabs(plane.y) * extents.y + std::fabs(plane.z) * extents.z;
+            outside = d + r < 0.0f;
+            if (d - r < 0.0f)
+                crossing |= 1u << p;
+        }
+
+        if (outside)
+            continue;
+
+        if (node.child1 == InvalidProxy) {
+            visible.push_back(node.userData);
+        } else {
+            stack.push_back({ node.child2, crossing });
+            stack.push_back({ node.child1, crossing });
+        }
+    }
+}
+
+DynamicTreeBenchmark measureDynamicTree(uint32_t objectCount, uint32_t movingCount, uint32_t frames)
+{
+    DynamicTreeBenchmark result = {};
+    result.objects = objectCount;
+    result.moving = std::min(movingCount, objectCount);
+    result.frames = frames;
+    if (objectCount == 0 || frames == 0)
+        return result;
+
+    // fixed seed lcg, every run moves the same scene
+    uint32_t seed = 0x12345678;
+    auto random = [&seed](float low, float high) {
+        seed = seed * 1664525u + 1013904223u;
+        return low + (high - low) * static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+    };
+
+    // the boxes measureBvh() uses, the moving ones are spread out and drift
+    // a few centimetres a frame
+    std::vector<Float3> centers(objectCount);
+    std::vector<Float3> extents(objectCount);
+    for (uint32_t i = 0; i < objectCount; ++i) {
+        centers[i] = { random(-500.0f, 500.0f), random(-50.0f, 50.0f), random(-500.0f, 500.0f) };
+        extents[i] = { random(0.5f, 5.0f), random(0.5f, 5.0f), random(0.5f, 5.0f) };
+    }
+
+    std::vector<uint32_t> moving(result.moving);
+    std::vector<Float3> velocities(result.moving);
+    for (uint32_t i = 0; i < result.moving; ++i) {
+        moving[i] = static_cast<uint32_t>(static_cast<uint64_t>(i) * objectCount / result.moving);
+        velocities[i] = { random(-0.05f, 0.05f), random(-0.05f, 0.05f), random(-0.05f, 0.05f) };
+    }
+
+    auto boundsOf = [&](uint32_t object, uint32_t frame) {
+        const Float3& extent = extents[object];
+        Float3 center = centers[object];
+        if (frame > 0) {
+            const uint32_t index = static_cast<uint32_t>(std::lower_bound(moving.begin(), moving.end(), object) - moving.begin());
+            if (index < moving.size() && moving[index] == object) {
+                const Float3& velocity = velocities[index];
+                const float steps = static_cast<float>(frame);
+                center = { center.x + velocity.x * steps, center.y + velocity.y * steps, center.z + velocity.z * steps };
+            }
+        }
+        const Aabb bounds = { { center.x - extent.x, center.y - extent.y, center.z - extent.z }, { center.x + extent.x, center.y + extent.y, center.z + extent.z } };
+        return bounds;
+    };
+
+    const float margin = 0.1f;
+    DynamicAabbTree moved(margin);
+    DynamicAabbTree refitted(margin);
+    std::vector<uint32_t> proxies(objectCount);
+    for (uint32_t i = 0; i < objectCount; ++i) {
+        proxies[i] = moved.insert(boundsOf(i, 0), i);
+        refitted.insert(boundsOf(i, 0), i);
+    }
+
+    typedef std::chrono::duration<double> Seconds;
+
+    std::vector<uint32_t> movingProxies(result.moving);
+    for (uint32_t i = 0; i < result.moving; ++i)
+        movingProxies[i] = proxies[moving[i]];
+
+    std::vector<Aabb> frameBounds(result.moving);
+    uint64_t reinserted = 0;
+    double moveSeconds = 0.0;
+    double refitSeconds = 0.0;
+
+    for (uint32_t frame = 1; frame <= frames; ++frame) {
+        for (uint32_t i = 0; i < result.moving; ++i)
+            frameBounds[i] = boundsOf(moving[i], frame);
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < result.moving; ++i)
+            reinserted += moved.move(movingProxies[i], frameBounds[i], velocities[i]) ? 1 : 0;
+        moveSeconds += std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        refitted.refit(movingProxies.data(), frameBounds.data(), result.moving);
+        refitSeconds += std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    result.moveSeconds = moveSeconds / frames;
+    result.refitSeconds = refitSeconds / frames;
+    result.reinserted = static_cast<uint32_t>(reinserted / frames);
+    result.heightAfterMoves = moved.height();
+    result.areaRatioAfterMoves = moved.areaRatio();
+    result.areaRatioAfterRefits = refitted.areaRatio();
+
+    // what not having a dynamic tree costs, a rebuild of everything
+    std::vector<Aabb> current(objectCount);
+    for (uint32_t i = 0; i < objectCount; ++i)
+        current[i] = boundsOf(i, frames);
+
+    Bvh bvh;
+    auto start = std::chrono::steady_clock::now();
+    bvh.build(current.data(), objectCount, nullptr);
+    result.rebuildSeconds = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+
+    // fat boxes may report a little more than overlaps, never less
+    std::vector<uint32_t> found;
+    for (uint32_t query = 0; query < 32; ++query) {
+        const Float3 center = { random(-500.0f, 500.0f), random(-50.0f, 50.0f), random(-500.0f, 500.0f) };
+        const Aabb box = { { center.x - 20.0f, center.y - 20.0f, center.z - 20.0f }, { center.x + 20.0f, center.y + 20.0f, center.z + 20.0f } };
+
+        for (const DynamicAabbTree* tree : { &moved, &refitted }) {
+            found.clear();
+            tree->queryBox(box, found);
+            std::sort(found.begin(), found.end());
+
+            for (uint32_t i = 0; i < objectCount; ++i) {
+                if (overlaps(current[i], box) && !std::binary_search(found.begin(), found.end(), i))
+                    result.mismatches++;
+            }
+        }
+    }
+
+    return result;
+}
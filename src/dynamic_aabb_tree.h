@@ -0,0 +1,116 @@
+#if !defined(DYNAMIC_AABB_TREE_H)
+#define DYNAMIC_AABB_TREE_H
+
+#include "scene_math.h"
+
+#include <cstdint>
+#include <vector>
+
+struct Frustum;
+
+constexpr uint32_t InvalidProxy = 0xffffffff;
+
+// Bounding volume tree for objects that move, the counterpart to the
+// static Bvh. Every object is a leaf holding a fattened copy of its bounds,
+// so small moves leave the tree alone. Objects that leave their fat box are
+// either reinserted one by one with move() or refit in place in a batch
+// with refit(), so the work per frame follows the number of objects that
+// moved rather than the number of objects.
+//
+// Inserts and removes rotate the ancestors they touch, keeping the heights
+// of siblings at most one apart.
+class DynamicAabbTree
+{
+public:
+    // bounds grow by margin on every side when they are fattened
+    explicit DynamicAabbTree(float margin);
+
+    void clear();
+
+    // returns the proxy that stands for the object from now on, userData is
+    // what queries report for it
+    uint32_t insert(const Aabb& bounds, uint32_t userData);
+    void remove(uint32_t proxy);
+
+    // reinserts the object if the bounds left its fat box, returns whether
+    // it did. The fat box is stretched in the direction of displacement,
+    // the expected move until the next update.
+    bool move(uint32_t proxy, const Aabb& bounds, const Float3& displacement);
+
+    // grows the fat boxes the bounds left and refits their ancestors, each
+    // one once, without changing the shape of the tree. Cheaper than moving
+    // the objects one by one, but the tree gets looser until they are
+    // reinserted. Returns how many fat boxes changed.
+    uint32_t refit(const uint32_t* proxies, const Aabb* bounds, uint32_t count);
+
+    uint32_t count() const { return leafCount_; }
+    uint32_t height() const { return root_ == InvalidProxy ? 0 : nodes_[root_].height; }
+    const Aabb& fatBounds(uint32_t proxy) const { return nodes_[proxy].bounds; }
+    uint32_t userData(uint32_t proxy) const { return nodes_[proxy].userData; }
+
+    // sum of the surface areas of the inner nodes over the root's, lower
+    // is a better tree
+    float areaRatio() const;
+
+    // user data of the objects whose fat box overlaps the box or intersects
+    // the frustum, appended in tree order
+    void queryBox(const Aabb& box, std::vector<uint32_t>& result) const;
+    void cullFrustum(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+private:
+    // leaves have no children, free nodes have a negative height and chain
+    // through parent
+    struct Node
+    {
+        Aabb bounds;
+        uint32_t parent;
+        uint32_t child1;
+        uint32_t child2;
+        int32_t height;
+        uint32_t userData;
+        bool dirty; // queued for refit()
+    };
+
+    uint32_t allocateNode();
+    void freeNode(uint32_t node);
+
+    void insertLeaf(uint32_t leaf);
+    void removeLeaf(uint32_t leaf);
+
+    // rotates the taller child of a node up if it is more than one level
+    // taller than the other, returns the node now in its place
+    uint32_t balance(uint32_t node);
+
+    // walks up from node recomputing bounds and heights, balancing as it
+    // goes
+    void fixUpwards(uint32_t node);
+
+    std::vector<Node> nodes_;
+    uint32_t root_;
+    uint32_t freeList_;
+    uint32_t leafCount_;
+    float margin_;
+
+    std::vector<uint32_t> dirty_; // scratch for refit()
+};
+
+struct DynamicTreeBenchmark
+{
+    uint32_t objects;
+    uint32_t moving;         // objects that move every frame
+    uint32_t frames;
+    double moveSeconds;      // per frame, with move()
+    double refitSeconds;     // per frame, with refit()
+    double rebuildSeconds;   // building a Bvh over every object once
+    uint32_t reinserted;     // per frame on average, with move()
+    uint32_t heightAfterMoves;
+    float areaRatioAfterMoves;
+    float areaRatioAfterRefits;
+    uint32_t mismatches;     // box queries a brute force search answers differently
+};
+
+// moves movingCount of objectCount boxes a little every frame, once with
+// reinsertion and once with batch refits
+DynamicTreeBenchmark measureDynamicTree(uint32_t objectCount, uint32_t movingCount, uint32_t frames);
+
+#endif // DYNAMIC_AABB_TREE_H
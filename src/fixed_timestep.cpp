@@ -0,0 +1,51 @@
+#include "fixed_timestep.h"
+
+#include <algorithm>
+
+FixedTimestep::FixedTimestep()
+    : stepTime_(1.0 / 60.0)
+    , maxStepsPerFrame_(5)
+{
+    reset();
+}
+
+void FixedTimestep::configure(double stepTime, uint32_t maxStepsPerFrame)
+{
+    // keep the interpolation position when the rate changes
+    const double position = alpha();
+
+    stepTime_ = stepTime > 0.0 ? stepTime : 1.0 / 60.0;
+    maxStepsPerFrame_ = std::max(maxStepsPerFrame, 1u);
+    accumulator_ = position * stepTime_;
+}
+
+uint32_t FixedTimestep::advance(double elapsed)
+{
+    accumulator_ += std::max(elapsed, 0.0);
+
+    const double maxAccumulated = stepTime_ * maxStepsPerFrame_;
+    if (accumulator_ >= maxAccumulated + stepTime_) {
+        // keep the fraction of a step, only whole steps are dropped, so the
+        // interpolation does not jump
+        const double excess = accumulator_ - maxAccumulated;
+        const double kept = excess - stepTime_ * static_cast<double>(static_cast<uint64_t>(excess / stepTime_));
+        droppedTime_ += excess - kept;
+        accumulator_ = maxAccumulated + kept;
+    }
+
+    uint32_t steps = 0;
+    while (accumulator_ >= stepTime_ && steps < maxStepsPerFrame_) {
+        accumulator_ -= stepTime_;
+        steps++;
+    }
+
+    stepCount_ += steps;
+    return steps;
+}
+
+void FixedTimestep::reset()
+{
+    accumulator_ = 0.0;
+    stepCount_ = 0;
+    droppedTime_ = 0.0;
+}
@@ -0,0 +1,42 @@
+#if !defined(FIXED_TIMESTEP_H)
+#define FIXED_TIMESTEP_H
+
+#include <cstdint>
+
+// Accumulates real frame time and hands it out in fixed simulation steps.
+// Rendering interpolates between the last two simulated states with
+// alpha(), so the simulation rate can be lower than the frame rate without
+// visible stutter. Time is passed in, a fake clock drives it the same way
+// the real one does.
+class FixedTimestep
+{
+public:
+    FixedTimestep();
+
+    // after a long stall at most maxStepsPerFrame steps are run, the rest of
+    // the time is dropped instead of making the next frames even slower
+    void configure(double stepTime, uint32_t maxStepsPerFrame);
+
+    // adds the time since the last frame, returns how many steps to simulate
+    uint32_t advance(double elapsed);
+
+    // 0 renders the previous state, 1 the current one
+    double alpha() const { return accumulator_ / stepTime_; }
+
+    double stepTime() const { return stepTime_; }
+    uint32_t maxStepsPerFrame() const { return maxStepsPerFrame_; }
+
+    uint64_t stepCount() const { return stepCount_; }
+    double droppedTime() const { return droppedTime_; }
+
+    void reset();
+
+private:
+    double stepTime_;
+    uint32_t maxStepsPerFrame_;
+    double accumulator_;
+    uint64_t stepCount_;
+    double droppedTime_;
+};
+
+#endif // FIXED_TIMESTEP_H
@@ -0,0 +1,255 @@
+#include "frame_pacing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+// clock used by the simulation, sleeping and spinning only advance time
+class SimulatedPacingClock : public PacingClock
+{
+public:
+    explicit SimulatedPacingClock(double sleepOvershoot)
+        : time_(0.0)
+        , sleepOvershoot_(sleepOvershoot)
+    {
+    }
+
+    double now() override
+    {
+        return time_;
+    }
+
+    void sleepFor(double seconds) override
+    {
+        time_ += seconds + sleepOvershoot_;
+    }
+
+    void spinUntil(double time) override
+    {
+        time_ = std::max(time_, time);
+    }
+
+    void advance(double seconds)
+    {
+        time_ += seconds;
+    }
+
+private:
+    double time_;
+    double sleepOvershoot_;
+};
+
+double SteadyPacingClock::now()
+{
+    typedef std::chrono::duration<double> Seconds;
+    return std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SteadyPacingClock::sleepFor(double seconds)
+{
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+}
+
+void SteadyPacingClock::spinUntil(double time)
+{
+    while (now() < time)
+        std::this_thread::yield();
+}
+
+FramePacer::FramePacer(PacingClock& clock)
+    : clock_(clock)
+    , settings_()
+{
+    settings_.framesInFlight = 2;
+    settings_.targetFrameTime = 0.0;
+    settings_.spinThreshold = 0.002;
+
+    nextFrameTime_ = 0.0;
+    pendingInputTime_ = 0.0;
+    hasPendingInput_ = false;
+
+    resetStats();
+}
+
+void FramePacer::configure(const FramePacerSettings& settings)
+{
+    settings_ = settings;
+    settings_.framesInFlight = std::max(settings_.framesInFlight, 1u);
+    settings_.targetFrameTime = std::max(settings_.targetFrameTime, 0.0);
+    settings_.spinThreshold = std::max(settings_.spinThreshold, 0.0);
+
+    // start over from the next frame instead of catching up to the old rate
+    nextFrameTime_ = 0.0;
+}
+
+void FramePacer::waitForNextFrame()
+{
+    const double targetFrameTime = settings_.targetFrameTime;
+    if (targetFrameTime <= 0.0)
+        return;
+
+    const double now = clock_.now();
+
+    // more than a frame late, pace from now on instead of rushing frames out
+    // to catch up with the missed deadlines
+    if (nextFrameTime_ < now - targetFrameTime)
+        nextFrameTime_ = now;
+
+    const double remaining = nextFrameTime_ - now;
+    if (remaining > settings_.spinThreshold)
+        clock_.sleepFor(remaining - settings_.spinThreshold);
+    clock_.spinUntil(nextFrameTime_);
+
+    nextFrameTime_ += targetFrameTime;
+}
+
+void FramePacer::onInput()
+{
+    if (hasPendingInput_)
+        return;
+
+    pendingInputTime_ = clock_.now();
+    hasPendingInput_ = true;
+}
+
+double FramePacer::beginFrame()
+{
+    const double inputTime = hasPendingInput_ ? pendingInputTime_ : -1.0;
+    hasPendingInput_ = false;
+
+    return inputTime;
+}
+
+void FramePacer::onPresent(double inputTime)
+{
+    const double now = clock_.now();
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+
+    if (lastPresentTime_ >= 0.0)
+        recordFrameTime(now - lastPresentTime_);
+    lastPresentTime_ = now;
+
+    if (inputTime >= 0.0)
+        recordLatency(now - inputTime);
+}
+
+FramePacingStats FramePacer::stats()
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return stats_;
+}
+
+void FramePacer::resetStats()
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+
+    stats_ = FramePacingStats();
+    frameTimeSum_ = 0.0;
+    frameTimeSquaredSum_ = 0.0;
+    latencySum_ = 0.0;
+    latencyCount_ = 0;
+    lastPresentTime_ = -1.0;
+}
+
+void FramePacer::recordFrameTime(double frameTime)
+{
+    if (stats_.frameCount == 0) {
+        stats_.minFrameTime = frameTime;
+        stats_.maxFrameTime = frameTime;
+    } else {
+        stats_.minFrameTime = std::min(stats_.minFrameTime, frameTime);
+        stats_.maxFrameTime = std::max(stats_.maxFrameTime, frameTime);
+    }
+
+    stats_.frameCount++;
+    frameTimeSum_ += frameTime;
+    frameTimeSquaredSum_ += frameTime * frameTime;
+
+    const double count = static_cast<double>(stats_.frameCount);
+    stats_.averageFrameTime = frameTimeSum_ / count;
+    stats_.frameTimeDeviation = std::sqrt(std::max(frameTimeSquaredSum_ / count - stats_.averageFrameTime * stats_.averageFrameTime, 0.0));
+}
+
+void FramePacer::recordLatency(double latency)
+{
+    latencyCount_++;
+    latencySum_ += latency;
+
+    stats_.averageLatency = latencySum_ / static_cast<double>(latencyCount_);
+    stats_.maxLatency = std::max(stats_.maxLatency, latency);
+}
+
+FrameSimulationResult simulateFramePacing(const FramePacerSettings& settings, const FrameSimulationParams& params)
+{
+    FrameSimulationResult result = {};
+    if (params.frameCount == 0)
+        return result;
+
+    SimulatedPacingClock clock(params.sleepOvershoot);
+    FramePacer pacer(clock);
+    pacer.configure(settings);
+
+    const uint32_t framesInFlight = pacer.settings().framesInFlight;
+
+    // fixed seed lcg, runs with the same params give the same timeline
+    uint32_t seed = 0x12345678;
+    auto vary = [&](double duration) {
+        seed = seed * 1664525u + 1013904223u;
+        const double unit = static_cast<double>(seed >> 8) / static_cast<double>(1u << 24);
+        return duration * (1.0 + params.variance * (unit * 2.0 - 1.0));
+    };
+
+    std::vector<double> completions(params.frameCount);
+    double gpuFree = 0.0;
+    double latencySum = 0.0;
+    double intervalSum = 0.0;
+    double intervalSquaredSum = 0.0;
+
+    for (uint32_t frame = 0; frame < params.frameCount; ++frame) {
+        pacer.waitForNextFrame();
+
+        // the GPU may only be framesInFlight frames behind
+        if (frame >= framesInFlight) {
+            const double wait = completions[frame - framesInFlight] - clock.now();
+            if (wait > 0.0) {
+                result.cpuWaitTime += wait;
+                clock.advance(wait);
+            }
+        }
+
+        // input is sampled right before the frame starts simulating
+        pacer.onInput();
+        const double inputTime = pacer.beginFrame();
+
+        clock.advance(vary(params.cpuFrameTime));
+
+        const double gpuStart = std::max(clock.now(), gpuFree);
+        gpuFree = gpuStart + vary(params.gpuFrameTime);
+        completions[frame] = gpuFree;
+
+        pacer.onPresent(inputTime);
+
+        const double latency = gpuFree - inputTime;
+        latencySum += latency;
+        result.maxLatency = std::max(result.maxLatency, latency);
+
+        if (frame > 0) {
+            const double interval = completions[frame] - completions[frame - 1];
+            intervalSum += interval;
+            intervalSquaredSum += interval * interval;
+        }
+    }
+
+    result.averageLatency = latencySum / static_cast<double>(params.frameCount);
+
+    if (params.frameCount > 1) {
+        const double intervals = static_cast<double>(params.frameCount - 1);
+        result.averageFrameTime = intervalSum / intervals;
+        result.frameTimeDeviation = std::sqrt(std::max(intervalSquaredSum / intervals - result.averageFrameTime * result.averageFrameTime, 0.0));
+    }
+
+    return result;
+}
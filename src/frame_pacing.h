@@ -0,0 +1,117 @@
+#if !defined(FRAME_PACING_H)
+#define FRAME_PACING_H
+
+#include <cstdint>
+#include <mutex>
+
+// Frame limiter and latency measurement. All timing goes through a
+// PacingClock, so the same pacing code runs against a simulated GPU
+// timeline (see simulateFramePacing) as well as the real swap chain.
+
+class PacingClock
+{
+public:
+    virtual ~PacingClock() {}
+
+    // seconds since an arbitrary epoch
+    virtual double now() = 0;
+    virtual void sleepFor(double seconds) = 0;
+    virtual void spinUntil(double time) = 0;
+};
+
+class SteadyPacingClock : public PacingClock
+{
+public:
+    double now() override;
+    void sleepFor(double seconds) override;
+    void spinUntil(double time) override;
+};
+
+struct FramePacerSettings
+{
+    uint32_t framesInFlight;
+    double targetFrameTime; // seconds, 0 disables the limiter
+    double spinThreshold;   // the last part of the wait is spun, sleeps are not precise
+};
+
+struct FramePacingStats
+{
+    uint64_t frameCount;
+    double averageFrameTime;
+    double minFrameTime;
+    double maxFrameTime;
+    double frameTimeDeviation; // jitter
+    double averageLatency;     // input sample to present
+    double maxLatency;
+};
+
+class FramePacer
+{
+public:
+    explicit FramePacer(PacingClock& clock);
+
+    void configure(const FramePacerSettings& settings);
+    const FramePacerSettings& settings() const { return settings_; }
+
+    // sleeps and then spins until the next frame is due. Call before input
+    // is sampled, so the waiting does not add to the latency.
+    void waitForNextFrame();
+
+    // input arrived, the earliest unconsumed input is what latency is
+    // measured from
+    void onInput();
+
+    // the frame starts consuming input, returns when the earliest input it
+    // consumes arrived or a negative value if there was none
+    double beginFrame();
+
+    // inputTime is what beginFrame() returned for the presented frame. With
+    // a pipelined frame this is called from the render thread, everything
+    // else from the thread that pumps input.
+    void onPresent(double inputTime);
+
+    FramePacingStats stats();
+    void resetStats();
+
+private:
+    void recordFrameTime(double frameTime);
+    void recordLatency(double latency);
+
+    PacingClock& clock_;
+    FramePacerSettings settings_;
+    double nextFrameTime_;
+    double pendingInputTime_;
+    bool hasPendingInput_;
+
+    // present side, guarded by statsMutex_
+    std::mutex statsMutex_;
+    FramePacingStats stats_;
+    double frameTimeSum_;
+    double frameTimeSquaredSum_;
+    double latencySum_;
+    uint64_t latencyCount_;
+    double lastPresentTime_;
+};
+
+struct FrameSimulationParams
+{
+    uint32_t frameCount;
+    double cpuFrameTime;   // seconds of CPU work per frame
+    double gpuFrameTime;   // seconds of GPU work per frame
+    double variance;       // +- fraction applied to both, deterministic
+    double sleepOvershoot; // how late the simulated OS wakes up from sleeps
+};
+
+struct FrameSimulationResult
+{
+    double averageFrameTime;   // between GPU completions
+    double frameTimeDeviation;
+    double averageLatency;     // input sample to GPU completion
+    double maxLatency;
+    double cpuWaitTime;        // total time the CPU was blocked on frames in flight
+};
+
+// runs the pacer against a simulated clock and GPU timeline
+FrameSimulationResult simulateFramePacing(const FramePacerSettings& settings, const FrameSimulationParams& params);
+
+#endif // FRAME_PACING_H
@@ -0,0 +1,200 @@
+#include "frame_pipeline.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+
+static double secondsNow()
+{
+    typedef std::chrono::duration<double> Seconds;
+    return std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FramePipeline::FramePipeline()
+    : slotCount_(0)
+    , running_(false)
+    , stopping_(false)
+{
+}
+
+FramePipeline::~FramePipeline()
+{
+    stop();
+}
+
+void FramePipeline::addStage(const char* name, StageFn stage, FrameStageStart start)
+{
+    if (running_)
+        return;
+
+    stages_.emplace_back();
+    stages_.back().name = name;
+    stages_.back().run = stage;
+    stages_.back().start = start;
+    stages_.back().started = 0;
+    stages_.back().completed = 0;
+    stages_.back().busyTime = 0.0;
+}
+
+bool FramePipeline::start(uint32_t slotCount)
+{
+    if (running_ || stages_.empty() || slotCount == 0)
+        return false;
+
+    slotCount_ = slotCount;
+    stopping_ = false;
+    running_ = true;
+
+    for (Stage& stage : stages_) {
+        stage.started = 0;
+        stage.completed = 0;
+        stage.busyTime = 0.0;
+    }
+
+    for (uint32_t i = 1; i < stageCount(); ++i)
+        stages_[i].thread = std::thread(&FramePipeline::stageThread, this, i);
+
+    return true;
+}
+
+void FramePipeline::runFrame()
+{
+    uint64_t frame;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        frame = stages_[0].completed;
+
+        // the slot of frame - slotCount has to be through every stage, one
+        // that starts with the previous one may finish before it
+        progress_.wait(lock, [&] { return slowestCompleted() + slotCount_ > frame || stopping_; });
+        if (stopping_)
+            return;
+    }
+
+    runStage(0, frame);
+}
+
+void FramePipeline::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    progress_.wait(lock, [&] { return slowestCompleted() == stages_[0].completed; });
+}
+
+void FramePipeline::stop()
+{
+    if (!running_)
+        return;
+
+    flush();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    progress_.notify_all();
+
+    for (uint32_t i = 1; i < stageCount(); ++i)
+        stages_[i].thread.join();
+
+    running_ = false;
+}
+
+double FramePipeline::averageStageTime(uint32_t stage)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Stage& s = stages_[stage];
+    return s.completed > 0 ? s.busyTime / static_cast<double>(s.completed) : 0.0;
+}
+
+uint64_t FramePipeline::frameCount()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return slowestCompleted();
+}
+
+bool FramePipeline::canStart(uint32_t stage, uint64_t frame) const
+{
+    const Stage& previous = stages_[stage - 1];
+    const uint64_t ready = stages_[stage].start == StageWithPrevious ? previous.started : previous.completed;
+    return ready > frame;
+}
+
+uint64_t FramePipeline::slowestCompleted() const
+{
+    uint64_t completed = stages_[0].completed;
+    for (const Stage& stage : stages_)
+        completed = std::min(completed, stage.completed);
+    return completed;
+}
+
+void FramePipeline::stageThread(uint32_t stage)
+{
+    PROFILE_THREAD(stages_[stage].name);
+
+    for (;;) {
+        uint64_t frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            frame = stages_[stage].completed;
+
+            progress_.wait(lock, [&] { return canStart(stage, frame) || stopping_; });
+            if (!canStart(stage, frame))
+                return;
+        }
+
+        runStage(stage, frame);
+    }
+}
+
+void FramePipeline::runStage(uint32_t stage, uint64_t frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stages_[stage].started++;
+    }
+    progress_.notify_all();
+
+    const double start = secondsNow();
+    stages_[stage].run(frame, static_cast<uint32_t>(frame % slotCount_));
+    const double busy = secondsNow() - start;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stages_[stage].completed++;
+        stages_[stage].busyTime += busy;
+    }
+    progress_.notify_all();
+}
+
+FramePipelineBenchmark measureFramePipeline(const double* stageTimes, uint32_t stageCount, uint32_t slotCount, uint32_t frameCount)
+{
+    FramePipelineBenchmark result = {};
+
+    FramePipeline pipeline;
+    for (uint32_t i = 0; i < stageCount; ++i) {
+        const double stageTime = stageTimes[i];
+        result.sequentialFrameTime += stageTime;
+
+        pipeline.addStage("Stage", [stageTime](uint64_t, uint32_t) {
+            const double end = secondsNow() + stageTime;
+            while (secondsNow() < end) {
+            }
+        });
+    }
+
+    if (!pipeline.start(slotCount))
+        return result;
+
+    const double start = secondsNow();
+    for (uint32_t frame = 0; frame < frameCount; ++frame)
+        pipeline.runFrame();
+    pipeline.flush();
+
+    if (frameCount > 0)
+        result.pipelinedFrameTime = (secondsNow() - start) / static_cast<double>(frameCount);
+
+    pipeline.stop();
+
+    return result;
+}
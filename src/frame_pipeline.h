@@ -0,0 +1,103 @@
+#if !defined(FRAME_PIPELINE_H)
+#define FRAME_PIPELINE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs the stages of a frame (simulate, build render packets, record and
+// submit) on separate threads, so consecutive frames overlap and the frame
+// time approaches the longest stage instead of the sum of all of them.
+// Stages hand data over through slots, frame N uses slot N % slotCount and a
+// slot is only reused once every stage is done with it.
+//
+// A stage normally starts a frame once the stage before it finished it. A
+// stage that consumes a stream the one before it produces, like render
+// packets through a bounded queue, starts along with it instead, so the
+// producer never waits for room the consumer is not yet making.
+enum FrameStageStart
+{
+    StageAfterPrevious,
+    StageWithPrevious,
+};
+
+class FramePipeline
+{
+public:
+    typedef std::function<void(uint64_t frame, uint32_t slot)> StageFn;
+
+    FramePipeline();
+    ~FramePipeline();
+
+    // stages run in the order they were added. The first one runs on the
+    // thread that calls runFrame(), every other stage gets its own thread.
+    // The first stage always starts right away.
+    void addStage(const char* name, StageFn stage, FrameStageStart start = StageAfterPrevious);
+
+    // with fewer slots than stages not every stage can overlap
+    bool start(uint32_t slotCount);
+
+    // waits for a free slot, runs the first stage for the next frame and
+    // hands the slot to the second stage
+    void runFrame();
+
+    // waits until every frame went through all stages
+    void flush();
+
+    // flushes and joins the stage threads
+    void stop();
+
+    bool isRunning() const { return running_; }
+    uint32_t slotCount() const { return slotCount_; }
+    uint32_t stageCount() const { return static_cast<uint32_t>(stages_.size()); }
+    const char* stageName(uint32_t stage) const { return stages_[stage].name; }
+
+    // busy time of a stage per frame in seconds, averaged since start(). A
+    // stage that starts with the previous one counts the time it waits on it.
+    double averageStageTime(uint32_t stage);
+    uint64_t frameCount();
+
+private:
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    struct Stage
+    {
+        const char* name;
+        StageFn run;
+        FrameStageStart start;
+        std::thread thread;
+        uint64_t started;   // frames this stage began
+        uint64_t completed; // frames this stage is done with
+        double busyTime;
+    };
+
+    // with mutex_ held
+    bool canStart(uint32_t stage, uint64_t frame) const;
+    uint64_t slowestCompleted() const;
+
+    void stageThread(uint32_t stage);
+    void runStage(uint32_t stage, uint64_t frame);
+
+    std::vector<Stage> stages_;
+    std::mutex mutex_;
+    std::condition_variable progress_;
+    uint32_t slotCount_;
+    bool running_;
+    bool stopping_;
+};
+
+struct FramePipelineBenchmark
+{
+    double sequentialFrameTime; // sum of the stage times
+    double pipelinedFrameTime;  // measured wall time per frame
+};
+
+// runs a pipeline whose stages only burn the given seconds of CPU time,
+// nothing is rendered
+FramePipelineBenchmark measureFramePipeline(const double* stageTimes, uint32_t stageCount, uint32_t slotCount, uint32_t frameCount);
+
+#endif // FRAME_PIPELINE_H
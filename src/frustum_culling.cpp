@@ -0,0 +1,332 @@
+#include "frustum_culling.h"
+
+#include "job_system.h"
+#include "profiler.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// widest block cullRange() loads, the bounds are padded by one block
+static const uint32_t maxCullWidth_ = 8;
+
+// objects one job culls, enough to keep the split cheap
+static const uint32_t objectsPerJob_ = 16384;
+
+namespace {
+
+struct SseLanes
+{
+    typedef SimdFloat Value;
+    static const uint32_t width = simdWidth;
+
+    static Value load(const float* values) { return simdLoad(values); }
+    static Value splat(float value) { return simdSplat(value); }
+    static Value add(Value a, Value b) { return simdAdd(a, b); }
+    static Value mul(Value a, Value b) { return simdMul(a, b); }
+    static Value mulAdd(Value a, Value b, Value c) { return simdMulAdd(a, b, c); }
+    static Value less(Value a, Value b) { return simdLess(a, b); }
+    static Value orMask(Value a, Value b) { return simdOr(a, b); }
+    static uint32_t mask(Value v) { return simdMask(v); }
+};
+
+#if defined(__AVX2__)
+struct Avx2Lanes
+{
+    typedef __m256 Value;
+    static const uint32_t width = 8;
+
+    static Value load(const float* values) { return _mm256_loadu_ps(values); }
+    static Value splat(float value) { return _mm256_set1_ps(value); }
+    static Value add(Value a, Value b) { return _mm256_add_ps(a, b); }
+    static Value mul(Value a, Value b) { return _mm256_mul_ps(a, b); }
+    static Value mulAdd(Value a, Value b, Value c) { return _mm256_fmadd_ps(a, b, c); }
+    static Value less(Value a, Value b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Value orMask(Value a, Value b) { return _mm256_or_ps(a, b); }
+    static uint32_t mask(Value v) { return static_cast<uint32_t>(_mm256_movemask_ps(v)); }
+};
+
+typedef Avx2Lanes CullLanes;
+#else
+typedef SseLanes CullLanes;
+#endif
+
+// an object is outside once it is entirely behind one plane. The distance
+// of the center has to be below minus the box's extent along the plane
+// normal, or the sphere's radius.
+template <typename Lanes>
+uint32_t cullBlocks(const Frustum& frustum, const CullingBounds& bounds, CullShape shape, uint32_t begin, uint32_t end, uint32_t* visible)
+{
+    typedef typename Lanes::Value Value;
+
+    Value normal[6][3];
+    Value absNormal[6][3];
+    Value distance[6];
+    for (uint32_t p = 0; p < 6; ++p) {
+        const Float4& plane = frustum.planes[p];
+        normal[p][0] = Lanes::splat(plane.x);
+        normal[p][1] = Lanes::splat(plane.y);
+        normal[p][2] = Lanes::splat(plane.z);
+        absNormal[p][0] = Lanes::splat(std::fabs(plane.x));
+        absNormal[p][1] = Lanes::splat(std::fabs(plane.y));
+        absNormal[p][2] = Lanes::splat(std::fabs(plane.z));
+        distance[p] = Lanes::splat(plane.w);
+    }
+
+    const uint32_t width = Lanes::width;
+    const Value zero = Lanes::splat(0.0f);
+    uint32_t count = 0;
+
+    for (uint32_t first = begin; first < end; first += width) {
+        const Value x = Lanes::load(bounds.centers(0) + first);
+        const Value y = Lanes::load(bounds.centers(1) + first);
+        const Value z = Lanes::load(bounds.centers(2) + first);
+
+        Value outside = zero;
+
+        if (shape == CullBoxes) {
+            const Value ex = Lanes::load(bounds.extents(0) + first);
+            const Value ey = Lanes::load(bounds.extents(1) + first);
+            const Value ez = Lanes::load(bounds.extents(2) + first);
+
+            for (uint32_t p = 0; p < 6; ++p) {
+                Value d = Lanes::mulAdd(x, normal[p][0], distance[p]);
+                d = Lanes::mulAdd(y, normal[p][1], d);
+                d = Lanes::mulAdd(z, normal[p][2], d);
+
+                Value r = Lanes::mul(ex, absNormal[p][0]);
+                r = Lanes::mulAdd(ey, absNormal[p][1], r);
+                r = Lanes::mulAdd(ez, absNormal[p][2], r);
+
+                outside = Lanes::orMask(outside, Lanes::less(Lanes::add(d, r), zero));
+            }
+        } else {
+            const Value r = Lanes::load(bounds.radii() + first);
+
+            for (uint32_t p = 0; p < 6; ++p) {
+                Value d = Lanes::mulAdd(x, normal[p][0], distance[p]);
+                d = Lanes::mulAdd(y, normal[p][1], d);
+                d = Lanes::mulAdd(z, normal[p][2], d);
+
+                outside = Lanes::orMask(outside, Lanes::less(Lanes::add(d, r), zero));
+            }
+        }
+
+        // every lane writes its index, only visible ones move count on
+        const uint32_t lanes = std::min(width, end - first);
+        const uint32_t inside = ~Lanes::mask(outside);
+        for (uint32_t lane = 0; lane < lanes; ++lane) {
+            visible[count] = first + lane;
+            count += (inside >> lane) & 1;
+        }
+    }
+
+    return count;
+}
+
+uint32_t cullBoxScalar(const Frustum& frustum, const CullingBounds& bounds, uint32_t index)
+{
+    const float x = bounds.centers(0)[index], y = bounds.centers(1)[index], z = bounds.centers(2)[index];
+    const float ex = bounds.extents(0)[index], ey = bounds.extents(1)[index], ez = bounds.extents(2)[index];
+
+    for (const Float4& plane : frustum.planes) {
+        const float d = plane.x * x + plane.y * y + plane.z * z + plane.w;
+        const float r = std::fabs(plane.x) * ex + std::fabs(plane.y) * ey + std::fabs(plane.z) * ez;
+        if (d + r < 0.0f)
+            return 0;
+    }
+
+    return 1;
+}
+
+} // namespace
+
+Frustum frustumFromMatrix(const Float4x4& viewProjection)
+{
+    // clip = p * m, so each clip coordinate is p dotted with a column
+    Float4 column[4];
+    for (uint32_t j = 0; j < 4; ++j)
+        column[j] = { viewProjection.m[0][j], viewProjection.m[1][j], viewProjection.m[2][j], viewProjection.m[3][j] };
+
+    auto combine = [](const Float4& a, const Float4& b, float sign) {
+        const Float4 result = { a.x + sign * b.x, a.y + sign * b.y, a.z + sign * b.z, a.w + sign * b.w };
+        return result;
+    };
+
+    Frustum frustum;
+    frustum.planes[0] = combine(column[3], column[0], 1.0f);  // -w <= x
+    frustum.planes[1] = combine(column[3], column[0], -1.0f); // x <= w
+    frustum.planes[2] = combine(column[3], column[1], 1.0f);  // -w <= y
+    frustum.planes[3] = combine(column[3], column[1], -1.0f); // y <= w
+    frustum.planes[4] = column[2];                            // 0 <= z
+    frustum.planes[5] = combine(column[3], column[2], -1.0f); // z <= w
+
+    for (Float4& plane : frustum.planes) {
+        const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (length > 0.0f) {
+            plane.x /= length;
+            plane.y /= length;
+            plane.z /= length;
+            plane.w /= length;
+        }
+    }
+
+    return frustum;
+}
+
+CullingBounds::CullingBounds()
+    : count_(0)
+{
+    resize(0);
+}
+
+void CullingBounds::resize(uint32_t count)
+{
+    count_ = count;
+
+    // the padding is never visible, it is masked off
+    for (std::vector<float>& values : center_)
+        values.resize(count + maxCullWidth_, 0.0f);
+    for (std::vector<float>& values : extents_)
+        values.resize(count + maxCullWidth_, 0.0f);
+    radius_.resize(count + maxCullWidth_, 0.0f);
+}
+
+void CullingBounds::setBox(uint32_t index, const Float3& center, const Float3& extents)
+{
+    center_[0][index] = center.x;
+    center_[1][index] = center.y;
+    center_[2][index] = center.z;
+    extents_[0][index] = extents.x;
+    extents_[1][index] = extents.y;
+    extents_[2][index] = extents.z;
+    radius_[index] = std::sqrt(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z);
+}
+
+void CullingBounds::setSphere(uint32_t index, const Float3& center, float radius)
+{
+    center_[0][index] = center.x;
+    center_[1][index] = center.y;
+    center_[2][index] = center.z;
+    extents_[0][index] = radius;
+    extents_[1][index] = radius;
+    extents_[2][index] = radius;
+    radius_[index] = radius;
+}
+
+uint32_t cullRange(const Frustum& frustum, const CullingBounds& bounds, CullShape shape, uint32_t begin, uint32_t end, uint32_t* visible)
+{
+    return cullBlocks<CullLanes>(frustum, bounds, shape, begin, std::min(end, bounds.count()), visible);
+}
+
+void cullObjects(const Frustum& frustum, const CullingBounds& bounds, CullShape shape, JobSystem* jobs, std::vector<uint32_t>& visible)
+{
+    PROFILE_FUNCTION();
+
+    const uint32_t count = bounds.count();
+    visible.resize(count);
+
+    if (!jobs || count < 2 * objectsPerJob_) {
+        visible.resize(cullRange(frustum, bounds, shape, 0, count, visible.data()));
+        return;
+    }
+
+    // every chunk culls into its own part of the list, the parts are then
+    // moved together
+    const uint32_t chunkCount = (count + objectsPerJob_ - 1) / objectsPerJob_;
+    std::vector<uint32_t> chunkVisible(chunkCount);
+
+    jobs->parallelFor(0, chunkCount, 1, [&](uint32_t firstChunk, uint32_t lastChunk) {
+        for (uint32_t chunk = firstChunk; chunk < lastChunk; ++chunk) {
+            const uint32_t begin = chunk * objectsPerJob_;
+            const uint32_t end = std::min(begin + objectsPerJob_, count);
+            chunkVisible[chunk] = cullRange(frustum, bounds, shape, begin, end, visible.data() + begin);
+        }
+    });
+
+    uint32_t visibleCount = chunkVisible[0];
+    for (uint32_t chunk = 1; chunk < chunkCount; ++chunk) {
+        memmove(visible.data() + visibleCount, visible.data() + chunk * objectsPerJob_, chunkVisible[chunk] * sizeof(uint32_t));
+        visibleCount += chunkVisible[chunk];
+    }
+
+    visible.resize(visibleCount);
+}
+
+CullingBenchmark measureFrustumCulling(uint32_t objectCount, uint32_t threadCount, uint32_t iterations)
+{
+    CullingBenchmark result = {};
+    result.objects = objectCount;
+    result.threads = threadCount + 1;
+    if (iterations == 0)
+        return result;
+
+    // fixed seed lcg, every run culls the same scene
+    uint32_t seed = 0x12345678;
+    auto random = [&seed](float low, float high) {
+        seed = seed * 1664525u + 1013904223u;
+        return low + (high - low) * static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+    };
+
+    // camera at the origin looking down z, objects all around it
+    const Float3 eye = { 0.0f, 0.0f, 0.0f };
+    const Float3 target = { 0.0f, 0.0f, 1.0f };
+    const Float3 up = { 0.0f, 1.0f, 0.0f };
+    const Float4x4 viewProjection = matrixMultiply(matrixLookAtLH(eye, target, up), matrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.1f, 500.0f));
+    const Frustum frustum = frustumFromMatrix(viewProjection);
+
+    CullingBounds bounds;
+    bounds.resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; ++i) {
+        const Float3 center = { random(-500.0f, 500.0f), random(-50.0f, 50.0f), random(-500.0f, 500.0f) };
+        const Float3 extents = { random(0.5f, 5.0f), random(0.5f, 5.0f), random(0.5f, 5.0f) };
+        bounds.setBox(i, center, extents);
+    }
+
+    JobSystem jobs;
+    jobs.start(threadCount);
+    JobSystem* cullJobs = threadCount > 0 ? &jobs : nullptr;
+
+    std::vector<uint32_t> visible;
+    typedef std::chrono::duration<double> Seconds;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; ++i)
+        cullObjects(frustum, bounds, CullSpheres, cullJobs, visible);
+    result.sphereSeconds = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count() / iterations;
+    result.visibleSpheres = static_cast<uint32_t>(visible.size());
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; ++i)
+        cullObjects(frustum, bounds, CullBoxes, cullJobs, visible);
+    result.boxSeconds = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count() / iterations;
+    result.visibleBoxes = static_cast<uint32_t>(visible.size());
+
+    jobs.stop();
+
+    std::vector<uint8_t> scalarVisible(objectCount);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; ++i) {
+        for (uint32_t object = 0; object < objectCount; ++object)
+            scalarVisible[object] = static_cast<uint8_t>(cullBoxScalar(frustum, bounds, object));
+    }
+    result.scalarSeconds = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+    // both lists are in ascending order
+    size_t next = 0;
+    for (uint32_t object = 0; object < objectCount; ++object) {
+        const bool listed = next < visible.size() && visible[next] == object;
+        if (listed)
+            ++next;
+        if (listed != (scalarVisible[object] != 0))
+            result.mismatches++;
+    }
+
+    return result;
+}
@@ -0,0 +1,86 @@
+#if !defined(FRUSTUM_CULLING_H)
+#define FRUSTUM_CULLING_H
+
+#include "scene_math.h"
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// Batched frustum culling. Bounds are kept as structure of arrays and
+// tested against the six planes four at a time with SSE, eight with AVX2
+// when the build targets it. The result is a compact list of the indices
+// that may be visible.
+
+// a point p is inside if dot(plane.xyz, p) + plane.w >= 0 for every plane,
+// plane normals point inwards and have unit length
+struct Frustum
+{
+    Float4 planes[6]; // left, right, bottom, top, near, far
+};
+
+// planes of a view projection matrix with D3D clip space, 0 <= z <= w
+Frustum frustumFromMatrix(const Float4x4& viewProjection);
+
+enum CullShape
+{
+    CullBoxes,   // axis aligned boxes
+    CullSpheres, // the bounding spheres of the boxes, cheaper and looser
+};
+
+// object bounds, a box is a center and half extents. Setting a box also
+// sets its bounding sphere and the other way round.
+class CullingBounds
+{
+public:
+    CullingBounds();
+
+    void clear() { resize(0); }
+    void resize(uint32_t count);
+
+    uint32_t count() const { return count_; }
+
+    void setBox(uint32_t index, const Float3& center, const Float3& extents);
+    void setSphere(uint32_t index, const Float3& center, float radius);
+
+    // one array per axis, padded past the last object so a block of any
+    // SIMD width can be loaded whole
+    const float* centers(uint32_t axis) const { return center_[axis].data(); }
+    const float* extents(uint32_t axis) const { return extents_[axis].data(); }
+    const float* radii() const { return radius_.data(); }
+
+private:
+    uint32_t count_;
+
+    std::vector<float> center_[3];
+    std::vector<float> extents_[3];
+    std::vector<float> radius_;
+};
+
+// writes the indices of the objects in [begin, end) that intersect the
+// frustum to visible, which needs room for end - begin indices. Returns
+// how many were written.
+uint32_t cullRange(const Frustum& frustum, const CullingBounds& bounds, CullShape shape, uint32_t begin, uint32_t end, uint32_t* visible);
+
+// every object, split across workers unless jobs is null. Indices come out
+// in ascending order either way.
+void cullObjects(const Frustum& frustum, const CullingBounds& bounds, CullShape shape, JobSystem* jobs, std::vector<uint32_t>& visible);
+
+struct CullingBenchmark
+{
+    uint32_t objects;
+    uint32_t threads;
+    uint32_t visibleBoxes;
+    uint32_t visibleSpheres;
+    double boxSeconds;    // per cull of all objects
+    double sphereSeconds;
+    double scalarSeconds; // boxes one at a time
+    uint32_t mismatches;  // boxes the scalar test disagrees on
+};
+
+// culls objectCount random boxes scattered around a camera, iterations
+// times
+CullingBenchmark measureFrustumCulling(uint32_t objectCount, uint32_t threadCount, uint32_t iterations);
+
+#endif // FRUSTUM_CULLING_H
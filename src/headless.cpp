@@ -0,0 +1,117 @@
+#include "frame_pipeline.h"
+#include "null_backend.h"
+#include "profiler.h"
+#include "scene.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Runs the frame loop against the null backend without a window or a GPU
+// and reports the CPU time of each stage. Exits with 1 if frames got lost
+// or out of order, so it can gate CI runs.
+//
+// usage: dx12_headless [--frames count] [--frame-time seconds] [--trace path]
+
+static void printUsage()
+{
+    printf("usage: dx12_headless [--frames count] [--frame-time seconds] [--trace path]\n");
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frameCount = 1000;
+    double frameTime = 1.0 / 60.0; // elapsed time every update is given
+    const char* tracePath = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frameCount = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--frame-time") == 0 && i + 1 < argc) {
+            frameTime = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else {
+            printUsage();
+            return 2;
+        }
+    }
+
+    PROFILE_THREAD("Main");
+
+    Scene scene;
+    NullRenderBackend backend;
+    RenderPacketQueue packets(16384);
+
+    scene.reset(800, 600);
+    scene.setSimulationRate(60.0);
+    scene.setMaterialIndex(backend.defaultMaterialIndex());
+    backend.setFramesInFlight(2);
+
+    // same stages as the windowed app, minus input and pacing
+    FramePipeline pipeline;
+
+    pipeline.addStage("Update", [&](uint64_t, uint32_t slot) {
+        PROFILE_ZONE("UpdateStage");
+        scene.update(frameTime, slot);
+    });
+
+    pipeline.addStage("BuildRenderPackets", [&](uint64_t, uint32_t slot) {
+        PROFILE_ZONE("BuildRenderPacketsStage");
+        scene.buildRenderPackets(slot, packets);
+    });
+
+    // drains the queue while the packets are built
+    pipeline.addStage("Render", [&](uint64_t, uint32_t slot) {
+        PROFILE_ZONE("RenderStage");
+        backend.render(packets, slot);
+    }, StageWithPrevious);
+
+    if (!pipeline.start(frameSlotCount_)) {
+        printf("starting the frame pipeline failed\n");
+        return 1;
+    }
+
+    typedef std::chrono::duration<double> Seconds;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t frame = 0; frame < frameCount; ++frame) {
+        pipeline.runFrame();
+        PROFILE_FRAME();
+    }
+    pipeline.flush();
+
+    const double seconds = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+
+    pipeline.stop();
+
+    const NullBackendStats stats = backend.stats();
+
+    printf("%u frames in %.3f s, %.3f ms per frame\n", frameCount, seconds, frameCount > 0 ? seconds * 1000.0 / frameCount : 0.0);
+    for (uint32_t stage = 0; stage < pipeline.stageCount(); ++stage)
+        printf("  %-20s %8.4f ms\n", pipeline.stageName(stage), pipeline.averageStageTime(stage) * 1000.0);
+    printf("backend: %llu frames, %llu draws in %llu instanced draws, %llu out of order\n",
+        static_cast<unsigned long long>(stats.frames),
+        static_cast<unsigned long long>(stats.draws),
+        static_cast<unsigned long long>(stats.instancedDraws),
+        static_cast<unsigned long long>(stats.outOfOrderFrames));
+
+    std::vector<ProfileZoneStats> zones;
+    profileZoneStats(zones);
+    for (const ProfileZoneStats& zone : zones) {
+        printf("  %-32s min %8.4f ms, avg %8.4f ms, p99 %8.4f ms\n",
+            zone.name,
+            zone.minTime * 1000.0,
+            zone.averageTime * 1000.0,
+            zone.p99Time * 1000.0);
+    }
+
+    if (tracePath && !exportChromeTrace(tracePath)) {
+        printf("writing %s failed\n", tracePath);
+        return 1;
+    }
+
+    return stats.frames == frameCount && stats.outOfOrderFrames == 0 ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+#include "instancing.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// what a draw took in the constant buffer before instancing, one matrix
+// padded to the constant buffer alignment
+static const size_t perDrawConstantsSize_ = 256;
+
+void InstanceBatcher::clear()
+{
+    added_.clear();
+    draws_.clear();
+    keys_.clear();
+    drawOfInstance_.clear();
+    batches_.clear();
+}
+
+void InstanceBatcher::add(uint64_t sortKey, uint32_t mesh, uint32_t material, const float* worldViewProjection)
+{
+    InstanceData instance;
+    memcpy(instance.worldViewProjection, worldViewProjection, sizeof(instance.worldViewProjection));
+    instance.materialIndex = material;
+
+    added_.push_back(instance);
+    draws_.push_back({ mesh, material });
+    keys_.push_back(sortKey);
+}
+
+void InstanceBatcher::build(JobSystem* jobs)
+{
+    PROFILE_FUNCTION();
+
+    const uint32_t drawCount = static_cast<uint32_t>(added_.size());
+
+    drawOfInstance_.resize(drawCount);
+    for (uint32_t i = 0; i < drawCount; ++i)
+        drawOfInstance_[i] = i;
+
+    sorter_.sort(keys_.data(), drawOfInstance_.data(), drawCount, jobs);
+
+    // a new batch wherever the state changes, the key should say so but
+    // mesh and material are checked as well in case they did not fit it
+    batches_.clear();
+    for (uint32_t i = 0; i < drawCount; ++i) {
+        const Draw& draw = draws_[drawOfInstance_[i]];
+
+        if (i == 0 || drawKeyState(keys_[i]) != drawKeyState(keys_[i - 1])
+            || draw.mesh != batches_.back().mesh || draw.material != batches_.back().material)
+            batches_.push_back({ draw.mesh, draw.material, i, 0 });
+
+        batches_.back().instanceCount++;
+    }
+}
+
+void InstanceBatcher::writeInstances(InstanceData* destination, uint32_t count) const
+{
+    PROFILE_FUNCTION();
+
+    const uint32_t instanceCount = std::min(count, static_cast<uint32_t>(drawOfInstance_.size()));
+    for (uint32_t i = 0; i < instanceCount; ++i)
+        memcpy(&destination[i], &added_[drawOfInstance_[i]], sizeof(InstanceData));
+}
+
+InstancingBenchmark measureInstancing(uint32_t objectCount, uint32_t meshCount, uint32_t materialCount, uint32_t frames)
+{
+    InstancingBenchmark result = {};
+    result.objects = objectCount;
+    if (objectCount == 0 || meshCount == 0 || materialCount == 0 || frames == 0)
+        return result;
+
+    // fixed seed lcg, every run draws the same scene
+    uint32_t seed = 0x12345678;
+    auto random = [&seed](uint32_t count) {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<uint32_t>((static_cast<uint64_t>(seed >> 8) * count) >> 24);
+    };
+
+    std::vector<uint32_t> meshes(objectCount);
+    std::vector<uint32_t> materials(objectCount);
+    std::vector<uint64_t> keys(objectCount);
+    std::vector<float> matrices(objectCount * 16);
+
+    for (uint32_t i = 0; i < objectCount; ++i) {
+        meshes[i] = random(meshCount);
+        materials[i] = random(materialCount);
+
+        DrawKey key = {};
+        key.layer = DrawLayerOpaque;
+        key.material = materials[i];
+        key.mesh = meshes[i];
+        key.depth = static_cast<float>(random(1 << 20)) / static_cast<float>(1 << 20);
+        keys[i] = encodeDrawKey(key);
+
+        for (uint32_t j = 0; j < 16; ++j)
+            matrices[i * 16 + j] = static_cast<float>(i) + j * 0.0625f;
+    }
+
+    // stand ins for the mapped upload buffers
+    std::vector<InstanceData> instanceUpload(objectCount);
+    std::vector<uint8_t> perDrawUpload(objectCount * perDrawConstantsSize_);
+
+    typedef std::chrono::duration<double> Seconds;
+
+    InstanceBatcher batcher;
+    double buildSeconds = 0.0;
+
+    // the first frame of either path is not timed, it faults the memory in
+    for (uint32_t frame = 0; frame <= frames; ++frame) {
+        const auto start = std::chrono::steady_clock::now();
+
+        batcher.clear();
+        for (uint32_t i = 0; i < objectCount; ++i)
+            batcher.add(keys[i], meshes[i], materials[i], &matrices[i * 16]);
+        batcher.build(nullptr);
+        batcher.writeInstances(instanceUpload.data(), objectCount);
+
+        if (frame > 0)
+            buildSeconds += std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double perDrawSeconds = 0.0;
+
+    for (uint32_t frame = 0; frame <= frames; ++frame) {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t i = 0; i < objectCount; ++i)
+            memcpy(&perDrawUpload[i * perDrawConstantsSize_], &matrices[i * 16], 16 * sizeof(float));
+
+        if (frame > 0)
+            perDrawSeconds += std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    result.batches = static_cast<uint32_t>(batcher.batches().size());
+    result.buildSeconds = buildSeconds / frames;
+    result.perDrawSeconds = perDrawSeconds / frames;
+    result.instanceBytes = objectCount * sizeof(InstanceData);
+    result.perDrawBytes = objectCount * perDrawConstantsSize_;
+
+    // every object once, in the batch of its mesh and material, in key
+    // order and in the order it was added among equal keys
+    std::vector<bool> seen(objectCount, false);
+    uint32_t instanceCount = 0;
+    uint32_t lastObject = 0;
+
+    for (const InstanceBatch& batch : batcher.batches()) {
+        if (batch.firstInstance != instanceCount)
+            result.mismatches++;
+
+        for (uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount && i < objectCount; ++i) {
+            const InstanceData& instance = instanceUpload[i];
+            const uint32_t object = static_cast<uint32_t>(instance.worldViewProjection[0]);
+
+            const bool ordered = i == 0 || keys[lastObject] < keys[object] || (keys[lastObject] == keys[object] && lastObject < object);
+            if (object >= objectCount || seen[object] || !ordered
+                || meshes[object] != batch.mesh || materials[object] != batch.material || instance.materialIndex != batch.material
+                || memcmp(instance.worldViewProjection, &matrices[object * 16], sizeof(instance.worldViewProjection)) != 0) {
+                result.mismatches++;
+                continue;
+            }
+
+            seen[object] = true;
+            lastObject = object;
+        }
+
+        instanceCount += batch.instanceCount;
+    }
+
+    if (instanceCount != objectCount)
+        result.mismatches++;
+
+    return result;
+}
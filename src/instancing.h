@@ -0,0 +1,88 @@
+#if !defined(INSTANCING_H)
+#define INSTANCING_H
+
+#include "draw_sort.h"
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// Groups the draws of a frame into instanced draws. Draws are added one by
+// one with their sort key, mesh, material and matrix, build() then sorts
+// them by key and turns runs of the same state into batches whose
+// instances are contiguous, so the instance data is written to the GPU in
+// one sequential pass and every batch is a single DrawIndexedInstanced.
+
+// what the vertex shader reads per instance, the layout of the structured
+// buffer the instances are uploaded to. 68 bytes.
+struct InstanceData
+{
+    float worldViewProjection[16]; // already transposed for the GPU
+    uint32_t materialIndex;
+};
+
+struct InstanceBatch
+{
+    uint32_t mesh;
+    uint32_t material;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+};
+
+class InstanceBatcher
+{
+public:
+    void clear();
+    void add(uint64_t sortKey, uint32_t mesh, uint32_t material, const float* worldViewProjection);
+
+    // batches and their instances are in key order, draws with equal keys
+    // in the order they were added. Opaque draws of the same state end up
+    // in one batch, transparent ones only where no other state sits
+    // between them back to front. jobs may be null.
+    void build(JobSystem* jobs);
+
+    uint32_t drawCount() const { return static_cast<uint32_t>(added_.size()); }
+
+    // valid after build()
+    const std::vector<InstanceBatch>& batches() const { return batches_; }
+
+    // writes the first count instances in batch order, front to back so it
+    // suits write combined upload memory
+    void writeInstances(InstanceData* destination, uint32_t count) const;
+
+private:
+    struct Draw
+    {
+        uint32_t mesh;
+        uint32_t material;
+    };
+
+    std::vector<InstanceData> added_;
+    std::vector<Draw> draws_;
+
+    // sorted by build(), keys along with the draws they belong to
+    std::vector<uint64_t> keys_;
+    std::vector<uint32_t> drawOfInstance_;
+    RadixSorter sorter_;
+
+    std::vector<InstanceBatch> batches_;
+};
+
+struct InstancingBenchmark
+{
+    uint32_t objects;
+    uint32_t batches;        // draw calls left after grouping
+    double buildSeconds;     // per frame, adding the draws and grouping them
+    double perDrawSeconds;   // per frame, packing every draw into its own 256 byte constant buffer,
+                             // without the calls that bind it for every draw
+    uint64_t instanceBytes;  // uploaded per frame when instanced
+    uint64_t perDrawBytes;   // uploaded per frame with a constant buffer per draw
+    uint32_t mismatches;     // instances that ended up in the wrong batch or with the wrong data
+};
+
+// objectCount opaque draws spread randomly over meshCount meshes,
+// materialCount materials and the depth range, grouped every frame
+InstancingBenchmark measureInstancing(uint32_t objectCount, uint32_t meshCount, uint32_t materialCount, uint32_t frames);
+
+#endif // INSTANCING_H
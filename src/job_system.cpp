@@ -0,0 +1,373 @@
+#include "job_system.h"
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+
+// index of the worker running on this thread in the system it belongs to
+static thread_local const JobSystem* currentSystem_ = nullptr;
+static thread_local uint32_t currentWorker_ = JobSystem::ExternalThread;
+
+JobDeque::JobDeque()
+    : top_(0)
+    , bottom_(0)
+{
+    for (int64_t i = 0; i < capacity; ++i)
+        jobs_[i].store(nullptr, std::memory_order_relaxed);
+}
+
+bool JobDeque::push(Job* job)
+{
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    const int64_t top = top_.load(std::memory_order_acquire);
+    if (bottom - top >= capacity)
+        return false;
+
+    jobs_[bottom & (capacity - 1)].store(job, std::memory_order_relaxed);
+    bottom_.store(bottom + 1, std::memory_order_release);
+
+    return true;
+}
+
+Job* JobDeque::pop()
+{
+    // take the bottom slot first, then see whether a thief got there too
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(bottom, std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_seq_cst);
+
+    if (top > bottom) {
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = jobs_[bottom & (capacity - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // last job, race the thieves for it
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+Job* JobDeque::steal()
+{
+    int64_t top = top_.load(std::memory_order_seq_cst);
+    const int64_t bottom = bottom_.load(std::memory_order_seq_cst);
+    if (top >= bottom)
+        return nullptr;
+
+    Job* job = jobs_[top & (capacity - 1)].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+
+    return job;
+}
+
+bool JobDeque::isEmpty() const
+{
+    return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+}
+
+JobSystem::JobSystem()
+    : sharedCount_(0)
+    , queuedJobs_(0)
+    , sleepers_(0)
+    , stopping_(false)
+{
+}
+
+JobSystem::~JobSystem()
+{
+    stop();
+}
+
+void JobSystem::start(uint32_t threadCount)
+{
+    stop();
+
+    stopping_ = false;
+
+    for (uint32_t i = 0; i < threadCount + 1; ++i)
+        deques_.push_back(new JobDeque);
+
+    currentSystem_ = this;
+    currentWorker_ = 0;
+
+    for (uint32_t i = 0; i < threadCount; ++i)
+        threads_.emplace_back(&JobSystem::workerThread, this, i + 1);
+}
+
+void JobSystem::stop()
+{
+    if (deques_.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+
+    for (std::thread& thread : threads_)
+        thread.join();
+    threads_.clear();
+
+    // whatever is still queued never ran, nobody waits for it anymore
+    for (JobDeque* deque : deques_) {
+        while (Job* job = deque->pop())
+            delete job;
+        delete deque;
+    }
+    deques_.clear();
+
+    for (Job* job : sharedJobs_)
+        delete job;
+    sharedJobs_.clear();
+    sharedCount_ = 0;
+    queuedJobs_ = 0;
+
+    if (currentSystem_ == this) {
+        currentSystem_ = nullptr;
+        currentWorker_ = ExternalThread;
+    }
+}
+
+uint32_t JobSystem::currentWorker() const
+{
+    return currentSystem_ == this ? currentWorker_ : ExternalThread;
+}
+
+void JobSystem::run(std::function<void()> work, JobCounter* counter)
+{
+    if (counter)
+        counter->value_.fetch_add(1, std::memory_order_relaxed);
+
+    Job* job = new Job;
+    job->work = std::move(work);
+    job->counter = counter;
+
+    submit(job);
+}
+
+void JobSystem::runAfter(JobCounter& dependency, std::function<void()> work, JobCounter* counter)
+{
+    if (counter)
+        counter->value_.fetch_add(1, std::memory_order_relaxed);
+
+    Job* job = new Job;
+    job->work = std::move(work);
+    job->counter = counter;
+
+    {
+        std::lock_guard<std::mutex> lock(dependency.mutex_);
+        if (dependency.value_.load(std::memory_order_acquire) != 0) {
+            dependency.continuations_.push_back(job);
+            return;
+        }
+    }
+
+    submit(job);
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+    const uint32_t worker = currentWorker();
+
+    while (!counter.isDone()) {
+        Job* job = findJob(worker);
+        if (job)
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+
+    // the last job may still hold the lock, the counter must outlive it
+    std::lock_guard<std::mutex> lock(counter.mutex_);
+}
+
+void JobSystem::parallelFor(uint32_t begin, uint32_t end, uint32_t minGrain, const std::function<void(uint32_t, uint32_t)>& body)
+{
+    if (begin >= end)
+        return;
+
+    const uint32_t grain = std::max(minGrain, 1u);
+    if ((end - begin) / 2 < grain || deques_.empty()) {
+        body(begin, end);
+        return;
+    }
+
+    JobCounter counter;
+    splitFor(begin, end, grain, body, counter);
+    wait(counter);
+}
+
+void JobSystem::splitFor(uint32_t begin, uint32_t end, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& body, JobCounter& counter)
+{
+    // lazy splitting: work through the range a grain at a time and only hand
+    // the upper half of what is left out as a job when there is nothing
+    // queued for thieves to take. An empty deque means the last half was
+    // stolen, so the range is split as finely as the idle workers ask for and
+    // costs a handful of jobs when nobody is idle.
+    const uint32_t worker = currentWorker();
+    while ((end - begin) / 2 >= grain) {
+        const bool ranDry = worker == ExternalThread ? sharedCount_.load(std::memory_order_relaxed) == 0 : deques_[worker]->isEmpty();
+        if (ranDry) {
+            const uint32_t middle = begin + (end - begin) / 2;
+            const uint32_t upperEnd = end;
+            run([this, middle, upperEnd, grain, &body, &counter]() { splitFor(middle, upperEnd, grain, body, counter); }, &counter);
+            end = middle;
+            continue;
+        }
+
+        body(begin, begin + grain);
+        begin += grain;
+    }
+
+    body(begin, end);
+}
+
+void JobSystem::submit(Job* job)
+{
+    const uint32_t worker = currentWorker();
+
+    if (worker == ExternalThread || !deques_[worker]->push(job)) {
+        if (worker != ExternalThread) {
+            // deque is full, running it right away keeps things moving
+            execute(job);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(sharedMutex_);
+        sharedJobs_.push_back(job);
+        sharedCount_.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    queuedJobs_.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        wake_.notify_one();
+    }
+}
+
+Job* JobSystem::findJob(uint32_t worker)
+{
+    Job* job = nullptr;
+
+    if (worker != ExternalThread)
+        job = deques_[worker]->pop();
+
+    if (!job && sharedCount_.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(sharedMutex_);
+        if (!sharedJobs_.empty()) {
+            job = sharedJobs_.back();
+            sharedJobs_.pop_back();
+            sharedCount_.fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+
+    // steal, starting after our own deque so thieves spread out
+    const uint32_t count = workerCount();
+    const uint32_t first = worker != ExternalThread ? worker + 1 : 0;
+    for (uint32_t i = 0; !job && i < count; ++i) {
+        const uint32_t victim = (first + i) % count;
+        if (victim != worker)
+            job = deques_[victim]->steal();
+    }
+
+    if (job)
+        queuedJobs_.fetch_sub(1, std::memory_order_seq_cst);
+
+    return job;
+}
+
+void JobSystem::execute(Job* job)
+{
+    job->work();
+
+    if (job->counter)
+        finish(*job->counter);
+
+    delete job;
+}
+
+void JobSystem::finish(JobCounter& counter)
+{
+    // only the last job takes the lock, continuations are released under it
+    uint32_t value = counter.value_.load(std::memory_order_relaxed);
+    while (value > 1) {
+        if (counter.value_.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+            return;
+    }
+
+    std::vector<Job*> continuations;
+    {
+        std::lock_guard<std::mutex> lock(counter.mutex_);
+        if (counter.value_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        continuations.swap(counter.continuations_);
+    }
+
+    for (Job* continuation : continuations)
+        submit(continuation);
+}
+
+void JobSystem::workerThread(uint32_t worker)
+{
+    currentSystem_ = this;
+    currentWorker_ = worker;
+
+    PROFILE_THREAD(("JobWorker" + std::to_string(worker)).c_str());
+
+    while (!stopping_.load(std::memory_order_acquire)) {
+        Job* job = findJob(worker);
+        if (job) {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        wake_.wait(lock, [&] { return queuedJobs_.load(std::memory_order_seq_cst) > 0 || stopping_.load(std::memory_order_acquire); });
+        sleepers_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+}
+
+JobBenchmark measureParallelFor(uint32_t threadCount, uint32_t itemCount, uint32_t minGrain)
+{
+    JobBenchmark result = {};
+    result.threads = threadCount + 1;
+
+    std::vector<float> values(itemCount);
+    std::vector<uint32_t> visits(itemCount);
+
+    JobSystem jobs;
+    jobs.start(threadCount);
+
+    typedef std::chrono::duration<double> Seconds;
+    const auto start = std::chrono::steady_clock::now();
+
+    jobs.parallelFor(0, itemCount, minGrain, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            float x = static_cast<float>(i);
+            for (int k = 0; k < 64; ++k)
+                x = std::sqrt(x * 1.0001f + 1.0f);
+            values[i] = x;
+            visits[i]++;
+        }
+    });
+
+    result.seconds = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+
+    jobs.stop();
+
+    for (uint32_t visit : visits)
+        result.mismatches += visit != 1;
+
+    return result;
+}
@@ -0,0 +1,140 @@
+#if !defined(JOB_SYSTEM_H)
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing job system. Every worker owns a Chase-Lev deque, it pushes
+// and pops at the bottom while idle workers steal from the top. Threads
+// that are not workers submit through a shared queue. Waiting on a counter
+// runs jobs instead of blocking, so the thread that waits helps out.
+
+class JobSystem;
+
+struct Job;
+
+// counts unfinished jobs, jobs queued with runAfter() start once it hits 0
+class JobCounter
+{
+public:
+    JobCounter()
+        : value_(0)
+    {
+    }
+
+    bool isDone() const { return value_.load(std::memory_order_acquire) == 0; }
+
+private:
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    friend class JobSystem;
+
+    std::atomic<uint32_t> value_;
+    std::mutex mutex_;
+    std::vector<Job*> continuations_;
+};
+
+struct Job
+{
+    std::function<void()> work;
+    JobCounter* counter;
+};
+
+// single owner deque, the owner pushes and pops at the bottom, any thread
+// steals from the top. Capacity is fixed, push fails when it is full.
+class JobDeque
+{
+public:
+    JobDeque();
+
+    bool push(Job* job);
+    Job* pop();
+    Job* steal();
+
+    bool isEmpty() const;
+
+private:
+    static const int64_t capacity = 4096;
+
+    std::atomic<int64_t> top_;
+    std::atomic<int64_t> bottom_;
+    std::atomic<Job*> jobs_[capacity];
+};
+
+class JobSystem
+{
+public:
+    // currentWorker() of threads that are not workers
+    static const uint32_t ExternalThread = 0xffffffff;
+
+    JobSystem();
+    ~JobSystem();
+
+    // the calling thread becomes worker 0, threadCount more threads are
+    // started. Worker 0 only runs jobs while it waits.
+    void start(uint32_t threadCount);
+    void stop();
+
+    uint32_t workerCount() const { return static_cast<uint32_t>(deques_.size()); }
+    uint32_t currentWorker() const;
+
+    // counter may be null
+    void run(std::function<void()> work, JobCounter* counter);
+
+    // queues work once dependency reached 0
+    void runAfter(JobCounter& dependency, std::function<void()> work, JobCounter* counter);
+
+    // runs other jobs until counter reached 0, a counter jobs were queued
+    // against must not be destroyed before wait() returned
+    void wait(JobCounter& counter);
+
+    // calls body with subranges of [begin, end) of minGrain to 2 * minGrain
+    // items, or the whole range if it is smaller. The range is split while it
+    // runs: pieces are only handed out as jobs once the previous ones were
+    // stolen, so idle workers get work and busy ones are not flooded with it.
+    void parallelFor(uint32_t begin, uint32_t end, uint32_t minGrain, const std::function<void(uint32_t, uint32_t)>& body);
+
+private:
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void submit(Job* job);
+    Job* findJob(uint32_t worker);
+    void execute(Job* job);
+    void finish(JobCounter& counter);
+    void workerThread(uint32_t worker);
+    void splitFor(uint32_t begin, uint32_t end, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& body, JobCounter& counter);
+
+    std::vector<JobDeque*> deques_;
+    std::vector<std::thread> threads_;
+
+    // jobs from threads that are not workers
+    std::mutex sharedMutex_;
+    std::vector<Job*> sharedJobs_;
+    std::atomic<uint32_t> sharedCount_;
+
+    // idle workers sleep until something is queued
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    std::atomic<uint32_t> queuedJobs_;
+    std::atomic<uint32_t> sleepers_;
+    std::atomic<bool> stopping_;
+};
+
+struct JobBenchmark
+{
+    uint32_t threads;
+    double seconds;
+    uint32_t mismatches; // items not processed exactly once, should be 0
+};
+
+// parallelFor over itemCount items of synthetic math work
+JobBenchmark measureParallelFor(uint32_t threadCount, uint32_t itemCount, uint32_t minGrain);
+
+#endif // JOB_SYSTEM_H
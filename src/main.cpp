@@ -1,6 +1,16 @@
 #include "dx.h"
+#include "frame_pacing.h"
+#include "frame_pipeline.h"
+#include "profiler.h"
+#include "render_backend_d3d12.h"
+#include "scene.h"
+
+#include <atomic>
+#include <cstdio>
+#include <vector>
 
 #include <Windows.h>
+#include <mmsystem.h>
 
 // Some utility/helpers
 
@@ -17,10 +27,50 @@ int height_ = 600;
 
 bool isFullscreen_ = false;
 
-bool isRunning_ = true;
+// cleared from the render thread on errors
+std::atomic<bool> isRunning_(true);
+
+// frame pacing, a target frame rate of 0 disables the limiter. The frames
+// in flight are what the backend and the pacer get asked for, dx.cpp keeps
+// the count it actually uses.
+int requestedFramesInFlight_ = 2;
+double targetFrameRate_ = 120.0;
+double statsInterval_ = 1.0;
+
+// fixed simulation rate, rendering interpolates between steps
+double simulationRate_ = 60.0;
+
+// the scene reaches the renderer only through the packets it queues
+Scene scene_;
+D3D12RenderBackend backend_;
+
+// the render thread drains packets while they are built, frames may have
+// more draws than fit
+constexpr uint32_t renderPacketCapacity_ = 16384;
+RenderPacketQueue renderPackets_(renderPacketCapacity_);
+
+// update runs on the window thread, building render packets and recording
+// each get their own thread, so consecutive frames overlap
+FramePipeline framePipeline_;
+double lastFrameTime_ = 0.0;
+double frameInputTimes_[frameSlotCount_];
+
+SteadyPacingClock pacingClock_;
+FramePacer framePacer_(pacingClock_);
+
+// P writes the profiler's trace here, relative to the working directory
+const char* profileTracePath_ = "profile.json";
+
+// C captures the commands of the next frames, dx12_capture_replay reads it
+const char* commandCapturePath_ = "commands.dxcs";
+const uint32_t commandCaptureFrames_ = 60;
 
 // function declarations
 static LRESULT CALLBACK windowProcess(HWND window, UINT message, WPARAM wparam, LPARAM lparam);
+static void configurePacing();
+static void showPacingStats();
+static void startFramePipeline();
+static void exportProfile();
 
 // function definitions
 bool initWindow(HINSTANCE instance, int showWindow, int width, int height, bool fullscreen)
@@ -79,14 +129,36 @@ bool initWindow(HINSTANCE instance, int showWindow, int width, int height, bool
 
 LRESULT windowProcess(HWND window, UINT message, WPARAM wparam, LPARAM lparam)
 {
+    // latency is measured from the first input a frame consumes
+    if ((message >= WM_KEYFIRST && message <= WM_KEYLAST) || (message >= WM_MOUSEFIRST && message <= WM_MOUSELAST))
+        framePacer_.onInput();
+
     switch (message) {
     case WM_KEYDOWN:
     {
-        if (wparam == VK_ESCAPE) {
+        // the window is destroyed once the frame pipeline stopped, the
+        // render thread may still be presenting to it
+        if (wparam == VK_ESCAPE)
             isRunning_ = false;
-            DestroyWindow(window);
+
+        // 1-3 switch the number of frames in flight
+        if (wparam >= '1' && wparam <= '3') {
+            requestedFramesInFlight_ = static_cast<int>(wparam - '0');
+            configurePacing();
         }
 
+        if (wparam == 'P')
+            exportProfile();
+
+        if (wparam == 'C')
+            captureCommands(commandCapturePath_, commandCaptureFrames_);
+
+        return 0;
+    }
+
+    case WM_CLOSE:
+    {
+        isRunning_ = false;
         return 0;
     }
 
@@ -102,20 +174,131 @@ LRESULT windowProcess(HWND window, UINT message, WPARAM wparam, LPARAM lparam)
     return DefWindowProc(window, message, wparam, lparam);
 }
 
+void configurePacing()
+{
+    backend_.setFramesInFlight(static_cast<uint32_t>(requestedFramesInFlight_));
+
+    FramePacerSettings settings = framePacer_.settings();
+    settings.framesInFlight = static_cast<uint32_t>(requestedFramesInFlight_);
+    settings.targetFrameTime = targetFrameRate_ > 0.0 ? 1.0 / targetFrameRate_ : 0.0;
+    framePacer_.configure(settings);
+    framePacer_.resetStats();
+}
+
+void showPacingStats()
+{
+    const FramePacingStats stats = framePacer_.stats();
+    if (stats.frameCount == 0 || stats.averageFrameTime * static_cast<double>(stats.frameCount) < statsInterval_)
+        return;
+
+    char title[256];
+    snprintf(title, sizeof(title), "%s - %.2f ms (jitter %.2f ms), latency %.2f ms, %d frames in flight",
+        windowTitle_,
+        stats.averageFrameTime * 1000.0,
+        stats.frameTimeDeviation * 1000.0,
+        stats.averageLatency * 1000.0,
+        requestedFramesInFlight_);
+    SetWindowText(window_, title);
+
+    framePacer_.resetStats();
+}
+
+void startFramePipeline()
+{
+    framePipeline_.addStage("Update", [](uint64_t frame, uint32_t slot) {
+        UNUSED(frame);
+        PROFILE_ZONE("UpdateStage");
+
+        // input pumped so far is what this frame consumes
+        frameInputTimes_[slot] = framePacer_.beginFrame();
+
+        const double frameTime = pacingClock_.now();
+        scene_.update(frameTime - lastFrameTime_, slot);
+        lastFrameTime_ = frameTime;
+    });
+
+    framePipeline_.addStage("BuildRenderPackets", [](uint64_t frame, uint32_t slot) {
+        UNUSED(frame);
+        PROFILE_ZONE("BuildRenderPacketsStage");
+        scene_.buildRenderPackets(slot, renderPackets_);
+    });
+
+    framePipeline_.addStage("Render", [](uint64_t frame, uint32_t slot) {
+        UNUSED(frame);
+        PROFILE_ZONE("RenderStage");
+        if (!backend_.render(renderPackets_, slot))
+            isRunning_ = false;
+        framePacer_.onPresent(frameInputTimes_[slot]);
+    }, StageWithPrevious);
+
+    lastFrameTime_ = pacingClock_.now();
+    framePipeline_.start(frameSlotCount_);
+}
+
+void exportProfile()
+{
+    if (!exportChromeTrace(profileTracePath_)) {
+        OutputDebugString("Writing the profile trace failed\n");
+        return;
+    }
+
+    std::vector<ProfileZoneStats> stats;
+    profileZoneStats(stats);
+
+    char line[256];
+    for (const ProfileZoneStats& zone : stats) {
+        snprintf(line, sizeof(line), "%-32s min %8.3f ms, avg %8.3f ms, p99 %8.3f ms over %u frames\n",
+            zone.name,
+            zone.minTime * 1000.0,
+            zone.averageTime * 1000.0,
+            zone.p99Time * 1000.0,
+            zone.frames);
+        OutputDebugString(line);
+    }
+}
+
 void appMain()
 {
     MSG msg = { 0 };
 
+    PROFILE_THREAD("Main");
+
+    configurePacing();
+    scene_.setSimulationRate(simulationRate_);
+    startFramePipeline();
+
     while (isRunning_) {
-        if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
-        } else {
-            // Run game code
-            update();
-            render();
+        // wait before pumping messages, the input the frame consumes is then
+        // as fresh as possible
+        {
+            PROFILE_ZONE("WaitForNextFrame");
+            framePacer_.waitForNextFrame();
+        }
+
+        {
+            PROFILE_ZONE("PumpMessages");
+            while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+                TranslateMessage(&msg);
+                DispatchMessage(&msg);
+            }
         }
+
+        if (!isRunning_)
+            break;
+
+        // Run game code, waits while every slot is still in use by the
+        // later stages
+        framePipeline_.runFrame();
+
+        // the pipeline overlaps frames, a profiler frame is one run of the
+        // first stage and whatever the others did meanwhile
+        PROFILE_FRAME();
+
+        showPacingStats();
     }
+
+    framePipeline_.stop();
+    DestroyWindow(window_);
 }
 
 void errorCallback()
@@ -138,9 +321,18 @@ int WinMain(HINSTANCE instance, HINSTANCE prevInstance, LPSTR cmdLineArgs, int s
         return 0;
     }
 
+    scene_.reset(static_cast<uint32_t>(width_), static_cast<uint32_t>(height_));
+    scene_.setMaterialIndex(backend_.defaultMaterialIndex());
+
+    // default timer resolution makes the limiter sleeps overshoot by up to
+    // 15ms
+    timeBeginPeriod(1);
+
     isRunning_ = true;
     appMain();
 
+    timeEndPeriod(1);
+
     cleanupd3d();
 
     return 0;
@@ -0,0 +1,492 @@
+#include "matrix_batch.h"
+
+#include "job_system.h"
+#include "profiler.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER)))
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// The widest registers the build allows, with fused multiply add where
+// there is one. MSVC has no macro for FMA, /arch:AVX2 implies it.
+
+struct SseLanes
+{
+    typedef SimdFloat Value;
+    static const uint32_t width = simdWidth;
+
+    static Value load(const float* values) { return simdLoad(values); }
+    static void store(float* values, Value v) { simdStore(values, v); }
+    static Value splat(float value) { return simdSplat(value); }
+    static Value sub(Value a, Value b) { return simdSub(a, b); }
+    static Value mul(Value a, Value b) { return simdMul(a, b); }
+    static Value div(Value a, Value b) { return simdDiv(a, b); }
+    static Value mulAdd(Value a, Value b, Value c) { return simdMulAdd(a, b, c); }
+    static Value mulSub(Value a, Value b, Value c) { return simdSub(simdMul(a, b), c); }
+};
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+struct Avx2Lanes
+{
+    typedef __m256 Value;
+    static const uint32_t width = 8;
+
+    static Value load(const float* values) { return _mm256_loadu_ps(values); }
+    static void store(float* values, Value v) { _mm256_storeu_ps(values, v); }
+    static Value splat(float value) { return _mm256_set1_ps(value); }
+    static Value sub(Value a, Value b) { return _mm256_sub_ps(a, b); }
+    static Value mul(Value a, Value b) { return _mm256_mul_ps(a, b); }
+    static Value div(Value a, Value b) { return _mm256_div_ps(a, b); }
+    static Value mulAdd(Value a, Value b, Value c) { return _mm256_fmadd_ps(a, b, c); }
+    static Value mulSub(Value a, Value b, Value c) { return _mm256_fmsub_ps(a, b, c); }
+};
+#endif
+
+#if defined(__AVX512F__)
+struct Avx512Lanes
+{
+    typedef __m512 Value;
+    static const uint32_t width = 16;
+
+    static Value load(const float* values) { return _mm512_loadu_ps(values); }
+    static void store(float* values, Value v) { _mm512_storeu_ps(values, v); }
+    static Value splat(float value) { return _mm512_set1_ps(value); }
+    static Value sub(Value a, Value b) { return _mm512_sub_ps(a, b); }
+    static Value mul(Value a, Value b) { return _mm512_mul_ps(a, b); }
+    static Value div(Value a, Value b) { return _mm512_div_ps(a, b); }
+    static Value mulAdd(Value a, Value b, Value c) { return _mm512_fmadd_ps(a, b, c); }
+    static Value mulSub(Value a, Value b, Value c) { return _mm512_fmsub_ps(a, b, c); }
+};
+
+typedef Avx512Lanes MatrixLanes;
+#elif defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+typedef Avx2Lanes MatrixLanes;
+#else
+typedef SseLanes MatrixLanes;
+#endif
+
+typedef MatrixLanes::Value Lanes;
+
+} // namespace
+
+// matrices per block whatever the build, the widest there is
+static const uint32_t blockSize_ = 16;
+static const uint32_t blockFloats_ = 16 * blockSize_;
+
+// batches smaller than this are not worth splitting across workers
+static const uint32_t minMatricesPerJob_ = 4096;
+
+static const Float4x4 identity_ = { { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } } };
+
+// where element 0 of a matrix is, the others follow blockSize_ apart
+static uint32_t matrixOffset(uint32_t index)
+{
+    return index / blockSize_ * blockFloats_ + index % blockSize_;
+}
+
+MatrixBatch::MatrixBatch()
+    : count_(0)
+{
+}
+
+void MatrixBatch::resize(uint32_t count)
+{
+    const uint32_t blocks = (count + blockSize_ - 1) / blockSize_;
+    values_.resize(blocks * blockFloats_);
+
+    // the padding is identity as well, kernels run over it and the inverse
+    // of zero would be infinite
+    for (uint32_t index = std::min(count_, count); index < blocks * blockSize_; ++index)
+        set(index, identity_);
+
+    count_ = count;
+}
+
+void MatrixBatch::set(uint32_t index, const Float4x4& matrix)
+{
+    float* values = &values_[matrixOffset(index)];
+    for (uint32_t i = 0; i < 16; ++i)
+        values[i * blockSize_] = matrix.m[i / 4][i % 4];
+}
+
+Float4x4 MatrixBatch::get(uint32_t index) const
+{
+    const float* values = &values_[matrixOffset(index)];
+
+    Float4x4 result;
+    for (uint32_t i = 0; i < 16; ++i)
+        result.m[i / 4][i % 4] = values[i * blockSize_];
+    return result;
+}
+
+void MatrixBatch::load(const Float4x4* matrices, uint32_t count)
+{
+    PROFILE_FUNCTION();
+
+    resize(count);
+
+    // a row of four matrices transposed into one element per vector
+    uint32_t first = 0;
+    for (; first + simdWidth <= count; first += simdWidth) {
+        float* values = &values_[matrixOffset(first)];
+
+        for (uint32_t row = 0; row < 4; ++row) {
+            SimdFloat rows[simdWidth] = {
+                simdLoad(matrices[first + 0].m[row]), simdLoad(matrices[first + 1].m[row]),
+                simdLoad(matrices[first + 2].m[row]), simdLoad(matrices[first + 3].m[row]),
+            };
+            simdTranspose(rows[0], rows[1], rows[2], rows[3]);
+
+            for (uint32_t column = 0; column < 4; ++column)
+                simdStore(values + (row * 4 + column) * blockSize_, rows[column]);
+        }
+    }
+
+    for (; first < count; ++first)
+        set(first, matrices[first]);
+}
+
+void MatrixBatch::store(Float4x4* matrices, bool transpose) const
+{
+    PROFILE_FUNCTION();
+
+    // the way back, a row or a column of four matrices at a time
+    uint32_t first = 0;
+    for (; first + simdWidth <= count_; first += simdWidth) {
+        const float* values = &values_[matrixOffset(first)];
+
+        for (uint32_t row = 0; row < 4; ++row) {
+            SimdFloat elements[simdWidth];
+            for (uint32_t i = 0; i < 4; ++i)
+                elements[i] = simdLoad(values + (transpose ? i * 4 + row : row * 4 + i) * blockSize_);
+            simdTranspose(elements[0], elements[1], elements[2], elements[3]);
+
+            for (uint32_t lane = 0; lane < simdWidth; ++lane)
+                simdStore(matrices[first + lane].m[row], elements[lane]);
+        }
+    }
+
+    for (; first < count_; ++first)
+        matrices[first] = transpose ? matrixTranspose(get(first)) : get(first);
+}
+
+uint32_t matrixBatchWidth()
+{
+    return MatrixLanes::width;
+}
+
+// calls body with ranges of whole blocks, they may run into the padding
+template <typename Body>
+static void forEachBlock(uint32_t count, JobSystem* jobs, const Body& body)
+{
+    const uint32_t blocks = (count + blockSize_ - 1) / blockSize_;
+
+    if (jobs && count >= 2 * minMatricesPerJob_)
+        jobs->parallelFor(0, blocks, minMatricesPerJob_ / blockSize_, body);
+    else
+        body(0, blocks);
+}
+
+// Kernels get the start of a group of MatrixLanes::width matrices in a block, its
+// elements are blockSize_ apart. Every input element is loaded before the
+// element or row of the result that overwrites it is stored, so results
+// may alias inputs.
+
+template <typename Kernel>
+static void forEachGroup(uint32_t begin, uint32_t end, const Kernel& kernel)
+{
+    for (uint32_t block = begin; block < end; ++block) {
+        for (uint32_t lane = 0; lane < blockSize_; lane += MatrixLanes::width)
+            kernel(block * blockFloats_ + lane);
+    }
+}
+
+static void multiplyBlocks(const float* a, const float* b, float* result, uint32_t begin, uint32_t end)
+{
+    forEachGroup(begin, end, [a, b, result](uint32_t offset) {
+        Lanes right[16];
+        for (uint32_t i = 0; i < 16; ++i)
+            right[i] = MatrixLanes::load(b + offset + i * blockSize_);
+
+        for (uint32_t row = 0; row < 4; ++row) {
+            const float* left = a + offset + row * 4 * blockSize_;
+            const Lanes left0 = MatrixLanes::load(left);
+            const Lanes left1 = MatrixLanes::load(left + blockSize_);
+            const Lanes left2 = MatrixLanes::load(left + 2 * blockSize_);
+            const Lanes left3 = MatrixLanes::load(left + 3 * blockSize_);
+
+            for (uint32_t column = 0; column < 4; ++column) {
+                Lanes value = MatrixLanes::mul(left3, right[12 + column]);
+                value = MatrixLanes::mulAdd(left2, right[8 + column], value);
+                value = MatrixLanes::mulAdd(left1, right[4 + column], value);
+                value = MatrixLanes::mulAdd(left0, right[column], value);
+                MatrixLanes::store(result + offset + (row * 4 + column) * blockSize_, value);
+            }
+        }
+    });
+}
+
+static void multiplySharedBlocks(const float* a, const Float4x4& b, float* result, uint32_t begin, uint32_t end)
+{
+    Lanes right[16];
+    for (uint32_t i = 0; i < 16; ++i)
+        right[i] = MatrixLanes::splat(b.m[i / 4][i % 4]);
+
+    forEachGroup(begin, end, [a, &right, result](uint32_t offset) {
+        for (uint32_t row = 0; row < 4; ++row) {
+            const float* left = a + offset + row * 4 * blockSize_;
+            const Lanes left0 = MatrixLanes::load(left);
+            const Lanes left1 = MatrixLanes::load(left + blockSize_);
+            const Lanes left2 = MatrixLanes::load(left + 2 * blockSize_);
+            const Lanes left3 = MatrixLanes::load(left + 3 * blockSize_);
+
+            for (uint32_t column = 0; column < 4; ++column) {
+                Lanes value = MatrixLanes::mul(left3, right[12 + column]);
+                value = MatrixLanes::mulAdd(left2, right[8 + column], value);
+                value = MatrixLanes::mulAdd(left1, right[4 + column], value);
+                value = MatrixLanes::mulAdd(left0, right[column], value);
+                MatrixLanes::store(result + offset + (row * 4 + column) * blockSize_, value);
+            }
+        }
+    });
+}
+
+static void transposeBlocks(const float* a, float* result, uint32_t begin, uint32_t end)
+{
+    forEachGroup(begin, end, [a, result](uint32_t offset) {
+        Lanes elements[16];
+        for (uint32_t i = 0; i < 16; ++i)
+            elements[i] = MatrixLanes::load(a + offset + i * blockSize_);
+
+        for (uint32_t row = 0; row < 4; ++row) {
+            for (uint32_t column = 0; column < 4; ++column)
+                MatrixLanes::store(result + offset + (column * 4 + row) * blockSize_, elements[row * 4 + column]);
+        }
+    });
+}
+
+static void inverseAffineBlocks(const float* a, float* result, uint32_t begin, uint32_t end)
+{
+    const Lanes zero = MatrixLanes::splat(0.0f);
+    const Lanes one = MatrixLanes::splat(1.0f);
+
+    forEachGroup(begin, end, [a, result, zero, one](uint32_t offset) {
+        auto load = [a, offset](uint32_t element) { return MatrixLanes::load(a + offset + element * blockSize_); };
+        auto store = [result, offset](uint32_t element, Lanes value) { MatrixLanes::store(result + offset + element * blockSize_, value); };
+
+        const Lanes m00 = load(0), m01 = load(1), m02 = load(2);
+        const Lanes m10 = load(4), m11 = load(5), m12 = load(6);
+        const Lanes m20 = load(8), m21 = load(9), m22 = load(10);
+        const Lanes t0 = load(12), t1 = load(13), t2 = load(14);
+
+        // the adjugate of the upper 3x3 over its determinant, as
+        // matrixInverseAffine() does it
+        const Lanes c00 = MatrixLanes::mulSub(m11, m22, MatrixLanes::mul(m12, m21));
+        const Lanes c01 = MatrixLanes::mulSub(m02, m21, MatrixLanes::mul(m01, m22));
+        const Lanes c02 = MatrixLanes::mulSub(m01, m12, MatrixLanes::mul(m02, m11));
+        const Lanes c10 = MatrixLanes::mulSub(m12, m20, MatrixLanes::mul(m10, m22));
+        const Lanes c11 = MatrixLanes::mulSub(m00, m22, MatrixLanes::mul(m02, m20));
+        const Lanes c12 = MatrixLanes::mulSub(m02, m10, MatrixLanes::mul(m00, m12));
+        const Lanes c20 = MatrixLanes::mulSub(m10, m21, MatrixLanes::mul(m11, m20));
+        const Lanes c21 = MatrixLanes::mulSub(m01, m20, MatrixLanes::mul(m00, m21));
+        const Lanes c22 = MatrixLanes::mulSub(m00, m11, MatrixLanes::mul(m01, m10));
+
+        const Lanes determinant = MatrixLanes::mulAdd(m00, c00, MatrixLanes::mulAdd(m01, c10, MatrixLanes::mul(m02, c20)));
+        const Lanes inverseDeterminant = MatrixLanes::div(one, determinant);
+
+        const Lanes i00 = MatrixLanes::mul(c00, inverseDeterminant), i01 = MatrixLanes::mul(c01, inverseDeterminant), i02 = MatrixLanes::mul(c02, inverseDeterminant);
+        const Lanes i10 = MatrixLanes::mul(c10, inverseDeterminant), i11 = MatrixLanes::mul(c11, inverseDeterminant), i12 = MatrixLanes::mul(c12, inverseDeterminant);
+        const Lanes i20 = MatrixLanes::mul(c20, inverseDeterminant), i21 = MatrixLanes::mul(c21, inverseDeterminant), i22 = MatrixLanes::mul(c22, inverseDeterminant);
+
+        store(0, i00);
+        store(1, i01);
+        store(2, i02);
+        store(3, zero);
+        store(4, i10);
+        store(5, i11);
+        store(6, i12);
+        store(7, zero);
+        store(8, i20);
+        store(9, i21);
+        store(10, i22);
+        store(11, zero);
+
+        // the translation undone in the rotated frame
+        store(12, MatrixLanes::sub(zero, MatrixLanes::mulAdd(t0, i00, MatrixLanes::mulAdd(t1, i10, MatrixLanes::mul(t2, i20)))));
+        store(13, MatrixLanes::sub(zero, MatrixLanes::mulAdd(t0, i01, MatrixLanes::mulAdd(t1, i11, MatrixLanes::mul(t2, i21)))));
+        store(14, MatrixLanes::sub(zero, MatrixLanes::mulAdd(t0, i02, MatrixLanes::mulAdd(t1, i12, MatrixLanes::mul(t2, i22)))));
+        store(15, one);
+    });
+}
+
+void batchMultiply(const MatrixBatch& a, const MatrixBatch& b, MatrixBatch& result, JobSystem* jobs)
+{
+    PROFILE_FUNCTION();
+
+    result.resize(a.count());
+
+    const float* left = a.data();
+    const float* right = b.data();
+    float* target = result.data();
+
+    forEachBlock(a.count(), jobs, [left, right, target](uint32_t begin, uint32_t end) {
+        multiplyBlocks(left, right, target, begin, end);
+    });
+}
+
+void batchMultiply(const MatrixBatch& a, const Float4x4& b, MatrixBatch& result, JobSystem* jobs)
+{
+    PROFILE_FUNCTION();
+
+    result.resize(a.count());
+
+    const float* left = a.data();
+    float* target = result.data();
+
+    forEachBlock(a.count(), jobs, [left, &b, target](uint32_t begin, uint32_t end) {
+        multiplySharedBlocks(left, b, target, begin, end);
+    });
+}
+
+void batchTranspose(const MatrixBatch& a, MatrixBatch& result, JobSystem* jobs)
+{
+    PROFILE_FUNCTION();
+
+    result.resize(a.count());
+
+    const float* source = a.data();
+    float* target = result.data();
+
+    forEachBlock(a.count(), jobs, [source, target](uint32_t begin, uint32_t end) {
+        transposeBlocks(source, target, begin, end);
+    });
+}
+
+void batchInverseAffine(const MatrixBatch& a, MatrixBatch& result, JobSystem* jobs)
+{
+    PROFILE_FUNCTION();
+
+    result.resize(a.count());
+
+    const float* source = a.data();
+    float* target = result.data();
+
+    forEachBlock(a.count(), jobs, [source, target](uint32_t begin, uint32_t end) {
+        inverseAffineBlocks(source, target, begin, end);
+    });
+}
+
+// difference relative to the size of the element, at least 1
+static float maxDifference(const MatrixBatch& batch, const std::vector<Float4x4>& matrices)
+{
+    float result = 0.0f;
+    for (uint32_t i = 0; i < batch.count(); ++i) {
+        const Float4x4 matrix = batch.get(i);
+        for (uint32_t row = 0; row < 4; ++row) {
+            for (uint32_t column = 0; column < 4; ++column) {
+                const float expected = matrices[i].m[row][column];
+                result = std::max(result, std::fabs(matrix.m[row][column] - expected) / std::max(1.0f, std::fabs(expected)));
+            }
+        }
+    }
+    return result;
+}
+
+MatrixBatchBenchmark measureMatrixBatch(uint32_t matrixCount, uint32_t iterations)
+{
+    MatrixBatchBenchmark result = {};
+    result.matrices = matrixCount;
+    result.width = MatrixLanes::width;
+    if (matrixCount == 0 || iterations == 0)
+        return result;
+
+    // fixed seed lcg, every run uses the same matrices
+    uint32_t seed = 0x12345678;
+    auto random = [&seed](float low, float high) {
+        seed = seed * 1664525u + 1013904223u;
+        return low + (high - low) * static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+    };
+
+    // objects scattered over a city block, scaled, turned any way
+    auto randomAffine = [&random]() {
+        Float4x4 matrix = matrixRotationQuaternion(quaternionNormalize({ random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f) }));
+        const float scale[] = { random(0.5f, 2.0f), random(0.5f, 2.0f), random(0.5f, 2.0f) };
+        for (uint32_t row = 0; row < 3; ++row) {
+            for (uint32_t column = 0; column < 3; ++column)
+                matrix.m[row][column] *= scale[row];
+        }
+        matrix.m[3][0] = random(-100.0f, 100.0f);
+        matrix.m[3][1] = random(-10.0f, 10.0f);
+        matrix.m[3][2] = random(-100.0f, 100.0f);
+        return matrix;
+    };
+
+    std::vector<Float4x4> a(matrixCount);
+    std::vector<Float4x4> b(matrixCount);
+    for (uint32_t i = 0; i < matrixCount; ++i) {
+        a[i] = randomAffine();
+        b[i] = randomAffine();
+    }
+
+    const Float3 eye = { 0.0f, 20.0f, -150.0f };
+    const Float3 target = { 0.0f, 0.0f, 0.0f };
+    const Float3 up = { 0.0f, 1.0f, 0.0f };
+    const Float4x4 viewProjection = matrixMultiply(matrixLookAtLH(eye, target, up), matrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.1f, 500.0f));
+
+    MatrixBatch batchA;
+    MatrixBatch batchB;
+    MatrixBatch batchResult;
+    batchA.load(a.data(), matrixCount);
+    batchB.load(b.data(), matrixCount);
+    std::vector<Float4x4> scalarResult(matrixCount);
+
+    typedef std::chrono::duration<double> Seconds;
+
+    // times a pass over the batch, the first one is not timed, it faults
+    // the result in
+    auto time = [iterations](const auto& pass) {
+        pass();
+
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t iteration = 0; iteration < iterations; ++iteration)
+            pass();
+        return std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count() / iterations;
+    };
+
+    result.multiplySeconds = time([&batchA, &batchB, &batchResult]() { batchMultiply(batchA, batchB, batchResult, nullptr); });
+    result.scalarMultiplySeconds = time([&a, &b, &scalarResult, matrixCount]() {
+        for (uint32_t i = 0; i < matrixCount; ++i)
+            scalarResult[i] = matrixMultiply(a[i], b[i]);
+    });
+    result.maxError = std::max(result.maxError, maxDifference(batchResult, scalarResult));
+
+    result.viewProjectionSeconds = time([&batchA, &viewProjection, &batchResult]() { batchMultiply(batchA, viewProjection, batchResult, nullptr); });
+    result.scalarViewProjectionSeconds = time([&a, &viewProjection, &scalarResult, matrixCount]() {
+        for (uint32_t i = 0; i < matrixCount; ++i)
+            scalarResult[i] = matrixMultiply(a[i], viewProjection);
+    });
+    result.maxError = std::max(result.maxError, maxDifference(batchResult, scalarResult));
+
+    result.transposeSeconds = time([&batchA, &batchResult]() { batchTranspose(batchA, batchResult, nullptr); });
+    result.scalarTransposeSeconds = time([&a, &scalarResult, matrixCount]() {
+        for (uint32_t i = 0; i < matrixCount; ++i)
+            scalarResult[i] = matrixTranspose(a[i]);
+    });
+    result.maxError = std::max(result.maxError, maxDifference(batchResult, scalarResult));
+
+    result.inverseSeconds = time([&batchA, &batchResult]() { batchInverseAffine(batchA, batchResult, nullptr); });
+    result.scalarInverseSeconds = time([&a, &scalarResult, matrixCount]() {
+        for (uint32_t i = 0; i < matrixCount; ++i)
+            scalarResult[i] = matrixInverseAffine(a[i]);
+    });
+    result.maxError = std::max(result.maxError, maxDifference(batchResult, scalarResult));
+
+    return result;
+}
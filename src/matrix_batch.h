@@ -0,0 +1,82 @@
+#if !defined(MATRIX_BATCH_H)
+#define MATRIX_BATCH_H
+
+#include "scene_math.h"
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// Matrices stored transposed in blocks of 16, a block holds the first
+// element of its 16 matrices, then the second and so on. The kernels below
+// work on as many matrices at once as the build has lanes: 16 with
+// AVX-512, 8 with AVX2 and FMA, 4 with SSE2 or the plain fallback. Unlike
+// an array per element a batch is one stream through memory. DXP_SIMD in
+// CMake picks the instruction set. Same conventions as scene_math, row
+// vectors and row-major matrices.
+//
+// Kernels take a job system to split large batches across workers, it may
+// be null. The result may be one of the inputs.
+
+class MatrixBatch
+{
+public:
+    MatrixBatch();
+
+    // matrices that are added are identity
+    void resize(uint32_t count);
+    uint32_t count() const { return count_; }
+
+    void set(uint32_t index, const Float4x4& matrix);
+    Float4x4 get(uint32_t index) const;
+
+    // one matrix after the other, the way the rest of the renderer keeps
+    // them. store() can transpose them on the way, as the GPU wants them.
+    void load(const Float4x4* matrices, uint32_t count);
+    void store(Float4x4* matrices, bool transpose) const;
+
+    // the blocks, the last one padded with identity
+    float* data() { return values_.data(); }
+    const float* data() const { return values_.data(); }
+
+private:
+    uint32_t count_;
+    std::vector<float> values_;
+};
+
+// lanes the kernels of this build work on
+uint32_t matrixBatchWidth();
+
+// result[i] = a[i] then b[i], the counts have to match
+void batchMultiply(const MatrixBatch& a, const MatrixBatch& b, MatrixBatch& result, JobSystem* jobs);
+
+// result[i] = a[i] then b, e.g. world matrices times the view projection
+void batchMultiply(const MatrixBatch& a, const Float4x4& b, MatrixBatch& result, JobSystem* jobs);
+
+void batchTranspose(const MatrixBatch& a, MatrixBatch& result, JobSystem* jobs);
+
+// the last column is taken to be 0, 0, 0, 1, singular matrices give
+// infinities
+void batchInverseAffine(const MatrixBatch& a, MatrixBatch& result, JobSystem* jobs);
+
+struct MatrixBatchBenchmark
+{
+    uint32_t matrices;
+    uint32_t width;                     // lanes of the kernels
+    double multiplySeconds;             // per pass over every matrix
+    double scalarMultiplySeconds;       // scene_math, one matrix at a time
+    double viewProjectionSeconds;       // times one shared matrix
+    double scalarViewProjectionSeconds;
+    double transposeSeconds;
+    double scalarTransposeSeconds;
+    double inverseSeconds;
+    double scalarInverseSeconds;
+    float maxError;                     // largest difference to the scalar results
+};
+
+// random affine matrices of a scene, run through every kernel iterations
+// times on the calling thread
+MatrixBatchBenchmark measureMatrixBatch(uint32_t matrixCount, uint32_t iterations);
+
+#endif // MATRIX_BATCH_H
@@ -0,0 +1,329 @@
+#include "mesh_lod.h"
+
+#include "frustum_culling.h"
+#include "job_system.h"
+#include "profiler.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+// fewer instances are not worth a job
+static const uint32_t minInstancesPerJob_ = 1024;
+
+// what the benchmark renders at
+static const float benchmarkViewportHeight_ = 1080.0f;
+static const float benchmarkMaxError_ = 1.0f;
+static const float benchmarkHysteresis_ = 0.25f;
+
+// meters per frame the camera walks and shakes back and forth
+static const float benchmarkWalkSpeed_ = 0.05f;
+static const float benchmarkShake_ = 0.1f;
+
+void MeshLodTable::clear()
+{
+    lods_.clear();
+    firstLods_.clear();
+    lodCounts_.clear();
+    errors_.clear();
+}
+
+uint32_t MeshLodTable::addMesh(const MeshLod* lods, uint32_t count)
+{
+    count = std::min(count, maxMeshLods_);
+
+    const uint32_t mesh = meshCount();
+    firstLods_.push_back(static_cast<uint32_t>(lods_.size()));
+    lodCounts_.push_back(count);
+    lods_.insert(lods_.end(), lods, lods + count);
+
+    errors_.resize(errors_.size() + maxMeshLods_, std::numeric_limits<float>::infinity());
+    for (uint32_t level = 0; level < count; ++level)
+        errors_[mesh * maxMeshLods_ + level] = lods[level].error;
+
+    return mesh;
+}
+
+LodSelector::LodSelector()
+    : maxError_(1.0f)
+    , hysteresis_(0.25f)
+{
+}
+
+void LodSelector::resize(uint32_t count)
+{
+    meshes_.resize(count, 0);
+    scales_.resize(count, 1.0f);
+    levels_.resize(count, 0);
+}
+
+void LodSelector::setInstance(uint32_t instance, uint32_t mesh, float scale)
+{
+    meshes_[instance] = mesh;
+    scales_[instance] = scale;
+}
+
+void LodSelector::select(const MeshLodTable& table, const CullingBounds& bounds, const std::vector<uint32_t>& visible,
+    const Float3& eye, const Float4x4& projection, float viewportHeight, JobSystem* jobs)
+{
+    PROFILE_FUNCTION();
+
+    // pixels a unit at a distance of one covers on screen
+    const float pixelsPerUnit = projection.m[1][1] * viewportHeight * 0.5f;
+
+    const uint32_t count = static_cast<uint32_t>(visible.size());
+    const uint32_t groups = (count + simdWidth - 1) / simdWidth;
+
+    if (jobs && count >= 2 * minInstancesPerJob_) {
+        jobs->parallelFor(0, groups, minInstancesPerJob_ / simdWidth, [this, &table, &bounds, &visible, &eye, count, pixelsPerUnit](uint32_t first, uint32_t last) {
+            const uint32_t begin = first * simdWidth;
+            const uint32_t end = std::min(last * simdWidth, count);
+            selectRange(table, bounds, visible.data() + begin, end - begin, eye, pixelsPerUnit);
+        });
+    } else {
+        selectRange(table, bounds, visible.data(), count, eye, pixelsPerUnit);
+    }
+}
+
+void LodSelector::selectRange(const MeshLodTable& table, const CullingBounds& bounds, const uint32_t* visible, uint32_t count,
+    const Float3& eye, float pixelsPerUnit)
+{
+    const SimdFloat one = simdSplat(1.0f);
+
+    // an instance goes coarser to the coarsest level under the strict
+    // limit and finer to the coarsest level under the loose one
+    const SimdFloat strictLimit = simdSplat(maxError_ / (1.0f + hysteresis_));
+    const SimdFloat looseLimit = simdSplat(maxError_ * (1.0f + hysteresis_));
+
+    for (uint32_t first = 0; first < count; first += simdWidth) {
+        const uint32_t lanes = std::min(simdWidth, count - first);
+
+        // lanes past count repeat the last instance
+        uint32_t instances[simdWidth];
+        const float* errors[simdWidth];
+        for (uint32_t lane = 0; lane < simdWidth; ++lane) {
+            instances[lane] = visible[first + std::min(lane, lanes - 1)];
+            errors[lane] = table.errors(meshes_[instances[lane]]);
+        }
+
+        auto gather = [&instances](const float* values) {
+            return simdSet(values[instances[0]], values[instances[1]], values[instances[2]], values[instances[3]]);
+        };
+
+        // from the eye to the nearest point of the bounding sphere, not
+        // positive when the eye is inside it
+        const SimdFloat dx = simdSub(gather(bounds.centers(0)), simdSplat(eye.x));
+        const SimdFloat dy = simdSub(gather(bounds.centers(1)), simdSplat(eye.y));
+        const SimdFloat dz = simdSub(gather(bounds.centers(2)), simdSplat(eye.z));
+        const SimdFloat distance = simdSub(simdSqrt(simdAdd(simdAdd(simdMul(dx, dx), simdMul(dy, dy)), simdMul(dz, dz))), gather(bounds.radii()));
+
+        // a level is under a limit while error * scale * pixelsPerUnit <
+        // limit * distance, which takes no division
+        const SimdFloat errorScale = simdMul(gather(scales_.data()), simdSplat(pixelsPerUnit));
+        const SimdFloat strictReach = simdMul(strictLimit, distance);
+        const SimdFloat looseReach = simdMul(looseLimit, distance);
+
+        // errors grow along a chain, the levels under a limit are the
+        // first ones. The full mesh is always allowed.
+        SimdFloat strict = simdSplat(0.0f);
+        SimdFloat loose = simdSplat(0.0f);
+        for (uint32_t level = 1; level < maxMeshLods_; ++level) {
+            const SimdFloat error = simdMul(simdSet(errors[0][level], errors[1][level], errors[2][level], errors[3][level]), errorScale);
+            const SimdFloat underLoose = simdLess(error, looseReach);
+            if (simdMask(underLoose) == 0)
+                break;
+
+            strict = simdAdd(strict, simdAnd(simdLess(error, strictReach), one));
+            loose = simdAdd(loose, simdAnd(underLoose, one));
+        }
+
+        const SimdFloat previous = simdSet(static_cast<float>(levels_[instances[0]]), static_cast<float>(levels_[instances[1]]),
+            static_cast<float>(levels_[instances[2]]), static_cast<float>(levels_[instances[3]]));
+
+        float selected[simdWidth];
+        simdStore(selected, simdMin(simdMax(previous, strict), loose));
+
+        for (uint32_t lane = 0; lane < lanes; ++lane)
+            levels_[instances[lane]] = static_cast<uint32_t>(selected[lane]);
+    }
+}
+
+// the same choice one instance at a time, what the benchmark compares to
+static uint32_t selectLevel(const float* errors, float scale, const Float3& center, float radius, const Float3& eye,
+    float pixelsPerUnit, float maxError, float hysteresis, uint32_t previous)
+{
+    const float dx = center.x - eye.x;
+    const float dy = center.y - eye.y;
+    const float dz = center.z - eye.z;
+    const float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - radius;
+
+    const float errorScale = scale * pixelsPerUnit;
+    const float strictReach = (maxError / (1.0f + hysteresis)) * distance;
+    const float looseReach = (maxError * (1.0f + hysteresis)) * distance;
+
+    uint32_t strict = 0;
+    uint32_t loose = 0;
+    for (uint32_t level = 1; level < maxMeshLods_; ++level) {
+        const float error = errors[level] * errorScale;
+        if (!(error < looseReach))
+            break;
+
+        strict += error < strictReach ? 1 : 0;
+        loose++;
+    }
+
+    return std::min(std::max(previous, strict), loose);
+}
+
+LodBenchmark measureLodSelection(uint32_t instanceCount, uint32_t meshCount, uint32_t threadCount, uint32_t frames)
+{
+    LodBenchmark result = {};
+    result.instances = instanceCount;
+    result.meshes = meshCount;
+    result.threads = threadCount + 1;
+    result.frames = frames;
+    if (instanceCount == 0 || meshCount == 0 || frames == 0)
+        return result;
+
+    // fixed seed lcg, every run builds the same field
+    uint32_t seed = 0x12345678;
+    auto random = [&seed](float low, float high) {
+        seed = seed * 1664525u + 1013904223u;
+        return low + (high - low) * static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+    };
+
+    // meshes of radius 1, every level has half the triangles and twice the
+    // error of the one before
+    MeshLodTable table;
+    uint32_t firstIndex = 0;
+    for (uint32_t mesh = 0; mesh < meshCount; ++mesh) {
+        MeshLod lods[maxMeshLods_];
+        const uint32_t lodCount = 3 + static_cast<uint32_t>(random(0.0f, 4.0f));
+        uint32_t triangles = static_cast<uint32_t>(random(2000.0f, 20000.0f));
+        float error = random(0.002f, 0.005f);
+
+        for (uint32_t level = 0; level < lodCount; ++level) {
+            lods[level] = { firstIndex, triangles * 3, 0, level == 0 ? 0.0f : error };
+            firstIndex += triangles * 3;
+            triangles /= 2;
+            error *= 2.0f;
+        }
+
+        table.addMesh(lods, lodCount);
+    }
+
+    // scattered over a square a few meters apart
+    const float fieldSize = std::sqrt(static_cast<float>(instanceCount)) * 4.0f;
+    CullingBounds bounds;
+    bounds.resize(instanceCount);
+
+    LodSelector selector;
+    LodSelector popping;
+    selector.resize(instanceCount);
+    popping.resize(instanceCount);
+    selector.setMaxError(benchmarkMaxError_);
+    selector.setHysteresis(benchmarkHysteresis_);
+    popping.setMaxError(benchmarkMaxError_);
+    popping.setHysteresis(0.0f);
+
+    std::vector<uint32_t> meshes(instanceCount);
+    std::vector<float> scales(instanceCount);
+    std::vector<uint32_t> scalarLevels(instanceCount, 0);
+
+    for (uint32_t i = 0; i < instanceCount; ++i) {
+        meshes[i] = std::min(static_cast<uint32_t>(random(0.0f, static_cast<float>(meshCount))), meshCount - 1);
+        scales[i] = random(0.5f, 2.0f);
+
+        const Float3 center = { random(0.0f, fieldSize), scales[i], random(0.0f, fieldSize) };
+        bounds.setSphere(i, center, scales[i]);
+        selector.setInstance(i, meshes[i], scales[i]);
+        popping.setInstance(i, meshes[i], scales[i]);
+    }
+
+    JobSystem jobs;
+    jobs.start(threadCount);
+    JobSystem* selectJobs = threadCount > 0 ? &jobs : nullptr;
+
+    const Float4x4 projection = matrixPerspectiveFovLH(60.0f * (3.14159265f / 180.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    const float pixelsPerUnit = projection.m[1][1] * benchmarkViewportHeight_ * 0.5f;
+    const Float3 up = { 0.0f, 1.0f, 0.0f };
+
+    std::vector<uint32_t> visible;
+    std::vector<uint32_t> before;
+    std::vector<uint32_t> beforePopping;
+
+    typedef std::chrono::duration<double> Seconds;
+
+    double selectSeconds = 0.0;
+    double scalarSeconds = 0.0;
+    uint64_t visibleCount = 0;
+    uint64_t switches = 0;
+    uint64_t switchesNoHysteresis = 0;
+    uint64_t indices = 0;
+    uint64_t fullIndices = 0;
+
+    // the camera walks into the field and shakes back and forth along the
+    // way, which is what makes levels pop. The first frame is not timed,
+    // it faults the memory in.
+    for (uint32_t frame = 0; frame <= frames; ++frame) {
+        const float walk = benchmarkWalkSpeed_ * static_cast<float>(frame);
+        const float shake = (frame & 1) ? benchmarkShake_ : -benchmarkShake_;
+        const Float3 eye = { fieldSize * 0.5f, 1.7f, fieldSize * 0.25f + walk + shake };
+        const Float3 target = { eye.x + 0.3f, eye.y, eye.z + 1.0f };
+        const Float4x4 view = matrixLookAtLH(eye, target, up);
+
+        cullObjects(frustumFromMatrix(matrixMultiply(view, projection)), bounds, CullSpheres, nullptr, visible);
+
+        before.resize(visible.size());
+        beforePopping.resize(visible.size());
+        for (size_t i = 0; i < visible.size(); ++i) {
+            before[i] = selector.level(visible[i]);
+            beforePopping[i] = popping.level(visible[i]);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        selector.select(table, bounds, visible, eye, projection, benchmarkViewportHeight_, selectJobs);
+        if (frame > 0)
+            selectSeconds += std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (uint32_t instance : visible) {
+            const Float3 center = { bounds.centers(0)[instance], bounds.centers(1)[instance], bounds.centers(2)[instance] };
+            scalarLevels[instance] = selectLevel(table.errors(meshes[instance]), scales[instance], center, bounds.radii()[instance], eye,
+                pixelsPerUnit, benchmarkMaxError_, benchmarkHysteresis_, scalarLevels[instance]);
+        }
+        if (frame > 0)
+            scalarSeconds += std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+
+        popping.select(table, bounds, visible, eye, projection, benchmarkViewportHeight_, nullptr);
+
+        if (frame == 0)
+            continue;
+
+        visibleCount += visible.size();
+        for (size_t i = 0; i < visible.size(); ++i) {
+            const uint32_t instance = visible[i];
+            const uint32_t level = selector.level(instance);
+
+            switches += level != before[i] ? 1 : 0;
+            switchesNoHysteresis += popping.level(instance) != beforePopping[i] ? 1 : 0;
+            indices += table.lod(meshes[instance], level).indexCount;
+            fullIndices += table.lod(meshes[instance], 0).indexCount;
+
+            if (level != scalarLevels[instance])
+                result.mismatches++;
+        }
+    }
+
+    jobs.stop();
+
+    result.visible = static_cast<uint32_t>(visibleCount / frames);
+    result.selectSeconds = selectSeconds / frames;
+    result.scalarSeconds = scalarSeconds / frames;
+    result.indexRatio = fullIndices > 0 ? static_cast<double>(indices) / static_cast<double>(fullIndices) : 1.0;
+    result.switches = static_cast<double>(switches) / frames;
+    result.switchesNoHysteresis = static_cast<double>(switchesNoHysteresis) / frames;
+    return result;
+}
@@ -0,0 +1,116 @@
+#if !defined(MESH_LOD_H)
+#define MESH_LOD_H
+
+#include "scene_math.h"
+
+#include <cstdint>
+#include <vector>
+
+class CullingBounds;
+class JobSystem;
+
+// Levels of detail for meshes. A mesh is a chain of index ranges into the
+// index buffer, the full mesh first and coarser ones after it, each with
+// the vertex its indices count from and the geometric error it has against
+// the full mesh in object space. Every frame the visible instances pick the
+// coarsest level whose error, projected to the screen from the bounding
+// sphere's nearest point, stays below a number of pixels.
+//
+// To keep instances near a boundary from popping back and forth, an
+// instance only goes coarser once the coarser level is clearly below the
+// limit and only goes finer once its level is clearly above it, the
+// hysteresis is how far either side of the limit that is.
+
+constexpr uint32_t maxMeshLods_ = 8;
+
+struct MeshLod
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t baseVertex; // added to every index, like the base vertex of a draw
+    float error;        // object space, grows along the chain
+};
+
+class MeshLodTable
+{
+public:
+    void clear();
+
+    // returns the mesh, levels past maxMeshLods_ are dropped
+    uint32_t addMesh(const MeshLod* lods, uint32_t count);
+
+    uint32_t meshCount() const { return static_cast<uint32_t>(lodCounts_.size()); }
+    uint32_t lodCount(uint32_t mesh) const { return lodCounts_[mesh]; }
+    const MeshLod& lod(uint32_t mesh, uint32_t level) const { return lods_[firstLods_[mesh] + level]; }
+
+    // every level of every mesh numbered in order, the geometry a draw of
+    // that level uses
+    uint32_t geometry(uint32_t mesh, uint32_t level) const { return firstLods_[mesh] + level; }
+
+    // maxMeshLods_ errors per mesh, infinity past the end of its chain
+    const float* errors(uint32_t mesh) const { return &errors_[mesh * maxMeshLods_]; }
+
+private:
+    std::vector<MeshLod> lods_;
+    std::vector<uint32_t> firstLods_;
+    std::vector<uint32_t> lodCounts_;
+    std::vector<float> errors_;
+};
+
+// keeps the level of every instance from one frame to the next
+class LodSelector
+{
+public:
+    LodSelector();
+
+    // instances that are added start at the full mesh
+    void resize(uint32_t count);
+    uint32_t count() const { return static_cast<uint32_t>(meshes_.size()); }
+
+    // scale is how much the instance's world matrix scales the mesh
+    void setInstance(uint32_t instance, uint32_t mesh, float scale);
+
+    // pixels of projected error a level may have, and the fraction either
+    // side of it an instance has to cross to change its level
+    void setMaxError(float pixels) { maxError_ = pixels; }
+    void setHysteresis(float fraction) { hysteresis_ = fraction; }
+
+    // projection and viewport height turn errors into pixels. bounds are
+    // the world bounds of the instances, only the visible ones change
+    // their level, four at a time. jobs may be null.
+    void select(const MeshLodTable& table, const CullingBounds& bounds, const std::vector<uint32_t>& visible,
+        const Float3& eye, const Float4x4& projection, float viewportHeight, JobSystem* jobs);
+
+    uint32_t level(uint32_t instance) const { return levels_[instance]; }
+
+private:
+    void selectRange(const MeshLodTable& table, const CullingBounds& bounds, const uint32_t* visible, uint32_t count,
+        const Float3& eye, float pixelsPerUnit);
+
+    std::vector<uint32_t> meshes_;
+    std::vector<float> scales_;
+    std::vector<uint32_t> levels_;
+    float maxError_;
+    float hysteresis_;
+};
+
+struct LodBenchmark
+{
+    uint32_t instances;
+    uint32_t meshes;
+    uint32_t threads;
+    uint32_t frames;
+    uint32_t visible;              // per frame, on average
+    double selectSeconds;          // per frame, every thread
+    double scalarSeconds;          // per frame, one instance at a time on one thread
+    double indexRatio;             // indices drawn over those of the full meshes
+    double switches;               // level changes per frame, on average
+    double switchesNoHysteresis;   // the same without hysteresis
+    uint32_t mismatches;           // levels that differ from the scalar ones, should be 0
+};
+
+// a field of instanceCount instances of meshCount meshes, seen from a
+// camera that moves through it with a little shake
+LodBenchmark measureLodSelection(uint32_t instanceCount, uint32_t meshCount, uint32_t threadCount, uint32_t frames);
+
+#endif // MESH_LOD_H
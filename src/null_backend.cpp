@@ -0,0 +1,69 @@
+#include "null_backend.h"
+
+NullRenderBackend::Translator::Translator()
+    : frameCount_(0)
+    , drawCount_(0)
+    , batchCount_(0)
+{
+}
+
+void NullRenderBackend::Translator::beginFrame(uint32_t frameSlot)
+{
+    (void)frameSlot;
+    batcher_.clear();
+}
+
+void NullRenderBackend::Translator::draw(const RenderPacket& packet)
+{
+    batcher_.add(packet.sortKey, packet.meshIndex, packet.materialIndex, packet.worldViewProjection);
+    drawCount_++;
+}
+
+void NullRenderBackend::Translator::endFrame()
+{
+    batcher_.build(nullptr);
+    batchCount_ += batcher_.batches().size();
+    frameCount_++;
+}
+
+NullRenderBackend::NullRenderBackend()
+    : renderCalls_(0)
+    , outOfOrderFrames_(0)
+    , framesInFlight_(2)
+{
+}
+
+void NullRenderBackend::setFramesInFlight(uint32_t count)
+{
+    framesInFlight_ = count;
+}
+
+uint32_t NullRenderBackend::defaultMaterialIndex()
+{
+    return 0;
+}
+
+bool NullRenderBackend::render(RenderPacketQueue& packets, uint32_t slot)
+{
+    renderCalls_++;
+
+    if (translateFrame(packets, translator_) != slot) {
+        outOfOrderFrames_++;
+        return false;
+    }
+
+    return true;
+}
+
+NullBackendStats NullRenderBackend::stats() const
+{
+    NullBackendStats result;
+    result.renderCalls = renderCalls_;
+    result.frames = translator_.frameCount();
+    result.draws = translator_.drawCount();
+    result.instancedDraws = translator_.batchCount();
+    result.outOfOrderFrames = outOfOrderFrames_;
+    result.framesInFlight = framesInFlight_;
+
+    return result;
+}
@@ -0,0 +1,61 @@
+#if !defined(NULL_BACKEND_H)
+#define NULL_BACKEND_H
+
+#include "instancing.h"
+#include "render_backend.h"
+
+// Accepts everything and counts it without a GPU, for running the CPU side
+// of the renderer headless.
+
+struct NullBackendStats
+{
+    uint64_t renderCalls;
+    uint64_t frames;
+    uint64_t draws;
+    uint64_t instancedDraws;   // draw calls left after grouping by mesh and material
+    uint64_t outOfOrderFrames; // translated frame did not match the slot
+    uint32_t framesInFlight;
+};
+
+class NullRenderBackend : public RenderBackend
+{
+public:
+    NullRenderBackend();
+
+    void setFramesInFlight(uint32_t count) override;
+    uint32_t defaultMaterialIndex() override;
+    bool render(RenderPacketQueue& packets, uint32_t slot) override;
+
+    // only read it while nothing renders
+    NullBackendStats stats() const;
+
+private:
+    // counts frames and draws, and sorts and groups the draws into
+    // instances the way the D3D12 backend does without uploading them
+    class Translator : public RenderPacketTranslator
+    {
+    public:
+        Translator();
+
+        void beginFrame(uint32_t frameSlot) override;
+        void draw(const RenderPacket& packet) override;
+        void endFrame() override;
+
+        uint64_t frameCount() const { return frameCount_; }
+        uint64_t drawCount() const { return drawCount_; }
+        uint64_t batchCount() const { return batchCount_; }
+
+    private:
+        InstanceBatcher batcher_;
+        uint64_t frameCount_;
+        uint64_t drawCount_;
+        uint64_t batchCount_;
+    };
+
+    Translator translator_;
+    uint64_t renderCalls_;
+    uint64_t outOfOrderFrames_;
+    uint32_t framesInFlight_;
+};
+
+#endif // NULL_BACKEND_H
@@ -0,0 +1,605 @@
+#include "occlusion_culling.h"
+
+#include "frustum_culling.h"
+#include "job_system.h"
+#include "profiler.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+// rows a job rasterizes, a band is only touched by the job that owns it
+static const uint32_t bandRows_ = 16;
+
+// city layout of the benchmark, in meters
+static const float blockSize_ = 40.0f;
+static const float streetWidth_ = 12.0f;
+static const float eyeHeight_ = 1.7f;
+
+// depth buffer of the benchmark, about 16:9
+static const uint32_t benchmarkWidth_ = 320;
+static const uint32_t benchmarkHeight_ = 180;
+
+// corner i has bit 0 for x, 1 for y and 2 for z set where it is at +1. Two
+// triangles a face, clockwise seen from outside.
+const Float3 boxOccluderVertices[8] = {
+    { -1.0f, -1.0f, -1.0f }, { 1.0f, -1.0f, -1.0f }, { -1.0f, 1.0f, -1.0f }, { 1.0f, 1.0f, -1.0f },
+    { -1.0f, -1.0f, 1.0f }, { 1.0f, -1.0f, 1.0f }, { -1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f },
+};
+
+const uint32_t boxOccluderIndices[36] = {
+    2, 3, 1, 2, 1, 0, // -z
+    7, 6, 4, 7, 4, 5, // +z
+    6, 2, 0, 6, 0, 4, // -x
+    3, 7, 5, 3, 5, 1, // +x
+    5, 4, 0, 5, 0, 1, // -y
+    6, 7, 3, 6, 3, 2, // +y
+};
+
+static Float4 transformPoint(const Float3& point, const Float4x4& matrix)
+{
+    const float (&m)[4][4] = matrix.m;
+    return {
+        point.x * m[0][0] + point.y * m[1][0] + point.z * m[2][0] + m[3][0],
+        point.x * m[0][1] + point.y * m[1][1] + point.z * m[2][1] + m[3][1],
+        point.x * m[0][2] + point.y * m[1][2] + point.z * m[2][2] + m[3][2],
+        point.x * m[0][3] + point.y * m[1][3] + point.z * m[2][3] + m[3][3],
+    };
+}
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+    : viewProjection_(matrixIdentity())
+{
+    uint32_t levelWidth = std::max(simdWidth, (width + simdWidth - 1) / simdWidth * simdWidth);
+    uint32_t levelHeight = std::max(1u, height);
+
+    for (;;) {
+        levelWidths_.push_back(levelWidth);
+        levelHeights_.push_back(levelHeight);
+        levels_.emplace_back(levelWidth * levelHeight, 1.0f);
+
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+    }
+
+    bins_.resize((levelHeights_[0] + bandRows_ - 1) / bandRows_);
+}
+
+void OcclusionCuller::begin(const Float4x4& viewProjection)
+{
+    viewProjection_ = viewProjection;
+    triangles_.clear();
+    for (std::vector<uint32_t>& bin : bins_)
+        bin.clear();
+}
+
+void OcclusionCuller::addOccluder(const Float3* vertices, const uint32_t* indices, uint32_t triangleCount, const Float4x4& world)
+{
+    const Float4x4 worldViewProjection = matrixMultiply(world, viewProjection_);
+
+    uint32_t vertexCount = 0;
+    for (uint32_t i = 0; i < triangleCount * 3; ++i)
+        vertexCount = std::max(vertexCount, indices[i] + 1);
+
+    clipVertices_.resize(vertexCount);
+    for (uint32_t i = 0; i < vertexCount; ++i)
+        clipVertices_[i] = transformPoint(vertices[i], worldViewProjection);
+
+    const float width = static_cast<float>(levelWidths_[0]);
+    const float height = static_cast<float>(levelHeights_[0]);
+
+    for (uint32_t triangle = 0; triangle < triangleCount; ++triangle) {
+        const Float4* clip[3] = {
+            &clipVertices_[indices[triangle * 3 + 0]],
+            &clipVertices_[indices[triangle * 3 + 1]],
+            &clipVertices_[indices[triangle * 3 + 2]],
+        };
+
+        // in front of the near plane z >= 0, which also puts w above 0
+        if (clip[0]->z < 0.0f || clip[1]->z < 0.0f || clip[2]->z < 0.0f)
+            continue;
+
+        float x[3], y[3], z[3];
+        for (uint32_t i = 0; i < 3; ++i) {
+            const float inverseW = 1.0f / clip[i]->w;
+            x[i] = (clip[i]->x * inverseW * 0.5f + 0.5f) * width;
+            y[i] = (0.5f - clip[i]->y * inverseW * 0.5f) * height;
+            z[i] = clip[i]->z * inverseW;
+        }
+
+        // clockwise on screen is a positive area with y down
+        const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (!(area > 0.0f))
+            continue;
+
+        Triangle setup;
+        setup.minX = static_cast<int32_t>(std::max(0.0f, std::floor(std::min(x[0], std::min(x[1], x[2])))));
+        setup.maxX = static_cast<int32_t>(std::min(width - 1.0f, std::floor(std::max(x[0], std::max(x[1], x[2])))));
+        setup.minY = static_cast<int32_t>(std::max(0.0f, std::floor(std::min(y[0], std::min(y[1], y[2])))));
+        setup.maxY = static_cast<int32_t>(std::min(height - 1.0f, std::floor(std::max(y[0], std::max(y[1], y[2])))));
+        if (setup.minX > setup.maxX || setup.minY > setup.maxY)
+            continue;
+
+        // edge i runs from vertex i to the next one, sampled at pixel
+        // centers. Moving edges in to only take whole pixels would leave the
+        // pixels along the edges triangles share uncovered.
+        for (uint32_t i = 0; i < 3; ++i) {
+            const uint32_t j = (i + 1) % 3;
+            setup.edges[i][0] = y[i] - y[j];
+            setup.edges[i][1] = x[j] - x[i];
+            setup.edges[i][2] = (y[j] - y[i]) * x[i] - (x[j] - x[i]) * y[i];
+        }
+
+        // z / w is linear on screen, moved back to the farthest corner of
+        // the pixel
+        const float depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+        const float depthB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+        setup.depth[0] = depthA;
+        setup.depth[1] = depthB;
+        setup.depth[2] = z[0] - depthA * x[0] - depthB * y[0] + 0.5f * (std::fabs(depthA) + std::fabs(depthB));
+
+        const uint32_t index = static_cast<uint32_t>(triangles_.size());
+        triangles_.push_back(setup);
+
+        for (uint32_t band = setup.minY / bandRows_; band <= setup.maxY / bandRows_; ++band)
+            bins_[band].push_back(index);
+    }
+}
+
+void OcclusionCuller::rasterize(JobSystem* jobs)
+{
+    PROFILE_FUNCTION();
+
+    const uint32_t bandCount = static_cast<uint32_t>(bins_.size());
+
+    if (jobs && bandCount > 1) {
+        jobs->parallelFor(0, bandCount, 1, [this](uint32_t first, uint32_t last) {
+            for (uint32_t band = first; band < last; ++band)
+                rasterizeBand(band);
+        });
+    } else {
+        for (uint32_t band = 0; band < bandCount; ++band)
+            rasterizeBand(band);
+    }
+
+    buildPyramid();
+}
+
+void OcclusionCuller::rasterizeBand(uint32_t band)
+{
+    const uint32_t width = levelWidths_[0];
+    const int32_t firstRow = static_cast<int32_t>(band * bandRows_);
+    const int32_t lastRow = static_cast<int32_t>(std::min((band + 1) * bandRows_, levelHeights_[0])) - 1;
+
+    float* depth = levels_[0].data();
+    std::fill(depth + firstRow * width, depth + (lastRow + 1) * width, 1.0f);
+
+    const SimdFloat zero = simdSplat(0.0f);
+    const SimdFloat infinity = simdSplat(std::numeric_limits<float>::infinity());
+    const SimdFloat laneCenters = simdSet(0.5f, 1.5f, 2.5f, 3.5f);
+    const float blockWidth = static_cast<float>(simdWidth);
+
+    for (uint32_t index : bins_[band]) {
+        const Triangle& triangle = triangles_[index];
+
+        // moving one block to the right
+        SimdFloat edgeStep[3];
+        for (uint32_t i = 0; i < 3; ++i)
+            edgeStep[i] = simdSplat(triangle.edges[i][0] * blockWidth);
+        const SimdFloat depthStep = simdSplat(triangle.depth[0] * blockWidth);
+
+        const int32_t firstX = triangle.minX & ~static_cast<int32_t>(simdWidth - 1);
+        const SimdFloat x = simdAdd(simdSplat(static_cast<float>(firstX)), laneCenters);
+
+        const int32_t top = std::max(firstRow, triangle.minY);
+        const int32_t bottom = std::min(lastRow, triangle.maxY);
+
+        for (int32_t row = top; row <= bottom; ++row) {
+            const float y = static_cast<float>(row) + 0.5f;
+
+            SimdFloat edges[3];
+            for (uint32_t i = 0; i < 3; ++i)
+                edges[i] = simdMulAdd(simdSplat(triangle.edges[i][0]), x, simdSplat(triangle.edges[i][1] * y + triangle.edges[i][2]));
+            SimdFloat z = simdMulAdd(simdSplat(triangle.depth[0]), x, simdSplat(triangle.depth[1] * y + triangle.depth[2]));
+
+            float* pixels = depth + row * width;
+            bool entered = false;
+
+            for (int32_t column = firstX; column <= triangle.maxX; column += simdWidth) {
+                const SimdFloat outside = simdOr(simdLess(edges[0], zero), simdOr(simdLess(edges[1], zero), simdLess(edges[2], zero)));
+                const uint32_t outsideMask = simdMask(outside);
+
+                if (outsideMask != (1u << simdWidth) - 1) {
+                    // pixels outside take infinity and keep what they had
+                    const SimdFloat covered = simdMax(z, simdAnd(outside, infinity));
+                    simdStore(pixels + column, simdMin(simdLoad(pixels + column), covered));
+                    entered = true;
+                } else if (entered) {
+                    // a triangle covers one span per row, it is past it
+                    break;
+                }
+
+                for (uint32_t i = 0; i < 3; ++i)
+                    edges[i] = simdAdd(edges[i], edgeStep[i]);
+                z = simdAdd(z, depthStep);
+            }
+        }
+    }
+}
+
+void OcclusionCuller::buildPyramid()
+{
+    PROFILE_FUNCTION();
+
+    for (uint32_t level = 1; level < levelCount(); ++level) {
+        const float* source = levels_[level - 1].data();
+        const uint32_t sourceWidth = levelWidths_[level - 1];
+        const uint32_t sourceHeight = levelHeights_[level - 1];
+        float* target = levels_[level].data();
+
+        // odd edges have a single row or column to take
+        for (uint32_t y = 0; y < levelHeights_[level]; ++y) {
+            const float* row0 = source + (2 * y) * sourceWidth;
+            const float* row1 = source + std::min(2 * y + 1, sourceHeight - 1) * sourceWidth;
+
+            for (uint32_t x = 0; x < levelWidths_[level]; ++x) {
+                const uint32_t x0 = 2 * x;
+                const uint32_t x1 = std::min(2 * x + 1, sourceWidth - 1);
+                target[y * levelWidths_[level] + x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::testRectangle(float minX, float minY, float maxX, float maxY, float nearest) const
+{
+    // a corner in front of the near plane, there is no telling
+    if (!(nearest >= 0.0f))
+        return true;
+
+    const float width = static_cast<float>(levelWidths_[0]);
+    const float height = static_cast<float>(levelHeights_[0]);
+    if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+        return false;
+
+    // every pixel the rectangle touches and one more around it. A pixel
+    // an occluder's outline only partly covers counts as covered, part of
+    // the box may show in it, but then it reaches the pixel across the
+    // outline.
+    uint32_t x0 = static_cast<uint32_t>(std::max(0.0f, minX - 1.0f));
+    uint32_t y0 = static_cast<uint32_t>(std::max(0.0f, minY - 1.0f));
+    uint32_t x1 = static_cast<uint32_t>(std::min(width - 1.0f, maxX + 1.0f));
+    uint32_t y1 = static_cast<uint32_t>(std::min(height - 1.0f, maxY + 1.0f));
+
+    // the first level where it touches at most 4x4 texels
+    uint32_t level = 0;
+    while (level + 1 < levelCount() && ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3))
+        level++;
+
+    x0 >>= level;
+    y0 >>= level;
+    x1 >>= level;
+    y1 >>= level;
+
+    const float* depth = levels_[level].data();
+    const uint32_t levelWidth = levelWidths_[level];
+
+    for (uint32_t y = y0; y <= y1; ++y) {
+        for (uint32_t x = x0; x <= x1; ++x) {
+            if (nearest <= depth[y * levelWidth + x])
+                return true;
+        }
+    }
+
+    return false;
+}
+
+void OcclusionCuller::testBoxes(const Float3* centers, const Float3* extents, uint32_t count, bool* visible) const
+{
+    float lanes[6][simdWidth];
+    for (uint32_t lane = 0; lane < simdWidth; ++lane) {
+        const uint32_t box = std::min(lane, count - 1);
+        lanes[0][lane] = centers[box].x;
+        lanes[1][lane] = centers[box].y;
+        lanes[2][lane] = centers[box].z;
+        lanes[3][lane] = extents[box].x;
+        lanes[4][lane] = extents[box].y;
+        lanes[5][lane] = extents[box].z;
+    }
+
+    const SimdFloat centerX = simdLoad(lanes[0]), centerY = simdLoad(lanes[1]), centerZ = simdLoad(lanes[2]);
+    const SimdFloat extentX = simdLoad(lanes[3]), extentY = simdLoad(lanes[4]), extentZ = simdLoad(lanes[5]);
+
+    // the clip position of the center and how far each axis of the box
+    // moves it, every corner is the center plus or minus each axis
+    const float (&m)[4][4] = viewProjection_.m;
+    SimdFloat center[4], axes[3][4];
+    for (uint32_t k = 0; k < 4; ++k) {
+        center[k] = simdMulAdd(centerX, simdSplat(m[0][k]), simdMulAdd(centerY, simdSplat(m[1][k]), simdMulAdd(centerZ, simdSplat(m[2][k]), simdSplat(m[3][k]))));
+        axes[0][k] = simdMul(extentX, simdSplat(m[0][k]));
+        axes[1][k] = simdMul(extentY, simdSplat(m[1][k]));
+        axes[2][k] = simdMul(extentZ, simdSplat(m[2][k]));
+    }
+
+    const SimdFloat one = simdSplat(1.0f);
+    SimdFloat minX = simdSplat(std::numeric_limits<float>::max()), minY = minX, nearest = minX, nearestClip = minX;
+    SimdFloat maxX = simdSplat(-std::numeric_limits<float>::max()), maxY = maxX;
+
+    for (uint32_t corner = 0; corner < 8; ++corner) {
+        SimdFloat clip[4];
+        for (uint32_t k = 0; k < 4; ++k) {
+            clip[k] = center[k];
+            for (uint32_t axis = 0; axis < 3; ++axis)
+                clip[k] = (corner >> axis) & 1 ? simdAdd(clip[k], axes[axis][k]) : simdSub(clip[k], axes[axis][k]);
+        }
+
+        const SimdFloat inverseW = simdDiv(one, clip[3]);
+        const SimdFloat x = simdMul(clip[0], inverseW);
+        const SimdFloat y = simdMul(clip[1], inverseW);
+        minX = simdMin(minX, x);
+        maxX = simdMax(maxX, x);
+        minY = simdMin(minY, y);
+        maxY = simdMax(maxY, y);
+        nearest = simdMin(nearest, simdMul(clip[2], inverseW));
+        nearestClip = simdMin(nearestClip, clip[2]);
+    }
+
+    float lanesMinX[simdWidth], lanesMaxX[simdWidth], lanesMinY[simdWidth], lanesMaxY[simdWidth], lanesNearest[simdWidth], lanesNearestClip[simdWidth];
+    simdStore(lanesMinX, minX);
+    simdStore(lanesMaxX, maxX);
+    simdStore(lanesMinY, minY);
+    simdStore(lanesMaxY, maxY);
+    simdStore(lanesNearest, nearest);
+    simdStore(lanesNearestClip, nearestClip);
+
+    const float width = static_cast<float>(levelWidths_[0]);
+    const float height = static_cast<float>(levelHeights_[0]);
+
+    for (uint32_t lane = 0; lane < count; ++lane) {
+        // to pixels, with y down the top of the screen is the largest y
+        const float left = (lanesMinX[lane] * 0.5f + 0.5f) * width;
+        const float right = (lanesMaxX[lane] * 0.5f + 0.5f) * width;
+        const float top = (0.5f - lanesMaxY[lane] * 0.5f) * height;
+        const float bottom = (0.5f - lanesMinY[lane] * 0.5f) * height;
+        const float nearestDepth = lanesNearestClip[lane] < 0.0f ? -1.0f : lanesNearest[lane];
+
+        visible[lane] = testRectangle(left, top, right, bottom, nearestDepth);
+    }
+}
+
+bool OcclusionCuller::testBox(const Float3& center, const Float3& extents) const
+{
+    bool visible;
+    testBoxes(&center, &extents, 1, &visible);
+    return visible;
+}
+
+void OcclusionCuller::cullObjects(const CullingBounds& bounds, std::vector<uint32_t>& visible) const
+{
+    PROFILE_FUNCTION();
+
+    const uint32_t count = static_cast<uint32_t>(visible.size());
+    uint32_t kept = 0;
+
+    // kept never passes the block being read, the list is compacted in
+    // place
+    for (uint32_t first = 0; first < count; first += simdWidth) {
+        const uint32_t lanes = std::min(simdWidth, count - first);
+
+        Float3 centers[simdWidth], extents[simdWidth];
+        uint32_t objects[simdWidth];
+        for (uint32_t lane = 0; lane < lanes; ++lane) {
+            const uint32_t object = visible[first + lane];
+            objects[lane] = object;
+            centers[lane] = { bounds.centers(0)[object], bounds.centers(1)[object], bounds.centers(2)[object] };
+            extents[lane] = { bounds.extents(0)[object], bounds.extents(1)[object], bounds.extents(2)[object] };
+        }
+
+        bool laneVisible[simdWidth];
+        testBoxes(centers, extents, lanes, laneVisible);
+
+        for (uint32_t lane = 0; lane < lanes; ++lane) {
+            if (laneVisible[lane])
+                visible[kept++] = objects[lane];
+        }
+    }
+
+    visible.resize(kept);
+}
+
+// the benchmark's idea of what is visible, every triangle sampled at pixel
+// centers. Writes the nearest depth, or without write tells whether any
+// sample would pass the depth test.
+static bool rasterizeReference(const Float4x4& worldViewProjection, uint32_t width, uint32_t height, bool write, std::vector<float>& depth)
+{
+    Float4 clip[8];
+    for (uint32_t i = 0; i < 8; ++i)
+        clip[i] = transformPoint(boxOccluderVertices[i], worldViewProjection);
+
+    for (uint32_t triangle = 0; triangle < 12; ++triangle) {
+        float x[3], y[3], z[3];
+        bool clipped = false;
+
+        for (uint32_t i = 0; i < 3; ++i) {
+            const Float4& vertex = clip[boxOccluderIndices[triangle * 3 + i]];
+            clipped = clipped || vertex.z < 0.0f;
+            x[i] = (vertex.x / vertex.w * 0.5f + 0.5f) * static_cast<float>(width);
+            y[i] = (0.5f - vertex.y / vertex.w * 0.5f) * static_cast<float>(height);
+            z[i] = vertex.z / vertex.w;
+        }
+
+        const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (clipped || !(area > 0.0f))
+            continue;
+
+        const int32_t minX = std::max(0, static_cast<int32_t>(std::floor(std::min(x[0], std::min(x[1], x[2])))));
+        const int32_t maxX = std::min(static_cast<int32_t>(width) - 1, static_cast<int32_t>(std::floor(std::max(x[0], std::max(x[1], x[2])))));
+        const int32_t minY = std::max(0, static_cast<int32_t>(std::floor(std::min(y[0], std::min(y[1], y[2])))));
+        const int32_t maxY = std::min(static_cast<int32_t>(height) - 1, static_cast<int32_t>(std::floor(std::max(y[0], std::max(y[1], y[2])))));
+
+        for (int32_t row = minY; row <= maxY; ++row) {
+            for (int32_t column = minX; column <= maxX; ++column) {
+                const float px = static_cast<float>(column) + 0.5f;
+                const float py = static_cast<float>(row) + 0.5f;
+
+                // edge i weighs the vertex across from it
+                float weights[3];
+                for (uint32_t i = 0; i < 3; ++i) {
+                    const uint32_t j = (i + 1) % 3;
+                    weights[(i + 2) % 3] = (x[j] - x[i]) * (py - y[i]) - (y[j] - y[i]) * (px - x[i]);
+                }
+                if (weights[0] < 0.0f || weights[1] < 0.0f || weights[2] < 0.0f)
+                    continue;
+
+                const float sample = (weights[0] * z[0] + weights[1] * z[1] + weights[2] * z[2]) / area;
+                float& pixel = depth[row * width + column];
+
+                if (write)
+                    pixel = std::min(pixel, sample);
+                else if (sample < pixel)
+                    return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static Float4x4 boxWorld(const CullingBounds& bounds, uint32_t index)
+{
+    Float4x4 world = matrixIdentity();
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+        world.m[axis][axis] = bounds.extents(axis)[index];
+        world.m[3][axis] = bounds.centers(axis)[index];
+    }
+    return world;
+}
+
+OcclusionBenchmark measureOcclusionCulling(uint32_t buildingsPerSide, uint32_t objectCount, uint32_t threadCount, uint32_t frames)
+{
+    OcclusionBenchmark result = {};
+    result.objects = objectCount;
+    result.buildings = buildingsPerSide * buildingsPerSide;
+    result.threads = threadCount + 1;
+    result.frames = frames;
+    if (buildingsPerSide == 0 || frames == 0)
+        return result;
+
+    // fixed seed lcg, every run builds the same city
+    uint32_t seed = 0x12345678;
+    auto random = [&seed](float low, float high) {
+        seed = seed * 1664525u + 1013904223u;
+        return low + (high - low) * static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+    };
+
+    // a building on every block, the streets between them
+    const float citySize = static_cast<float>(buildingsPerSide) * blockSize_;
+    const float lotSize = 0.5f * (blockSize_ - streetWidth_);
+
+    CullingBounds buildings;
+    buildings.resize(result.buildings);
+    for (uint32_t i = 0; i < result.buildings; ++i) {
+        const float height = random(4.0f, 40.0f);
+        const Float3 center = { (static_cast<float>(i % buildingsPerSide) + 0.5f) * blockSize_, height, (static_cast<float>(i / buildingsPerSide) + 0.5f) * blockSize_ };
+        const Float3 extents = { lotSize * random(0.7f, 1.0f), height, lotSize * random(0.7f, 1.0f) };
+        buildings.setBox(i, center, extents);
+    }
+
+    // cars and props anywhere on the ground, some end up inside buildings
+    CullingBounds objects;
+    objects.resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; ++i) {
+        const float size = random(0.3f, 1.5f);
+        const Float3 car = { 1.0f, 0.75f, 2.25f };
+        const Float3 prop = { size, size, size };
+        const Float3 extents = random(0.0f, 1.0f) < 0.5f ? car : prop;
+        const Float3 center = { random(0.0f, citySize), extents.y, random(0.0f, citySize) };
+        objects.setBox(i, center, extents);
+    }
+
+    const Float4x4 projection = matrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.5f, 2000.0f);
+    const float street = static_cast<float>(buildingsPerSide / 2) * blockSize_;
+
+    JobSystem jobs;
+    jobs.start(threadCount);
+    JobSystem* rasterJobs = threadCount > 0 ? &jobs : nullptr;
+
+    OcclusionCuller culler(benchmarkWidth_, benchmarkHeight_);
+    const uint32_t referenceWidth = 2 * culler.width();
+    const uint32_t referenceHeight = 2 * culler.height();
+    std::vector<float> referenceDepth(referenceWidth * referenceHeight);
+
+    std::vector<uint32_t> visibleBuildings;
+    std::vector<uint32_t> visibleObjects;
+    std::vector<uint32_t> kept;
+
+    typedef std::chrono::duration<double> Seconds;
+    uint64_t triangles = 0, frustumVisible = 0, occlusionVisible = 0, referenceVisible = 0;
+
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        // walking up the middle street, looking around
+        const float walked = static_cast<float>(frame) / static_cast<float>(frames);
+        const float yaw = 0.6f * std::sin(static_cast<float>(frame) * 0.7f);
+        const Float3 eye = { street, eyeHeight_, blockSize_ * 0.25f + walked * 0.5f * citySize };
+        const Float3 target = { eye.x + std::sin(yaw), eyeHeight_, eye.z + std::cos(yaw) };
+        const Float3 up = { 0.0f, 1.0f, 0.0f };
+        const Float4x4 viewProjection = matrixMultiply(matrixLookAtLH(eye, target, up), projection);
+        const Frustum frustum = frustumFromMatrix(viewProjection);
+
+        cullObjects(frustum, buildings, CullBoxes, nullptr, visibleBuildings);
+        cullObjects(frustum, objects, CullBoxes, nullptr, visibleObjects);
+
+        auto start = std::chrono::steady_clock::now();
+
+        culler.begin(viewProjection);
+        for (uint32_t building : visibleBuildings)
+            culler.addOccluder(boxOccluderVertices, boxOccluderIndices, 12, boxWorld(buildings, building));
+        culler.rasterize(rasterJobs);
+
+        result.rasterizeSeconds += std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+
+        kept = visibleObjects;
+        start = std::chrono::steady_clock::now();
+        culler.cullObjects(objects, kept);
+        result.testSeconds += std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+
+        // what can actually be seen, the buildings first, then whether any
+        // sample of an object is in front of them
+        std::fill(referenceDepth.begin(), referenceDepth.end(), 1.0f);
+        for (uint32_t building : visibleBuildings)
+            rasterizeReference(matrixMultiply(boxWorld(buildings, building), viewProjection), referenceWidth, referenceHeight, true, referenceDepth);
+
+        // both lists are in ascending order
+        size_t next = 0;
+        for (uint32_t object : visibleObjects) {
+            while (next < kept.size() && kept[next] < object)
+                ++next;
+            const bool isKept = next < kept.size() && kept[next] == object;
+
+            if (rasterizeReference(matrixMultiply(boxWorld(objects, object), viewProjection), referenceWidth, referenceHeight, false, referenceDepth)) {
+                referenceVisible++;
+                if (!isKept)
+                    result.falseCulls++;
+            }
+        }
+
+        triangles += culler.triangleCount();
+        frustumVisible += visibleObjects.size();
+        occlusionVisible += kept.size();
+    }
+
+    jobs.stop();
+
+    result.triangles = static_cast<uint32_t>(triangles / frames);
+    result.frustumVisible = static_cast<uint32_t>(frustumVisible / frames);
+    result.occlusionVisible = static_cast<uint32_t>(occlusionVisible / frames);
+    result.referenceVisible = static_cast<uint32_t>(referenceVisible / frames);
+    result.rasterizeSeconds /= frames;
+    result.testSeconds /= frames;
+
+    return result;
+}
@@ -0,0 +1,122 @@
+#if !defined(OCCLUSION_CULLING_H)
+#define OCCLUSION_CULLING_H
+
+#include "scene_math.h"
+
+#include <cstdint>
+#include <vector>
+
+class CullingBounds;
+class JobSystem;
+
+// Software occlusion culling. A few large occluder meshes are rasterized on
+// the CPU into a small depth buffer, then the boxes of objects are tested
+// against a pyramid of the farthest depths in it, so objects hidden behind
+// the occluders are not drawn.
+//
+// Occluders cover the pixels whose centers they cover, with the farthest
+// depth they have in the pixel. A box is tested with its nearest depth
+// against every texel its screen rectangle, grown by a pixel, touches, so
+// what shows at an occluder's outline keeps it. Some hidden boxes are kept.
+//
+// Triangles are rasterized four pixels at a time, with a coverage mask from
+// their three edge functions. The screen is split into bands of rows that
+// workers fill on their own. Depth is D3D's, 0 at the near plane and 1 at
+// the far one.
+
+// a box of half extents 1 around the origin facing out, to add boxes as
+// occluders with a world matrix that scales it
+extern const Float3 boxOccluderVertices[8];
+extern const uint32_t boxOccluderIndices[36];
+
+class OcclusionCuller
+{
+public:
+    // width is rounded up to a whole number of SIMD blocks
+    OcclusionCuller(uint32_t width, uint32_t height);
+
+    uint32_t width() const { return levelWidths_[0]; }
+    uint32_t height() const { return levelHeights_[0]; }
+
+    // drops the occluders of the last frame
+    void begin(const Float4x4& viewProjection);
+
+    // triangles are clockwise on screen when they face the camera, as D3D
+    // draws them, back faces are skipped. Triangles that cross the near
+    // plane are left out, fewer occluders only cull less.
+    void addOccluder(const Float3* vertices, const uint32_t* indices, uint32_t triangleCount, const Float4x4& world);
+
+    // rasterizes the occluders and builds the pyramid, jobs may be null
+    void rasterize(JobSystem* jobs);
+
+    // world space box, center and half extents. False when it is hidden
+    // behind the occluders or off screen.
+    bool testBox(const Float3& center, const Float3& extents) const;
+
+    // keeps the objects in visible whose boxes may be visible, in order,
+    // four boxes are projected at a time
+    void cullObjects(const CullingBounds& bounds, std::vector<uint32_t>& visible) const;
+
+    // level 0 is the depth buffer, every level after it has the farthest
+    // depth of 2x2 texels of the one before, down to a single texel
+    uint32_t levelCount() const { return static_cast<uint32_t>(levels_.size()); }
+    uint32_t levelWidth(uint32_t level) const { return levelWidths_[level]; }
+    uint32_t levelHeight(uint32_t level) const { return levelHeights_[level]; }
+    const float* depth(uint32_t level) const { return levels_[level].data(); }
+
+    // front facing triangles that went into the depth buffer
+    uint32_t triangleCount() const { return static_cast<uint32_t>(triangles_.size()); }
+
+private:
+    // set up for rasterization, in pixels with y down
+    struct Triangle
+    {
+        float edges[3][3]; // a, b, c of a * x + b * y + c, not negative inside
+        float depth[3];    // the same for the depth plane, the farthest depth in the pixel
+        int32_t minX, maxX, minY, maxY;
+    };
+
+    void rasterizeBand(uint32_t band);
+    void buildPyramid();
+
+    // whether a box that projects to the rectangle, in pixels, with nearest
+    // as its nearest depth may be visible
+    bool testRectangle(float minX, float minY, float maxX, float maxY, float nearest) const;
+
+    // rectangles and nearest depths of up to four boxes, lanes past count
+    // repeat the last box
+    void testBoxes(const Float3* centers, const Float3* extents, uint32_t count, bool* visible) const;
+
+    Float4x4 viewProjection_;
+
+    std::vector<Float4> clipVertices_;
+    std::vector<Triangle> triangles_;
+    std::vector<std::vector<uint32_t>> bins_; // triangles per band
+
+    std::vector<std::vector<float>> levels_;
+    std::vector<uint32_t> levelWidths_;
+    std::vector<uint32_t> levelHeights_;
+};
+
+struct OcclusionBenchmark
+{
+    uint32_t objects;
+    uint32_t buildings;         // the occluders
+    uint32_t threads;
+    uint32_t frames;
+    uint32_t triangles;         // rasterized per frame, on average
+    uint32_t frustumVisible;    // per frame, on average
+    uint32_t occlusionVisible;  // left after occlusion culling, on average
+    uint32_t referenceVisible;  // actually visible, on average
+    uint32_t falseCulls;        // culled in any frame but visible, should be 0
+    double rasterizeSeconds;    // per frame, adding the occluders, rasterizing and the pyramid
+    double testSeconds;         // per frame, testing the objects the frustum left
+};
+
+// a city of buildingsPerSide x buildingsPerSide blocks with objectCount
+// props and cars on the ground, seen from a camera walking down a street.
+// What is actually visible comes from rasterizing every box at twice the
+// resolution, sampled at pixel centers.
+OcclusionBenchmark measureOcclusionCulling(uint32_t buildingsPerSide, uint32_t objectCount, uint32_t threadCount, uint32_t frames);
+
+#endif // OCCLUSION_CULLING_H
@@ -0,0 +1,345 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace {
+
+// the fields are atomics so a reader on another thread can copy an event
+// while the owner overwrites it, the copy is thrown away afterwards. Stores
+// are release and loads acquire, which on x86 costs nothing and lets a
+// reader that saw an overwrite also see the count that covers it.
+struct ProfileEvent
+{
+    std::atomic<uint32_t> zone;
+    std::atomic<uint64_t> begin;
+    std::atomic<uint64_t> end;
+};
+
+const uint64_t eventCapacity = 1 << 16;
+
+struct ProfileThreadBuffer
+{
+    explicit ProfileThreadBuffer(uint32_t id)
+        : threadId(id)
+        , written(0)
+        , collected(0)
+        , events(new ProfileEvent[eventCapacity])
+    {
+    }
+
+    uint32_t threadId;
+    std::string name;
+    std::atomic<uint64_t> written;
+    uint64_t collected;
+    std::unique_ptr<ProfileEvent[]> events;
+};
+
+struct CopiedEvent
+{
+    uint32_t zone;
+    uint64_t begin;
+    uint64_t end;
+};
+
+const uint32_t maxZones = 1024;
+
+struct ZoneHistory
+{
+    double frameTimes[profileStatsFrames];
+    uint32_t count;
+    uint32_t next;
+};
+
+// everything but the rings themselves is guarded by mutex
+struct Profiler
+{
+    Profiler()
+        : zoneCount(0)
+        , startTicks(profileTimestamp())
+        , startTime(std::chrono::steady_clock::now())
+    {
+    }
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ProfileThreadBuffer>> threads;
+
+    const char* zoneNames[maxZones];
+    ZoneHistory history[maxZones];
+    double frameTotals[maxZones];
+    std::atomic<uint32_t> zoneCount;
+
+    uint64_t startTicks;
+    std::chrono::steady_clock::time_point startTime;
+    std::vector<CopiedEvent> scratch;
+};
+
+Profiler& profiler()
+{
+    static Profiler instance;
+    return instance;
+}
+
+thread_local ProfileThreadBuffer* threadBuffer_ = nullptr;
+
+ProfileThreadBuffer* createThreadBuffer()
+{
+    Profiler& p = profiler();
+
+    std::lock_guard<std::mutex> lock(p.mutex);
+    p.threads.emplace_back(new ProfileThreadBuffer(static_cast<uint32_t>(p.threads.size())));
+
+    return p.threads.back().get();
+}
+
+// copies events [from, written) that are still in the ring
+uint64_t copyEvents(const ProfileThreadBuffer& buffer, uint64_t from, std::vector<CopiedEvent>& events)
+{
+    events.clear();
+
+    const uint64_t written = buffer.written.load(std::memory_order_acquire);
+    const uint64_t first = std::max(from, written > eventCapacity ? written - eventCapacity : 0);
+
+    for (uint64_t i = first; i < written; ++i) {
+        const ProfileEvent& event = buffer.events[i & (eventCapacity - 1)];
+        CopiedEvent copy;
+        copy.zone = event.zone.load(std::memory_order_acquire);
+        copy.begin = event.begin.load(std::memory_order_acquire);
+        copy.end = event.end.load(std::memory_order_acquire);
+        events.push_back(copy);
+    }
+
+    // the owner may have lapped the copy while it ran, drop whatever it
+    // could have overwritten
+    const uint64_t after = buffer.written.load(std::memory_order_acquire);
+    if (after >= eventCapacity && after - eventCapacity + 1 > first) {
+        const uint64_t overwritten = std::min(after - eventCapacity + 1 - first, static_cast<uint64_t>(events.size()));
+        events.erase(events.begin(), events.begin() + static_cast<ptrdiff_t>(overwritten));
+    }
+
+    return written;
+}
+
+// ticks of profileTimestamp() per second, the longer the profiler has run
+// the more accurate
+double ticksPerSecond(const Profiler& p)
+{
+    typedef std::chrono::duration<double> Seconds;
+
+    double elapsed = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - p.startTime).count();
+    while (elapsed < 0.001)
+        elapsed = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - p.startTime).count();
+
+    return static_cast<double>(profileTimestamp() - p.startTicks) / elapsed;
+}
+
+FILE* openForWriting(const char* path)
+{
+#if defined(_MSC_VER)
+    FILE* file = nullptr;
+    return fopen_s(&file, path, "w") == 0 ? file : nullptr;
+#else
+    return fopen(path, "w");
+#endif
+}
+
+void writeJsonString(FILE* file, const char* text)
+{
+    fputc('"', file);
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', file);
+        if (static_cast<unsigned char>(*c) >= 0x20)
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+} // namespace
+
+uint32_t registerProfileZone(const char* name)
+{
+    Profiler& p = profiler();
+
+    std::lock_guard<std::mutex> lock(p.mutex);
+
+    const uint32_t count = p.zoneCount.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (strcmp(p.zoneNames[i], name) == 0)
+            return i;
+    }
+
+    // out of zones, the last one collects the rest
+    if (count == maxZones)
+        return maxZones - 1;
+
+    p.zoneNames[count] = name;
+    p.history[count] = ZoneHistory();
+    p.frameTotals[count] = 0.0;
+    p.zoneCount.store(count + 1, std::memory_order_release);
+
+    return count;
+}
+
+void recordProfileZone(uint32_t zone, uint64_t begin, uint64_t end)
+{
+    ProfileThreadBuffer* buffer = threadBuffer_;
+    if (!buffer) {
+        buffer = createThreadBuffer();
+        threadBuffer_ = buffer;
+    }
+
+    const uint64_t index = buffer->written.load(std::memory_order_relaxed);
+    ProfileEvent& event = buffer->events[index & (eventCapacity - 1)];
+    event.zone.store(zone, std::memory_order_release);
+    event.begin.store(begin, std::memory_order_release);
+    event.end.store(end, std::memory_order_release);
+
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void setProfileThreadName(const char* name)
+{
+    if (!threadBuffer_)
+        threadBuffer_ = createThreadBuffer();
+
+    std::lock_guard<std::mutex> lock(profiler().mutex);
+    threadBuffer_->name = name;
+}
+
+void endProfileFrame()
+{
+    Profiler& p = profiler();
+
+    std::lock_guard<std::mutex> lock(p.mutex);
+
+    const uint32_t zoneCount = p.zoneCount.load(std::memory_order_acquire);
+    const double secondsPerTick = 1.0 / ticksPerSecond(p);
+
+    std::fill(p.frameTotals, p.frameTotals + zoneCount, -1.0);
+
+    for (const std::unique_ptr<ProfileThreadBuffer>& buffer : p.threads) {
+        buffer->collected = copyEvents(*buffer, buffer->collected, p.scratch);
+
+        for (const CopiedEvent& event : p.scratch) {
+            if (event.zone >= zoneCount)
+                continue;
+
+            double& total = p.frameTotals[event.zone];
+            total = std::max(total, 0.0) + static_cast<double>(event.end - event.begin) * secondsPerTick;
+        }
+    }
+
+    for (uint32_t zone = 0; zone < zoneCount; ++zone) {
+        if (p.frameTotals[zone] < 0.0)
+            continue;
+
+        ZoneHistory& history = p.history[zone];
+        history.frameTimes[history.next] = p.frameTotals[zone];
+        history.next = (history.next + 1) % profileStatsFrames;
+        history.count = std::min(history.count + 1, profileStatsFrames);
+    }
+}
+
+void profileZoneStats(std::vector<ProfileZoneStats>& stats)
+{
+    Profiler& p = profiler();
+
+    std::lock_guard<std::mutex> lock(p.mutex);
+
+    stats.clear();
+
+    const uint32_t zoneCount = p.zoneCount.load(std::memory_order_acquire);
+    std::vector<double> sorted;
+
+    for (uint32_t zone = 0; zone < zoneCount; ++zone) {
+        const ZoneHistory& history = p.history[zone];
+        if (history.count == 0)
+            continue;
+
+        sorted.assign(history.frameTimes, history.frameTimes + history.count);
+        std::sort(sorted.begin(), sorted.end());
+
+        double sum = 0.0;
+        for (double time : sorted)
+            sum += time;
+
+        ProfileZoneStats zoneStats;
+        zoneStats.name = p.zoneNames[zone];
+        zoneStats.frames = history.count;
+        zoneStats.minTime = sorted.front();
+        zoneStats.averageTime = sum / static_cast<double>(history.count);
+        zoneStats.p99Time = sorted[(history.count - 1) * 99 / 100];
+        stats.push_back(zoneStats);
+    }
+}
+
+bool exportChromeTrace(const char* path)
+{
+    Profiler& p = profiler();
+
+    FILE* file = openForWriting(path);
+    if (!file)
+        return false;
+
+    std::lock_guard<std::mutex> lock(p.mutex);
+
+    const double microsecondsPerTick = 1000000.0 / ticksPerSecond(p);
+    const uint32_t zoneCount = p.zoneCount.load(std::memory_order_acquire);
+    bool first = true;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+
+    for (const std::unique_ptr<ProfileThreadBuffer>& buffer : p.threads) {
+        if (!buffer->name.empty()) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", buffer->threadId);
+            writeJsonString(file, buffer->name.c_str());
+            fprintf(file, "}}");
+            first = false;
+        }
+
+        copyEvents(*buffer, 0, p.scratch);
+
+        for (const CopiedEvent& event : p.scratch) {
+            if (event.zone >= zoneCount)
+                continue;
+
+            // events before the profiler started would come out negative
+            const double begin = static_cast<double>(static_cast<int64_t>(event.begin - p.startTicks)) * microsecondsPerTick;
+            const double duration = static_cast<double>(event.end - event.begin) * microsecondsPerTick;
+
+            fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+            writeJsonString(file, p.zoneNames[event.zone]);
+            fprintf(file, ",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", buffer->threadId, begin, duration);
+            first = false;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+
+    const bool written = ferror(file) == 0;
+    return fclose(file) == 0 && written;
+}
+
+double measureProfileZoneOverhead(uint32_t iterations)
+{
+    typedef std::chrono::duration<double> Seconds;
+
+    static const uint32_t zone = registerProfileZone("ProfileOverhead");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < iterations; ++i) {
+        ProfileZone profileZone(zone);
+    }
+
+    const double seconds = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count();
+
+    return iterations > 0 ? seconds / iterations : 0.0;
+}
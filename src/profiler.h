@@ -0,0 +1,108 @@
+#if !defined(PROFILER_H)
+#define PROFILER_H
+
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// CPU zone profiler. Zones are timed with the time stamp counter and
+// written to a ring per thread, only the thread that owns a ring writes to
+// it. endProfileFrame() collects what the threads wrote into per zone
+// statistics, exportChromeTrace() dumps what the rings still hold.
+//
+// The macros compile to nothing unless DXP_PROFILE is defined.
+
+inline uint64_t profileTimestamp()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// zones are registered once per call site, name has to outlive the profiler
+uint32_t registerProfileZone(const char* name);
+
+void recordProfileZone(uint32_t zone, uint64_t begin, uint64_t end);
+
+class ProfileZone
+{
+public:
+    explicit ProfileZone(uint32_t zone)
+        : zone_(zone)
+        , begin_(profileTimestamp())
+    {
+    }
+
+    ~ProfileZone()
+    {
+        recordProfileZone(zone_, begin_, profileTimestamp());
+    }
+
+private:
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+    uint32_t zone_;
+    uint64_t begin_;
+};
+
+// shows up as the thread's name in traces, name is copied
+void setProfileThreadName(const char* name);
+
+// collects the zones recorded since the last call as one frame
+void endProfileFrame();
+
+// time a zone took per frame, over the frames it ran in out of the last
+// profileStatsFrames
+struct ProfileZoneStats
+{
+    const char* name;
+    uint32_t frames;
+    double minTime; // seconds
+    double averageTime;
+    double p99Time;
+};
+
+constexpr uint32_t profileStatsFrames = 256;
+
+void profileZoneStats(std::vector<ProfileZoneStats>& stats);
+
+// writes the events still held by the rings as Chrome trace event JSON,
+// load it in chrome://tracing or Perfetto
+bool exportChromeTrace(const char* path);
+
+// seconds one zone costs, measured with an empty zone
+double measureProfileZoneOverhead(uint32_t iterations);
+
+#if defined(DXP_PROFILE)
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#define PROFILE_ZONE(name) \
+    static const uint32_t PROFILE_CONCAT(profileZoneId_, __LINE__) = registerProfileZone(name); \
+    ProfileZone PROFILE_CONCAT(profileZone_, __LINE__)(PROFILE_CONCAT(profileZoneId_, __LINE__))
+
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#define PROFILE_THREAD(name) setProfileThreadName(name)
+#define PROFILE_FRAME() endProfileFrame()
+
+#else
+
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD(name)
+#define PROFILE_FRAME()
+
+#endif // defined(DXP_PROFILE)
+
+#endif // PROFILER_H
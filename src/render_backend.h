@@ -0,0 +1,32 @@
+#if !defined(RENDER_BACKEND_H)
+#define RENDER_BACKEND_H
+
+#include "render_packets.h"
+
+#include <cstdint>
+
+// A frame runs in three stages, the scene's update -> buildRenderPackets
+// -> the backend's render, which may each run on their own thread. The
+// stages hand a frame over through a slot, a slot must not go back to
+// update before render is done with it.
+constexpr uint32_t frameSlotCount_ = 3;
+
+// what the frame loop needs from the API side. The scene only talks to the
+// backend through the packets it queues.
+class RenderBackend
+{
+public:
+    virtual ~RenderBackend() {}
+
+    // frames the CPU may queue ahead of the GPU
+    virtual void setFramesInFlight(uint32_t count) = 0;
+
+    // material the scene draws with until it brings its own
+    virtual uint32_t defaultMaterialIndex() = 0;
+
+    // translates the next frame of packets and submits it, false if the
+    // frame could not be rendered
+    virtual bool render(RenderPacketQueue& packets, uint32_t slot) = 0;
+};
+
+#endif // RENDER_BACKEND_H
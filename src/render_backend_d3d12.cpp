@@ -0,0 +1,20 @@
+#include "render_backend_d3d12.h"
+
+#include "dx.h"
+
+void D3D12RenderBackend::setFramesInFlight(uint32_t count)
+{
+    ::setFramesInFlight(static_cast<int>(count));
+}
+
+uint32_t D3D12RenderBackend::defaultMaterialIndex()
+{
+    return ::defaultMaterialIndex();
+}
+
+bool D3D12RenderBackend::render(RenderPacketQueue& packets, uint32_t slot)
+{
+    // failures go to the error callback passed to initd3d
+    ::render(packets, slot);
+    return true;
+}
@@ -0,0 +1,16 @@
+#if !defined(RENDER_BACKEND_D3D12_H)
+#define RENDER_BACKEND_D3D12_H
+
+#include "render_backend.h"
+
+// the renderer in dx.h behind the backend interface, initd3d has to have
+// succeeded before it is used
+class D3D12RenderBackend : public RenderBackend
+{
+public:
+    void setFramesInFlight(uint32_t count) override;
+    uint32_t defaultMaterialIndex() override;
+    bool render(RenderPacketQueue& packets, uint32_t slot) override;
+};
+
+#endif // RENDER_BACKEND_D3D12_H
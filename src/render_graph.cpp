@@ -0,0 +1,483 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <chrono>
+
+// states that can be combined and held by a resource for several readers
+static const uint32_t readOnlyStates = ResourceStateDepthRead | ResourceStateShaderResource | ResourceStateCopySource;
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+NullRenderGraphExecutor::NullRenderGraphExecutor()
+    : passCount(0)
+    , barrierCount(0)
+{
+}
+
+void NullRenderGraphExecutor::barriers(const RenderGraph& graph, const RenderGraphBarrier* barriers, uint32_t count)
+{
+    (void)graph;
+    (void)barriers;
+    barrierCount += count;
+}
+
+void NullRenderGraphExecutor::beginPass(const char* name)
+{
+    (void)name;
+    passCount++;
+}
+
+void NullRenderGraphExecutor::endPass()
+{
+}
+
+RenderGraph::RenderGraph()
+    : finalBarrierStart_(0)
+    , stats_()
+{
+}
+
+void RenderGraph::reset()
+{
+    passes_.clear();
+    resources_.clear();
+    accesses_.clear();
+    passOfAccess_.clear();
+    barriers_.clear();
+    finalBarrierStart_ = 0;
+    stats_ = RenderGraphStats();
+}
+
+RenderGraphResource RenderGraph::createTransient(const char* name, uint64_t sizeBytes, uint64_t alignment, const void* desc)
+{
+    Resource resource = {};
+    resource.name = name;
+    resource.desc = desc;
+    resource.sizeBytes = sizeBytes;
+    resource.alignment = alignment;
+    resource.initialState = ResourceStateUndefined;
+    resource.finalState = ResourceStateUndefined;
+    resource.imported = false;
+    resources_.push_back(resource);
+
+    return static_cast<RenderGraphResource>(resources_.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importResource(const char* name, void* physical, uint32_t initialState, uint32_t finalState)
+{
+    Resource resource = {};
+    resource.name = name;
+    resource.physical = physical;
+    resource.initialState = initialState;
+    resource.finalState = finalState;
+    resource.imported = true;
+    resources_.push_back(resource);
+
+    return static_cast<RenderGraphResource>(resources_.size() - 1);
+}
+
+RenderGraphPass RenderGraph::addPass(const char* name, ExecuteFn execute)
+{
+    Pass pass = {};
+    pass.name = name;
+    pass.execute = std::move(execute);
+    passes_.push_back(std::move(pass));
+
+    return static_cast<RenderGraphPass>(passes_.size() - 1);
+}
+
+void RenderGraph::read(RenderGraphPass pass, RenderGraphResource resource, uint32_t state)
+{
+    // accesses are grouped by pass in compile(), so passes can declare them
+    // in any order
+    accesses_.push_back({ resource, state, false });
+    passOfAccess_.push_back(pass);
+}
+
+void RenderGraph::write(RenderGraphPass pass, RenderGraphResource resource, uint32_t state)
+{
+    accesses_.push_back({ resource, state, true });
+    passOfAccess_.push_back(pass);
+}
+
+void RenderGraph::setSideEffect(RenderGraphPass pass)
+{
+    passes_[pass].sideEffect = true;
+}
+
+bool RenderGraph::compile()
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    stats_ = RenderGraphStats();
+    stats_.passCount = static_cast<uint32_t>(passes_.size());
+    barriers_.clear();
+
+    // group accesses by pass, keeping declaration order inside a pass
+    std::vector<uint32_t> order(accesses_.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return passOfAccess_[a] < passOfAccess_[b]; });
+
+    std::vector<Access> sorted(accesses_.size());
+    std::vector<RenderGraphPass> sortedPasses(accesses_.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        sorted[i] = accesses_[order[i]];
+        sortedPasses[i] = passOfAccess_[order[i]];
+    }
+    accesses_.swap(sorted);
+    passOfAccess_.swap(sortedPasses);
+
+    for (Pass& pass : passes_) {
+        pass.firstAccess = 0;
+        pass.accessCount = 0;
+    }
+    for (uint32_t i = static_cast<uint32_t>(accesses_.size()); i > 0; --i) {
+        Pass& pass = passes_[passOfAccess_[i - 1]];
+        pass.firstAccess = i - 1;
+        pass.accessCount++;
+    }
+
+    // passes are executed in declaration order, reads see the writes of
+    // earlier passes, so that order is the dependency order by definition
+    cullPasses();
+
+    if (!computeLifetimes())
+        return false;
+
+    placeTransients();
+    placeBarriers();
+
+    const auto end = std::chrono::steady_clock::now();
+    stats_.compileMicroseconds = std::chrono::duration<double, std::micro>(end - start).count();
+
+    return true;
+}
+
+void RenderGraph::execute(RenderGraphExecutor& executor) const
+{
+    for (const Pass& pass : passes_) {
+        if (!pass.alive)
+            continue;
+
+        if (pass.barrierCount > 0)
+            executor.barriers(*this, &barriers_[pass.firstBarrier], pass.barrierCount);
+
+        executor.beginPass(pass.name);
+        if (pass.execute)
+            pass.execute();
+        executor.endPass();
+    }
+
+    const uint32_t finalCount = static_cast<uint32_t>(barriers_.size()) - finalBarrierStart_;
+    if (finalCount > 0)
+        executor.barriers(*this, &barriers_[finalBarrierStart_], finalCount);
+}
+
+void RenderGraph::cullPasses()
+{
+    // walk passes back to front, a pass survives if it has side effects or
+    // writes something a surviving later pass (or the outside world, for
+    // imported resources) still needs
+    std::vector<bool> needed(resources_.size());
+    for (size_t i = 0; i < resources_.size(); ++i)
+        needed[i] = resources_[i].imported;
+
+    for (size_t p = passes_.size(); p > 0; --p) {
+        Pass& pass = passes_[p - 1];
+
+        bool alive = pass.sideEffect;
+        for (uint32_t i = 0; i < pass.accessCount && !alive; ++i) {
+            const Access& access = accesses_[pass.firstAccess + i];
+            alive = access.write && needed[access.resource];
+        }
+
+        pass.alive = alive;
+        if (!alive) {
+            stats_.culledPassCount++;
+            continue;
+        }
+
+        // writes satisfy the need for the current contents, reads create a
+        // need for whatever was written before this pass
+        for (uint32_t i = 0; i < pass.accessCount; ++i) {
+            const Access& access = accesses_[pass.firstAccess + i];
+            if (access.write)
+                needed[access.resource] = false;
+        }
+        for (uint32_t i = 0; i < pass.accessCount; ++i) {
+            const Access& access = accesses_[pass.firstAccess + i];
+            if (!access.write)
+                needed[access.resource] = true;
+        }
+    }
+}
+
+bool RenderGraph::computeLifetimes()
+{
+    for (Resource& resource : resources_) {
+        resource.firstPass = RenderGraphNoPass;
+        resource.lastPass = RenderGraphNoPass;
+    }
+
+    for (uint32_t p = 0; p < passes_.size(); ++p) {
+        const Pass& pass = passes_[p];
+        if (!pass.alive)
+            continue;
+
+        for (uint32_t i = 0; i < pass.accessCount; ++i) {
+            const Access& access = accesses_[pass.firstAccess + i];
+            Resource& resource = resources_[access.resource];
+
+            if (resource.firstPass == RenderGraphNoPass) {
+                // transient contents are undefined until somebody writes them
+                if (!resource.imported && !access.write)
+                    return false;
+
+                resource.firstPass = p;
+                if (!resource.imported)
+                    resource.initialState = access.state;
+            }
+
+            resource.lastPass = p;
+        }
+    }
+
+    return true;
+}
+
+void RenderGraph::placeTransients()
+{
+    std::vector<RenderGraphResource> transients;
+    for (uint32_t i = 0; i < resources_.size(); ++i) {
+        Resource& resource = resources_[i];
+        resource.heapOffset = 0;
+
+        if (!resource.imported && resource.firstPass != RenderGraphNoPass) {
+            transients.push_back(i);
+            stats_.transientBytes += resource.sizeBytes;
+        }
+    }
+
+    // biggest first, smaller resources then fill the gaps between them
+    std::sort(transients.begin(), transients.end(), [this](RenderGraphResource a, RenderGraphResource b) {
+        if (resources_[a].sizeBytes != resources_[b].sizeBytes)
+            return resources_[a].sizeBytes > resources_[b].sizeBytes;
+        return a < b;
+    });
+
+    struct Interval
+    {
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    std::vector<RenderGraphResource> placed;
+    std::vector<Interval> occupied;
+
+    for (RenderGraphResource index : transients) {
+        Resource& resource = resources_[index];
+
+        // memory of resources alive at the same time can not be shared
+        occupied.clear();
+        for (RenderGraphResource other : placed) {
+            const Resource& o = resources_[other];
+            if (o.firstPass <= resource.lastPass && resource.firstPass <= o.lastPass)
+                occupied.push_back({ o.heapOffset, o.heapOffset + o.sizeBytes });
+        }
+        std::sort(occupied.begin(), occupied.end(), [](const Interval& a, const Interval& b) { return a.begin < b.begin; });
+
+        uint64_t offset = 0;
+        for (const Interval& interval : occupied) {
+            if (offset + resource.sizeBytes <= interval.begin)
+                break;
+            offset = std::max(offset, alignUp(interval.end, resource.alignment));
+        }
+
+        resource.heapOffset = offset;
+        stats_.aliasedHeapBytes = std::max(stats_.aliasedHeapBytes, offset + resource.sizeBytes);
+        placed.push_back(index);
+    }
+
+    stats_.savedBytes = stats_.transientBytes - stats_.aliasedHeapBytes;
+}
+
+void RenderGraph::placeBarriers()
+{
+    std::vector<uint32_t> current(resources_.size());
+    for (size_t i = 0; i < resources_.size(); ++i)
+        current[i] = resources_[i].imported ? resources_[i].initialState : ResourceStateUndefined;
+
+    for (uint32_t p = 0; p < passes_.size(); ++p) {
+        Pass& pass = passes_[p];
+        pass.firstBarrier = static_cast<uint32_t>(barriers_.size());
+        pass.barrierCount = 0;
+
+        if (!pass.alive)
+            continue;
+
+        for (uint32_t i = 0; i < pass.accessCount; ++i) {
+            const Access& access = accesses_[pass.firstAccess + i];
+            const RenderGraphResource r = access.resource;
+            const Resource& resource = resources_[r];
+
+            // a resource used several times by one pass needs all the states
+            // at once, handle it on its first access only
+            bool seen = false;
+            uint32_t required = 0;
+            for (uint32_t j = 0; j < pass.accessCount; ++j) {
+                const Access& other = accesses_[pass.firstAccess + j];
+                if (other.resource != r)
+                    continue;
+                if (j < i)
+                    seen = true;
+                required |= other.state;
+            }
+            if (seen)
+                continue;
+
+            if (!resource.imported && resource.firstPass == p) {
+                // find the last resource that occupied overlapping memory,
+                // it has to be retired with an aliasing barrier
+                RenderGraphResource before = InvalidRenderGraphResource;
+                uint32_t beforeLastPass = 0;
+                bool overlaps = false;
+                for (uint32_t o = 0; o < resources_.size(); ++o) {
+                    const Resource& other = resources_[o];
+                    if (o == r || other.imported || other.firstPass == RenderGraphNoPass || other.lastPass >= p)
+                        continue;
+                    if (other.heapOffset < resource.heapOffset + resource.sizeBytes && resource.heapOffset < other.heapOffset + other.sizeBytes) {
+                        if (!overlaps || other.lastPass > beforeLastPass) {
+                            before = o;
+                            beforeLastPass = other.lastPass;
+                        }
+                        overlaps = true;
+                    }
+                }
+
+                if (overlaps) {
+                    barriers_.push_back({ RenderGraphBarrierAliasing, r, before, 0, 0 });
+                    stats_.aliasingBarrierCount++;
+                }
+
+                current[r] = resource.initialState;
+            }
+
+            const bool covered = (current[r] & readOnlyStates) == current[r] && (current[r] & required) == required;
+            if (current[r] != required && !covered) {
+                barriers_.push_back({ RenderGraphBarrierTransition, r, InvalidRenderGraphResource, current[r], required });
+                stats_.barrierCount++;
+                current[r] = required;
+            }
+        }
+
+        pass.barrierCount = static_cast<uint32_t>(barriers_.size()) - pass.firstBarrier;
+    }
+
+    // hand imported resources back in the state the outside world expects
+    // and put transients back into their placement state for the next frame
+    finalBarrierStart_ = static_cast<uint32_t>(barriers_.size());
+    for (uint32_t r = 0; r < resources_.size(); ++r) {
+        const Resource& resource = resources_[r];
+        if (!resource.imported && resource.firstPass == RenderGraphNoPass)
+            continue;
+
+        const uint32_t target = resource.imported ? resource.finalState : resource.initialState;
+        if (current[r] != target) {
+            barriers_.push_back({ RenderGraphBarrierTransition, r, InvalidRenderGraphResource, current[r], target });
+            stats_.barrierCount++;
+        }
+    }
+}
+
+RenderGraphBenchmark measureRenderGraph(uint32_t passCount, uint32_t iterations)
+{
+    RenderGraphBenchmark result = {};
+    result.iterations = iterations;
+    if (passCount == 0 || iterations == 0)
+        return result;
+
+    static int backBuffer = 0;
+    const uint64_t alignment = 64 * 1024;
+
+    RenderGraph graph;
+    std::vector<RenderGraphResource> chain;
+    std::vector<RenderGraphPass> debugPasses;
+    double buildSeconds = 0.0;
+    double compileMicroseconds = 0.0;
+
+    for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+        const auto start = std::chrono::steady_clock::now();
+
+        graph.reset();
+        chain.clear();
+        debugPasses.clear();
+
+        const RenderGraphResource output = graph.importResource("BackBuffer", &backBuffer, ResourceStatePresent, ResourceStatePresent);
+        for (uint32_t i = 0; i < passCount; ++i) {
+            const RenderGraphPass pass = graph.addPass("Pass", nullptr);
+            if (chain.size() >= 1)
+                graph.read(pass, chain[chain.size() - 1], ResourceStateShaderResource);
+            if (chain.size() >= 4)
+                graph.read(pass, chain[chain.size() - 4], ResourceStateShaderResource);
+
+            // 64 KB to 4 MB targets, some written by compute
+            const uint64_t size = alignment * (1 + (i * 7) % 64);
+            const RenderGraphResource target = graph.createTransient("Target", size, alignment);
+            graph.write(pass, target, i % 3 == 0 ? ResourceStateUnorderedAccess : ResourceStateRenderTarget);
+
+            if (i % 8 == 7)
+                debugPasses.push_back(pass);
+            else
+                chain.push_back(target);
+        }
+
+        const RenderGraphPass present = graph.addPass("Present", nullptr);
+        if (!chain.empty())
+            graph.read(present, chain.back(), ResourceStateShaderResource);
+        graph.write(present, output, ResourceStateRenderTarget);
+
+        const auto built = std::chrono::steady_clock::now();
+        buildSeconds += std::chrono::duration<double>(built - start).count();
+
+        if (!graph.compile()) {
+            result.failedCompiles++;
+            continue;
+        }
+        compileMicroseconds += graph.stats().compileMicroseconds;
+    }
+
+    result.stats = graph.stats();
+    result.buildMicroseconds = buildSeconds * 1e6 / iterations;
+    if (result.failedCompiles < iterations)
+        result.stats.compileMicroseconds = compileMicroseconds / (iterations - result.failedCompiles);
+
+    // the last frame: only debug views are culled, and transients that are
+    // alive at the same time do not share memory
+    if (result.stats.culledPassCount != debugPasses.size())
+        result.mismatches++;
+    for (RenderGraphPass pass : debugPasses) {
+        if (!graph.isCulled(pass))
+            result.mismatches++;
+    }
+
+    for (RenderGraphResource a = 0; a < graph.resourceCount(); ++a) {
+        if (!graph.isTransient(a) || graph.firstPass(a) == RenderGraphNoPass)
+            continue;
+
+        for (RenderGraphResource b = a + 1; b < graph.resourceCount(); ++b) {
+            if (!graph.isTransient(b) || graph.firstPass(b) == RenderGraphNoPass)
+                continue;
+
+            const bool together = graph.firstPass(a) <= graph.lastPass(b) && graph.firstPass(b) <= graph.lastPass(a);
+            const bool shared = graph.heapOffset(a) < graph.heapOffset(b) + graph.resourceSize(b) && graph.heapOffset(b) < graph.heapOffset(a) + graph.resourceSize(a);
+            if (together && shared)
+                result.mismatches++;
+        }
+    }
+
+    return result;
+}
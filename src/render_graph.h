@@ -0,0 +1,205 @@
+#if !defined(RENDER_GRAPH_H)
+#define RENDER_GRAPH_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Frame graph: passes declare which virtual resources they read and write,
+// compile() culls passes that do not contribute to an imported resource,
+// places state transitions and packs transient resources with disjoint
+// lifetimes into one aliased heap. Nothing in here depends on D3D12, the
+// executor translates barriers and owns the physical resources.
+//
+// Passes run in the order they were added, compile() does not reorder them.
+// A read sees what the last pass added before it wrote to the resource, so
+// declaration order is what defines the dependencies: producers have to be
+// added before their consumers, and compile() fails if a transient is read
+// before anything wrote it.
+
+typedef uint32_t RenderGraphResource;
+typedef uint32_t RenderGraphPass;
+
+constexpr RenderGraphResource InvalidRenderGraphResource = 0xffffffff;
+
+// firstPass()/lastPass() of resources no surviving pass touches
+constexpr uint32_t RenderGraphNoPass = 0xffffffff;
+
+// bit mask, read states can be combined
+enum ResourceState : uint32_t
+{
+    ResourceStateUndefined = 0,
+    ResourceStatePresent = 1 << 0,
+    ResourceStateRenderTarget = 1 << 1,
+    ResourceStateDepthWrite = 1 << 2,
+    ResourceStateDepthRead = 1 << 3,
+    ResourceStateShaderResource = 1 << 4,
+    ResourceStateUnorderedAccess = 1 << 5,
+    ResourceStateCopySource = 1 << 6,
+    ResourceStateCopyDest = 1 << 7,
+};
+
+enum RenderGraphBarrierType
+{
+    RenderGraphBarrierTransition,
+    RenderGraphBarrierAliasing,
+};
+
+struct RenderGraphBarrier
+{
+    RenderGraphBarrierType type;
+    RenderGraphResource resource;
+    RenderGraphResource aliasedBefore; // aliasing only, may be invalid
+    uint32_t stateBefore;
+    uint32_t stateAfter;
+};
+
+struct RenderGraphStats
+{
+    uint32_t passCount;
+    uint32_t culledPassCount;
+    uint32_t barrierCount;
+    uint32_t aliasingBarrierCount;
+    uint64_t transientBytes;     // sum of all live transient sizes
+    uint64_t aliasedHeapBytes;   // size of the heap they were packed into
+    uint64_t savedBytes;
+    double compileMicroseconds;
+};
+
+class RenderGraph;
+
+class RenderGraphExecutor
+{
+public:
+    virtual ~RenderGraphExecutor() {}
+
+    virtual void barriers(const RenderGraph& graph, const RenderGraphBarrier* barriers, uint32_t count) = 0;
+    virtual void beginPass(const char* name) = 0;
+    virtual void endPass() = 0;
+};
+
+// Accepts everything and only counts, used to run the graph without a GPU
+class NullRenderGraphExecutor : public RenderGraphExecutor
+{
+public:
+    NullRenderGraphExecutor();
+
+    void barriers(const RenderGraph& graph, const RenderGraphBarrier* barriers, uint32_t count) override;
+    void beginPass(const char* name) override;
+    void endPass() override;
+
+    uint32_t passCount;
+    uint32_t barrierCount;
+};
+
+class RenderGraph
+{
+public:
+    typedef std::function<void()> ExecuteFn;
+
+    RenderGraph();
+
+    // clears passes and resources, keeps allocated memory for the next frame
+    void reset();
+
+    // desc is an opaque, executor specific description of the resource
+    RenderGraphResource createTransient(const char* name, uint64_t sizeBytes, uint64_t alignment, const void* desc = nullptr);
+    RenderGraphResource importResource(const char* name, void* physical, uint32_t initialState, uint32_t finalState);
+
+    // passes execute in the order they are added
+    RenderGraphPass addPass(const char* name, ExecuteFn execute);
+
+    // a pass that loads or blends into a target has to declare both
+    void read(RenderGraphPass pass, RenderGraphResource resource, uint32_t state);
+    void write(RenderGraphPass pass, RenderGraphResource resource, uint32_t state);
+
+    // pass is never culled, e.g. readback or queries
+    void setSideEffect(RenderGraphPass pass);
+
+    // false if a pass reads a transient that nothing wrote before it
+    bool compile();
+    void execute(RenderGraphExecutor& executor) const;
+
+    // valid after compile()
+    bool isCulled(RenderGraphPass pass) const { return !passes_[pass].alive; }
+    uint64_t heapOffset(RenderGraphResource resource) const { return resources_[resource].heapOffset; }
+    uint32_t initialState(RenderGraphResource resource) const { return resources_[resource].initialState; }
+    uint32_t firstPass(RenderGraphResource resource) const { return resources_[resource].firstPass; }
+    uint32_t lastPass(RenderGraphResource resource) const { return resources_[resource].lastPass; }
+    const RenderGraphStats& stats() const { return stats_; }
+
+    uint32_t resourceCount() const { return static_cast<uint32_t>(resources_.size()); }
+    bool isTransient(RenderGraphResource resource) const { return !resources_[resource].imported; }
+    const char* resourceName(RenderGraphResource resource) const { return resources_[resource].name; }
+    uint64_t resourceSize(RenderGraphResource resource) const { return resources_[resource].sizeBytes; }
+    const void* resourceDesc(RenderGraphResource resource) const { return resources_[resource].desc; }
+
+    // executors bind physical resources to transients once they are placed
+    void* physical(RenderGraphResource resource) const { return resources_[resource].physical; }
+    void setPhysical(RenderGraphResource resource, void* physical) { resources_[resource].physical = physical; }
+
+private:
+    struct Access
+    {
+        RenderGraphResource resource;
+        uint32_t state;
+        bool write;
+    };
+
+    struct Pass
+    {
+        const char* name;
+        ExecuteFn execute;
+        uint32_t firstAccess;
+        uint32_t accessCount;
+        uint32_t firstBarrier;
+        uint32_t barrierCount;
+        bool sideEffect;
+        bool alive;
+    };
+
+    struct Resource
+    {
+        const char* name;
+        const void* desc;
+        void* physical;
+        uint64_t sizeBytes;
+        uint64_t alignment;
+        uint64_t heapOffset;
+        uint32_t initialState;
+        uint32_t finalState;
+        uint32_t firstPass;
+        uint32_t lastPass;
+        bool imported;
+    };
+
+    void cullPasses();
+    bool computeLifetimes();
+    void placeTransients();
+    void placeBarriers();
+
+    std::vector<Pass> passes_;
+    std::vector<Resource> resources_;
+    std::vector<Access> accesses_;
+    std::vector<RenderGraphPass> passOfAccess_;
+    std::vector<RenderGraphBarrier> barriers_;
+    uint32_t finalBarrierStart_;
+    RenderGraphStats stats_;
+};
+
+struct RenderGraphBenchmark
+{
+    uint32_t iterations;
+    RenderGraphStats stats;   // of the last compile, compileMicroseconds is the average
+    double buildMicroseconds; // declaring passes and resources, on average
+    uint32_t failedCompiles;
+    uint32_t mismatches;      // culled live passes, kept dead ones or overlapping placements
+};
+
+// builds and compiles a frame of passCount passes every iteration, like the
+// renderer does. Every pass reads the output of the previous pass and of the
+// one four passes back, every eighth pass writes a debug view nothing reads
+// and gets culled.
+RenderGraphBenchmark measureRenderGraph(uint32_t passCount, uint32_t iterations);
+
+#endif // RENDER_GRAPH_H
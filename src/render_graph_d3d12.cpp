@@ -0,0 +1,155 @@
+#include "render_graph_d3d12.h"
+
+#include <cstring>
+
+D3D12_RESOURCE_STATES toD3D12ResourceStates(uint32_t state)
+{
+    // present (and undefined) map to D3D12_RESOURCE_STATE_COMMON
+    uint32_t result = D3D12_RESOURCE_STATE_COMMON;
+
+    if (state & ResourceStateRenderTarget)
+        result |= D3D12_RESOURCE_STATE_RENDER_TARGET;
+    if (state & ResourceStateDepthWrite)
+        result |= D3D12_RESOURCE_STATE_DEPTH_WRITE;
+    if (state & ResourceStateDepthRead)
+        result |= D3D12_RESOURCE_STATE_DEPTH_READ;
+    if (state & ResourceStateShaderResource)
+        result |= D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+    if (state & ResourceStateUnorderedAccess)
+        result |= D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+    if (state & ResourceStateCopySource)
+        result |= D3D12_RESOURCE_STATE_COPY_SOURCE;
+    if (state & ResourceStateCopyDest)
+        result |= D3D12_RESOURCE_STATE_COPY_DEST;
+
+    return static_cast<D3D12_RESOURCE_STATES>(result);
+}
+
+D3D12RenderGraphExecutor::D3D12RenderGraphExecutor(ID3D12GraphicsCommandList* commandList, CommandCapture* capture)
+    : commandList_(commandList, capture)
+{
+}
+
+void D3D12RenderGraphExecutor::barriers(const RenderGraph& graph, const RenderGraphBarrier* barriers, uint32_t count)
+{
+    scratch_.clear();
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const RenderGraphBarrier& barrier = barriers[i];
+        ID3D12Resource* resource = static_cast<ID3D12Resource*>(graph.physical(barrier.resource));
+
+        D3D12_RESOURCE_BARRIER d3dBarrier = {};
+        if (barrier.type == RenderGraphBarrierAliasing) {
+            d3dBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+            d3dBarrier.Aliasing.pResourceBefore = barrier.aliasedBefore != InvalidRenderGraphResource
+                ? static_cast<ID3D12Resource*>(graph.physical(barrier.aliasedBefore))
+                : nullptr;
+            d3dBarrier.Aliasing.pResourceAfter = resource;
+        } else {
+            d3dBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            d3dBarrier.Transition.pResource = resource;
+            d3dBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+            d3dBarrier.Transition.StateBefore = toD3D12ResourceStates(barrier.stateBefore);
+            d3dBarrier.Transition.StateAfter = toD3D12ResourceStates(barrier.stateAfter);
+        }
+
+        scratch_.push_back(d3dBarrier);
+    }
+
+    commandList_.resourceBarrier(static_cast<UINT>(scratch_.size()), scratch_.data());
+}
+
+void D3D12RenderGraphExecutor::beginPass(const char* name)
+{
+    UNREFERENCED_PARAMETER(name);
+}
+
+void D3D12RenderGraphExecutor::endPass()
+{
+}
+
+static void releaseComObject(void* object)
+{
+    static_cast<IUnknown*>(object)->Release();
+}
+
+D3D12TransientHeap::D3D12TransientHeap()
+    : heapSize_(0)
+{
+}
+
+bool D3D12TransientHeap::realize(ID3D12Device* device, RenderGraph& graph, DeferredReleaseQueue& deferredRelease, uint64_t fenceValue)
+{
+    const uint64_t required = graph.stats().aliasedHeapBytes;
+    if (required == 0)
+        return true;
+
+    if (required > heapSize_) {
+        // frames in flight may still use the old resources
+        for (Placed& placed : placed_)
+            deferredRelease.retire(placed.resource.Detach(), releaseComObject, fenceValue);
+        placed_.clear();
+        if (heap_)
+            deferredRelease.retire(heap_.Detach(), releaseComObject, fenceValue);
+        heapSize_ = 0;
+
+        // resource heap tier 1 only allows one resource category per heap,
+        // transients are render and depth targets
+        D3D12_HEAP_DESC heapDesc = {};
+        heapDesc.SizeInBytes = required;
+        heapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+        heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+
+        HRESULT result = device->CreateHeap(&heapDesc, IID_PPV_ARGS(heap_.GetAddressOf()));
+        if (FAILED(result))
+            return false;
+        heap_->SetName(L"RenderGraphTransientHeap");
+
+        heapSize_ = required;
+    }
+
+    for (RenderGraphResource r = 0; r < graph.resourceCount(); ++r) {
+        if (!graph.isTransient(r) || graph.firstPass(r) == RenderGraphNoPass)
+            continue;
+
+        const D3D12_RESOURCE_DESC* desc = static_cast<const D3D12_RESOURCE_DESC*>(graph.resourceDesc(r));
+        if (!desc)
+            return false;
+
+        const uint64_t offset = graph.heapOffset(r);
+        const uint32_t initialState = graph.initialState(r);
+
+        ID3D12Resource* resource = nullptr;
+        for (const Placed& placed : placed_) {
+            if (placed.offset == offset && placed.initialState == initialState && memcmp(&placed.desc, desc, sizeof(*desc)) == 0) {
+                resource = placed.resource.Get();
+                break;
+            }
+        }
+
+        if (!resource) {
+            Placed placed = {};
+            placed.offset = offset;
+            placed.desc = *desc;
+            placed.initialState = initialState;
+
+            HRESULT result = device->CreatePlacedResource(
+                heap_.Get(),
+                offset,
+                desc,
+                toD3D12ResourceStates(initialState),
+                nullptr,
+                IID_PPV_ARGS(placed.resource.GetAddressOf()));
+            if (FAILED(result))
+                return false;
+
+            resource = placed.resource.Get();
+            placed_.push_back(placed);
+        }
+
+        graph.setPhysical(r, resource);
+    }
+
+    return true;
+}
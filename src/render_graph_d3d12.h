@@ -0,0 +1,64 @@
+#if !defined(RENDER_GRAPH_D3D12_H)
+#define RENDER_GRAPH_D3D12_H
+
+#include "command_capture_d3d12.h"
+#include "deferred_release.h"
+#include "render_graph.h"
+
+#include <vector>
+
+#include <d3d12.h>
+#include <wrl/client.h>
+
+D3D12_RESOURCE_STATES toD3D12ResourceStates(uint32_t state);
+
+// Records the barriers of a compiled graph into a command list. Physical
+// resources of the graph are expected to be ID3D12Resource pointers.
+class D3D12RenderGraphExecutor : public RenderGraphExecutor
+{
+public:
+    // barriers go into capture as well unless it is null
+    D3D12RenderGraphExecutor(ID3D12GraphicsCommandList* commandList, CommandCapture* capture);
+
+    // passes may close the list and continue in another one, barriers after
+    // the pass go into the new list
+    void setCommandList(ID3D12GraphicsCommandList* commandList, CommandCapture* capture) { commandList_ = D3D12CapturedList(commandList, capture); }
+
+    void barriers(const RenderGraph& graph, const RenderGraphBarrier* barriers, uint32_t count) override;
+    void beginPass(const char* name) override;
+    void endPass() override;
+
+private:
+    D3D12CapturedList commandList_;
+    std::vector<D3D12_RESOURCE_BARRIER> scratch_;
+};
+
+// Backs the transients of a compiled graph with placed resources in one
+// heap. Transient descs have to point at a D3D12_RESOURCE_DESC. Placed
+// resources are cached by offset and desc, so a graph that does not change
+// between frames does not create anything after the first one.
+class D3D12TransientHeap
+{
+public:
+    D3D12TransientHeap();
+
+    // growing the heap drops every cached resource, they and the old heap
+    // are retired to deferredRelease with fenceValue, the value of the last
+    // submission that may still use them
+    bool realize(ID3D12Device* device, RenderGraph& graph, DeferredReleaseQueue& deferredRelease, uint64_t fenceValue);
+
+private:
+    struct Placed
+    {
+        uint64_t offset;
+        D3D12_RESOURCE_DESC desc;
+        uint32_t initialState;
+        Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+    };
+
+    Microsoft::WRL::ComPtr<ID3D12Heap> heap_;
+    uint64_t heapSize_;
+    std::vector<Placed> placed_;
+};
+
+#endif // RENDER_GRAPH_D3D12_H
@@ -0,0 +1,213 @@
+#include "render_packets.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+static uint32_t roundUpToPowerOfTwo(uint32_t value)
+{
+    uint32_t result = 2;
+    while (result < value)
+        result *= 2;
+
+    return result;
+}
+
+RenderPacketQueue::RenderPacketQueue(uint32_t capacity)
+    : cells_(roundUpToPowerOfTwo(capacity))
+    , mask_(cells_.size() - 1)
+    , tail_(0)
+    , head_(0)
+    , sleeping_(false)
+{
+    for (size_t i = 0; i < cells_.size(); ++i)
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool RenderPacketQueue::tryPush(const RenderPacket& packet)
+{
+    uint64_t position = tail_.load(std::memory_order_relaxed);
+    Cell* cell;
+
+    for (;;) {
+        cell = &cells_[static_cast<size_t>(position & mask_)];
+        const uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const int64_t difference = static_cast<int64_t>(sequence - position);
+
+        if (difference == 0) {
+            // claim the cell, another producer may have beaten us to it
+            if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        } else if (difference < 0) {
+            // the consumer has not popped this cell a lap ago, full
+            return false;
+        } else {
+            position = tail_.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->packet = packet;
+    cell->sequence.store(position + 1, std::memory_order_seq_cst);
+
+    if (sleeping_.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        wake_.notify_one();
+    }
+
+    return true;
+}
+
+void RenderPacketQueue::push(const RenderPacket& packet)
+{
+    while (!tryPush(packet))
+        std::this_thread::yield();
+}
+
+bool RenderPacketQueue::tryPop(RenderPacket& packet)
+{
+    Cell& cell = cells_[static_cast<size_t>(head_ & mask_)];
+    if (cell.sequence.load(std::memory_order_acquire) != head_ + 1)
+        return false;
+
+    packet = cell.packet;
+
+    // free for the push one lap ahead
+    cell.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+    head_++;
+
+    return true;
+}
+
+void RenderPacketQueue::pop(RenderPacket& packet)
+{
+    // packets of a frame arrive in bursts, spinning briefly avoids a sleep
+    // between most of them
+    for (int i = 0; i < 64; ++i) {
+        if (tryPop(packet))
+            return;
+        std::this_thread::yield();
+    }
+
+    while (!tryPop(packet)) {
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        sleeping_.store(true, std::memory_order_seq_cst);
+        wake_.wait(lock, [&] { return isReadable(); });
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+}
+
+bool RenderPacketQueue::isReadable() const
+{
+    const Cell& cell = cells_[static_cast<size_t>(head_ & mask_)];
+    return cell.sequence.load(std::memory_order_seq_cst) == head_ + 1;
+}
+
+uint32_t translateFrame(RenderPacketQueue& queue, RenderPacketTranslator& translator)
+{
+    RenderPacket packet;
+    bool inFrame = false;
+
+    for (;;) {
+        queue.pop(packet);
+
+        switch (packet.type) {
+        case RenderPacketBeginFrame:
+            translator.beginFrame(packet.frameSlot);
+            inFrame = true;
+            break;
+        case RenderPacketDraw:
+            if (inFrame)
+                translator.draw(packet);
+            break;
+        case RenderPacketEndFrame:
+            if (inFrame) {
+                translator.endFrame();
+                return packet.frameSlot;
+            }
+            break;
+        }
+    }
+}
+
+RenderPacketBenchmark measureRenderPacketQueue(uint32_t producerCount, uint32_t frameCount, uint32_t drawsPerFrame)
+{
+    typedef std::chrono::duration<double> Seconds;
+    typedef std::chrono::steady_clock Clock;
+
+    RenderPacketBenchmark result = {};
+
+    RenderPacketQueue queue(4096);
+    NullRenderPacketTranslator translator;
+
+    producerCount = std::max(producerCount, 1u);
+
+    RenderPacket packet = {};
+    packet.type = RenderPacketDraw;
+
+    // throughput, the producers split each frame's draws between them
+    const auto start = Clock::now();
+
+    std::thread consumer([&] {
+        for (uint32_t frame = 0; frame < frameCount; ++frame)
+            translateFrame(queue, translator);
+    });
+
+    for (uint32_t frame = 0; frame < frameCount; ++frame) {
+        RenderPacket begin = {};
+        begin.type = RenderPacketBeginFrame;
+        begin.frameSlot = frame;
+        queue.push(begin);
+
+        std::vector<std::thread> producers;
+        for (uint32_t p = 0; p < producerCount; ++p) {
+            const uint32_t draws = drawsPerFrame / producerCount + (p < drawsPerFrame % producerCount ? 1 : 0);
+            producers.emplace_back([&queue, &packet, draws] {
+                for (uint32_t i = 0; i < draws; ++i)
+                    queue.push(packet);
+            });
+        }
+        for (std::thread& producer : producers)
+            producer.join();
+
+        RenderPacket end = {};
+        end.type = RenderPacketEndFrame;
+        end.frameSlot = frame;
+        queue.push(end);
+    }
+
+    consumer.join();
+
+    const double seconds = std::chrono::duration_cast<Seconds>(Clock::now() - start).count();
+    const uint64_t packets = translator.drawCount() + 2 * translator.frameCount();
+    if (seconds > 0.0)
+        result.packetsPerSecond = static_cast<double>(packets) / seconds;
+    result.missingDraws = static_cast<uint64_t>(frameCount) * drawsPerFrame - translator.drawCount();
+
+    // wakeup latency, the consumer is asleep by the time each frame arrives
+    const uint32_t wakeups = 100;
+    std::atomic<int64_t> pushTime(0);
+    double latencySum = 0.0;
+
+    consumer = std::thread([&] {
+        for (uint32_t i = 0; i < wakeups; ++i) {
+            RenderPacket received;
+            queue.pop(received);
+
+            const double latency = std::chrono::duration_cast<Seconds>(Clock::now().time_since_epoch() - Clock::duration(pushTime.load())).count();
+            latencySum += latency;
+            result.maxWakeupLatency = std::max(result.maxWakeupLatency, latency);
+        }
+    });
+
+    for (uint32_t i = 0; i < wakeups; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        pushTime.store(Clock::now().time_since_epoch().count());
+        queue.push(packet);
+    }
+
+    consumer.join();
+
+    result.averageWakeupLatency = latencySum / wakeups;
+
+    return result;
+}
@@ -0,0 +1,126 @@
+#if !defined(RENDER_PACKETS_H)
+#define RENDER_PACKETS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Compact draw packets the game side emits for the render thread. Packets
+// are plain data and go through a bounded lock-free queue, any number of
+// threads may push while the render thread pops and translates them into
+// API calls. A frame is a begin packet, its draws and an end packet, its
+// draws may come from several threads as long as they are all pushed
+// between the two.
+
+enum RenderPacketType : uint32_t
+{
+    RenderPacketBeginFrame = 0,
+    RenderPacketDraw,
+    RenderPacketEndFrame,
+};
+
+struct RenderPacket
+{
+    uint32_t type;
+    uint32_t frameSlot;
+    uint32_t materialIndex;
+    uint32_t meshIndex;            // draws of the same mesh and material are instanced
+    uint64_t sortKey;              // encodeDrawKey(), draws are submitted in key order
+    float worldViewProjection[16]; // already transposed for the GPU
+};
+
+class RenderPacketQueue
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit RenderPacketQueue(uint32_t capacity);
+
+    // false if the queue is full
+    bool tryPush(const RenderPacket& packet);
+
+    // yields until there is room
+    void push(const RenderPacket& packet);
+
+    // only one thread may pop
+    bool tryPop(RenderPacket& packet);
+
+    // spins a little, then sleeps until a packet arrives
+    void pop(RenderPacket& packet);
+
+private:
+    RenderPacketQueue(const RenderPacketQueue&) = delete;
+    RenderPacketQueue& operator=(const RenderPacketQueue&) = delete;
+
+    // a cell is free for the push at position p while sequence is p and
+    // holds a packet for the pop at p while sequence is p + 1
+    struct Cell
+    {
+        std::atomic<uint64_t> sequence;
+        RenderPacket packet;
+    };
+
+    bool isReadable() const;
+
+    std::vector<Cell> cells_;
+    uint64_t mask_;
+    std::atomic<uint64_t> tail_;
+    uint64_t head_;
+
+    // producers only take the lock when the consumer sleeps
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    std::atomic<bool> sleeping_;
+};
+
+class RenderPacketTranslator
+{
+public:
+    virtual ~RenderPacketTranslator() {}
+
+    virtual void beginFrame(uint32_t frameSlot) = 0;
+    virtual void draw(const RenderPacket& packet) = 0;
+    virtual void endFrame() = 0;
+};
+
+// counts what it is given, for measuring the queue alone
+class NullRenderPacketTranslator : public RenderPacketTranslator
+{
+public:
+    NullRenderPacketTranslator()
+        : frameCount_(0)
+        , drawCount_(0)
+    {
+    }
+
+    void beginFrame(uint32_t frameSlot) override { (void)frameSlot; }
+    void draw(const RenderPacket& packet) override { (void)packet; drawCount_++; }
+    void endFrame() override { frameCount_++; }
+
+    uint64_t frameCount() const { return frameCount_; }
+    uint64_t drawCount() const { return drawCount_; }
+
+private:
+    uint64_t frameCount_;
+    uint64_t drawCount_;
+};
+
+// pops packets up to and including the next end of frame, returns the slot
+// of that frame. Draws outside of a frame are dropped.
+uint32_t translateFrame(RenderPacketQueue& queue, RenderPacketTranslator& translator);
+
+struct RenderPacketBenchmark
+{
+    double packetsPerSecond;
+    uint64_t missingDraws;       // pushed but not translated, should be 0
+    double averageWakeupLatency; // seconds from a push to the sleeping consumer popping it
+    double maxWakeupLatency;
+};
+
+// producerCount threads push frames' worth of draws, framed by the calling
+// thread, into a null translator, then a single producer pushes packets one at a time to a
+// sleeping consumer to measure wakeups
+RenderPacketBenchmark measureRenderPacketQueue(uint32_t producerCount, uint32_t frameCount, uint32_t drawsPerFrame);
+
+#endif // RENDER_PACKETS_H
@@ -0,0 +1,251 @@
+#include "residency.h"
+
+#include <algorithm>
+
+// backend used by the simulation, it only counts what would be paged
+class CountingResidencyBackend : public ResidencyBackend
+{
+public:
+    CountingResidencyBackend()
+        : evictions(0)
+        , pageIns(0)
+    {
+    }
+
+    bool makeResident(void* const* objects, uint32_t count) override
+    {
+        (void)objects;
+        pageIns += count;
+        return true;
+    }
+
+    bool evict(void* const* objects, uint32_t count) override
+    {
+        (void)objects;
+        evictions += count;
+        return true;
+    }
+
+    uint64_t evictions;
+    uint64_t pageIns;
+};
+
+ResidencyManager::ResidencyManager()
+    : budget_(0)
+    , framesInFlight_(0)
+    , stats_()
+    , trace_(nullptr)
+{
+}
+
+void ResidencyManager::reset(uint64_t budgetBytes, uint32_t framesInFlight)
+{
+    entries_.clear();
+    freeHandles_.clear();
+    pendingResident_.clear();
+    budget_ = budgetBytes;
+    framesInFlight_ = framesInFlight;
+    stats_ = ResidencyStats();
+    stats_.budgetBytes = budgetBytes;
+}
+
+ResidencyHandle ResidencyManager::track(void* object, uint64_t sizeBytes, uint32_t priority)
+{
+    ResidencyHandle handle;
+    if (!freeHandles_.empty()) {
+        handle = freeHandles_.back();
+        freeHandles_.pop_back();
+    } else {
+        handle = static_cast<ResidencyHandle>(entries_.size());
+        entries_.push_back(Entry());
+    }
+
+    Entry& entry = entries_[handle];
+    entry.object = object;
+    entry.sizeBytes = sizeBytes;
+    entry.lastUsedFrame = 0;
+    entry.priority = priority;
+    entry.traceId = 0;
+    entry.resident = true;
+    entry.pending = false;
+    entry.tracked = true;
+
+    if (trace_) {
+        entry.traceId = static_cast<uint32_t>(trace_->resources.size());
+        trace_->resources.push_back({ sizeBytes, priority });
+    }
+
+    stats_.trackedBytes += sizeBytes;
+    stats_.residentBytes += sizeBytes;
+    stats_.residentCount++;
+
+    return handle;
+}
+
+void ResidencyManager::untrack(ResidencyHandle handle)
+{
+    Entry& entry = entries_[handle];
+    if (!entry.tracked)
+        return;
+
+    if (entry.resident) {
+        stats_.residentBytes -= entry.sizeBytes;
+        stats_.residentCount--;
+    }
+    stats_.trackedBytes -= entry.sizeBytes;
+
+    entry.object = nullptr;
+    entry.tracked = false;
+    entry.pending = false;
+    freeHandles_.push_back(handle);
+}
+
+void ResidencyManager::setPriority(ResidencyHandle handle, uint32_t priority)
+{
+    entries_[handle].priority = priority;
+}
+
+void ResidencyManager::markUsed(ResidencyHandle handle, uint64_t frame)
+{
+    Entry& entry = entries_[handle];
+    entry.lastUsedFrame = frame;
+
+    if (!entry.resident && !entry.pending) {
+        entry.pending = true;
+        pendingResident_.push_back(handle);
+    }
+
+    if (trace_)
+        trace_->uses.push_back({ frame, entry.traceId });
+}
+
+bool ResidencyManager::update(uint64_t frame, ResidencyBackend& backend)
+{
+    stats_.budgetBytes = budget_;
+    stats_.evictedCount = 0;
+    stats_.madeResidentCount = 0;
+    stats_.evictedBytes = 0;
+    stats_.madeResidentBytes = 0;
+
+    uint64_t neededBytes = 0;
+    for (ResidencyHandle handle : pendingResident_) {
+        const Entry& entry = entries_[handle];
+        if (entry.tracked && entry.pending)
+            neededBytes += entry.sizeBytes;
+    }
+
+    bool success = true;
+
+    if (stats_.residentBytes + neededBytes > budget_) {
+        // anything the GPU might still be using is off limits
+        candidates_.clear();
+        for (ResidencyHandle handle = 0; handle < entries_.size(); ++handle) {
+            const Entry& entry = entries_[handle];
+            if (entry.tracked && entry.resident && entry.priority < ResidencyPriorityMaximum && entry.lastUsedFrame + framesInFlight_ < frame)
+                candidates_.push_back(handle);
+        }
+
+        // lowest priority first, least recently used first within a priority
+        std::sort(candidates_.begin(), candidates_.end(), [this](ResidencyHandle a, ResidencyHandle b) {
+            const Entry& ea = entries_[a];
+            const Entry& eb = entries_[b];
+            if (ea.priority != eb.priority)
+                return ea.priority < eb.priority;
+            return ea.lastUsedFrame < eb.lastUsedFrame;
+        });
+
+        batch_.clear();
+        for (ResidencyHandle handle : candidates_) {
+            if (stats_.residentBytes + neededBytes <= budget_)
+                break;
+
+            Entry& entry = entries_[handle];
+            entry.resident = false;
+            stats_.residentBytes -= entry.sizeBytes;
+            stats_.residentCount--;
+            stats_.evictedCount++;
+            stats_.evictedBytes += entry.sizeBytes;
+            batch_.push_back(entry.object);
+        }
+
+        if (!batch_.empty())
+            success = backend.evict(batch_.data(), static_cast<uint32_t>(batch_.size())) && success;
+    }
+
+    batch_.clear();
+    for (ResidencyHandle handle : pendingResident_) {
+        Entry& entry = entries_[handle];
+        if (!entry.tracked || !entry.pending)
+            continue;
+
+        entry.pending = false;
+        entry.resident = true;
+        stats_.residentBytes += entry.sizeBytes;
+        stats_.residentCount++;
+        stats_.madeResidentCount++;
+        stats_.madeResidentBytes += entry.sizeBytes;
+        batch_.push_back(entry.object);
+    }
+    pendingResident_.clear();
+
+    if (!batch_.empty())
+        success = backend.makeResident(batch_.data(), static_cast<uint32_t>(batch_.size())) && success;
+
+    stats_.overBudget = stats_.residentBytes > budget_;
+
+    return success;
+}
+
+ResidencySimulationResult simulateResidency(const ResidencyTrace& trace, uint64_t budgetBytes, uint32_t framesInFlight)
+{
+    ResidencySimulationResult result = {};
+    if (trace.uses.empty())
+        return result;
+
+    ResidencyManager manager;
+    manager.reset(budgetBytes, framesInFlight);
+
+    std::vector<ResidencyHandle> handles(trace.resources.size());
+    for (size_t i = 0; i < trace.resources.size(); ++i)
+        handles[i] = manager.track(nullptr, trace.resources[i].sizeBytes, trace.resources[i].priority);
+
+    CountingResidencyBackend backend;
+
+    size_t use = 0;
+    const uint64_t firstFrame = trace.uses.front().frame;
+    const uint64_t lastFrame = trace.uses.back().frame;
+
+    for (uint64_t frame = firstFrame; frame <= lastFrame; ++frame) {
+        for (; use < trace.uses.size() && trace.uses[use].frame == frame; ++use)
+            manager.markUsed(handles[trace.uses[use].resource], frame);
+
+        manager.update(frame, backend);
+
+        const ResidencyStats& stats = manager.stats();
+        result.pagedInBytes += stats.madeResidentBytes;
+        result.peakResidentBytes = std::max(result.peakResidentBytes, stats.residentBytes);
+        if (stats.overBudget)
+            result.overBudgetFrames++;
+        result.frames++;
+    }
+
+    result.evictions = backend.evictions;
+    result.pageIns = backend.pageIns;
+
+    return result;
+}
+
+uint64_t estimateTextureSize(uint32_t width, uint32_t height, uint32_t depthOrArraySize, uint32_t mipLevels, uint32_t bitsPerPixel)
+{
+    uint64_t size = 0;
+    for (uint32_t mip = 0; mip < std::max(mipLevels, 1u); ++mip) {
+        const uint64_t w = std::max(width >> mip, 1u);
+        const uint64_t h = std::max(height >> mip, 1u);
+        size += (w * h * bitsPerPixel + 7) / 8;
+    }
+    size *= std::max(depthOrArraySize, 1u);
+
+    // textures are placed with 64KB alignment
+    const uint64_t alignment = 64 * 1024;
+    return (size + alignment - 1) / alignment * alignment;
+}
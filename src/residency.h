@@ -0,0 +1,131 @@
+#if !defined(RESIDENCY_H)
+#define RESIDENCY_H
+
+#include <cstdint>
+#include <vector>
+
+// GPU memory accounting and eviction policy. The manager only decides what
+// has to be resident, the backend does the actual MakeResident/Evict calls,
+// so the policy can be replayed against recorded traces without a GPU.
+
+typedef uint32_t ResidencyHandle;
+
+constexpr ResidencyHandle InvalidResidencyHandle = 0xffffffff;
+
+enum ResidencyPriority : uint32_t
+{
+    ResidencyPriorityMinimum = 0,
+    ResidencyPriorityLow,
+    ResidencyPriorityNormal,
+    ResidencyPriorityHigh,
+    ResidencyPriorityMaximum, // never evicted
+};
+
+class ResidencyBackend
+{
+public:
+    virtual ~ResidencyBackend() {}
+
+    virtual bool makeResident(void* const* objects, uint32_t count) = 0;
+    virtual bool evict(void* const* objects, uint32_t count) = 0;
+};
+
+struct ResidencyStats
+{
+    uint64_t budgetBytes;
+    uint64_t trackedBytes;
+    uint64_t residentBytes;
+    uint32_t residentCount;
+    uint32_t evictedCount;       // evictions done by the last update
+    uint32_t madeResidentCount;  // objects paged back in by the last update
+    uint64_t evictedBytes;
+    uint64_t madeResidentBytes;
+    bool overBudget;             // resources in use do not fit the budget
+};
+
+// usage trace, recorded by the manager and replayed by simulateResidency()
+struct ResidencyTrace
+{
+    struct Resource
+    {
+        uint64_t sizeBytes;
+        uint32_t priority;
+    };
+
+    struct Use
+    {
+        uint64_t frame;
+        uint32_t resource;
+    };
+
+    std::vector<Resource> resources;
+    std::vector<Use> uses; // sorted by frame
+};
+
+class ResidencyManager
+{
+public:
+    ResidencyManager();
+
+    // resources used within the last framesInFlight frames may still be
+    // referenced by the GPU and are never evicted
+    void reset(uint64_t budgetBytes, uint32_t framesInFlight);
+    void setBudget(uint64_t budgetBytes) { budget_ = budgetBytes; }
+
+    // new resources are created resident
+    ResidencyHandle track(void* object, uint64_t sizeBytes, uint32_t priority);
+    void untrack(ResidencyHandle handle);
+    void setPriority(ResidencyHandle handle, uint32_t priority);
+
+    void markUsed(ResidencyHandle handle, uint64_t frame);
+
+    // pages in what the frame needs and evicts least recently used, lowest
+    // priority resources until residency fits the budget again, every
+    // backend call is batched
+    bool update(uint64_t frame, ResidencyBackend& backend);
+
+    const ResidencyStats& stats() const { return stats_; }
+
+    // records every track and use into trace, pass nullptr to stop
+    void recordTrace(ResidencyTrace* trace) { trace_ = trace; }
+
+private:
+    struct Entry
+    {
+        void* object;
+        uint64_t sizeBytes;
+        uint64_t lastUsedFrame;
+        uint32_t priority;
+        uint32_t traceId;
+        bool resident;
+        bool pending;
+        bool tracked;
+    };
+
+    std::vector<Entry> entries_;
+    std::vector<ResidencyHandle> freeHandles_;
+    std::vector<ResidencyHandle> pendingResident_;
+    std::vector<ResidencyHandle> candidates_;
+    std::vector<void*> batch_;
+    uint64_t budget_;
+    uint32_t framesInFlight_;
+    ResidencyStats stats_;
+    ResidencyTrace* trace_;
+};
+
+struct ResidencySimulationResult
+{
+    uint64_t frames;
+    uint64_t evictions;
+    uint64_t pageIns;      // resources made resident again after eviction
+    uint64_t pagedInBytes;
+    uint64_t peakResidentBytes;
+    uint64_t overBudgetFrames;
+};
+
+// replays a trace against a budget with a backend that only counts
+ResidencySimulationResult simulateResidency(const ResidencyTrace& trace, uint64_t budgetBytes, uint32_t framesInFlight);
+
+uint64_t estimateTextureSize(uint32_t width, uint32_t height, uint32_t depthOrArraySize, uint32_t mipLevels, uint32_t bitsPerPixel);
+
+#endif // RESIDENCY_H
@@ -0,0 +1,79 @@
+#include "residency_d3d12.h"
+
+D3D12ResidencyBackend::D3D12ResidencyBackend(ID3D12Device* device)
+    : device_(device)
+{
+}
+
+bool D3D12ResidencyBackend::makeResident(void* const* objects, uint32_t count)
+{
+    HRESULT result = device_->MakeResident(count, reinterpret_cast<ID3D12Pageable* const*>(objects));
+    return SUCCEEDED(result);
+}
+
+bool D3D12ResidencyBackend::evict(void* const* objects, uint32_t count)
+{
+    HRESULT result = device_->Evict(count, reinterpret_cast<ID3D12Pageable* const*>(objects));
+    return SUCCEEDED(result);
+}
+
+uint32_t formatBitsPerPixel(DXGI_FORMAT format)
+{
+    switch (format) {
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+    case DXGI_FORMAT_R32G32B32A32_UINT:
+        return 128;
+    case DXGI_FORMAT_R32G32B32_FLOAT:
+        return 96;
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+    case DXGI_FORMAT_R16G16B16A16_UNORM:
+    case DXGI_FORMAT_R32G32_FLOAT:
+        return 64;
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+    case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+    case DXGI_FORMAT_R10G10B10A2_UNORM:
+    case DXGI_FORMAT_R11G11B10_FLOAT:
+    case DXGI_FORMAT_R32_FLOAT:
+    case DXGI_FORMAT_R32_UINT:
+    case DXGI_FORMAT_D32_FLOAT:
+    case DXGI_FORMAT_D24_UNORM_S8_UINT:
+        return 32;
+    case DXGI_FORMAT_B5G5R5A1_UNORM:
+    case DXGI_FORMAT_B5G6R5_UNORM:
+    case DXGI_FORMAT_R16_FLOAT:
+    case DXGI_FORMAT_R16_UNORM:
+    case DXGI_FORMAT_D16_UNORM:
+        return 16;
+    case DXGI_FORMAT_R8_UNORM:
+    case DXGI_FORMAT_A8_UNORM:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+uint64_t resourceSize(ID3D12Device* device, const D3D12_RESOURCE_DESC& desc)
+{
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+        return desc.Width;
+
+    const uint32_t bitsPerPixel = formatBitsPerPixel(desc.Format);
+    if (bitsPerPixel > 0 && desc.SampleDesc.Count <= 1)
+        return estimateTextureSize(static_cast<uint32_t>(desc.Width), desc.Height, desc.DepthOrArraySize, desc.MipLevels, bitsPerPixel);
+
+    // let the driver work out the odd ones
+    return device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+}
+
+uint64_t queryVideoMemoryBudget(IDXGIAdapter3* adapter)
+{
+    DXGI_QUERY_VIDEO_MEMORY_INFO info = {};
+    HRESULT result = adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info);
+    if (FAILED(result))
+        return 0;
+
+    return info.Budget;
+}
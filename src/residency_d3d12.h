@@ -0,0 +1,31 @@
+#if !defined(RESIDENCY_D3D12_H)
+#define RESIDENCY_D3D12_H
+
+#include "residency.h"
+
+#include <d3d12.h>
+#include <dxgi1_4.h>
+
+class D3D12ResidencyBackend : public ResidencyBackend
+{
+public:
+    explicit D3D12ResidencyBackend(ID3D12Device* device);
+
+    // objects have to be ID3D12Pageable pointers
+    bool makeResident(void* const* objects, uint32_t count) override;
+    bool evict(void* const* objects, uint32_t count) override;
+
+private:
+    ID3D12Device* device_;
+};
+
+// 0 for formats without a fixed size per pixel (block compressed etc.)
+uint32_t formatBitsPerPixel(DXGI_FORMAT format);
+
+// size used for budget accounting, computed from the format where possible
+uint64_t resourceSize(ID3D12Device* device, const D3D12_RESOURCE_DESC& desc);
+
+// local video memory the OS currently grants this process, 0 on failure
+uint64_t queryVideoMemoryBudget(IDXGIAdapter3* adapter);
+
+#endif // RESIDENCY_D3D12_H
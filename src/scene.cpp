@@ -0,0 +1,200 @@
+#include "scene.h"
+
+#include "cube_mesh.h"
+#include "draw_sort.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// spin in radians per second around x, y and z
+static const Float3 cube1AngularSpeed_ = { 0.3f, 0.6f, 0.9f };
+static const Float3 cube2AngularSpeed_ = { 0.9f, 0.6f, 0.3f };
+
+// depth buffer the draws are rasterized into as occluders
+static const uint32_t occlusionWidth_ = 256;
+static const uint32_t occlusionHeight_ = 144;
+static const size_t maxOccluders_ = 64;
+
+// clip planes, draw sort keys take depth as a fraction of the far one
+static const float nearZ_ = 0.1f;
+static const float farZ_ = 1000.0f;
+
+Scene::Scene()
+    : occlusion_(occlusionWidth_, occlusionHeight_)
+    , cubeMesh_(0)
+    , materialIndex_(0)
+{
+    reset(1, 1);
+}
+
+void Scene::reset(uint32_t width, uint32_t height)
+{
+    const float aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+    projection_ = matrixPerspectiveFovLH(45.0f * (3.14f / 180.0f), aspectRatio, nearZ_, farZ_);
+    viewportHeight_ = static_cast<float>(height);
+
+    const Float3 cameraPosition = { 0.0f, 2.0f, -4.0f };
+    const Float3 cameraTarget = { 0.0f, 0.0f, 0.0f };
+    const Float3 cameraUp = { 0.0f, 1.0f, 0.0f };
+    view_ = matrixLookAtLH(cameraPosition, cameraTarget, cameraUp);
+    eye_ = cameraPosition;
+
+    // created level by level, see TransformSystem::create()
+    transforms_.clear();
+    anchorNode_ = transforms_.create(InvalidTransform);
+    cube1Node_ = transforms_.create(anchorNode_);
+    cube2OrbitNode_ = transforms_.create(anchorNode_);
+    cube2Node_ = transforms_.create(cube2OrbitNode_);
+
+    // cube2 is half the size of cube1
+    const Float3 cube1Position = { 0.0f, 0.0f, 0.0f };
+    const Float3 cube2Offset = { 1.5f, 0.0f, 0.0f };
+    const Float3 cube2Scale = { 0.5f, 0.5f, 0.5f };
+    transforms_.setLocalPosition(anchorNode_, cube1Position);
+    transforms_.setLocalPosition(cube2Node_, cube2Offset);
+    transforms_.setLocalScale(cube2Node_, cube2Scale);
+    transforms_.setAngularVelocity(cube1Node_, cube1AngularSpeed_);
+    transforms_.setAngularVelocity(cube2OrbitNode_, cube2AngularSpeed_);
+    transforms_.updateWorld(nullptr);
+
+    drawNodes_.clear();
+    drawNodes_.push_back(cube1Node_);
+    drawNodes_.push_back(cube2Node_);
+    drawBounds_.resize(static_cast<uint32_t>(drawNodes_.size()));
+
+    // the same chain the backend uploads, so the geometry of a level is the
+    // same on both sides
+    CubeMesh cube;
+    buildCubeMesh(cube);
+    cubeExtents_ = cube.extents;
+    cubeOccluderExtents_ = cube.innerExtents;
+
+    meshLods_.clear();
+    cubeMesh_ = meshLods_.addMesh(cube.lods.data(), static_cast<uint32_t>(cube.lods.size()));
+
+    // every draw starts over at the full mesh
+    lods_.resize(0);
+    lods_.resize(static_cast<uint32_t>(drawNodes_.size()));
+    lods_.setInstance(0, cubeMesh_, 1.0f);
+    lods_.setInstance(1, cubeMesh_, cube2Scale.x);
+
+    timestep_.reset();
+
+    for (Frame& frame : frames_) {
+        frame.world.clear();
+        for (uint32_t node : drawNodes_)
+            frame.world.push_back(transforms_.world(node));
+    }
+}
+
+void Scene::setSimulationRate(double stepsPerSecond)
+{
+    timestep_.configure(1.0 / stepsPerSecond, timestep_.maxStepsPerFrame());
+}
+
+void Scene::update(double elapsed, uint32_t slot)
+{
+    PROFILE_FUNCTION();
+
+    // simulation runs at a fixed rate, independent of the frame rate
+    const uint32_t steps = timestep_.advance(elapsed);
+    for (uint32_t i = 0; i < steps; ++i)
+        transforms_.integrateRotations(static_cast<float>(timestep_.stepTime()), nullptr);
+
+    // render somewhere between the last two steps
+    transforms_.updateWorld(nullptr, static_cast<float>(timestep_.alpha()));
+
+    Frame& frame = frames_[slot];
+    for (size_t i = 0; i < drawNodes_.size(); ++i)
+        frame.world[i] = transforms_.world(drawNodes_[i]);
+}
+
+void Scene::buildRenderPackets(uint32_t slot, RenderPacketQueue& packets)
+{
+    PROFILE_FUNCTION();
+
+    const Frame& frame = frames_[slot];
+    const Float4x4 viewProjection = matrixMultiply(view_, projection_);
+
+    // world space box around the rotated cube, its extent along an axis is
+    // what the cube's axes reach along it
+    for (uint32_t i = 0; i < drawBounds_.count(); ++i) {
+        const Float4x4& world = frame.world[i];
+        const Float3 center = { world.m[3][0], world.m[3][1], world.m[3][2] };
+        const Float3 extents = {
+            std::fabs(world.m[0][0]) * cubeExtents_.x + std::fabs(world.m[1][0]) * cubeExtents_.y + std::fabs(world.m[2][0]) * cubeExtents_.z,
+            std::fabs(world.m[0][1]) * cubeExtents_.x + std::fabs(world.m[1][1]) * cubeExtents_.y + std::fabs(world.m[2][1]) * cubeExtents_.z,
+            std::fabs(world.m[0][2]) * cubeExtents_.x + std::fabs(world.m[1][2]) * cubeExtents_.y + std::fabs(world.m[2][2]) * cubeExtents_.z,
+        };
+        drawBounds_.setBox(i, center, extents);
+    }
+
+    cullObjects(frustumFromMatrix(viewProjection), drawBounds_, CullBoxes, nullptr, visibleDraws_);
+
+    // the cubes are all the same size, the nearest ones cover the most of
+    // the screen and occlude the others. A box is never hidden by itself.
+    occluders_.clear();
+    for (uint32_t draw : visibleDraws_) {
+        const Float4x4& world = frame.world[draw];
+        const float depth = world.m[3][0] * viewProjection.m[0][3] + world.m[3][1] * viewProjection.m[1][3]
+            + world.m[3][2] * viewProjection.m[2][3] + viewProjection.m[3][3];
+        occluders_.push_back({ depth, draw });
+    }
+
+    if (occluders_.size() > maxOccluders_) {
+        std::nth_element(occluders_.begin(), occluders_.begin() + maxOccluders_, occluders_.end());
+        occluders_.resize(maxOccluders_);
+    }
+
+    // the box of the coarsest level is inside every level, whichever one a
+    // cube is drawn with covers at least that much
+    Float4x4 cubeScale = matrixIdentity();
+    cubeScale.m[0][0] = cubeOccluderExtents_.x;
+    cubeScale.m[1][1] = cubeOccluderExtents_.y;
+    cubeScale.m[2][2] = cubeOccluderExtents_.z;
+
+    occlusion_.begin(viewProjection);
+    for (const auto& occluder : occluders_)
+        occlusion_.addOccluder(boxOccluderVertices, boxOccluderIndices, 12, matrixMultiply(cubeScale, frame.world[occluder.second]));
+    occlusion_.rasterize(nullptr);
+    occlusion_.cullObjects(drawBounds_, visibleDraws_);
+
+    lods_.select(meshLods_, drawBounds_, visibleDraws_, eye_, projection_, viewportHeight_, nullptr);
+
+    RenderPacket packet = {};
+    packet.type = RenderPacketBeginFrame;
+    packet.frameSlot = slot;
+    packets.push(packet);
+
+    // every object is the cube, at the level it picked
+    packet.type = RenderPacketDraw;
+    packet.materialIndex = materialIndex_;
+
+    // one pipeline and root signature so far, draws sort by material, mesh
+    // and then front to back
+    DrawKey key = {};
+    key.layer = DrawLayerOpaque;
+    key.material = materialIndex_;
+
+    for (uint32_t draw : visibleDraws_) {
+        const Float4x4 wvp = matrixMultiply(frame.world[draw], viewProjection);
+
+        packet.meshIndex = meshLods_.geometry(cubeMesh_, lods_.level(draw));
+        key.mesh = packet.meshIndex;
+
+        // clip space w of the object's origin is its view depth
+        key.depth = wvp.m[3][3] / farZ_;
+        packet.sortKey = encodeDrawKey(key);
+
+        // the GPU wants the wvp matrix transposed
+        const Float4x4 transposed = matrixTranspose(wvp);
+        memcpy(packet.worldViewProjection, transposed.m, sizeof(packet.worldViewProjection));
+
+        packets.push(packet);
+    }
+
+    packet.type = RenderPacketEndFrame;
+    packets.push(packet);
+}
@@ -0,0 +1,92 @@
+#if !defined(SCENE_H)
+#define SCENE_H
+
+#include "fixed_timestep.h"
+#include "frustum_culling.h"
+#include "mesh_lod.h"
+#include "occlusion_culling.h"
+#include "render_backend.h"
+#include "scene_math.h"
+#include "transform_system.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// The scene: two cubes, one circling the other, and a fixed camera. It is
+// simulated at a fixed rate and interpolated for rendering, and turns into
+// render packets for whichever backend renders it. Object transforms live
+// in a transform hierarchy, draws outside the view or hidden behind the
+// others are culled and the rest pick a level of detail.
+
+class Scene
+{
+public:
+    Scene();
+
+    // puts the camera and the cubes back at the start, width and height are
+    // the viewport's in pixels
+    void reset(uint32_t width, uint32_t height);
+
+    void setSimulationRate(double stepsPerSecond);
+    void setMaterialIndex(uint32_t materialIndex) { materialIndex_ = materialIndex; }
+
+    // elapsed is the real time since the last frame in seconds, the scene is
+    // simulated in fixed steps and interpolated for rendering
+    void update(double elapsed, uint32_t slot);
+
+    // queues the frame's draw packets. Frames have to be built in the order
+    // they are rendered.
+    void buildRenderPackets(uint32_t slot, RenderPacketQueue& packets);
+
+private:
+    // what update() hands to buildRenderPackets(), a world matrix per draw
+    struct Frame
+    {
+        std::vector<Float4x4> world;
+    };
+
+    Float4x4 projection_;
+    Float4x4 view_;
+    Float3 eye_;
+    float viewportHeight_;
+
+    // cube1 and the orbit of cube2 hang off the anchor at cube1's position,
+    // cube2 is offset from the orbit, so it circles cube1. The spin of both
+    // is simulated by the transforms, which keep the previous step for
+    // rendering to interpolate from.
+    TransformSystem transforms_;
+    uint32_t anchorNode_;
+    uint32_t cube1Node_;
+    uint32_t cube2OrbitNode_;
+    uint32_t cube2Node_;
+
+    // nodes that are drawn, in draw order
+    std::vector<uint32_t> drawNodes_;
+
+    // world bounds of the draws, only the ones in the view get packets
+    CullingBounds drawBounds_;
+    std::vector<uint32_t> visibleDraws_;
+
+    // the nearest draws in the view occlude the others, view depth and draw
+    OcclusionCuller occlusion_;
+    std::vector<std::pair<float, uint32_t>> occluders_;
+
+    // level of detail per draw, the geometry of the level is the mesh the
+    // packet draws
+    MeshLodTable meshLods_;
+    LodSelector lods_;
+    uint32_t cubeMesh_;
+
+    // half extents of the cube's full mesh, which the bounds are made of,
+    // and of the box that occludes for it
+    Float3 cubeExtents_;
+    Float3 cubeOccluderExtents_;
+
+    FixedTimestep timestep_;
+
+    uint32_t materialIndex_;
+    Frame frames_[frameSlotCount_];
+};
+
+#endif // SCENE_H
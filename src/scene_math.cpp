@@ -0,0 +1,258 @@
+#include "scene_math.h"
+
+#include <cmath>
+
+static Float3 subtract(const Float3& a, const Float3& b)
+{
+    return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+static float dot(const Float3& a, const Float3& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static Float3 cross(const Float3& a, const Float3& b)
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static Float3 normalize(const Float3& v)
+{
+    const float length = std::sqrt(dot(v, v));
+    if (length == 0.0f)
+        return v;
+
+    return { v.x / length, v.y / length, v.z / length };
+}
+
+Float4x4 matrixIdentity()
+{
+    Float4x4 result = {};
+    for (int i = 0; i < 4; ++i)
+        result.m[i][i] = 1.0f;
+
+    return result;
+}
+
+Float4x4 matrixMultiply(const Float4x4& a, const Float4x4& b)
+{
+    Float4x4 result;
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            result.m[row][column] =
+                a.m[row][0] * b.m[0][column] +
+                a.m[row][1] * b.m[1][column] +
+                a.m[row][2] * b.m[2][column] +
+                a.m[row][3] * b.m[3][column];
+        }
+    }
+
+    return result;
+}
+
+Float4x4 matrixTranspose(const Float4x4& matrix)
+{
+    Float4x4 result;
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 4; ++column)
+            result.m[row][column] = matrix.m[column][row];
+    }
+
+    return result;
+}
+
+Float4x4 matrixInverseAffine(const Float4x4& matrix)
+{
+    const float (&m)[4][4] = matrix.m;
+
+    // the inverse of the upper 3x3 is its adjugate over the determinant
+    const float c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+    const float c01 = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+    const float c02 = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+    const float c10 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+    const float c11 = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+    const float c12 = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+    const float c20 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+    const float c21 = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+    const float c22 = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+    const float inverseDeterminant = 1.0f / (m[0][0] * c00 + m[0][1] * c10 + m[0][2] * c20);
+
+    Float4x4 result = {};
+    result.m[0][0] = c00 * inverseDeterminant;
+    result.m[0][1] = c01 * inverseDeterminant;
+    result.m[0][2] = c02 * inverseDeterminant;
+    result.m[1][0] = c10 * inverseDeterminant;
+    result.m[1][1] = c11 * inverseDeterminant;
+    result.m[1][2] = c12 * inverseDeterminant;
+    result.m[2][0] = c20 * inverseDeterminant;
+    result.m[2][1] = c21 * inverseDeterminant;
+    result.m[2][2] = c22 * inverseDeterminant;
+
+    // the translation undone in the rotated frame
+    for (int column = 0; column < 3; ++column)
+        result.m[3][column] = -(m[3][0] * result.m[0][column] + m[3][1] * result.m[1][column] + m[3][2] * result.m[2][column]);
+    result.m[3][3] = 1.0f;
+
+    return result;
+}
+
+Float4x4 matrixTranslation(const Float3& offset)
+{
+    Float4x4 result = matrixIdentity();
+    result.m[3][0] = offset.x;
+    result.m[3][1] = offset.y;
+    result.m[3][2] = offset.z;
+
+    return result;
+}
+
+Float4x4 matrixScaling(float scale)
+{
+    Float4x4 result = {};
+    result.m[0][0] = scale;
+    result.m[1][1] = scale;
+    result.m[2][2] = scale;
+    result.m[3][3] = 1.0f;
+
+    return result;
+}
+
+Float4x4 matrixRotationQuaternion(const Float4& q)
+{
+    const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+    Float4x4 result = {};
+    result.m[0][0] = 1.0f - 2.0f * (yy + zz);
+    result.m[0][1] = 2.0f * (xy + wz);
+    result.m[0][2] = 2.0f * (xz - wy);
+    result.m[1][0] = 2.0f * (xy - wz);
+    result.m[1][1] = 1.0f - 2.0f * (xx + zz);
+    result.m[1][2] = 2.0f * (yz + wx);
+    result.m[2][0] = 2.0f * (xz + wy);
+    result.m[2][1] = 2.0f * (yz - wx);
+    result.m[2][2] = 1.0f - 2.0f * (xx + yy);
+    result.m[3][3] = 1.0f;
+
+    return result;
+}
+
+Float4x4 matrixPerspectiveFovLH(float fovY, float aspectRatio, float nearZ, float farZ)
+{
+    const float height = 1.0f / std::tan(0.5f * fovY);
+    const float width = height / aspectRatio;
+    const float range = farZ / (farZ - nearZ);
+
+    Float4x4 result = {};
+    result.m[0][0] = width;
+    result.m[1][1] = height;
+    result.m[2][2] = range;
+    result.m[2][3] = 1.0f;
+    result.m[3][2] = -range * nearZ;
+
+    return result;
+}
+
+Float4x4 matrixLookAtLH(const Float3& eye, const Float3& target, const Float3& up)
+{
+    const Float3 forward = normalize(subtract(target, eye));
+    const Float3 right = normalize(cross(up, forward));
+    const Float3 cameraUp = cross(forward, right);
+
+    Float4x4 result = {};
+    result.m[0][0] = right.x;
+    result.m[1][0] = right.y;
+    result.m[2][0] = right.z;
+    result.m[0][1] = cameraUp.x;
+    result.m[1][1] = cameraUp.y;
+    result.m[2][1] = cameraUp.z;
+    result.m[0][2] = forward.x;
+    result.m[1][2] = forward.y;
+    result.m[2][2] = forward.z;
+    result.m[3][0] = -dot(right, eye);
+    result.m[3][1] = -dot(cameraUp, eye);
+    result.m[3][2] = -dot(forward, eye);
+    result.m[3][3] = 1.0f;
+
+    return result;
+}
+
+Float4 quaternionIdentity()
+{
+    return { 0.0f, 0.0f, 0.0f, 1.0f };
+}
+
+Float4 quaternionRotationNormal(const Float3& axis, float angle)
+{
+    const float s = std::sin(0.5f * angle);
+    return { axis.x * s, axis.y * s, axis.z * s, std::cos(0.5f * angle) };
+}
+
+Float4 quaternionMultiply(const Float4& a, const Float4& b)
+{
+    // the product b * a, a is applied first
+    return {
+        b.w * a.x + b.x * a.w + b.y * a.z - b.z * a.y,
+        b.w * a.y - b.x * a.z + b.y * a.w + b.z * a.x,
+        b.w * a.z + b.x * a.y - b.y * a.x + b.z * a.w,
+        b.w * a.w - b.x * a.x - b.y * a.y - b.z * a.z,
+    };
+}
+
+Float4 quaternionNormalize(const Float4& q)
+{
+    const float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    if (length == 0.0f)
+        return q;
+
+    return { q.x / length, q.y / length, q.z / length, q.w / length };
+}
+
+Float4 quaternionSlerp(const Float4& from, const Float4& to, float t)
+{
+    float cosOmega = from.x * to.x + from.y * to.y + from.z * to.z + from.w * to.w;
+
+    // take the short way around
+    float sign = 1.0f;
+    if (cosOmega < 0.0f) {
+        cosOmega = -cosOmega;
+        sign = -1.0f;
+    }
+
+    float scaleFrom = 1.0f - t;
+    float scaleTo = t;
+
+    // nearly parallel rotations are interpolated linearly, the sine below
+    // would divide by almost zero
+    if (cosOmega < 1.0f - 0.00001f) {
+        const float sinOmega = std::sqrt(1.0f - cosOmega * cosOmega);
+        const float omega = std::atan2(sinOmega, cosOmega);
+
+        scaleFrom = std::sin((1.0f - t) * omega) / sinOmega;
+        scaleTo = std::sin(t * omega) / sinOmega;
+    }
+
+    scaleTo *= sign;
+
+    return {
+        from.x * scaleFrom + to.x * scaleTo,
+        from.y * scaleFrom + to.y * scaleTo,
+        from.z * scaleFrom + to.z * scaleTo,
+        from.w * scaleFrom + to.w * scaleTo,
+    };
+}
+
+Float3 aabbCenter(const Aabb& box)
+{
+    return { (box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f, (box.min.z + box.max.z) * 0.5f };
+}
+
+float aabbSurfaceArea(const Aabb& box)
+{
+    const Float3 size = subtract(box.max, box.min);
+    if (size.x < 0.0f || size.y < 0.0f || size.z < 0.0f)
+        return 0.0f;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
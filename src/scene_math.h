@@ -0,0 +1,50 @@
+#if !defined(SCENE_MATH_H)
+#define SCENE_MATH_H
+
+// Portable float math for the scene, so it runs without DirectXMath on
+// other platforms. Same conventions as DirectXMath: row vectors multiplied
+// from the left, row-major matrices and left-handed view and projection.
+
+struct Float3
+{
+    float x, y, z;
+};
+
+// a quaternion is x, y, z and the scalar part in w
+struct Float4
+{
+    float x, y, z, w;
+};
+
+struct Float4x4
+{
+    float m[4][4];
+};
+
+// axis aligned box, empty when min is larger than max on any axis
+struct Aabb
+{
+    Float3 min;
+    Float3 max;
+};
+
+Float4x4 matrixIdentity();
+Float4x4 matrixMultiply(const Float4x4& a, const Float4x4& b); // a, then b
+Float4x4 matrixTranspose(const Float4x4& matrix);
+Float4x4 matrixInverseAffine(const Float4x4& matrix); // the last column is taken to be 0, 0, 0, 1
+Float4x4 matrixTranslation(const Float3& offset);
+Float4x4 matrixScaling(float scale);
+Float4x4 matrixRotationQuaternion(const Float4& rotation);
+Float4x4 matrixPerspectiveFovLH(float fovY, float aspectRatio, float nearZ, float farZ);
+Float4x4 matrixLookAtLH(const Float3& eye, const Float3& target, const Float3& up);
+
+Float4 quaternionIdentity();
+Float4 quaternionRotationNormal(const Float3& axis, float angle);
+Float4 quaternionMultiply(const Float4& a, const Float4& b); // rotates by a, then by b
+Float4 quaternionNormalize(const Float4& rotation);
+Float4 quaternionSlerp(const Float4& from, const Float4& to, float t);
+
+Float3 aabbCenter(const Aabb& box);
+float aabbSurfaceArea(const Aabb& box); // 0 for an empty box
+
+#endif // SCENE_MATH_H
@@ -0,0 +1,200 @@
+#if !defined(SIMD_H)
+#define SIMD_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Four float lanes for the batched scene math. SSE2 is part of every x64
+// target, other targets get a plain array with the same interface. Loads
+// and stores do not need any alignment.
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+constexpr uint32_t simdWidth = 4;
+
+#if defined(SIMD_SSE2)
+
+typedef __m128 SimdFloat;
+
+inline SimdFloat simdLoad(const float* values) { return _mm_loadu_ps(values); }
+inline void simdStore(float* values, SimdFloat v) { _mm_storeu_ps(values, v); }
+inline SimdFloat simdSplat(float value) { return _mm_set1_ps(value); }
+inline SimdFloat simdSet(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+
+inline SimdFloat simdAdd(SimdFloat a, SimdFloat b) { return _mm_add_ps(a, b); }
+inline SimdFloat simdSub(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a, b); }
+inline SimdFloat simdMul(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a, b); }
+inline SimdFloat simdDiv(SimdFloat a, SimdFloat b) { return _mm_div_ps(a, b); }
+inline SimdFloat simdSqrt(SimdFloat v) { return _mm_sqrt_ps(v); }
+
+// a * b + c
+inline SimdFloat simdMulAdd(SimdFloat a, SimdFloat b, SimdFloat c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return _mm_min_ps(a, b); }
+inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return _mm_max_ps(a, b); }
+
+// rows become columns
+inline void simdTranspose(SimdFloat& a, SimdFloat& b, SimdFloat& c, SimdFloat& d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+
+// comparisons set every bit of the lanes they hold for, simdMask() packs
+// the lanes into the low bits of an integer, lane 0 first
+inline SimdFloat simdLess(SimdFloat a, SimdFloat b) { return _mm_cmplt_ps(a, b); }
+inline SimdFloat simdOr(SimdFloat a, SimdFloat b) { return _mm_or_ps(a, b); }
+inline SimdFloat simdAnd(SimdFloat a, SimdFloat b) { return _mm_and_ps(a, b); }
+inline uint32_t simdMask(SimdFloat v) { return static_cast<uint32_t>(_mm_movemask_ps(v)); }
+
+#else
+
+struct SimdFloat
+{
+    float lane[simdWidth];
+};
+
+inline SimdFloat simdLoad(const float* values)
+{
+    SimdFloat result;
+    for (uint32_t i = 0; i < simdWidth; ++i)
+        result.lane[i] = values[i];
+    return result;
+}
+
+inline void simdStore(float* values, SimdFloat v)
+{
+    for (uint32_t i = 0; i < simdWidth; ++i)
+        values[i] = v.lane[i];
+}
+
+inline SimdFloat simdSplat(float value)
+{
+    SimdFloat result;
+    for (uint32_t i = 0; i < simdWidth; ++i)
+        result.lane[i] = value;
+    return result;
+}
+
+inline SimdFloat simdSet(float x, float y, float z, float w)
+{
+    SimdFloat result = { { x, y, z, w } };
+    return result;
+}
+
+inline SimdFloat simdAdd(SimdFloat a, SimdFloat b)
+{
+    for (uint32_t i = 0; i < simdWidth; ++i)
+        a.lane[i] += b.lane[i];
+    return a;
+}
+
+inline SimdFloat simdSub(SimdFloat a, SimdFloat b)
+{
+    for (uint32_t i = 0; i < simdWidth; ++i)
+        a.lane[i] -= b.lane[i];
+    return a;
+}
+
+inline SimdFloat simdMul(SimdFloat a, SimdFloat b)
+{
+    for (uint32_t i = 0; i < simdWidth; ++i)
+        a.lane[i] *= b.lane[i];
+    return a;
+}
+
+inline SimdFloat simdDiv(SimdFloat a, SimdFloat b)
+{
+    for (uint32_t i = 0; i < simdWidth; ++i)
+        a.lane[i] /= b.lane[i];
+    return a;
+}
+
+inline SimdFloat simdSqrt(SimdFloat v)
+{
+    for (uint32_t i = 0; i < simdWidth; ++i)
+        v.lane[i] = std::sqrt(v.lane[i]);
+    return v;
+}
+
+inline SimdFloat simdMulAdd(SimdFloat a, SimdFloat b, SimdFloat c)
+{
+    return simdAdd(simdMul(a, b), c);
+}
+
+// same as SSE, b when either is NaN
+inline SimdFloat simdMin(SimdFloat a, SimdFloat b)
+{
+    for (uint32_t i = 0; i < simdWidth; ++i)
+        a.lane[i] = a.lane[i] < b.lane[i] ? a.lane[i] : b.lane[i];
+    return a;
+}
+
+inline SimdFloat simdMax(SimdFloat a, SimdFloat b)
+{
+    for (uint32_t i = 0; i < simdWidth; ++i)
+        a.lane[i] = a.lane[i] > b.lane[i] ? a.lane[i] : b.lane[i];
+    return a;
+}
+
+inline void simdTranspose(SimdFloat& a, SimdFloat& b, SimdFloat& c, SimdFloat& d)
+{
+    SimdFloat* rows[] = { &a, &b, &c, &d };
+    for (uint32_t i = 0; i < simdWidth; ++i) {
+        for (uint32_t j = i + 1; j < simdWidth; ++j) {
+            const float value = rows[i]->lane[j];
+            rows[i]->lane[j] = rows[j]->lane[i];
+            rows[j]->lane[i] = value;
+        }
+    }
+}
+
+inline SimdFloat simdLess(SimdFloat a, SimdFloat b)
+{
+    const uint32_t all = 0xffffffff;
+    const uint32_t none = 0;
+
+    SimdFloat result;
+    for (uint32_t i = 0; i < simdWidth; ++i)
+        memcpy(&result.lane[i], a.lane[i] < b.lane[i] ? &all : &none, sizeof(float));
+    return result;
+}
+
+inline SimdFloat simdOr(SimdFloat a, SimdFloat b)
+{
+    for (uint32_t i = 0; i < simdWidth; ++i) {
+        uint32_t x, y;
+        memcpy(&x, &a.lane[i], sizeof(x));
+        memcpy(&y, &b.lane[i], sizeof(y));
+        x |= y;
+        memcpy(&a.lane[i], &x, sizeof(x));
+    }
+    return a;
+}
+
+inline SimdFloat simdAnd(SimdFloat a, SimdFloat b)
+{
+    for (uint32_t i = 0; i < simdWidth; ++i) {
+        uint32_t x, y;
+        memcpy(&x, &a.lane[i], sizeof(x));
+        memcpy(&y, &b.lane[i], sizeof(y));
+        x &= y;
+        memcpy(&a.lane[i], &x, sizeof(x));
+    }
+    return a;
+}
+
+inline uint32_t simdMask(SimdFloat v)
+{
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < simdWidth; ++i) {
+        uint32_t bits;
+        memcpy(&bits, &v.lane[i], sizeof(bits));
+        result |= (bits >> 31) << i;
+    }
+    return result;
+}
+
+#endif // defined(SIMD_SSE2)
+
+#endif // SIMD_H
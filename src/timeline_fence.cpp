@@ -0,0 +1,60 @@
+#include "timeline_fence.h"
+
+bool isComplete(const FenceTicket& ticket)
+{
+    // signaled values start at 1, 0 is complete before anything was submitted
+    return !ticket.isValid() || ticket.value == 0 || ticket.fence->isComplete(ticket.value);
+}
+
+bool waitForTickets(const FenceTicket* tickets, uint32_t count)
+{
+    // waiting one after the other is as fast as waiting for all at once,
+    // the last one to complete decides how long it takes
+    for (uint32_t i = 0; i < count; ++i) {
+        if (isComplete(tickets[i]))
+            continue;
+
+        if (!tickets[i].fence->waitFor(tickets[i].value))
+            return false;
+    }
+
+    return true;
+}
+
+CpuTimelineFence::CpuTimelineFence()
+    : completed_(0)
+{
+}
+
+FenceTicket CpuTimelineFence::signal()
+{
+    return { this, lastSignaled_.fetch_add(1, std::memory_order_acq_rel) + 1 };
+}
+
+uint64_t CpuTimelineFence::completedValue()
+{
+    return completed_.load(std::memory_order_acquire);
+}
+
+bool CpuTimelineFence::waitFor(uint64_t value)
+{
+    if (completedValue() >= value)
+        return true;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    completedChanged_.wait(lock, [&] { return completedValue() >= value; });
+
+    return true;
+}
+
+void CpuTimelineFence::complete(uint64_t value)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (value <= completed_.load(std::memory_order_relaxed))
+            return;
+        completed_.store(value, std::memory_order_release);
+    }
+
+    completedChanged_.notify_all();
+}
@@ -0,0 +1,87 @@
+#if !defined(TIMELINE_FENCE_H)
+#define TIMELINE_FENCE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// One monotonically increasing value per queue. Every signal returns a
+// ticket, work associated with the ticket is done once the fence reached its
+// value. Uploads, deferred releases and frame pacing all wait on tickets of
+// the same fence instead of keeping their own fences and events.
+
+class TimelineFence;
+
+struct FenceTicket
+{
+    TimelineFence* fence;
+    uint64_t value;
+
+    // a default ticket has nothing to wait for
+    bool isValid() const { return fence != nullptr; }
+};
+
+class TimelineFence
+{
+public:
+    TimelineFence()
+        : lastSignaled_(0)
+    {
+    }
+
+    virtual ~TimelineFence() {}
+
+    // returns an invalid ticket if the signal could not be queued
+    virtual FenceTicket signal() = 0;
+
+    virtual uint64_t completedValue() = 0;
+
+    // blocks until the fence reached value
+    virtual bool waitFor(uint64_t value) = 0;
+
+    bool isComplete(uint64_t value) { return completedValue() >= value; }
+
+    FenceTicket lastSignaled() { return { this, lastSignaled_.load(std::memory_order_acquire) }; }
+
+protected:
+    std::atomic<uint64_t> lastSignaled_;
+
+private:
+    TimelineFence(const TimelineFence&) = delete;
+    TimelineFence& operator=(const TimelineFence&) = delete;
+};
+
+bool isComplete(const FenceTicket& ticket);
+
+// waits until every ticket is complete, tickets may belong to different
+// fences (queues)
+bool waitForTickets(const FenceTicket* tickets, uint32_t count);
+
+inline bool waitForTicket(const FenceTicket& ticket)
+{
+    return waitForTickets(&ticket, 1);
+}
+
+// Fence completed from the CPU. complete() plays the part of the GPU, so
+// code written against TimelineFence runs without a device.
+class CpuTimelineFence : public TimelineFence
+{
+public:
+    CpuTimelineFence();
+
+    FenceTicket signal() override;
+    uint64_t completedValue() override;
+    bool waitFor(uint64_t value) override;
+
+    // values can only move forward, completing an older value does nothing
+    void complete(uint64_t value);
+    void completeAll() { complete(lastSignaled_.load(std::memory_order_acquire)); }
+
+private:
+    std::atomic<uint64_t> completed_;
+    std::mutex mutex_;
+    std::condition_variable completedChanged_;
+};
+
+#endif // TIMELINE_FENCE_H
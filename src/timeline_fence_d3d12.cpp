@@ -0,0 +1,49 @@
+#include "timeline_fence_d3d12.h"
+
+D3D12TimelineFence::D3D12TimelineFence()
+    : queue_(nullptr)
+{
+}
+
+bool D3D12TimelineFence::init(ID3D12Device* device, ID3D12CommandQueue* queue, const wchar_t* name)
+{
+    HRESULT result = device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(fence_.ReleaseAndGetAddressOf()));
+    if (FAILED(result))
+        return false;
+    fence_->SetName(name);
+
+    queue_ = queue;
+    lastSignaled_.store(0, std::memory_order_release);
+
+    return true;
+}
+
+FenceTicket D3D12TimelineFence::signal()
+{
+    // signals are issued from the thread that submits to the queue, so the
+    // value does not need an atomic increment
+    const uint64_t value = lastSignaled_.load(std::memory_order_relaxed) + 1;
+
+    HRESULT result = queue_->Signal(fence_.Get(), value);
+    if (FAILED(result))
+        return { nullptr, 0 };
+
+    lastSignaled_.store(value, std::memory_order_release);
+    return { this, value };
+}
+
+uint64_t D3D12TimelineFence::completedValue()
+{
+    return fence_->GetCompletedValue();
+}
+
+bool D3D12TimelineFence::waitFor(uint64_t value)
+{
+    if (fence_->GetCompletedValue() >= value)
+        return true;
+
+    // without an event the call blocks until the value is reached, so any
+    // number of threads can wait without sharing an event handle
+    HRESULT result = fence_->SetEventOnCompletion(value, nullptr);
+    return SUCCEEDED(result);
+}
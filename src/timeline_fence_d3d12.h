@@ -0,0 +1,28 @@
+#if !defined(TIMELINE_FENCE_D3D12_H)
+#define TIMELINE_FENCE_D3D12_H
+
+#include "timeline_fence.h"
+
+#include <d3d12.h>
+#include <wrl/client.h>
+
+// timeline of one command queue
+class D3D12TimelineFence : public TimelineFence
+{
+public:
+    D3D12TimelineFence();
+
+    bool init(ID3D12Device* device, ID3D12CommandQueue* queue, const wchar_t* name);
+
+    FenceTicket signal() override;
+    uint64_t completedValue() override;
+    bool waitFor(uint64_t value) override;
+
+    ID3D12Fence* fence() const { return fence_.Get(); }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Fence> fence_;
+    ID3D12CommandQueue* queue_;
+};
+
+#endif // TIMELINE_FENCE_D3D12_H
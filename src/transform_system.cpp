@@ -0,0 +1,546 @@
+#include "transform_system.h"
+
+#include "job_system.h"
+#include "profiler.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// levels smaller than this are not worth splitting across workers
+static const uint32_t minNodesPerJob_ = 2048;
+
+// squared lengths below this count as zero when normalizing
+static const float minSquaredLength_ = 1e-30f;
+
+// half the angle a step turns by up to which integrateNodes() trusts its
+// series, the first terms it leaves out are about float rounding there
+static const float maxSeriesHalfAngle_ = 0.5f;
+
+// rotation steps of the benchmark
+static const float benchmarkStepTime_ = 1.0f / 60.0f;
+
+TransformSystem::TransformSystem()
+{
+    clear();
+}
+
+void TransformSystem::clear()
+{
+    parents_.clear();
+    levelStarts_.clear();
+
+    // padding past the last node, see updateNodes()
+    for (std::vector<float>& values : position_)
+        values.assign(simdWidth - 1, 0.0f);
+    for (std::vector<float>& values : rotation_)
+        values.assign(simdWidth - 1, 0.0f);
+    for (std::vector<float>& values : scale_)
+        values.assign(simdWidth - 1, 0.0f);
+    for (std::vector<float>& values : previousRotation_)
+        values.assign(simdWidth - 1, 0.0f);
+    for (std::vector<float>& values : angularVelocity_)
+        values.assign(simdWidth - 1, 0.0f);
+    world_.clear();
+}
+
+uint32_t TransformSystem::create(uint32_t parent)
+{
+    const uint32_t node = count();
+
+    uint32_t level = 0;
+    if (parent != InvalidTransform) {
+        if (parent >= node)
+            return InvalidTransform;
+        level = static_cast<uint32_t>(std::upper_bound(levelStarts_.begin(), levelStarts_.end(), parent) - levelStarts_.begin());
+    }
+
+    if (level + 1 < levelCount())
+        return InvalidTransform;
+    if (level == levelCount())
+        levelStarts_.push_back(node);
+
+    parents_.push_back(parent);
+
+    // identity, the padding stays behind the last node
+    const float position[] = { 0.0f, 0.0f, 0.0f };
+    const float rotation[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    const float scale[] = { 1.0f, 1.0f, 1.0f };
+    for (uint32_t i = 0; i < 3; ++i)
+        position_[i].insert(position_[i].begin() + node, position[i]);
+    for (uint32_t i = 0; i < 4; ++i)
+        rotation_[i].insert(rotation_[i].begin() + node, rotation[i]);
+    for (uint32_t i = 0; i < 3; ++i)
+        scale_[i].insert(scale_[i].begin() + node, scale[i]);
+    for (uint32_t i = 0; i < 4; ++i)
+        previousRotation_[i].insert(previousRotation_[i].begin() + node, rotation[i]);
+    for (uint32_t i = 0; i < 3; ++i)
+        angularVelocity_[i].insert(angularVelocity_[i].begin() + node, 0.0f);
+
+    world_.push_back(matrixIdentity());
+
+    return node;
+}
+
+void TransformSystem::setLocalPosition(uint32_t node, const Float3& position)
+{
+    position_[0][node] = position.x;
+    position_[1][node] = position.y;
+    position_[2][node] = position.z;
+}
+
+void TransformSystem::setLocalRotation(uint32_t node, const Float4& rotation)
+{
+    rotation_[0][node] = rotation.x;
+    rotation_[1][node] = rotation.y;
+    rotation_[2][node] = rotation.z;
+    rotation_[3][node] = rotation.w;
+
+    previousRotation_[0][node] = rotation.x;
+    previousRotation_[1][node] = rotation.y;
+    previousRotation_[2][node] = rotation.z;
+    previousRotation_[3][node] = rotation.w;
+}
+
+void TransformSystem::setLocalScale(uint32_t node, const Float3& scale)
+{
+    scale_[0][node] = scale.x;
+    scale_[1][node] = scale.y;
+    scale_[2][node] = scale.z;
+}
+
+void TransformSystem::setAngularVelocity(uint32_t node, const Float3& velocity)
+{
+    angularVelocity_[0][node] = velocity.x;
+    angularVelocity_[1][node] = velocity.y;
+    angularVelocity_[2][node] = velocity.z;
+}
+
+Float3 TransformSystem::localPosition(uint32_t node) const
+{
+    const Float3 result = { position_[0][node], position_[1][node], position_[2][node] };
+    return result;
+}
+
+Float4 TransformSystem::localRotation(uint32_t node) const
+{
+    const Float4 result = { rotation_[0][node], rotation_[1][node], rotation_[2][node], rotation_[3][node] };
+    return result;
+}
+
+Float3 TransformSystem::localScale(uint32_t node) const
+{
+    const Float3 result = { scale_[0][node], scale_[1][node], scale_[2][node] };
+    return result;
+}
+
+Float3 TransformSystem::angularVelocity(uint32_t node) const
+{
+    const Float3 result = { angularVelocity_[0][node], angularVelocity_[1][node], angularVelocity_[2][node] };
+    return result;
+}
+
+void TransformSystem::integrateRotations(float stepTime, JobSystem* jobs)
+{
+    PROFILE_FUNCTION();
+
+    // whole blocks, the last one runs into the padding, which stays zero
+    const uint32_t blocks = (count() + simdWidth - 1) / simdWidth;
+
+    if (jobs && count() >= 2 * minNodesPerJob_) {
+        jobs->parallelFor(0, blocks, minNodesPerJob_ / simdWidth, [this, stepTime](uint32_t first, uint32_t last) {
+            integrateNodes(first * simdWidth, last * simdWidth, stepTime);
+        });
+    } else {
+        integrateNodes(0, blocks * simdWidth, stepTime);
+    }
+}
+
+void TransformSystem::integrateNodes(uint32_t begin, uint32_t end, float stepTime)
+{
+    const SimdFloat halfStep = simdSplat(0.5f * stepTime);
+    const SimdFloat one = simdSplat(1.0f);
+    const SimdFloat minSquaredLength = simdSplat(minSquaredLength_);
+
+    // Taylor series of sin(h) / h and cos(h) in h squared, to float
+    // precision while a step turns less than a radian, blocks with a node
+    // that turns further take sinf() and cosf() for it
+    const SimdFloat sin3 = simdSplat(-1.0f / 6.0f), sin5 = simdSplat(1.0f / 120.0f), sin7 = simdSplat(-1.0f / 5040.0f);
+    const SimdFloat cos2 = simdSplat(-1.0f / 2.0f), cos4 = simdSplat(1.0f / 24.0f), cos6 = simdSplat(-1.0f / 720.0f);
+    const SimdFloat maxSeriesHH = simdSplat(maxSeriesHalfAngle_ * maxSeriesHalfAngle_);
+
+    for (uint32_t first = begin; first < end; first += simdWidth) {
+        // half the step's rotation as a vector, its length h is half the
+        // angle the step turns by
+        const SimdFloat vx = simdMul(simdLoad(&angularVelocity_[0][first]), halfStep);
+        const SimdFloat vy = simdMul(simdLoad(&angularVelocity_[1][first]), halfStep);
+        const SimdFloat vz = simdMul(simdLoad(&angularVelocity_[2][first]), halfStep);
+        const SimdFloat hh = simdMulAdd(vx, vx, simdMulAdd(vy, vy, simdMul(vz, vz)));
+
+        SimdFloat sinc = simdMulAdd(hh, simdMulAdd(hh, simdMulAdd(hh, sin7, sin5), sin3), one);
+        SimdFloat dw = simdMulAdd(hh, simdMulAdd(hh, simdMulAdd(hh, cos6, cos4), cos2), one);
+
+        const uint32_t fast = simdMask(simdLess(maxSeriesHH, hh));
+        if (fast != 0) {
+            float hhLanes[simdWidth], sincLanes[simdWidth], dwLanes[simdWidth];
+            simdStore(hhLanes, hh);
+            simdStore(sincLanes, sinc);
+            simdStore(dwLanes, dw);
+
+            for (uint32_t lane = 0; lane < simdWidth; ++lane) {
+                if (fast & (1u << lane)) {
+                    const float h = std::sqrt(hhLanes[lane]);
+                    sincLanes[lane] = std::sin(h) / h;
+                    dwLanes[lane] = std::cos(h);
+                }
+            }
+
+            sinc = simdLoad(sincLanes);
+            dw = simdLoad(dwLanes);
+        }
+
+        const SimdFloat dx = simdMul(vx, sinc);
+        const SimdFloat dy = simdMul(vy, sinc);
+        const SimdFloat dz = simdMul(vz, sinc);
+
+        const SimdFloat x = simdLoad(&rotation_[0][first]);
+        const SimdFloat y = simdLoad(&rotation_[1][first]);
+        const SimdFloat z = simdLoad(&rotation_[2][first]);
+        const SimdFloat w = simdLoad(&rotation_[3][first]);
+
+        simdStore(&previousRotation_[0][first], x);
+        simdStore(&previousRotation_[1][first], y);
+        simdStore(&previousRotation_[2][first], z);
+        simdStore(&previousRotation_[3][first], w);
+
+        // the step after the current rotation, quaternionMultiply(q, d)
+        const SimdFloat nx = simdSub(simdMulAdd(dw, x, simdMulAdd(dx, w, simdMul(dy, z))), simdMul(dz, y));
+        const SimdFloat ny = simdSub(simdMulAdd(dw, y, simdMulAdd(dy, w, simdMul(dz, x))), simdMul(dx, z));
+        const SimdFloat nz = simdSub(simdMulAdd(dw, z, simdMulAdd(dx, y, simdMul(dz, w))), simdMul(dy, x));
+        const SimdFloat nw = simdSub(simdMul(dw, w), simdMulAdd(dx, x, simdMulAdd(dy, y, simdMul(dz, z))));
+
+        // renormalized every step so rounding never builds up, zero stays
+        // zero like quaternionNormalize()
+        const SimdFloat squaredLength = simdMulAdd(nx, nx, simdMulAdd(ny, ny, simdMulAdd(nz, nz, simdMul(nw, nw))));
+        const SimdFloat length = simdSqrt(simdMax(squaredLength, minSquaredLength));
+
+        simdStore(&rotation_[0][first], simdDiv(nx, length));
+        simdStore(&rotation_[1][first], simdDiv(ny, length));
+        simdStore(&rotation_[2][first], simdDiv(nz, length));
+        simdStore(&rotation_[3][first], simdDiv(nw, length));
+    }
+}
+
+void TransformSystem::updateWorld(JobSystem* jobs, float alpha)
+{
+    PROFILE_FUNCTION();
+
+    // a level only depends on the ones before it
+    for (uint32_t level = 0; level < levelCount(); ++level) {
+        const uint32_t begin = levelStarts_[level];
+        const uint32_t end = level + 1 < levelCount() ? levelStarts_[level + 1] : count();
+
+        if (jobs && end - begin >= 2 * minNodesPerJob_)
+            jobs->parallelFor(begin, end, minNodesPerJob_, [this, alpha](uint32_t first, uint32_t last) { updateNodes(first, last, alpha); });
+        else
+            updateNodes(begin, end, alpha);
+    }
+}
+
+void TransformSystem::updateNodes(uint32_t begin, uint32_t end, float alpha)
+{
+    // the nodes are all on one level, either all roots or none
+    const bool roots = parents_[begin] == InvalidTransform;
+
+    const SimdFloat zero = simdSplat(0.0f);
+    const SimdFloat one = simdSplat(1.0f);
+    const SimdFloat two = simdSplat(2.0f);
+
+    // normalized lerp between the rotations, for the small turn of a step
+    // it is as good as a slerp
+    const bool interpolate = alpha != 1.0f;
+    const SimdFloat previousWeight = simdSplat(1.0f - alpha);
+    const SimdFloat currentWeight = simdSplat(alpha);
+    const SimdFloat minSquaredLength = simdSplat(minSquaredLength_);
+
+    for (uint32_t first = begin; first < end; first += simdWidth) {
+        const uint32_t lanes = std::min(simdWidth, end - first);
+
+        // lanes past end may belong to the next level or the padding, they
+        // are computed but not stored
+        SimdFloat x = simdLoad(&rotation_[0][first]);
+        SimdFloat y = simdLoad(&rotation_[1][first]);
+        SimdFloat z = simdLoad(&rotation_[2][first]);
+        SimdFloat w = simdLoad(&rotation_[3][first]);
+
+        if (interpolate) {
+            const SimdFloat px = simdLoad(&previousRotation_[0][first]);
+            const SimdFloat py = simdLoad(&previousRotation_[1][first]);
+            const SimdFloat pz = simdLoad(&previousRotation_[2][first]);
+            const SimdFloat pw = simdLoad(&previousRotation_[3][first]);
+
+            // q and -q are the same rotation, the previous one is flipped
+            // to the current one's side so the blend takes the short way
+            const SimdFloat dot = simdMulAdd(px, x, simdMulAdd(py, y, simdMulAdd(pz, z, simdMul(pw, w))));
+            const SimdFloat flip = simdAnd(simdLess(dot, zero), simdMul(two, previousWeight));
+            const SimdFloat weight = simdSub(previousWeight, flip);
+
+            x = simdMulAdd(px, weight, simdMul(x, currentWeight));
+            y = simdMulAdd(py, weight, simdMul(y, currentWeight));
+            z = simdMulAdd(pz, weight, simdMul(z, currentWeight));
+            w = simdMulAdd(pw, weight, simdMul(w, currentWeight));
+
+            const SimdFloat squaredLength = simdMulAdd(x, x, simdMulAdd(y, y, simdMulAdd(z, z, simdMul(w, w))));
+            const SimdFloat length = simdSqrt(simdMax(squaredLength, minSquaredLength));
+            x = simdDiv(x, length);
+            y = simdDiv(y, length);
+            z = simdDiv(z, length);
+            w = simdDiv(w, length);
+        }
+
+        const SimdFloat xx = simdMul(x, x), yy = simdMul(y, y), zz = simdMul(z, z);
+        const SimdFloat xy = simdMul(x, y), xz = simdMul(x, z), yz = simdMul(y, z);
+        const SimdFloat wx = simdMul(w, x), wy = simdMul(w, y), wz = simdMul(w, z);
+
+        const SimdFloat scaleX = simdLoad(&scale_[0][first]);
+        const SimdFloat scaleY = simdLoad(&scale_[1][first]);
+        const SimdFloat scaleZ = simdLoad(&scale_[2][first]);
+
+        // scale times the rotation matrix, then the translation row. The
+        // last column of an affine matrix is always 0, 0, 0, 1 and left out.
+        SimdFloat local[12];
+        local[0] = simdMul(scaleX, simdSub(one, simdMul(two, simdAdd(yy, zz))));
+        local[1] = simdMul(scaleX, simdMul(two, simdAdd(xy, wz)));
+        local[2] = simdMul(scaleX, simdMul(two, simdSub(xz, wy)));
+        local[3] = simdMul(scaleY, simdMul(two, simdSub(xy, wz)));
+        local[4] = simdMul(scaleY, simdSub(one, simdMul(two, simdAdd(xx, zz))));
+        local[5] = simdMul(scaleY, simdMul(two, simdAdd(yz, wx)));
+        local[6] = simdMul(scaleZ, simdMul(two, simdAdd(xz, wy)));
+        local[7] = simdMul(scaleZ, simdMul(two, simdSub(yz, wx)));
+        local[8] = simdMul(scaleZ, simdSub(one, simdMul(two, simdAdd(xx, yy))));
+        local[9] = simdLoad(&position_[0][first]);
+        local[10] = simdLoad(&position_[1][first]);
+        local[11] = simdLoad(&position_[2][first]);
+
+        SimdFloat result[12];
+
+        if (roots) {
+            for (uint32_t i = 0; i < 12; ++i)
+                result[i] = local[i];
+        } else {
+            // unused lanes take the first lane's parent, which is done
+            const Float4x4* parents[simdWidth];
+            for (uint32_t lane = 0; lane < simdWidth; ++lane)
+                parents[lane] = &world_[parents_[lane < lanes ? first + lane : first]];
+
+            // a row of each parent, transposed into one element per lane.
+            // The last column is not needed.
+            SimdFloat parent[12];
+            for (uint32_t row = 0; row < 4; ++row) {
+                SimdFloat lastColumn = simdLoad(parents[3]->m[row]);
+                parent[row * 3 + 0] = simdLoad(parents[0]->m[row]);
+                parent[row * 3 + 1] = simdLoad(parents[1]->m[row]);
+                parent[row * 3 + 2] = simdLoad(parents[2]->m[row]);
+                simdTranspose(parent[row * 3 + 0], parent[row * 3 + 1], parent[row * 3 + 2], lastColumn);
+            }
+
+            for (uint32_t row = 0; row < 4; ++row) {
+                for (uint32_t column = 0; column < 3; ++column) {
+                    SimdFloat value = row == 3 ? parent[9 + column] : zero;
+                    value = simdMulAdd(local[row * 3 + 0], parent[column], value);
+                    value = simdMulAdd(local[row * 3 + 1], parent[3 + column], value);
+                    value = simdMulAdd(local[row * 3 + 2], parent[6 + column], value);
+                    result[row * 3 + column] = value;
+                }
+            }
+        }
+
+        // back to one row per lane, with the last column filled in
+        for (uint32_t row = 0; row < 4; ++row) {
+            SimdFloat rows[simdWidth] = { result[row * 3 + 0], result[row * 3 + 1], result[row * 3 + 2], row == 3 ? one : zero };
+            simdTranspose(rows[0], rows[1], rows[2], rows[3]);
+
+            for (uint32_t lane = 0; lane < lanes; ++lane)
+                simdStore(world_[first + lane].m[row], rows[lane]);
+        }
+    }
+}
+
+static Float4x4 scalarLocalMatrix(const TransformSystem& transforms, uint32_t node)
+{
+    const Float3 scale = transforms.localScale(node);
+    const Float3 position = transforms.localPosition(node);
+
+    Float4x4 result = matrixRotationQuaternion(transforms.localRotation(node));
+    for (uint32_t column = 0; column < 3; ++column) {
+        result.m[0][column] *= scale.x;
+        result.m[1][column] *= scale.y;
+        result.m[2][column] *= scale.z;
+    }
+    result.m[3][0] = position.x;
+    result.m[3][1] = position.y;
+    result.m[3][2] = position.z;
+
+    return result;
+}
+
+TransformBenchmark measureTransformUpdate(uint32_t nodeCount, uint32_t threadCount, uint32_t iterations)
+{
+    TransformBenchmark result = {};
+    result.nodes = nodeCount;
+    result.threads = threadCount + 1;
+    if (nodeCount == 0 || iterations == 0)
+        return result;
+
+    // fixed seed lcg, every run builds the same hierarchy
+    uint32_t seed = 0x12345678;
+    auto random = [&seed](float low, float high) {
+        seed = seed * 1664525u + 1013904223u;
+        return low + (high - low) * static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+    };
+
+    // breadth first with four children per node keeps it level ordered
+    TransformSystem transforms;
+    for (uint32_t i = 0; i < nodeCount; ++i) {
+        const uint32_t node = transforms.create(i == 0 ? InvalidTransform : (i - 1) / 4);
+
+        const Float3 position = { random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f) };
+        const Float4 rotation = quaternionNormalize({ random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f) });
+        const Float3 scale = { random(0.9f, 1.1f), random(0.9f, 1.1f), random(0.9f, 1.1f) };
+        transforms.setLocalPosition(node, position);
+        transforms.setLocalRotation(node, rotation);
+        transforms.setLocalScale(node, scale);
+    }
+    result.levels = transforms.levelCount();
+
+    JobSystem jobs;
+    jobs.start(threadCount);
+
+    typedef std::chrono::duration<double> Seconds;
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < iterations; ++i)
+        transforms.updateWorld(&jobs);
+
+    result.secondsPerUpdate = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+    jobs.stop();
+
+    std::vector<Float4x4> world(nodeCount);
+    start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < iterations; ++i) {
+        for (uint32_t node = 0; node < nodeCount; ++node) {
+            const Float4x4 local = scalarLocalMatrix(transforms, node);
+            const uint32_t parent = transforms.parent(node);
+            world[node] = parent == InvalidTransform ? local : matrixMultiply(local, world[parent]);
+        }
+    }
+
+    result.scalarSecondsPerUpdate = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+    for (uint32_t node = 0; node < nodeCount; ++node) {
+        const Float4x4 simdWorld = transforms.world(node);
+        for (uint32_t row = 0; row < 4; ++row) {
+            for (uint32_t column = 0; column < 4; ++column)
+                result.maxError = std::max(result.maxError, std::fabs(simdWorld.m[row][column] - world[node].m[row][column]));
+        }
+    }
+
+    return result;
+}
+
+RotationBenchmark measureRotationIntegration(uint32_t nodeCount, uint32_t threadCount, uint32_t steps)
+{
+    RotationBenchmark result = {};
+    result.nodes = nodeCount;
+    result.threads = threadCount + 1;
+    result.steps = steps;
+    if (nodeCount == 0 || steps == 0)
+        return result;
+
+    // fixed seed lcg, every run spins the same nodes
+    uint32_t seed = 0x12345678;
+    auto random = [&seed](float low, float high) {
+        seed = seed * 1664525u + 1013904223u;
+        return low + (high - low) * static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+    };
+
+    // all roots, a flat list of spinning objects
+    TransformSystem transforms;
+    std::vector<Float4> start(nodeCount);
+    std::vector<Float3> velocity(nodeCount);
+
+    for (uint32_t i = 0; i < nodeCount; ++i) {
+        const uint32_t node = transforms.create(InvalidTransform);
+
+        start[i] = quaternionNormalize({ random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f) });
+        velocity[i] = { random(-2.0f, 2.0f), random(-2.0f, 2.0f), random(-2.0f, 2.0f) };
+        transforms.setLocalRotation(node, start[i]);
+        transforms.setAngularVelocity(node, velocity[i]);
+    }
+
+    JobSystem jobs;
+    jobs.start(threadCount);
+
+    typedef std::chrono::duration<double> Seconds;
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (uint32_t step = 0; step < steps; ++step)
+        transforms.integrateRotations(benchmarkStepTime_, &jobs);
+
+    result.secondsPerStep = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - startTime).count() / steps;
+
+    jobs.stop();
+
+    // what every object did on its own, a rotation per axis
+    const Float3 axisX = { 1.0f, 0.0f, 0.0f };
+    const Float3 axisY = { 0.0f, 1.0f, 0.0f };
+    const Float3 axisZ = { 0.0f, 0.0f, 1.0f };
+    std::vector<Float4> scalar(start);
+    startTime = std::chrono::steady_clock::now();
+
+    for (uint32_t step = 0; step < steps; ++step) {
+        for (uint32_t i = 0; i < nodeCount; ++i) {
+            const Float4 rotX = quaternionRotationNormal(axisX, velocity[i].x * benchmarkStepTime_);
+            const Float4 rotY = quaternionRotationNormal(axisY, velocity[i].y * benchmarkStepTime_);
+            const Float4 rotZ = quaternionRotationNormal(axisZ, velocity[i].z * benchmarkStepTime_);
+            scalar[i] = quaternionNormalize(quaternionMultiply(quaternionMultiply(quaternionMultiply(scalar[i], rotX), rotY), rotZ));
+        }
+    }
+
+    result.scalarSecondsPerStep = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - startTime).count() / steps;
+
+    // constant spin turns the start rotation around the axis of the
+    // velocity by its length times the time, worked out in double
+    const double time = static_cast<double>(benchmarkStepTime_) * steps;
+
+    for (uint32_t i = 0; i < nodeCount; ++i) {
+        const double vx = velocity[i].x, vy = velocity[i].y, vz = velocity[i].z;
+        const double speed = std::sqrt(vx * vx + vy * vy + vz * vz);
+        const double halfAngle = 0.5 * speed * time;
+        const double s = speed > 0.0 ? std::sin(halfAngle) / speed : 0.0;
+        const double dx = vx * s, dy = vy * s, dz = vz * s, dw = std::cos(halfAngle);
+        const double x = start[i].x, y = start[i].y, z = start[i].z, w = start[i].w;
+
+        const double ex = dw * x + dx * w + dy * z - dz * y;
+        const double ey = dw * y - dx * z + dy * w + dz * x;
+        const double ez = dw * z + dx * y - dy * x + dz * w;
+        const double ew = dw * w - dx * x - dy * y - dz * z;
+
+        const Float4 q = transforms.localRotation(i);
+        const double norm = std::sqrt(static_cast<double>(q.x) * q.x + static_cast<double>(q.y) * q.y + static_cast<double>(q.z) * q.z + static_cast<double>(q.w) * q.w);
+        result.maxNormError = std::max(result.maxNormError, static_cast<float>(std::fabs(norm - 1.0)));
+
+        // unit quaternions a chord c apart are rotations 4 asin(c / 2)
+        // apart, which unlike the acos of their dot holds up for tiny angles
+        const double sign = ex * q.x + ey * q.y + ez * q.z + ew * q.w < 0.0 ? -1.0 : 1.0;
+        const double cx = ex - sign * q.x / norm, cy = ey - sign * q.y / norm, cz = ez - sign * q.z / norm, cw = ew - sign * q.w / norm;
+        const double chord = std::sqrt(cx * cx + cy * cy + cz * cz + cw * cw);
+        const float angle = static_cast<float>(4.0 * std::asin(std::min(1.0, 0.5 * chord)));
+        result.maxAngleError = std::max(result.maxAngleError, angle);
+    }
+
+    return result;
+}
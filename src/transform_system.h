@@ -0,0 +1,116 @@
+#if !defined(TRANSFORM_SYSTEM_H)
+#define TRANSFORM_SYSTEM_H
+
+#include "scene_math.h"
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+constexpr uint32_t InvalidTransform = 0xffffffff;
+
+// Transform hierarchy, local transforms are stored as structure of arrays
+// and world matrices as one matrix per node. Nodes are kept in order of
+// their depth in the hierarchy, so the nodes of one level are contiguous
+// and every parent comes before its children. World matrices are computed
+// level by level, four nodes at a time, and the nodes of a level are split
+// across workers.
+//
+// A local transform is scale, then rotation, then translation, the world
+// matrix is the local one followed by the parent's.
+//
+// Rotations are quaternions, nodes that spin have an angular velocity that
+// integrateRotations() steps them by, four at a time. Matrices are only
+// built by updateWorld(), which can interpolate between the last two steps.
+class TransformSystem
+{
+public:
+    TransformSystem();
+
+    void clear();
+
+    // hierarchies are created level by level: a node has to be as deep as
+    // the last one or one level deeper. Returns InvalidTransform if it
+    // would be shallower or the parent does not exist.
+    uint32_t create(uint32_t parent);
+
+    uint32_t count() const { return static_cast<uint32_t>(parents_.size()); }
+    uint32_t levelCount() const { return static_cast<uint32_t>(levelStarts_.size()); }
+    uint32_t parent(uint32_t node) const { return parents_[node]; }
+
+    // a rotation that is set is not interpolated to, the node jumps there
+    void setLocalPosition(uint32_t node, const Float3& position);
+    void setLocalRotation(uint32_t node, const Float4& rotation);
+    void setLocalScale(uint32_t node, const Float3& scale);
+
+    // radians per second around the parent's axes
+    void setAngularVelocity(uint32_t node, const Float3& velocity);
+
+    Float3 localPosition(uint32_t node) const;
+    Float4 localRotation(uint32_t node) const;
+    Float3 localScale(uint32_t node) const;
+    Float3 angularVelocity(uint32_t node) const;
+
+    // turns every node by its angular velocity over stepTime and keeps the
+    // rotations from before for updateWorld(). Rotations are renormalized
+    // every step, so they stay unit length however many steps are taken.
+    // jobs may be null.
+    void integrateRotations(float stepTime, JobSystem* jobs);
+
+    // recomputes every world matrix with the local rotations alpha of the
+    // way from before the last integrateRotations() to after it, jobs may
+    // be null to do it on the calling thread
+    void updateWorld(JobSystem* jobs, float alpha = 1.0f);
+
+    const Float4x4& world(uint32_t node) const { return world_[node]; }
+
+private:
+    void integrateNodes(uint32_t begin, uint32_t end, float stepTime);
+    void updateNodes(uint32_t begin, uint32_t end, float alpha);
+
+    std::vector<uint32_t> parents_;
+    std::vector<uint32_t> levelStarts_;
+
+    // local TRS, padded past the last node so a block of nodes can always
+    // be loaded whole
+    std::vector<float> position_[3];
+    std::vector<float> rotation_[4];
+    std::vector<float> scale_[3];
+    std::vector<float> previousRotation_[4];
+    std::vector<float> angularVelocity_[3];
+
+    // whole matrices, children gather their parent's in one go
+    std::vector<Float4x4> world_;
+};
+
+struct TransformBenchmark
+{
+    uint32_t nodes;
+    uint32_t levels;
+    uint32_t threads;
+    double secondsPerUpdate;
+    double scalarSecondsPerUpdate; // one matrix at a time with scene_math
+    float maxError;                // largest difference to the scalar result
+};
+
+// updates a hierarchy of nodeCount nodes, every node having up to four
+// children, iterations times
+TransformBenchmark measureTransformUpdate(uint32_t nodeCount, uint32_t threadCount, uint32_t iterations);
+
+struct RotationBenchmark
+{
+    uint32_t nodes;
+    uint32_t threads;
+    uint32_t steps;
+    double secondsPerStep;
+    double scalarSecondsPerStep; // a rotation per axis and object, multiplied one after the other
+    float maxNormError;          // how far a rotation got from unit length
+    float maxAngleError;         // radians between a rotation and where constant spin puts it
+};
+
+// spins nodeCount nodes at 60 steps a second for steps steps, a day is
+// about five million
+RotationBenchmark measureRotationIntegration(uint32_t nodeCount, uint32_t threadCount, uint32_t steps);
+
+#endif // TRANSFORM_SYSTEM_H
@@ -0,0 +1,95 @@
+#include "bindless_table.h"
+
+#include "test.h"
+
+TEST(BindlessTable, HandsOutLowIndicesFirst)
+{
+    BindlessTable table;
+    table.reset(4, 2);
+
+    const BindlessHandle a = table.allocate();
+    const BindlessHandle b = table.allocate();
+    CHECK(a.index == 0);
+    CHECK(b.index == 1);
+    CHECK(table.isAlive(a));
+    CHECK(table.isAlive(b));
+    CHECK(table.liveCount() == 2);
+
+    table.allocate();
+    table.allocate();
+    CHECK(table.allocate().index == InvalidBindlessIndex);
+}
+
+TEST(BindlessTable, NeverAllocatedSlotsAreNotAlive)
+{
+    BindlessTable table;
+    table.reset(4, 2);
+
+    const BindlessHandle forged = { 2, 0 };
+    CHECK(!table.isAlive(forged));
+    CHECK(!table.isAlive({ 7, 1 }));
+
+    // releasing it must not free the slot or count it
+    table.release(forged);
+    CHECK(table.liveCount() == 0);
+    CHECK(table.pendingCount() == 0);
+}
+
+TEST(BindlessTable, DoubleReleaseIsIgnored)
+{
+    BindlessTable table;
+    table.reset(2, 1);
+
+    const BindlessHandle handle = table.allocate();
+    table.release(handle);
+    table.release(handle);
+    CHECK(!table.isAlive(handle));
+    CHECK(table.liveCount() == 0);
+    CHECK(table.pendingCount() == 1);
+
+    // the index comes back once, so two allocations never share it
+    table.beginFrame();
+    const BindlessHandle a = table.allocate();
+    const BindlessHandle b = table.allocate();
+    CHECK(a.index != InvalidBindlessIndex);
+    CHECK(b.index != InvalidBindlessIndex);
+    CHECK(a.index != b.index);
+    CHECK(table.allocate().index == InvalidBindlessIndex);
+}
+
+TEST(BindlessTable, StaleHandlesStayDead)
+{
+    BindlessTable table;
+    table.reset(1, 1);
+
+    const BindlessHandle old = table.allocate();
+    table.release(old);
+    table.beginFrame();
+
+    const BindlessHandle reused = table.allocate();
+    CHECK(reused.index == old.index);
+    CHECK(reused.generation != old.generation);
+    CHECK(table.isAlive(reused));
+    CHECK(!table.isAlive(old));
+
+    // the stale handle cannot release the slot's new owner
+    table.release(old);
+    CHECK(table.isAlive(reused));
+    CHECK(table.liveCount() == 1);
+}
+
+TEST(BindlessTable, ReleasedIndicesWaitForFramesInFlight)
+{
+    BindlessTable table;
+    table.reset(1, 2);
+
+    table.release(table.allocate());
+    CHECK(table.allocate().index == InvalidBindlessIndex);
+
+    table.beginFrame();
+    CHECK(table.allocate().index == InvalidBindlessIndex);
+
+    table.beginFrame();
+    CHECK(table.pendingCount() == 0);
+    CHECK(table.allocate().index == 0);
+}
@@ -0,0 +1,290 @@
+#include "command_capture.h"
+
+#include "test.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char* capturePath_ = "command_capture_test.dxcs";
+
+static void appendRecord(std::vector<uint8_t>& data, uint32_t op, const void* payload, uint16_t size)
+{
+    CaptureRecordHeader header = {};
+    header.op = static_cast<uint8_t>(op);
+    header.size = size;
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&header);
+    data.insert(data.end(), bytes, bytes + sizeof(header));
+    if (size > 0)
+        data.insert(data.end(), static_cast<const uint8_t*>(payload), static_cast<const uint8_t*>(payload) + size);
+}
+
+static std::vector<uint8_t> fileHeader(const char* magic, uint32_t version)
+{
+    CaptureFileHeader header;
+    memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = version;
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&header);
+    return std::vector<uint8_t>(bytes, bytes + sizeof(header));
+}
+
+// a frame the way CaptureFile writes it, built in memory
+static void appendFrame(std::vector<uint8_t>& data, uint64_t frame, const CommandCapture& list)
+{
+    appendRecord(data, CaptureOpFrameBegin, &frame, sizeof(frame));
+    data.insert(data.end(), list.data().begin(), list.data().end());
+    appendRecord(data, CaptureOpFrameEnd, nullptr, 0);
+}
+
+static void recordDraw(CommandCapture& list, uint32_t indexCount)
+{
+    list.reset(100);
+    list.setPrimitiveTopology(4);
+    list.drawIndexed(indexCount, 1, 0, 0, 0);
+    list.close();
+}
+
+TEST(CommandCapture, RoundTripsThroughAFile)
+{
+    const uint64_t heap = 5;
+    const float color[4] = { 0.0f, 0.2f, 0.4f, 1.0f };
+
+    CommandCapture main;
+    main.reset(100);
+    main.setRootSignature(1);
+    main.setDescriptorHeaps(&heap, 1);
+    main.setRootDescriptorTable(0, 0x1000);
+    main.setRootDescriptorTable(0, 0x1000); // redundant
+    main.setRootDescriptorTable(1, 0x1000); // another parameter
+    main.setPipelineState(100);             // redundant, the list was reset with it
+    main.setPrimitiveTopology(4);
+    main.barrier(0, 42, 0, 4);
+    main.clearRenderTarget(42, color);
+    main.drawIndexed(36, 10, 0, 0, 0);
+    main.drawIndexed(36, 1, 36, 8, 10);
+    main.barrier(0, 42, 4, 0);
+    main.close();
+
+    // lists do not inherit what the list before them bound
+    CommandCapture overlay;
+    overlay.reset(200);
+    overlay.setPrimitiveTopology(4);
+    overlay.drawIndexed(6, 2, 0, 0, 0);
+    overlay.close();
+
+    CommandCapture next;
+    recordDraw(next, 3);
+
+    CaptureFile file;
+    CHECK(file.open(capturePath_));
+    file.beginFrame(7);
+    const CommandCapture* lists[] = { &main, &overlay };
+    file.submit(lists, 2);
+    CHECK(file.endFrame());
+
+    file.beginFrame(8);
+    const CommandCapture* nextLists[] = { &next };
+    file.submit(nextLists, 1);
+    CHECK(file.endFrame());
+    file.close();
+
+    CaptureReader reader;
+    const bool loaded = reader.load(capturePath_);
+    std::remove(capturePath_);
+    CHECK(loaded);
+
+    std::vector<CaptureFrameStats> frames;
+    CHECK(analyzeCapture(reader, frames));
+    CHECK(frames.size() == 2);
+    if (frames.size() != 2)
+        return;
+
+    const CaptureFrameStats& first = frames[0];
+    CHECK(first.frame == 7);
+    CHECK(first.commandLists == 2);
+    CHECK(first.draws == 3);
+    CHECK(first.instances == 13);
+    CHECK(first.indices == 36 * 10 + 36 + 6 * 2);
+    CHECK(first.stateChanges == 8);
+    CHECK(first.redundantStateChanges == 2);
+    CHECK(first.barriers == 2);
+    CHECK(first.clears == 1);
+    CHECK(first.bytes == main.data().size() + overlay.data().size() + 2 * sizeof(CaptureRecordHeader) + sizeof(uint64_t));
+
+    const CaptureFrameStats& second = frames[1];
+    CHECK(second.frame == 8);
+    CHECK(second.commandLists == 1);
+    CHECK(second.draws == 1);
+    CHECK(second.indices == 3);
+    CHECK(second.redundantStateChanges == 0);
+
+    // analyzing again starts from the first record
+    CHECK(analyzeCapture(reader, frames));
+    CHECK(frames.size() == 2);
+}
+
+TEST(CommandCapture, RejectsBadHeaders)
+{
+    CaptureReader reader;
+    CHECK(!reader.setData(fileHeader("DXCX", captureVersion)));
+    CHECK(!reader.setData(fileHeader("DXCS", captureVersion + 1)));
+    CHECK(!reader.setData(fileHeader("DXCS", captureVersion - 1)));
+
+    std::vector<uint8_t> short_ = fileHeader("DXCS", captureVersion);
+    short_.pop_back();
+    CHECK(!reader.setData(short_));
+    CHECK(!reader.load("command_capture_test_missing.dxcs"));
+
+    // a header alone is an empty capture
+    CHECK(reader.setData(fileHeader("DXCS", captureVersion)));
+    std::vector<CaptureFrameStats> frames;
+    CHECK(analyzeCapture(reader, frames));
+    CHECK(frames.empty());
+}
+
+TEST(CommandCapture, StopsAtTruncatedRecords)
+{
+    CommandCapture list;
+    recordDraw(list, 3);
+
+    std::vector<uint8_t> data = fileHeader("DXCS", captureVersion);
+    appendFrame(data, 1, list);
+    const size_t complete = data.size();
+
+    // a record whose payload runs past the end of the data
+    const uint32_t draw[5] = { 3, 1, 0, 0, 0 };
+    appendRecord(data, CaptureOpDrawIndexed, draw, sizeof(draw));
+    data.resize(data.size() - 4);
+
+    CaptureReader reader;
+    CHECK(reader.setData(data));
+    CaptureRecord record;
+    uint32_t records = 0;
+    uint32_t bytes = sizeof(CaptureFileHeader);
+    while (reader.next(record)) {
+        records++;
+        bytes += static_cast<uint32_t>(sizeof(CaptureRecordHeader) + record.size);
+    }
+    CHECK(records == 6);
+    CHECK(bytes == complete);
+
+    // a cut off record header ends the stream the same way
+    data.resize(complete + 2);
+    CHECK(reader.setData(data));
+    records = 0;
+    while (reader.next(record))
+        records++;
+    CHECK(records == 6);
+}
+
+TEST(CommandCapture, RejectsRecordsTooShortForTheirOp)
+{
+    const uint64_t frame = 1;
+    const uint32_t indexCount = 3;
+
+    std::vector<uint8_t> data = fileHeader("DXCS", captureVersion);
+    appendRecord(data, CaptureOpFrameBegin, &frame, sizeof(frame));
+    appendRecord(data, CaptureOpListBegin, &frame, sizeof(frame));
+    appendRecord(data, CaptureOpDrawIndexed, &indexCount, sizeof(indexCount));
+
+    CaptureReader reader;
+    std::vector<CaptureFrameStats> frames;
+    CHECK(reader.setData(data));
+    CHECK(!analyzeCapture(reader, frames));
+
+    // a frame number needs 8 bytes
+    data = fileHeader("DXCS", captureVersion);
+    appendRecord(data, CaptureOpFrameBegin, &indexCount, sizeof(indexCount));
+    CHECK(reader.setData(data));
+    CHECK(!analyzeCapture(reader, frames));
+
+    // commands outside of a list or a frame
+    const uint32_t draw[5] = { indexCount, 1, 0, 0, 0 };
+    data = fileHeader("DXCS", captureVersion);
+    appendRecord(data, CaptureOpFrameBegin, &frame, sizeof(frame));
+    appendRecord(data, CaptureOpDrawIndexed, draw, sizeof(draw));
+    CHECK(reader.setData(data));
+    CHECK(!analyzeCapture(reader, frames));
+
+    data = fileHeader("DXCS", captureVersion);
+    appendRecord(data, CaptureOpListBegin, &frame, sizeof(frame));
+    CHECK(reader.setData(data));
+    CHECK(!analyzeCapture(reader, frames));
+}
+
+TEST(CommandCapture, DropsAFrameCutOffMidStream)
+{
+    CommandCapture list;
+    recordDraw(list, 3);
+
+    std::vector<uint8_t> data = fileHeader("DXCS", captureVersion);
+    appendFrame(data, 1, list);
+    appendFrame(data, 2, list);
+
+    // the capture stops in the middle of the third frame's list
+    std::vector<uint8_t> cut = data;
+    appendFrame(cut, 3, list);
+    cut.resize(data.size() + sizeof(CaptureRecordHeader) + sizeof(uint64_t) + list.data().size() / 2);
+
+    CaptureReader reader;
+    std::vector<CaptureFrameStats> frames;
+    CHECK(reader.setData(cut));
+    CHECK(analyzeCapture(reader, frames));
+    CHECK(frames.size() == 2);
+    if (frames.size() == 2) {
+        CHECK(frames[0].frame == 1);
+        CHECK(frames[1].frame == 2);
+        CHECK(frames[1].draws == 1);
+    }
+
+    // a frame missing only its end record is dropped as well
+    cut = data;
+    appendFrame(cut, 3, list);
+    cut.resize(cut.size() - sizeof(CaptureRecordHeader));
+    CHECK(reader.setData(cut));
+    CHECK(analyzeCapture(reader, frames));
+    CHECK(frames.size() == 2);
+}
+
+TEST(CommandCapture, RootSignatureClearsRootParameters)
+{
+    const uint32_t constants[2] = { 1, 2 };
+
+    CommandCapture list;
+    list.reset(100);
+    list.setPrimitiveTopology(4);
+    list.setRootSignature(1);
+    list.setRootDescriptorTable(0, 0x1000);
+    list.setRootConstantBuffer(1, 0x2000);
+    list.setRootConstants(2, constants, 2, 0);
+
+    // a new root signature leaves every root parameter unbound, the rest of
+    // the state stays
+    list.setRootSignature(2);
+    list.setRootDescriptorTable(0, 0x1000);
+    list.setRootConstantBuffer(1, 0x2000);
+    list.setRootConstants(2, constants, 2, 0);
+    list.setPrimitiveTopology(4); // redundant
+
+    // same arguments under the same root signature
+    list.setRootDescriptorTable(0, 0x1000); // redundant
+    list.setRootConstantBuffer(1, 0x2000);  // redundant
+    list.setRootSignature(2);               // redundant
+    list.close();
+
+    std::vector<uint8_t> data = fileHeader("DXCS", captureVersion);
+    appendFrame(data, 1, list);
+
+    CaptureReader reader;
+    std::vector<CaptureFrameStats> frames;
+    CHECK(reader.setData(data));
+    CHECK(analyzeCapture(reader, frames));
+    CHECK(frames.size() == 1);
+    if (frames.size() == 1) {
+        CHECK(frames[0].stateChanges == 13);
+        CHECK(frames[0].redundantStateChanges == 4);
+    }
+}
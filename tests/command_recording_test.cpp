@@ -0,0 +1,179 @@
+#include "command_recording.h"
+
+#include "test.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// chunks that cover 0..drawCount in order, sizes at most one apart
+static bool coversInOrder(const std::vector<DrawRange>& chunks, uint32_t drawCount)
+{
+    if (chunks.empty() || chunks.front().begin != 0 || chunks.back().end != drawCount)
+        return false;
+
+    uint32_t smallest = drawCount;
+    uint32_t largest = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        if (chunks[i].end <= chunks[i].begin || (i > 0 && chunks[i].begin != chunks[i - 1].end))
+            return false;
+        smallest = std::min(smallest, chunks[i].end - chunks[i].begin);
+        largest = std::max(largest, chunks[i].end - chunks[i].begin);
+    }
+
+    return largest - smallest <= 1;
+}
+
+// remembers which worker recorded every chunk
+class WorkerRecordingBackend : public CommandRecordingBackend
+{
+public:
+    explicit WorkerRecordingBackend(uint32_t chunkCount)
+        : workers(chunkCount)
+        , calls(chunkCount)
+    {
+        for (std::atomic<uint32_t>& count : calls)
+            count = 0;
+    }
+
+    void recordChunk(uint32_t chunk, const DrawRange& range, uint32_t worker) override
+    {
+        (void)range;
+        workers[chunk] = worker;
+        calls[chunk]++;
+    }
+
+    std::vector<uint32_t> workers;
+    std::vector<std::atomic<uint32_t>> calls;
+};
+
+TEST(PartitionDraws, SplitsEvenly)
+{
+    std::vector<DrawRange> chunks;
+
+    partitionDraws(1000, 4, 1, chunks);
+    CHECK(chunks.size() == 4);
+    CHECK(coversInOrder(chunks, 1000));
+    CHECK(chunks[0].end == 250);
+
+    // the first chunks take the remainder
+    partitionDraws(1003, 4, 1, chunks);
+    CHECK(chunks.size() == 4);
+    CHECK(coversInOrder(chunks, 1003));
+    CHECK(chunks[0].end - chunks[0].begin == 251);
+    CHECK(chunks[2].end - chunks[2].begin == 251);
+    CHECK(chunks[3].end - chunks[3].begin == 250);
+
+    // fewer draws than chunks
+    partitionDraws(3, 8, 1, chunks);
+    CHECK(chunks.size() == 3);
+    CHECK(coversInOrder(chunks, 3));
+}
+
+TEST(PartitionDraws, KeepsChunksAboveTheMinimum)
+{
+    std::vector<DrawRange> chunks;
+
+    // 16 chunks would be 62 draws each, 256 allow three
+    partitionDraws(1000, 16, 256, chunks);
+    CHECK(chunks.size() == 3);
+    CHECK(coversInOrder(chunks, 1000));
+    for (const DrawRange& chunk : chunks)
+        CHECK(chunk.end - chunk.begin >= 256);
+
+    // below the minimum everything is one chunk
+    partitionDraws(100, 16, 256, chunks);
+    CHECK(chunks.size() == 1);
+    CHECK(coversInOrder(chunks, 100));
+
+    // no draws, no chunks
+    partitionDraws(0, 16, 256, chunks);
+    CHECK(chunks.empty());
+
+    // no limit on chunks or their size still gives at least one chunk
+    partitionDraws(10, 0, 0, chunks);
+    CHECK(chunks.size() == 1);
+    CHECK(coversInOrder(chunks, 10));
+}
+
+TEST(PartitionDraws, CoversEveryCount)
+{
+    std::vector<DrawRange> chunks;
+    bool covered = true;
+    bool bounded = true;
+    for (uint32_t drawCount = 1; drawCount < 2000; drawCount += 7) {
+        for (uint32_t maxChunks = 1; maxChunks <= 9; ++maxChunks) {
+            partitionDraws(drawCount, maxChunks, 64, chunks);
+            covered = covered && coversInOrder(chunks, drawCount);
+            bounded = bounded && chunks.size() <= maxChunks && (chunks.size() == 1 || chunks.back().end - chunks.back().begin >= 64);
+        }
+    }
+    CHECK(covered);
+    CHECK(bounded);
+}
+
+TEST(ParallelRecorder, WorkerIdsAreInRange)
+{
+    JobSystem jobs;
+    jobs.start(3);
+
+    ParallelRecorder recorder(jobs);
+    CHECK(recorder.workerCount() == jobs.workerCount() + 1);
+    CHECK(recorder.currentWorker() == jobs.currentWorker());
+
+    // a thread outside of the job system gets the last id
+    uint32_t external = 0;
+    std::thread thread([&recorder, &external]() { external = recorder.currentWorker(); });
+    thread.join();
+    CHECK(external == recorder.workerCount() - 1);
+
+    std::vector<DrawRange> chunks;
+    partitionDraws(100000, 64, 1, chunks);
+
+    WorkerRecordingBackend backend(static_cast<uint32_t>(chunks.size()));
+    recorder.record(chunks.data(), static_cast<uint32_t>(chunks.size()), backend);
+
+    uint32_t wrongCalls = 0;
+    uint32_t wrongWorkers = 0;
+    for (size_t chunk = 0; chunk < chunks.size(); ++chunk) {
+        wrongCalls += backend.calls[chunk].load() != 1;
+        wrongWorkers += backend.workers[chunk] >= recorder.workerCount();
+    }
+    CHECK(wrongCalls == 0);
+    CHECK(wrongWorkers == 0);
+}
+
+TEST(ParallelRecorder, RecordsFromAnExternalThread)
+{
+    JobSystem jobs;
+    jobs.start(2);
+    ParallelRecorder recorder(jobs);
+
+    std::vector<DrawRange> chunks;
+    partitionDraws(10000, 16, 1, chunks);
+    WorkerRecordingBackend backend(static_cast<uint32_t>(chunks.size()));
+
+    // the render thread is not one of the workers
+    std::thread thread([&recorder, &chunks, &backend]() {
+        recorder.record(chunks.data(), static_cast<uint32_t>(chunks.size()), backend);
+    });
+    thread.join();
+
+    uint32_t wrongCalls = 0;
+    uint32_t wrongWorkers = 0;
+    for (size_t chunk = 0; chunk < chunks.size(); ++chunk) {
+        wrongCalls += backend.calls[chunk].load() != 1;
+        wrongWorkers += backend.workers[chunk] >= recorder.workerCount();
+    }
+    CHECK(wrongCalls == 0);
+    CHECK(wrongWorkers == 0);
+}
+
+TEST(ParallelRecorder, BenchmarkSelfCheck)
+{
+    const RecordingBenchmark result = measureParallelRecording(50000, 3, 256);
+    CHECK(result.threads == 4);
+    CHECK(result.chunkCount == 5);
+    CHECK(result.mismatches == 0);
+}
@@ -0,0 +1,85 @@
+#include "cube_mesh.h"
+
+#include "test.h"
+
+#include <cmath>
+
+TEST(CubeMesh, LevelsIndexTheirOwnVertices)
+{
+    CubeMesh mesh;
+    buildCubeMesh(mesh);
+    CHECK(mesh.lods.size() == 2);
+
+    // every level's indices stay inside the vertices from its base vertex
+    // up to the next level's
+    bool inRange = true;
+    for (size_t level = 0; level < mesh.lods.size(); ++level) {
+        const MeshLod& lod = mesh.lods[level];
+        const uint32_t vertexEnd = level + 1 < mesh.lods.size() ? static_cast<uint32_t>(mesh.lods[level + 1].baseVertex)
+                                                                : static_cast<uint32_t>(mesh.vertices.size());
+        const uint32_t vertexCount = vertexEnd - static_cast<uint32_t>(lod.baseVertex);
+
+        inRange = inRange && lod.indexCount % 3 == 0 && lod.firstIndex + lod.indexCount <= mesh.indices.size();
+        for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.indexCount && inRange; ++i)
+            inRange = mesh.indices[i] < vertexCount;
+    }
+    CHECK(inRange);
+
+    // the box is two triangles a face, the full mesh a lot more
+    CHECK(mesh.lods[1].indexCount == 36);
+    CHECK(mesh.lods[0].indexCount > 4 * mesh.lods[1].indexCount);
+    CHECK(mesh.lods[0].firstIndex + mesh.lods[0].indexCount == mesh.lods[1].firstIndex);
+}
+
+TEST(CubeMesh, TrianglesFaceOutwards)
+{
+    CubeMesh mesh;
+    buildCubeMesh(mesh);
+
+    // clockwise seen from outside, the cross product of the first two edges
+    // points away from the center
+    uint32_t inwards = 0;
+    for (const MeshLod& lod : mesh.lods) {
+        for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; i += 3) {
+            const Float3& a = mesh.vertices[lod.baseVertex + mesh.indices[i]].position;
+            const Float3& b = mesh.vertices[lod.baseVertex + mesh.indices[i + 1]].position;
+            const Float3& c = mesh.vertices[lod.baseVertex + mesh.indices[i + 2]].position;
+
+            const Float3 ab = { b.x - a.x, b.y - a.y, b.z - a.z };
+            const Float3 ac = { c.x - a.x, c.y - a.y, c.z - a.z };
+            const Float3 normal = { ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x };
+            const Float3 center = { a.x + b.x + c.x, a.y + b.y + c.y, a.z + b.z + c.z };
+            inwards += normal.x * center.x + normal.y * center.y + normal.z * center.z <= 0.0f;
+        }
+    }
+    CHECK(inwards == 0);
+}
+
+TEST(CubeMesh, BoxIsInsideTheFullMesh)
+{
+    CubeMesh mesh;
+    buildCubeMesh(mesh);
+
+    const Float3& inner = mesh.innerExtents;
+    CHECK(inner.x < mesh.extents.x && inner.y < mesh.extents.y && inner.z < mesh.extents.z);
+
+    // every vertex of the full mesh is within the bounds and on or outside
+    // the box, no further from it than the box's error
+    const MeshLod& full = mesh.lods[0];
+    bool inside = true;
+    bool outsideBox = true;
+    float furthest = 0.0f;
+    for (int32_t i = full.baseVertex; i < mesh.lods[1].baseVertex; ++i) {
+        const Float3& p = mesh.vertices[i].position;
+        const float ax = std::fabs(p.x), ay = std::fabs(p.y), az = std::fabs(p.z);
+        inside = inside && ax <= mesh.extents.x + 1e-6f && ay <= mesh.extents.y + 1e-6f && az <= mesh.extents.z + 1e-6f;
+        outsideBox = outsideBox && (ax >= inner.x - 1e-6f || ay >= inner.y - 1e-6f || az >= inner.z - 1e-6f);
+
+        const float dx = std::fmax(ax - inner.x, 0.0f), dy = std::fmax(ay - inner.y, 0.0f), dz = std::fmax(az - inner.z, 0.0f);
+        furthest = std::fmax(furthest, std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+    CHECK(inside);
+    CHECK(outsideBox);
+    CHECK(mesh.lods[1].error > 0.0f);
+    CHECK(std::fabs(furthest - mesh.lods[1].error) < 1e-6f);
+}
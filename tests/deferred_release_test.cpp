@@ -0,0 +1,156 @@
+#include "deferred_release.h"
+
+#include "test.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+struct Retired
+{
+    uint64_t fenceValue;
+    uint32_t releases;
+    uint32_t order;
+};
+
+static uint32_t releaseOrder_ = 0;
+
+static void releaseRetired(void* object)
+{
+    Retired* retired = static_cast<Retired*>(object);
+    retired->releases++;
+    retired->order = releaseOrder_++;
+}
+
+TEST(DeferredRelease, CollectsByFenceValue)
+{
+    Retired objects[4] = { { 3, 0, 0 }, { 1, 0, 0 }, { 2, 0, 0 }, { 5, 0, 0 } };
+
+    DeferredReleaseQueue queue;
+    for (Retired& object : objects)
+        queue.retire(&object, releaseRetired, object.fenceValue);
+
+    CHECK(queue.collect(0) == 0);
+    CHECK(queue.pendingCount() == 4);
+
+    CHECK(queue.collect(2) == 2);
+    CHECK(objects[1].releases == 1);
+    CHECK(objects[2].releases == 1);
+    CHECK(objects[0].releases == 0);
+    CHECK(queue.pendingCount() == 2);
+
+    // collecting the same value again releases nothing twice
+    CHECK(queue.collect(2) == 0);
+    CHECK(objects[1].releases == 1);
+
+    CHECK(queue.collect(4) == 1);
+    CHECK(objects[0].releases == 1);
+    CHECK(objects[3].releases == 0);
+
+    CHECK(queue.releaseAll() == 1);
+    CHECK(objects[3].releases == 1);
+    CHECK(queue.pendingCount() == 0);
+}
+
+TEST(DeferredRelease, ReleasesInRetireOrder)
+{
+    Retired objects[8] = {};
+
+    DeferredReleaseQueue queue;
+    for (Retired& object : objects)
+        queue.retire(&object, releaseRetired, 1);
+
+    // some are already pending when more arrive
+    queue.collect(0);
+    Retired late = {};
+    queue.retire(&late, releaseRetired, 1);
+
+    releaseOrder_ = 0;
+    CHECK(queue.collect(1) == 9);
+    for (uint32_t i = 0; i < 8; ++i)
+        CHECK(objects[i].order == i);
+    CHECK(late.order == 8);
+}
+
+TEST(DeferredRelease, DestructorReleasesEverything)
+{
+    Retired objects[3] = {};
+
+    {
+        DeferredReleaseQueue queue;
+        queue.retire(&objects[0], releaseRetired, 10);
+        queue.collect(0);
+        queue.retire(&objects[1], releaseRetired, 20);
+        queue.retire(&objects[2], releaseRetired, 30);
+    }
+
+    for (const Retired& object : objects)
+        CHECK(object.releases == 1);
+}
+
+struct ConcurrentRetired
+{
+    uint64_t fenceValue;
+    std::atomic<uint32_t> releases;
+};
+
+static std::atomic<uint64_t> completed_(0);
+static std::atomic<uint32_t> early_(0);
+
+static void releaseConcurrent(void* object)
+{
+    ConcurrentRetired* retired = static_cast<ConcurrentRetired*>(object);
+    if (retired->fenceValue > completed_.load(std::memory_order_acquire))
+        early_++;
+    retired->releases++;
+}
+
+TEST(DeferredRelease, ManyProducersOneConsumer)
+{
+    const uint32_t producerCount = 4;
+    const uint32_t perProducer = 20000;
+
+    std::vector<ConcurrentRetired> objects(producerCount * perProducer);
+    for (ConcurrentRetired& object : objects)
+        object.releases = 0;
+
+    completed_ = 0;
+    early_ = 0;
+
+    DeferredReleaseQueue queue;
+    std::atomic<uint32_t> producersDone(0);
+
+    // producers retire against a fence that the consumer keeps advancing
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < producerCount; ++p) {
+        producers.emplace_back([&queue, &objects, &producersDone, p, perProducer]() {
+            for (uint32_t i = 0; i < perProducer; ++i) {
+                ConcurrentRetired& object = objects[p * perProducer + i];
+                object.fenceValue = completed_.load(std::memory_order_acquire) + 1 + i % 3;
+                queue.retire(&object, releaseConcurrent, object.fenceValue);
+            }
+            producersDone++;
+        });
+    }
+
+    uint64_t released = 0;
+    while (producersDone.load() < producerCount) {
+        completed_.fetch_add(1, std::memory_order_release);
+        released += queue.collect(completed_.load(std::memory_order_acquire));
+    }
+
+    for (std::thread& producer : producers)
+        producer.join();
+
+    completed_ = UINT64_MAX;
+    released += queue.releaseAll();
+
+    CHECK(released == objects.size());
+    CHECK(early_ == 0);
+    CHECK(queue.pendingCount() == 0);
+
+    uint32_t wrong = 0;
+    for (const ConcurrentRetired& object : objects)
+        wrong += object.releases != 1;
+    CHECK(wrong == 0);
+}
@@ -0,0 +1,225 @@
+#include "descriptor_allocator.h"
+
+#include "test.h"
+
+#include <vector>
+
+TEST(DescriptorFreeList, AllocatesFirstFit)
+{
+    DescriptorFreeList list(16);
+
+    CHECK(list.allocate(4) == 0);
+    CHECK(list.allocate(1) == 4);
+    CHECK(list.allocate(8) == 5);
+    CHECK(list.freeCount() == 3);
+
+    // the hole at the front is the first that fits
+    list.release(0, 4);
+    CHECK(list.allocate(2) == 0);
+    CHECK(list.allocate(3) == 13);
+    CHECK(list.allocate(2) == 2);
+    CHECK(list.freeCount() == 0);
+}
+
+TEST(DescriptorFreeList, RejectsWhatDoesNotFit)
+{
+    DescriptorFreeList list(8);
+
+    CHECK(list.allocate(0) == InvalidDescriptorOffset);
+    CHECK(list.allocate(9) == InvalidDescriptorOffset);
+
+    // enough free in total, but not in one range
+    CHECK(list.allocate(3) == 0);
+    CHECK(list.allocate(2) == 3);
+    CHECK(list.allocate(3) == 5);
+    list.release(0, 3);
+    list.release(5, 3);
+    CHECK(list.freeCount() == 6);
+    CHECK(list.allocate(4) == InvalidDescriptorOffset);
+    CHECK(list.allocate(3) == 0);
+}
+
+TEST(DescriptorFreeList, MergesReleasedNeighbours)
+{
+    DescriptorFreeList list(12);
+
+    const uint32_t a = list.allocate(4);
+    const uint32_t b = list.allocate(4);
+    const uint32_t c = list.allocate(4);
+    CHECK(list.rangeCount() == 0);
+
+    list.release(a, 4);
+    list.release(c, 4);
+    CHECK(list.rangeCount() == 2);
+
+    // joins the ranges before and after it
+    list.release(b, 4);
+    CHECK(list.rangeCount() == 1);
+    CHECK(list.freeCount() == 12);
+    CHECK(list.allocate(12) == 0);
+}
+
+TEST(DescriptorFreeList, ResetFreesEverything)
+{
+    DescriptorFreeList list(4);
+    list.allocate(3);
+
+    list.reset(32);
+    CHECK(list.capacity() == 32);
+    CHECK(list.freeCount() == 32);
+    CHECK(list.rangeCount() == 1);
+    CHECK(list.allocate(32) == 0);
+
+    DescriptorFreeList empty;
+    CHECK(empty.allocate(1) == InvalidDescriptorOffset);
+    CHECK(empty.rangeCount() == 0);
+}
+
+TEST(DescriptorFreeList, BenchmarkSelfCheck)
+{
+    const DescriptorFreeListBenchmark result = measureDescriptorFreeList(4096, 20000);
+
+    CHECK(result.operations == 20000);
+    CHECK(result.mismatches == 0);
+    CHECK(result.maxRanges > 0);
+}
+
+TEST(DescriptorRing, AllocatesContiguousTables)
+{
+    DescriptorRing ring;
+    ring.reset(100, 16);
+
+    CHECK(ring.allocate(4) == 100);
+    CHECK(ring.allocate(4) == 104);
+    CHECK(ring.usedCount() == 8);
+
+    CHECK(ring.allocate(0) == InvalidDescriptorOffset);
+    CHECK(ring.allocate(17) == InvalidDescriptorOffset);
+    CHECK(ring.usedCount() == 8);
+}
+
+TEST(DescriptorRing, WrapsAroundAfterRetirement)
+{
+    DescriptorRing ring;
+    ring.reset(0, 16);
+
+    CHECK(ring.allocate(6) == 0);
+    ring.endFrame(1);
+    CHECK(ring.allocate(6) == 6);
+    ring.endFrame(2);
+
+    // 4 left before the end, not enough for a contiguous table
+    CHECK(ring.allocate(6) == InvalidDescriptorOffset);
+
+    // frame 1 is done, the table skips the tail end and starts over
+    ring.collect(1);
+    CHECK(ring.usedCount() == 6);
+    CHECK(ring.allocate(6) == 0);
+    CHECK(ring.usedCount() == 16);
+    ring.endFrame(3);
+
+    ring.collect(3);
+    CHECK(ring.usedCount() == 0);
+    CHECK(ring.allocate(10) == 6);
+}
+
+TEST(DescriptorRing, FullUntilFenceCompletes)
+{
+    DescriptorRing ring;
+    ring.reset(0, 8);
+
+    CHECK(ring.allocate(8) == 0);
+    CHECK(ring.allocate(1) == InvalidDescriptorOffset);
+    ring.endFrame(5);
+
+    // nothing comes back before the frame's fence value completes
+    ring.collect(4);
+    CHECK(ring.usedCount() == 8);
+    CHECK(ring.allocate(1) == InvalidDescriptorOffset);
+
+    ring.collect(5);
+    CHECK(ring.usedCount() == 0);
+    CHECK(ring.allocate(8) == 0);
+}
+
+TEST(DescriptorRing, RetiresFramesInFenceOrder)
+{
+    DescriptorRing ring;
+    ring.reset(0, 64);
+
+    ring.allocate(4);
+    ring.endFrame(1);
+    ring.allocate(8);
+    ring.endFrame(2);
+    ring.endFrame(3); // allocated nothing, nothing to track
+    ring.allocate(2);
+    ring.endFrame(4);
+    CHECK(ring.pendingFrames() == 3);
+
+    ring.collect(2);
+    CHECK(ring.pendingFrames() == 1);
+    CHECK(ring.usedCount() == 2);
+
+    // tables of a frame that has not ended yet are kept
+    ring.allocate(16);
+    ring.collect(10);
+    CHECK(ring.pendingFrames() == 0);
+    CHECK(ring.usedCount() == 16);
+}
+
+TEST(DescriptorRing, TablesInFlightNeverOverlap)
+{
+    const uint32_t capacity = 512;
+    const uint32_t framesInFlight = 3;
+
+    DescriptorRing ring;
+    ring.reset(0, capacity);
+
+    struct Table
+    {
+        uint32_t offset;
+        uint32_t count;
+        uint64_t fenceValue;
+    };
+    std::vector<Table> live;
+
+    uint32_t seed = 12345;
+    uint32_t failed = 0;
+    uint32_t overlaps = 0;
+    for (uint64_t frame = 1; frame <= 1000; ++frame) {
+        // GPU runs framesInFlight behind
+        if (frame > framesInFlight) {
+            const uint64_t completed = frame - framesInFlight;
+            ring.collect(completed);
+            std::vector<Table> kept;
+            for (const Table& table : live) {
+                if (table.fenceValue > completed)
+                    kept.push_back(table);
+            }
+            live.swap(kept);
+        }
+
+        const uint32_t tables = 1 + frame % 5;
+        for (uint32_t i = 0; i < tables; ++i) {
+            seed = seed * 1664525u + 1013904223u;
+            const uint32_t count = 1 + (seed >> 16) % 16;
+            const uint32_t offset = ring.allocate(count);
+            if (offset == InvalidDescriptorOffset) {
+                failed++;
+                continue;
+            }
+
+            if (offset + count > capacity)
+                overlaps++;
+            for (const Table& table : live) {
+                if (offset < table.offset + table.count && table.offset < offset + count)
+                    overlaps++;
+            }
+            live.push_back({ offset, count, frame });
+        }
+        ring.endFrame(frame);
+    }
+
+    CHECK(overlaps == 0);
+    CHECK(failed == 0);
+}
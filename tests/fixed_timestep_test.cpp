@@ -0,0 +1,103 @@
+#include "fixed_timestep.h"
+
+#include "test.h"
+
+#include <cmath>
+
+static bool near(double a, double b)
+{
+    return std::fabs(a - b) < 1e-9;
+}
+
+TEST(FixedTimestep, RunsWholeSteps)
+{
+    FixedTimestep timestep;
+    timestep.configure(0.25, 4);
+
+    CHECK(timestep.advance(0.1) == 0);
+    CHECK(near(timestep.alpha(), 0.4));
+
+    CHECK(timestep.advance(0.2) == 1);
+    CHECK(near(timestep.alpha(), 0.2));
+
+    CHECK(timestep.advance(0.7) == 3);
+    CHECK(near(timestep.alpha(), 0.0));
+    CHECK(timestep.stepCount() == 4);
+    CHECK(timestep.droppedTime() == 0.0);
+}
+
+TEST(FixedTimestep, DropsWholeStepsAfterAStall)
+{
+    FixedTimestep timestep;
+    timestep.configure(0.25, 4);
+
+    // 10.1s at once, four steps run, the fraction of a step is kept so the
+    // interpolation does not jump and the rest is dropped
+    CHECK(timestep.advance(10.1) == 4);
+    CHECK(near(timestep.droppedTime(), 9.0));
+    CHECK(near(timestep.alpha(), 0.4));
+
+    // the next frame is back to normal
+    CHECK(timestep.advance(0.2) == 1);
+    CHECK(near(timestep.alpha(), 0.2));
+}
+
+TEST(FixedTimestep, AlphaStaysBelowOne)
+{
+    FixedTimestep timestep;
+    timestep.configure(1.0 / 60.0, 5);
+
+    // frame times from 0 to 200ms, some of them stalls
+    uint32_t seed = 1;
+    double elapsedSum = 0.0;
+    bool inRange = true;
+    bool bounded = true;
+    for (uint32_t frame = 0; frame < 10000; ++frame) {
+        seed = seed * 1664525u + 1013904223u;
+        const double elapsed = static_cast<double>(seed >> 8) / static_cast<double>(1u << 24) * 0.2;
+        elapsedSum += elapsed;
+
+        const uint32_t steps = timestep.advance(elapsed);
+        bounded = bounded && steps <= 5;
+        inRange = inRange && timestep.alpha() >= 0.0 && timestep.alpha() < 1.0;
+    }
+    CHECK(bounded);
+    CHECK(inRange);
+
+    // no time gets lost other than what was dropped
+    const double accounted = static_cast<double>(timestep.stepCount()) * timestep.stepTime() + timestep.droppedTime()
+        + timestep.alpha() * timestep.stepTime();
+    CHECK(std::fabs(accounted - elapsedSum) < 1e-6);
+    CHECK(timestep.droppedTime() > 0.0);
+}
+
+TEST(FixedTimestep, ConfigureKeepsThePosition)
+{
+    FixedTimestep timestep;
+    timestep.configure(0.25, 4);
+    timestep.advance(0.125);
+    CHECK(near(timestep.alpha(), 0.5));
+
+    timestep.configure(0.5, 4);
+    CHECK(near(timestep.alpha(), 0.5));
+    CHECK(timestep.advance(0.25) == 1);
+
+    // invalid settings fall back to 60Hz and at least one step
+    timestep.configure(0.0, 0);
+    CHECK(timestep.stepTime() == 1.0 / 60.0);
+    CHECK(timestep.maxStepsPerFrame() == 1);
+}
+
+TEST(FixedTimestep, IgnoresNegativeTime)
+{
+    FixedTimestep timestep;
+    timestep.configure(0.25, 4);
+    timestep.advance(0.125);
+
+    CHECK(timestep.advance(-1.0) == 0);
+    CHECK(near(timestep.alpha(), 0.5));
+
+    timestep.reset();
+    CHECK(timestep.alpha() == 0.0);
+    CHECK(timestep.stepCount() == 0);
+}
@@ -0,0 +1,192 @@
+#include "frame_pacing.h"
+
+#include "test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// time only moves when the test or the pacer moves it, sleeps wake up
+// overshoot late
+class FakePacingClock : public PacingClock
+{
+public:
+    explicit FakePacingClock(double overshoot)
+        : time(0.0)
+        , overshoot(overshoot)
+        , sleeps(0)
+    {
+    }
+
+    double now() override
+    {
+        return time;
+    }
+
+    void sleepFor(double seconds) override
+    {
+        time += seconds + overshoot;
+        sleeps++;
+    }
+
+    void spinUntil(double until) override
+    {
+        time = std::max(time, until);
+    }
+
+    double time;
+    double overshoot;
+    uint32_t sleeps;
+};
+
+static bool near(double a, double b)
+{
+    return std::fabs(a - b) < 1e-9;
+}
+
+static FramePacerSettings limiterSettings(double targetFrameTime)
+{
+    FramePacerSettings settings = {};
+    settings.framesInFlight = 2;
+    settings.targetFrameTime = targetFrameTime;
+    settings.spinThreshold = 0.002;
+    return settings;
+}
+
+TEST(FramePacing, LimiterKeepsTheTargetRate)
+{
+    FakePacingClock clock(0.0005);
+    FramePacer pacer(clock);
+    pacer.configure(limiterSettings(0.01));
+
+    // work of varying length, the frames still start exactly 10ms apart
+    std::vector<double> starts;
+    for (uint32_t frame = 0; frame < 20; ++frame) {
+        pacer.waitForNextFrame();
+        starts.push_back(clock.now());
+        clock.time += 0.001 * (frame % 7);
+    }
+
+    bool even = true;
+    for (size_t i = 2; i < starts.size(); ++i)
+        even = even && near(starts[i] - starts[i - 1], 0.01);
+    CHECK(even);
+
+    // the sleeps stop short of the deadline by the spin threshold, so an
+    // overshoot smaller than that costs nothing
+    CHECK(clock.sleeps > 0);
+}
+
+TEST(FramePacing, LateFramesDoNotCatchUp)
+{
+    FakePacingClock clock(0.0);
+    FramePacer pacer(clock);
+    pacer.configure(limiterSettings(0.01));
+
+    pacer.waitForNextFrame();
+    pacer.waitForNextFrame();
+    CHECK(near(clock.now(), 0.01));
+
+    // a hitch of five frames, the next frame starts right away and the ones
+    // after it keep the rate instead of rushing out
+    clock.time += 0.05;
+    const double late = clock.now();
+    pacer.waitForNextFrame();
+    CHECK(near(clock.now(), late));
+    pacer.waitForNextFrame();
+    CHECK(near(clock.now(), late + 0.01));
+}
+
+TEST(FramePacing, DisabledLimiterNeverWaits)
+{
+    FakePacingClock clock(0.0);
+    FramePacer pacer(clock);
+    pacer.configure(limiterSettings(0.0));
+
+    for (uint32_t frame = 0; frame < 10; ++frame)
+        pacer.waitForNextFrame();
+    CHECK(clock.now() == 0.0);
+    CHECK(clock.sleeps == 0);
+
+    // negative targets and zero frames in flight are clamped
+    FramePacerSettings settings = limiterSettings(-1.0);
+    settings.framesInFlight = 0;
+    pacer.configure(settings);
+    CHECK(pacer.settings().targetFrameTime == 0.0);
+    CHECK(pacer.settings().framesInFlight == 1);
+}
+
+TEST(FramePacing, MeasuresJitter)
+{
+    FakePacingClock clock(0.0);
+    FramePacer pacer(clock);
+
+    // alternating 10ms and 20ms frames
+    for (uint32_t frame = 0; frame < 101; ++frame) {
+        pacer.onPresent(-1.0);
+        clock.time += frame % 2 == 0 ? 0.01 : 0.02;
+    }
+
+    const FramePacingStats stats = pacer.stats();
+    CHECK(stats.frameCount == 100);
+    CHECK(near(stats.averageFrameTime, 0.015));
+    CHECK(near(stats.frameTimeDeviation, 0.005));
+    CHECK(near(stats.minFrameTime, 0.01));
+    CHECK(near(stats.maxFrameTime, 0.02));
+    CHECK(stats.averageLatency == 0.0);
+
+    pacer.resetStats();
+    pacer.onPresent(-1.0);
+    CHECK(pacer.stats().frameCount == 0);
+}
+
+TEST(FramePacing, MeasuresLatencyFromEarliestInput)
+{
+    FakePacingClock clock(0.0);
+    FramePacer pacer(clock);
+
+    clock.time = 1.0;
+    pacer.onInput();
+    clock.time = 1.5;
+    pacer.onInput();
+
+    const double inputTime = pacer.beginFrame();
+    CHECK(inputTime == 1.0);
+    CHECK(pacer.beginFrame() < 0.0);
+
+    clock.time = 2.0;
+    pacer.onPresent(inputTime);
+    clock.time = 2.5;
+    pacer.onPresent(2.25);
+
+    const FramePacingStats stats = pacer.stats();
+    CHECK(near(stats.averageLatency, 0.625));
+    CHECK(near(stats.maxLatency, 1.0));
+}
+
+TEST(FramePacing, SimulationFollowsTheBottleneck)
+{
+    FrameSimulationParams params = {};
+    params.frameCount = 600;
+    params.cpuFrameTime = 0.008;
+    params.gpuFrameTime = 0.012;
+    params.variance = 0.2;
+    params.sleepOvershoot = 0.001;
+
+    // GPU bound without the limiter, the CPU waits on frames in flight
+    const FrameSimulationResult unlimited = simulateFramePacing(limiterSettings(0.0), params);
+    CHECK(std::fabs(unlimited.averageFrameTime - 0.012) < 0.0005);
+    CHECK(unlimited.cpuWaitTime > 0.0);
+
+    // limited above both, frames come out at the target and the queue never
+    // fills up, so latency drops. the jitter left is that of the work.
+    const FrameSimulationResult limited = simulateFramePacing(limiterSettings(1.0 / 60.0), params);
+    CHECK(std::fabs(limited.averageFrameTime - 1.0 / 60.0) < 0.0001);
+    CHECK(limited.frameTimeDeviation < 0.2 * (params.cpuFrameTime + params.gpuFrameTime));
+    CHECK(limited.averageLatency < unlimited.averageLatency);
+    CHECK(limited.cpuWaitTime == 0.0);
+
+    // the same params give the same timeline
+    const FrameSimulationResult again = simulateFramePacing(limiterSettings(1.0 / 60.0), params);
+    CHECK(again.averageLatency == limited.averageLatency);
+}
@@ -0,0 +1,205 @@
+#include "frame_pipeline.h"
+#include "render_packets.h"
+
+#include "test.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+static const int64_t freeSlot_ = -1;
+
+TEST(FramePipeline, StreamsFramesLargerThanTheQueue)
+{
+    const uint32_t drawsPerFrame = 20000;
+    const uint32_t frameCount = 10;
+
+    // far fewer packets fit than a frame has, the render stage has to pop
+    // while the frame is still being built
+    RenderPacketQueue packets(64);
+    NullRenderPacketTranslator translator;
+    uint32_t wrongSlots = 0;
+
+    FramePipeline pipeline;
+    pipeline.addStage("Update", [](uint64_t, uint32_t) {});
+
+    pipeline.addStage("BuildRenderPackets", [&packets, drawsPerFrame](uint64_t, uint32_t slot) {
+        RenderPacket packet = {};
+        packet.type = RenderPacketBeginFrame;
+        packet.frameSlot = slot;
+        packets.push(packet);
+
+        packet.type = RenderPacketDraw;
+        for (uint32_t i = 0; i < drawsPerFrame; ++i)
+            packets.push(packet);
+
+        packet.type = RenderPacketEndFrame;
+        packets.push(packet);
+    });
+
+    pipeline.addStage("Render", [&packets, &translator, &wrongSlots](uint64_t, uint32_t slot) {
+        if (translateFrame(packets, translator) != slot)
+            wrongSlots++;
+    }, StageWithPrevious);
+
+    CHECK(pipeline.start(3));
+    for (uint32_t frame = 0; frame < frameCount; ++frame)
+        pipeline.runFrame();
+    pipeline.stop();
+
+    CHECK(pipeline.frameCount() == frameCount);
+    CHECK(translator.frameCount() == frameCount);
+    CHECK(translator.drawCount() == static_cast<uint64_t>(frameCount) * drawsPerFrame);
+    CHECK(wrongSlots == 0);
+
+    RenderPacket packet;
+    CHECK(!packets.tryPop(packet));
+}
+
+TEST(FramePipeline, RunsStagesInOrderWithinAFrame)
+{
+    const uint32_t stageCount = 3;
+    const uint32_t slotCount = 3;
+    const uint32_t frameCount = 50;
+
+    // stage s of frame f stores when it ran, every entry has one writer
+    std::atomic<uint32_t> clock(0);
+    std::vector<uint32_t> ranAt(frameCount * stageCount, 0);
+    std::vector<uint32_t> wrongFrames(stageCount, 0);
+    std::vector<uint64_t> expectedFrame(stageCount, 0);
+
+    FramePipeline pipeline;
+    for (uint32_t s = 0; s < stageCount; ++s) {
+        pipeline.addStage("Stage", [s, slotCount, &clock, &ranAt, &wrongFrames, &expectedFrame](uint64_t frame, uint32_t slot) {
+            // every stage sees the frames one after another
+            if (frame != expectedFrame[s]++ || slot != frame % slotCount || frame >= frameCount) {
+                wrongFrames[s]++;
+                return;
+            }
+            ranAt[frame * stageCount + s] = clock++;
+        });
+    }
+
+    CHECK(pipeline.start(slotCount));
+    for (uint32_t frame = 0; frame < frameCount; ++frame)
+        pipeline.runFrame();
+    pipeline.stop();
+
+    uint32_t outOfOrder = 0;
+    for (uint32_t frame = 0; frame < frameCount; ++frame) {
+        for (uint32_t s = 1; s < stageCount; ++s) {
+            if (ranAt[frame * stageCount + s] <= ranAt[frame * stageCount + s - 1])
+                outOfOrder++;
+        }
+    }
+
+    CHECK(outOfOrder == 0);
+    for (uint32_t s = 0; s < stageCount; ++s) {
+        CHECK(wrongFrames[s] == 0);
+        CHECK(expectedFrame[s] == frameCount);
+    }
+    CHECK(pipeline.frameCount() == frameCount);
+}
+
+TEST(FramePipeline, ReusesSlotsOnlyWhenEveryStageIsDone)
+{
+    const uint32_t slotCount = 2;
+    const uint32_t frameCount = 40;
+
+    // the frame holding each slot, taken by the first stage and given back
+    // by the last one
+    std::atomic<int64_t> owners[slotCount];
+    for (std::atomic<int64_t>& owner : owners)
+        owner = freeSlot_;
+    std::atomic<uint32_t> inFlight(0);
+    std::atomic<uint32_t> maxInFlight(0);
+    std::atomic<uint32_t> reusedEarly(0);
+
+    auto work = []() { std::this_thread::sleep_for(std::chrono::microseconds(200)); };
+
+    FramePipeline pipeline;
+    pipeline.addStage("First", [&owners, &inFlight, &maxInFlight, &reusedEarly, work](uint64_t frame, uint32_t slot) {
+        int64_t expected = freeSlot_;
+        if (!owners[slot].compare_exchange_strong(expected, static_cast<int64_t>(frame)))
+            reusedEarly++;
+
+        const uint32_t count = ++inFlight;
+        uint32_t seen = maxInFlight;
+        while (count > seen && !maxInFlight.compare_exchange_weak(seen, count)) {
+        }
+        work();
+    });
+    pipeline.addStage("Middle", [work](uint64_t, uint32_t) { work(); });
+    pipeline.addStage("Last", [&owners, &inFlight, work](uint64_t, uint32_t slot) {
+        work();
+        inFlight--;
+        owners[slot] = freeSlot_;
+    });
+
+    CHECK(pipeline.start(slotCount));
+    for (uint32_t frame = 0; frame < frameCount; ++frame)
+        pipeline.runFrame();
+    pipeline.stop();
+
+    CHECK(reusedEarly == 0);
+    CHECK(maxInFlight <= slotCount);
+    CHECK(inFlight == 0);
+    CHECK(pipeline.frameCount() == frameCount);
+}
+
+TEST(FramePipeline, RestartsAfterStop)
+{
+    std::atomic<uint32_t> runs(0);
+    std::atomic<uint64_t> lastFrame(0);
+
+    FramePipeline pipeline;
+    pipeline.addStage("First", [](uint64_t, uint32_t) {});
+    pipeline.addStage("Second", [&runs, &lastFrame](uint64_t frame, uint32_t) {
+        runs++;
+        lastFrame = frame;
+    });
+
+    CHECK(pipeline.start(2));
+    CHECK(pipeline.isRunning());
+    CHECK(!pipeline.start(2));
+
+    // stages can not be added while the threads are running
+    pipeline.addStage("Late", [](uint64_t, uint32_t) {});
+    CHECK(pipeline.stageCount() == 2);
+
+    for (uint32_t frame = 0; frame < 5; ++frame)
+        pipeline.runFrame();
+    pipeline.stop();
+    CHECK(!pipeline.isRunning());
+    CHECK(pipeline.frameCount() == 5);
+    CHECK(runs == 5);
+    CHECK(lastFrame == 4);
+
+    // frames count from zero again
+    CHECK(pipeline.start(3));
+    CHECK(pipeline.slotCount() == 3);
+    CHECK(pipeline.frameCount() == 0);
+    for (uint32_t frame = 0; frame < 3; ++frame)
+        pipeline.runFrame();
+    pipeline.stop();
+    CHECK(pipeline.frameCount() == 3);
+    CHECK(runs == 8);
+    CHECK(lastFrame == 2);
+
+    // stopping twice is fine
+    pipeline.stop();
+    CHECK(!pipeline.start(0));
+}
+
+TEST(FramePipeline, BenchmarkSelfCheck)
+{
+    const double stageTimes[] = { 0.001, 0.002 };
+    const FramePipelineBenchmark result = measureFramePipeline(stageTimes, 2, 2, 10);
+
+    CHECK(result.sequentialFrameTime > 0.0029 && result.sequentialFrameTime < 0.0031);
+
+    // never faster than the slowest stage
+    CHECK(result.pipelinedFrameTime >= 0.002);
+}
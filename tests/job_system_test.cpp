@@ -0,0 +1,301 @@
+#include "job_system.h"
+
+#include "test.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST(JobDeque, OwnerPopsNewestThievesStealOldest)
+{
+    Job jobs[3] = {};
+    JobDeque deque;
+    CHECK(deque.isEmpty());
+    CHECK(deque.pop() == nullptr);
+    CHECK(deque.steal() == nullptr);
+
+    for (Job& job : jobs)
+        CHECK(deque.push(&job));
+    CHECK(!deque.isEmpty());
+
+    CHECK(deque.pop() == &jobs[2]);
+    CHECK(deque.steal() == &jobs[0]);
+    CHECK(deque.pop() == &jobs[1]);
+    CHECK(deque.pop() == nullptr);
+    CHECK(deque.steal() == nullptr);
+    CHECK(deque.isEmpty());
+}
+
+TEST(JobDeque, PushFailsWhenFull)
+{
+    std::vector<Job> jobs(4097);
+    JobDeque deque;
+
+    bool pushed = true;
+    for (size_t i = 0; i < 4096; ++i)
+        pushed = pushed && deque.push(&jobs[i]);
+    CHECK(pushed);
+    CHECK(!deque.push(&jobs[4096]));
+
+    // a steal makes room again, and the indices wrap around
+    CHECK(deque.steal() == &jobs[0]);
+    CHECK(deque.push(&jobs[4096]));
+    CHECK(deque.pop() == &jobs[4096]);
+    CHECK(deque.steal() == &jobs[1]);
+}
+
+TEST(JobDeque, EveryJobIsTakenOnce)
+{
+    const uint32_t jobCount = 200000;
+    const uint32_t thiefCount = 3;
+
+    std::vector<Job> jobs(jobCount);
+    std::vector<std::atomic<uint32_t>> taken(jobCount);
+    for (std::atomic<uint32_t>& count : taken)
+        count = 0;
+
+    JobDeque deque;
+    std::atomic<bool> ownerDone(false);
+
+    // thieves race the owner for the top while it pushes and pops at the
+    // bottom, the deque running empty over and over
+    std::vector<std::thread> thieves;
+    for (uint32_t t = 0; t < thiefCount; ++t) {
+        thieves.emplace_back([&deque, &jobs, &taken, &ownerDone]() {
+            while (!ownerDone.load() || !deque.isEmpty()) {
+                if (Job* job = deque.steal())
+                    taken[job - jobs.data()]++;
+            }
+        });
+    }
+
+    uint32_t next = 0;
+    while (next < jobCount) {
+        // bursts of up to 7 pushes and 5 pops
+        const uint32_t pushes = std::min(jobCount - next, 1 + next % 7);
+        for (uint32_t i = 0; i < pushes; ++i) {
+            while (!deque.push(&jobs[next])) {
+            }
+            next++;
+        }
+
+        for (uint32_t i = 0; i < next % 5; ++i) {
+            if (Job* job = deque.pop())
+                taken[job - jobs.data()]++;
+        }
+    }
+    while (Job* job = deque.pop())
+        taken[job - jobs.data()]++;
+    ownerDone = true;
+
+    for (std::thread& thief : thieves)
+        thief.join();
+
+    uint32_t wrong = 0;
+    for (const std::atomic<uint32_t>& count : taken)
+        wrong += count.load() != 1;
+    CHECK(wrong == 0);
+    CHECK(deque.isEmpty());
+}
+
+TEST(JobSystem, RunsEveryJob)
+{
+    JobSystem jobs;
+    jobs.start(3);
+    CHECK(jobs.workerCount() == 4);
+    CHECK(jobs.currentWorker() == 0);
+
+    std::atomic<uint32_t> sum(0);
+    JobCounter counter;
+    for (uint32_t i = 1; i <= 1000; ++i)
+        jobs.run([&sum, i]() { sum += i; }, &counter);
+
+    jobs.wait(counter);
+    CHECK(counter.isDone());
+    CHECK(sum == 500500);
+
+    jobs.stop();
+    CHECK(jobs.workerCount() == 0);
+    CHECK(jobs.currentWorker() == JobSystem::ExternalThread);
+}
+
+TEST(JobSystem, ParallelForCoversTheRangeOnce)
+{
+    const uint32_t threadCounts[] = { 0, 1, 3, 7 };
+    for (uint32_t threads : threadCounts) {
+        JobSystem jobs;
+        jobs.start(threads);
+
+        const uint32_t itemCount = 100003;
+        std::vector<std::atomic<uint32_t>> visits(itemCount);
+        for (std::atomic<uint32_t>& visit : visits)
+            visit = 0;
+
+        jobs.parallelFor(3, itemCount, 64, [&visits](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i)
+                visits[i]++;
+        });
+
+        uint32_t wrong = 0;
+        for (uint32_t i = 0; i < itemCount; ++i)
+            wrong += visits[i].load() != (i >= 3 ? 1u : 0u);
+        CHECK(wrong == 0);
+
+        // empty ranges never call the body
+        bool called = false;
+        jobs.parallelFor(5, 5, 1, [&called](uint32_t, uint32_t) { called = true; });
+        CHECK(!called);
+    }
+}
+
+TEST(JobSystem, ParallelForPiecesStayWithinTheGrain)
+{
+    const uint32_t threadCounts[] = { 0, 3 };
+    for (uint32_t threads : threadCounts) {
+        JobSystem jobs;
+        jobs.start(threads);
+
+        std::atomic<uint32_t> tooSmall(0);
+        std::atomic<uint32_t> tooLarge(0);
+        std::atomic<uint32_t> items(0);
+        jobs.parallelFor(0, 10007, 50, [&tooSmall, &tooLarge, &items](uint32_t begin, uint32_t end) {
+            if (end - begin < 50)
+                tooSmall++;
+            if (end - begin >= 100)
+                tooLarge++;
+            items += end - begin;
+        });
+        CHECK(tooSmall == 0);
+        CHECK(tooLarge == 0);
+        CHECK(items == 10007);
+
+        // a range below two grains is not split at all
+        std::atomic<uint32_t> calls(0);
+        jobs.parallelFor(0, 99, 50, [&calls](uint32_t begin, uint32_t end) {
+            if (begin == 0 && end == 99)
+                calls++;
+        });
+        CHECK(calls == 1);
+    }
+}
+
+TEST(JobSystem, ParallelForSplitsForIdleWorkers)
+{
+    JobSystem jobs;
+    jobs.start(3);
+
+    // slow pieces, the other workers steal halves while the caller is busy
+    std::atomic<uint32_t> workers(0);
+    jobs.parallelFor(0, 64, 1, [&jobs, &workers](uint32_t, uint32_t) {
+        workers |= 1u << jobs.currentWorker();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+
+    uint32_t workerCount = 0;
+    for (uint32_t bits = workers; bits != 0; bits &= bits - 1)
+        workerCount++;
+    CHECK(workerCount > 1);
+}
+
+TEST(JobSystem, NestedParallelFor)
+{
+    JobSystem jobs;
+    jobs.start(3);
+
+    // jobs that wait for jobs of their own, the waiting workers help out
+    std::atomic<uint32_t> total(0);
+    jobs.parallelFor(0, 64, 1, [&jobs, &total](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            jobs.parallelFor(0, 1000, 16, [&total](uint32_t innerBegin, uint32_t innerEnd) {
+                total += innerEnd - innerBegin;
+            });
+        }
+    });
+
+    CHECK(total == 64000);
+}
+
+TEST(JobSystem, ContinuationsRunAfterTheirDependency)
+{
+    JobSystem jobs;
+    jobs.start(2);
+
+    std::atomic<uint32_t> done(0);
+    std::atomic<bool> early(false);
+
+    JobCounter first;
+    JobCounter second;
+    for (uint32_t i = 0; i < 100; ++i) {
+        jobs.run([&done]() {
+            std::this_thread::yield();
+            done++;
+        }, &first);
+    }
+    for (uint32_t i = 0; i < 10; ++i) {
+        jobs.runAfter(first, [&done, &early]() {
+            if (done.load() < 100)
+                early = true;
+        }, &second);
+    }
+
+    jobs.wait(second);
+    CHECK(first.isDone());
+    CHECK(!early);
+
+    // a dependency that is already done runs the job right away
+    JobCounter third;
+    bool ran = false;
+    jobs.runAfter(first, [&ran]() { ran = true; }, &third);
+    jobs.wait(third);
+    CHECK(ran);
+}
+
+TEST(JobSystem, AcceptsJobsFromOtherThreads)
+{
+    JobSystem jobs;
+    jobs.start(2);
+
+    std::atomic<uint32_t> count(0);
+    std::atomic<bool> external(true);
+    JobCounter counter;
+
+    // threads that are not workers go through the shared queue
+    std::vector<std::thread> producers;
+    for (uint32_t t = 0; t < 3; ++t) {
+        producers.emplace_back([&jobs, &count, &external, &counter]() {
+            if (jobs.currentWorker() != JobSystem::ExternalThread)
+                external = false;
+            for (uint32_t i = 0; i < 500; ++i)
+                jobs.run([&count]() { count++; }, &counter);
+        });
+    }
+    for (std::thread& producer : producers)
+        producer.join();
+
+    jobs.wait(counter);
+    CHECK(count == 1500);
+    CHECK(external);
+}
+
+TEST(JobSystem, Restarts)
+{
+    JobSystem jobs;
+    for (uint32_t round = 0; round < 3; ++round) {
+        jobs.start(round * 2);
+
+        std::atomic<uint32_t> count(0);
+        jobs.parallelFor(0, 10000, 10, [&count](uint32_t begin, uint32_t end) { count += end - begin; });
+        CHECK(count == 10000);
+    }
+    jobs.stop();
+}
+
+TEST(JobSystem, BenchmarkSelfCheck)
+{
+    const JobBenchmark result = measureParallelFor(3, 20000, 64);
+    CHECK(result.threads == 4);
+    CHECK(result.mismatches == 0);
+    CHECK(result.seconds > 0.0);
+}
@@ -0,0 +1,196 @@
+#include "profiler.h"
+
+#include "test.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// the profiler is global, every test uses zones of its own and looks them
+// up by name
+
+static const ProfileZoneStats* findStats(const std::vector<ProfileZoneStats>& stats, const char* name)
+{
+    for (const ProfileZoneStats& zone : stats) {
+        if (strcmp(zone.name, name) == 0)
+            return &zone;
+    }
+
+    return nullptr;
+}
+
+static bool roughly(double value, double expected)
+{
+    return std::fabs(value - expected) <= expected * 0.05;
+}
+
+static std::string readFile(const char* path)
+{
+    std::string text;
+#if defined(_MSC_VER)
+    FILE* file = nullptr;
+    if (fopen_s(&file, path, "r") != 0)
+        return text;
+#else
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return text;
+#endif
+
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        text.append(buffer, read);
+    fclose(file);
+
+    return text;
+}
+
+static uint32_t countOccurrences(const std::string& text, const char* pattern)
+{
+    uint32_t count = 0;
+    for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1))
+        count++;
+
+    return count;
+}
+
+TEST(Profiler, RegistersZonesOncePerName)
+{
+    const uint32_t a = registerProfileZone("ProfilerTestRegisterA");
+    const uint32_t b = registerProfileZone("ProfilerTestRegisterB");
+    CHECK(a != b);
+
+    // the same name from another call site gets the same zone
+    std::string copy = "ProfilerTestRegisterA";
+    CHECK(registerProfileZone(copy.c_str()) == a);
+}
+
+TEST(Profiler, SumsZonesPerFrame)
+{
+    const uint32_t single = registerProfileZone("ProfilerTestSingle");
+    const uint32_t repeated = registerProfileZone("ProfilerTestRepeated");
+    const uint32_t skipped = registerProfileZone("ProfilerTestSkipped");
+
+    // a zone that runs three times in a frame counts once with the sum
+    const uint64_t ticks = 1000000;
+    for (uint32_t frame = 0; frame < 10; ++frame) {
+        const uint64_t base = profileTimestamp();
+        recordProfileZone(single, base, base + ticks);
+        for (uint32_t i = 0; i < 3; ++i)
+            recordProfileZone(repeated, base, base + ticks);
+        if (frame % 2 == 0)
+            recordProfileZone(skipped, base, base + ticks);
+        endProfileFrame();
+    }
+
+    std::vector<ProfileZoneStats> stats;
+    profileZoneStats(stats);
+
+    const ProfileZoneStats* singleStats = findStats(stats, "ProfilerTestSingle");
+    const ProfileZoneStats* repeatedStats = findStats(stats, "ProfilerTestRepeated");
+    const ProfileZoneStats* skippedStats = findStats(stats, "ProfilerTestSkipped");
+    CHECK(singleStats && repeatedStats && skippedStats);
+    if (!singleStats || !repeatedStats || !skippedStats)
+        return;
+
+    CHECK(singleStats->frames == 10);
+    CHECK(singleStats->averageTime > 0.0);
+    CHECK(roughly(repeatedStats->averageTime, 3.0 * singleStats->averageTime));
+
+    // frames a zone did not run in do not count as zero
+    CHECK(skippedStats->frames == 5);
+    CHECK(roughly(skippedStats->averageTime, singleStats->averageTime));
+}
+
+TEST(Profiler, TracksMinimumAndPercentile)
+{
+    const uint32_t zone = registerProfileZone("ProfilerTestPercentile");
+
+    // 1 to 100 units, the 99th percentile of 100 frames is the 99th
+    const uint64_t unit = 100000;
+    for (uint64_t frame = 1; frame <= 100; ++frame) {
+        const uint64_t base = profileTimestamp();
+        recordProfileZone(zone, base, base + unit * frame);
+        endProfileFrame();
+    }
+
+    std::vector<ProfileZoneStats> stats;
+    profileZoneStats(stats);
+
+    const ProfileZoneStats* zoneStats = findStats(stats, "ProfilerTestPercentile");
+    CHECK(zoneStats != nullptr);
+    if (!zoneStats)
+        return;
+
+    CHECK(zoneStats->frames == 100);
+    CHECK(roughly(zoneStats->p99Time, 99.0 * zoneStats->minTime));
+    CHECK(roughly(zoneStats->averageTime, 50.5 * zoneStats->minTime));
+}
+
+TEST(Profiler, ExportsEveryThread)
+{
+    const uint32_t zone = registerProfileZone("ProfilerTestThreaded\"Zone");
+
+    // four threads record while this one keeps collecting frames
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < 4; ++t) {
+        threads.emplace_back([zone, t]() {
+            const std::string name = "ProfilerTestThread" + std::to_string(t);
+            setProfileThreadName(name.c_str());
+            for (uint32_t i = 0; i < 1000; ++i) {
+                ProfileZone profileZone(zone);
+            }
+        });
+    }
+    for (uint32_t frame = 0; frame < 20; ++frame)
+        endProfileFrame();
+    for (std::thread& thread : threads)
+        thread.join();
+
+    const char* path = "profiler_test_trace.json";
+    CHECK(exportChromeTrace(path));
+
+    const std::string trace = readFile(path);
+    std::remove(path);
+
+    CHECK(trace.compare(0, 16, "{\"traceEvents\":[") == 0);
+    CHECK(countOccurrences(trace, "\"ProfilerTestThreaded\\\"Zone\"") == 4000);
+    for (uint32_t t = 0; t < 4; ++t) {
+        const std::string name = "\"ProfilerTestThread" + std::to_string(t) + "\"";
+        CHECK(countOccurrences(trace, name.c_str()) == 1);
+    }
+}
+
+TEST(Profiler, RingKeepsTheNewestEvents)
+{
+    const uint32_t zone = registerProfileZone("ProfilerTestOverflow");
+
+    // a thread of its own, so its ring only holds this zone
+    std::thread thread([zone]() {
+        const uint64_t base = profileTimestamp();
+        for (uint64_t i = 0; i < 70000; ++i)
+            recordProfileZone(zone, base + i, base + i + 1);
+    });
+    thread.join();
+
+    const char* path = "profiler_test_overflow.json";
+    CHECK(exportChromeTrace(path));
+
+    const std::string trace = readFile(path);
+    std::remove(path);
+
+    // of the 65536 slots the oldest is the one the owner writes next, a copy
+    // leaves it out in case the owner is in the middle of it
+    CHECK(countOccurrences(trace, "\"ProfilerTestOverflow\"") == 65535);
+}
+
+TEST(Profiler, ZonesAreCheap)
+{
+    const double overhead = measureProfileZoneOverhead(100000);
+    CHECK(overhead > 0.0);
+    CHECK(overhead < 1e-5);
+}
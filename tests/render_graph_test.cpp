@@ -0,0 +1,307 @@
+#include "render_graph.h"
+
+#include "test.h"
+
+#include <cstddef>
+#include <vector>
+
+// remembers every barrier and the pass it came before, barriers after the
+// last pass have the pass count as their pass
+class RecordingExecutor : public RenderGraphExecutor
+{
+public:
+    RecordingExecutor()
+        : passCount(0)
+    {
+    }
+
+    void barriers(const RenderGraph& graph, const RenderGraphBarrier* barriers, uint32_t count) override
+    {
+        (void)graph;
+        for (uint32_t i = 0; i < count; ++i) {
+            recorded.push_back(barriers[i]);
+            passOfBarrier.push_back(passCount);
+        }
+    }
+
+    void beginPass(const char* name) override
+    {
+        (void)name;
+    }
+
+    void endPass() override
+    {
+        passCount++;
+    }
+
+    std::vector<RenderGraphBarrier> recorded;
+    std::vector<uint32_t> passOfBarrier;
+    uint32_t passCount;
+};
+
+static int physical_ = 0;
+
+TEST(RenderGraph, CullsPassesNothingConsumes)
+{
+    RenderGraph graph;
+    const RenderGraphResource backBuffer = graph.importResource("BackBuffer", &physical_, ResourceStatePresent, ResourceStatePresent);
+    const RenderGraphResource shadow = graph.createTransient("Shadow", 1024, 256);
+    const RenderGraphResource unused = graph.createTransient("Unused", 1024, 256);
+
+    bool unusedRan = false;
+    const RenderGraphPass shadowPass = graph.addPass("Shadow", nullptr);
+    graph.write(shadowPass, shadow, ResourceStateDepthWrite);
+
+    const RenderGraphPass unusedPass = graph.addPass("Unused", [&unusedRan]() { unusedRan = true; });
+    graph.write(unusedPass, unused, ResourceStateRenderTarget);
+
+    const RenderGraphPass mainPass = graph.addPass("Main", nullptr);
+    graph.read(mainPass, shadow, ResourceStateShaderResource);
+    graph.write(mainPass, backBuffer, ResourceStateRenderTarget);
+
+    CHECK(graph.compile());
+    CHECK(!graph.isCulled(shadowPass));
+    CHECK(graph.isCulled(unusedPass));
+    CHECK(!graph.isCulled(mainPass));
+    CHECK(graph.stats().passCount == 3);
+    CHECK(graph.stats().culledPassCount == 1);
+
+    // culled transients get no memory
+    CHECK(graph.firstPass(unused) == RenderGraphNoPass);
+    CHECK(graph.stats().transientBytes == 1024);
+
+    NullRenderGraphExecutor executor;
+    graph.execute(executor);
+    CHECK(executor.passCount == 2);
+    CHECK(!unusedRan);
+}
+
+TEST(RenderGraph, CullsChainsBackToFront)
+{
+    RenderGraph graph;
+    const RenderGraphResource backBuffer = graph.importResource("BackBuffer", &physical_, ResourceStatePresent, ResourceStatePresent);
+    const RenderGraphResource a = graph.createTransient("A", 256, 256);
+    const RenderGraphResource b = graph.createTransient("B", 256, 256);
+
+    // only feeds a pass that is culled itself
+    const RenderGraphPass first = graph.addPass("First", nullptr);
+    graph.write(first, a, ResourceStateRenderTarget);
+    const RenderGraphPass second = graph.addPass("Second", nullptr);
+    graph.read(second, a, ResourceStateShaderResource);
+    graph.write(second, b, ResourceStateRenderTarget);
+
+    const RenderGraphPass main = graph.addPass("Main", nullptr);
+    graph.write(main, backBuffer, ResourceStateRenderTarget);
+
+    CHECK(graph.compile());
+    CHECK(graph.isCulled(first));
+    CHECK(graph.isCulled(second));
+    CHECK(!graph.isCulled(main));
+    CHECK(graph.stats().aliasedHeapBytes == 0);
+}
+
+TEST(RenderGraph, KeepsSideEffectPasses)
+{
+    RenderGraph graph;
+    const RenderGraphResource query = graph.createTransient("Query", 64, 64);
+
+    const RenderGraphPass pass = graph.addPass("Readback", nullptr);
+    graph.write(pass, query, ResourceStateCopyDest);
+    graph.setSideEffect(pass);
+
+    const RenderGraphPass dropped = graph.addPass("Dropped", nullptr);
+    graph.write(dropped, graph.createTransient("Scratch", 64, 64), ResourceStateCopyDest);
+
+    CHECK(graph.compile());
+    CHECK(!graph.isCulled(pass));
+    CHECK(graph.isCulled(dropped));
+}
+
+TEST(RenderGraph, RejectsReadsOfUnwrittenTransients)
+{
+    RenderGraph graph;
+    const RenderGraphResource backBuffer = graph.importResource("BackBuffer", &physical_, ResourceStatePresent, ResourceStatePresent);
+    const RenderGraphResource history = graph.createTransient("History", 256, 256);
+
+    const RenderGraphPass pass = graph.addPass("Main", nullptr);
+    graph.read(pass, history, ResourceStateShaderResource);
+    graph.write(pass, backBuffer, ResourceStateRenderTarget);
+
+    CHECK(!graph.compile());
+}
+
+TEST(RenderGraph, PlacesTransitions)
+{
+    RenderGraph graph;
+    const RenderGraphResource backBuffer = graph.importResource("BackBuffer", &physical_, ResourceStatePresent, ResourceStatePresent);
+    const RenderGraphResource color = graph.createTransient("Color", 1024, 256);
+
+    const RenderGraphPass scene = graph.addPass("Scene", nullptr);
+    graph.write(scene, color, ResourceStateRenderTarget);
+
+    // two readers share the read state, only the first needs a barrier
+    const RenderGraphPass blur = graph.addPass("Blur", nullptr);
+    graph.read(blur, color, ResourceStateShaderResource);
+    graph.setSideEffect(blur);
+
+    const RenderGraphPass composite = graph.addPass("Composite", nullptr);
+    graph.read(composite, color, ResourceStateShaderResource);
+    graph.write(composite, backBuffer, ResourceStateRenderTarget);
+
+    CHECK(graph.compile());
+
+    RecordingExecutor executor;
+    graph.execute(executor);
+    CHECK(executor.passCount == 3);
+    CHECK(executor.recorded.size() == 4);
+    CHECK(graph.stats().barrierCount == 4);
+    CHECK(graph.stats().aliasingBarrierCount == 0);
+    if (executor.recorded.size() != 4)
+        return;
+
+    // the transient starts in the state of its first write, so the scene
+    // pass needs no barrier
+    const RenderGraphBarrier& toRead = executor.recorded[0];
+    CHECK(executor.passOfBarrier[0] == 1);
+    CHECK(toRead.type == RenderGraphBarrierTransition);
+    CHECK(toRead.resource == color);
+    CHECK(toRead.stateBefore == ResourceStateRenderTarget);
+    CHECK(toRead.stateAfter == ResourceStateShaderResource);
+
+    const RenderGraphBarrier& toTarget = executor.recorded[1];
+    CHECK(executor.passOfBarrier[1] == 2);
+    CHECK(toTarget.resource == backBuffer);
+    CHECK(toTarget.stateBefore == ResourceStatePresent);
+    CHECK(toTarget.stateAfter == ResourceStateRenderTarget);
+
+    // after the last pass both go back, the back buffer to present and the
+    // transient to its placement state
+    CHECK(executor.passOfBarrier[2] == 3);
+    CHECK(executor.passOfBarrier[3] == 3);
+    CHECK(executor.recorded[2].resource == backBuffer);
+    CHECK(executor.recorded[2].stateAfter == ResourceStatePresent);
+    CHECK(executor.recorded[3].resource == color);
+    CHECK(executor.recorded[3].stateAfter == ResourceStateRenderTarget);
+}
+
+TEST(RenderGraph, CombinesStatesOfOnePass)
+{
+    RenderGraph graph;
+    const RenderGraphResource depth = graph.importResource("Depth", &physical_, ResourceStateDepthWrite, ResourceStateDepthWrite);
+
+    // depth test against a buffer that is sampled at the same time
+    const RenderGraphPass pass = graph.addPass("Decals", nullptr);
+    graph.read(pass, depth, ResourceStateDepthRead);
+    graph.read(pass, depth, ResourceStateShaderResource);
+    graph.setSideEffect(pass);
+
+    CHECK(graph.compile());
+
+    RecordingExecutor executor;
+    graph.execute(executor);
+    CHECK(executor.recorded.size() == 2);
+    if (executor.recorded.size() != 2)
+        return;
+
+    CHECK(executor.recorded[0].stateBefore == ResourceStateDepthWrite);
+    CHECK(executor.recorded[0].stateAfter == (ResourceStateDepthRead | ResourceStateShaderResource));
+    CHECK(executor.recorded[1].stateAfter == ResourceStateDepthWrite);
+}
+
+TEST(RenderGraph, AliasesDisjointLifetimes)
+{
+    RenderGraph graph;
+    const RenderGraphResource backBuffer = graph.importResource("BackBuffer", &physical_, ResourceStatePresent, ResourceStatePresent);
+    const RenderGraphResource a = graph.createTransient("A", 256, 256);
+    const RenderGraphResource b = graph.createTransient("B", 256, 256);
+    const RenderGraphResource c = graph.createTransient("C", 256, 256);
+
+    // a lives in passes 0-1, b in 1-2 and c in 2-3, so a and c can share
+    const RenderGraphPass p0 = graph.addPass("P0", nullptr);
+    graph.write(p0, a, ResourceStateRenderTarget);
+    const RenderGraphPass p1 = graph.addPass("P1", nullptr);
+    graph.read(p1, a, ResourceStateShaderResource);
+    graph.write(p1, b, ResourceStateRenderTarget);
+    const RenderGraphPass p2 = graph.addPass("P2", nullptr);
+    graph.read(p2, b, ResourceStateShaderResource);
+    graph.write(p2, c, ResourceStateRenderTarget);
+    const RenderGraphPass p3 = graph.addPass("P3", nullptr);
+    graph.read(p3, c, ResourceStateShaderResource);
+    graph.write(p3, backBuffer, ResourceStateRenderTarget);
+
+    CHECK(graph.compile());
+    CHECK(graph.heapOffset(a) == graph.heapOffset(c));
+    CHECK(graph.heapOffset(a) != graph.heapOffset(b));
+    CHECK(graph.stats().transientBytes == 768);
+    CHECK(graph.stats().aliasedHeapBytes == 512);
+    CHECK(graph.stats().savedBytes == 256);
+    CHECK(graph.stats().aliasingBarrierCount == 1);
+
+    RecordingExecutor executor;
+    graph.execute(executor);
+
+    // c takes over a's memory before the pass that first writes it
+    uint32_t aliasing = 0;
+    for (size_t i = 0; i < executor.recorded.size(); ++i) {
+        const RenderGraphBarrier& barrier = executor.recorded[i];
+        if (barrier.type != RenderGraphBarrierAliasing)
+            continue;
+
+        aliasing++;
+        CHECK(barrier.resource == c);
+        CHECK(barrier.aliasedBefore == a);
+        CHECK(executor.passOfBarrier[i] == 2);
+    }
+    CHECK(aliasing == 1);
+}
+
+TEST(RenderGraph, KeepsOverlappingLifetimesApart)
+{
+    RenderGraph graph;
+    const RenderGraphResource backBuffer = graph.importResource("BackBuffer", &physical_, ResourceStatePresent, ResourceStatePresent);
+    const RenderGraphResource big = graph.createTransient("Big", 4096, 1024);
+    const RenderGraphResource small = graph.createTransient("Small", 100, 256);
+
+    const RenderGraphPass p0 = graph.addPass("P0", nullptr);
+    graph.write(p0, big, ResourceStateRenderTarget);
+    graph.write(p0, small, ResourceStateUnorderedAccess);
+    const RenderGraphPass p1 = graph.addPass("P1", nullptr);
+    graph.read(p1, big, ResourceStateShaderResource);
+    graph.read(p1, small, ResourceStateShaderResource);
+    graph.write(p1, backBuffer, ResourceStateRenderTarget);
+
+    CHECK(graph.compile());
+
+    // biggest first, the small one goes after it, aligned
+    CHECK(graph.heapOffset(big) == 0);
+    CHECK(graph.heapOffset(small) == 4096);
+    CHECK(graph.stats().aliasedHeapBytes == 4196);
+    CHECK(graph.stats().savedBytes == 0);
+    CHECK(graph.stats().aliasingBarrierCount == 0);
+}
+
+TEST(RenderGraph, ResetKeepsNothing)
+{
+    RenderGraph graph;
+    const RenderGraphPass pass = graph.addPass("Pass", nullptr);
+    graph.write(pass, graph.createTransient("T", 64, 64), ResourceStateRenderTarget);
+    graph.setSideEffect(pass);
+    CHECK(graph.compile());
+
+    graph.reset();
+    CHECK(graph.resourceCount() == 0);
+    CHECK(graph.compile());
+    CHECK(graph.stats().passCount == 0);
+    CHECK(graph.stats().aliasedHeapBytes == 0);
+}
+
+TEST(RenderGraph, BenchmarkSelfCheck)
+{
+    const RenderGraphBenchmark result = measureRenderGraph(300, 2);
+
+    CHECK(result.failedCompiles == 0);
+    CHECK(result.mismatches == 0);
+    CHECK(result.stats.passCount == 301);
+    CHECK(result.stats.culledPassCount == 37);
+    CHECK(result.stats.savedBytes > 0);
+}
@@ -0,0 +1,195 @@
+#include "render_packets.h"
+
+#include "test.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static RenderPacket drawPacket(uint32_t materialIndex, uint32_t meshIndex)
+{
+    RenderPacket packet = {};
+    packet.type = RenderPacketDraw;
+    packet.materialIndex = materialIndex;
+    packet.meshIndex = meshIndex;
+    return packet;
+}
+
+static RenderPacket framePacket(uint32_t type, uint32_t frameSlot)
+{
+    RenderPacket packet = {};
+    packet.type = type;
+    packet.frameSlot = frameSlot;
+    return packet;
+}
+
+// remembers the draws of the frames it translated
+class RecordingTranslator : public RenderPacketTranslator
+{
+public:
+    RecordingTranslator()
+        : frames(0)
+        , inFrame(false)
+        , nested(false)
+    {
+    }
+
+    void beginFrame(uint32_t frameSlot) override
+    {
+        (void)frameSlot;
+        nested = nested || inFrame;
+        inFrame = true;
+    }
+
+    void draw(const RenderPacket& packet) override
+    {
+        meshes.push_back(packet.meshIndex);
+    }
+
+    void endFrame() override
+    {
+        inFrame = false;
+        frames++;
+    }
+
+    std::vector<uint32_t> meshes;
+    uint32_t frames;
+    bool inFrame;
+    bool nested;
+};
+
+TEST(RenderPacketQueue, RoundsCapacityUp)
+{
+    // 5 becomes 8
+    RenderPacketQueue queue(5);
+
+    bool pushed = true;
+    for (uint32_t i = 0; i < 8; ++i)
+        pushed = pushed && queue.tryPush(drawPacket(0, i));
+    CHECK(pushed);
+    CHECK(!queue.tryPush(drawPacket(0, 8)));
+
+    RenderPacket packet;
+    for (uint32_t i = 0; i < 8; ++i)
+        CHECK(queue.tryPop(packet) && packet.meshIndex == i);
+    CHECK(!queue.tryPop(packet));
+}
+
+TEST(RenderPacketQueue, WrapsAroundFullAndEmpty)
+{
+    RenderPacketQueue queue(4);
+
+    // fill and drain over many laps, and at every offset into a lap
+    uint32_t pushed = 0;
+    uint32_t popped = 0;
+    bool inOrder = true;
+    bool fullAtCapacity = true;
+    RenderPacket packet;
+    for (uint32_t round = 0; round < 100; ++round) {
+        const uint32_t fill = round % 4 + 1;
+        for (uint32_t i = 0; i < fill; ++i)
+            inOrder = inOrder && queue.tryPush(drawPacket(0, pushed++));
+
+        if (fill == 4)
+            fullAtCapacity = fullAtCapacity && !queue.tryPush(drawPacket(0, 0));
+
+        for (uint32_t i = 0; i < fill; ++i)
+            inOrder = inOrder && queue.tryPop(packet) && packet.meshIndex == popped++;
+
+        inOrder = inOrder && !queue.tryPop(packet);
+    }
+    CHECK(inOrder);
+    CHECK(fullAtCapacity);
+    CHECK(pushed == popped);
+}
+
+TEST(RenderPacketQueue, KeepsTheOrderOfEveryProducer)
+{
+    const uint32_t producerCount = 4;
+    const uint32_t perProducer = 20000;
+
+    // small, so producers keep running into a full queue
+    RenderPacketQueue queue(64);
+
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < producerCount; ++p) {
+        producers.emplace_back([&queue, p, perProducer]() {
+            for (uint32_t i = 0; i < perProducer; ++i)
+                queue.push(drawPacket(p, i));
+        });
+    }
+
+    std::vector<uint32_t> next(producerCount);
+    bool inOrder = true;
+    for (uint32_t i = 0; i < producerCount * perProducer; ++i) {
+        RenderPacket packet;
+        queue.pop(packet);
+        inOrder = inOrder && packet.materialIndex < producerCount && packet.meshIndex == next[packet.materialIndex]++;
+    }
+
+    for (std::thread& producer : producers)
+        producer.join();
+
+    CHECK(inOrder);
+    for (uint32_t p = 0; p < producerCount; ++p)
+        CHECK(next[p] == perProducer);
+
+    RenderPacket packet;
+    CHECK(!queue.tryPop(packet));
+}
+
+TEST(RenderPacketQueue, WakesASleepingConsumer)
+{
+    RenderPacketQueue queue(16);
+
+    std::atomic<bool> received(false);
+    std::thread consumer([&queue, &received]() {
+        RenderPacket packet;
+        queue.pop(packet);
+        received = packet.meshIndex == 7;
+    });
+
+    // long enough for the consumer to give up spinning
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.push(drawPacket(0, 7));
+    consumer.join();
+
+    CHECK(received);
+}
+
+TEST(RenderPacketQueue, TranslatesWholeFrames)
+{
+    RenderPacketQueue queue(64);
+
+    // a stray draw before the frame is dropped
+    queue.push(drawPacket(0, 99));
+    queue.push(framePacket(RenderPacketBeginFrame, 1));
+    queue.push(drawPacket(0, 1));
+    queue.push(drawPacket(0, 2));
+    queue.push(framePacket(RenderPacketEndFrame, 1));
+    queue.push(framePacket(RenderPacketBeginFrame, 2));
+    queue.push(drawPacket(0, 3));
+    queue.push(framePacket(RenderPacketEndFrame, 2));
+
+    RecordingTranslator translator;
+    CHECK(translateFrame(queue, translator) == 1);
+    CHECK(translator.meshes.size() == 2);
+    CHECK(translator.frames == 1);
+
+    CHECK(translateFrame(queue, translator) == 2);
+    CHECK(translator.meshes.size() == 3 && translator.meshes[0] == 1 && translator.meshes[2] == 3);
+    CHECK(translator.frames == 2);
+    CHECK(!translator.nested);
+
+    RenderPacket packet;
+    CHECK(!queue.tryPop(packet));
+}
+
+TEST(RenderPacketQueue, BenchmarkSelfCheck)
+{
+    const RenderPacketBenchmark result = measureRenderPacketQueue(2, 20, 500);
+    CHECK(result.missingDraws == 0);
+    CHECK(result.packetsPerSecond > 0.0);
+    CHECK(result.maxWakeupLatency >= result.averageWakeupLatency);
+}
@@ -0,0 +1,221 @@
+#include "residency.h"
+
+#include "test.h"
+
+#include <vector>
+
+// remembers what was paged and in how many calls
+class RecordingResidencyBackend : public ResidencyBackend
+{
+public:
+    RecordingResidencyBackend()
+        : evictCalls(0)
+        , makeResidentCalls(0)
+    {
+    }
+
+    bool makeResident(void* const* objects, uint32_t count) override
+    {
+        madeResident.insert(madeResident.end(), objects, objects + count);
+        makeResidentCalls++;
+        return true;
+    }
+
+    bool evict(void* const* objects, uint32_t count) override
+    {
+        evicted.insert(evicted.end(), objects, objects + count);
+        evictCalls++;
+        return true;
+    }
+
+    std::vector<void*> evicted;
+    std::vector<void*> madeResident;
+    uint32_t evictCalls;
+    uint32_t makeResidentCalls;
+};
+
+static int objects_[8];
+
+TEST(Residency, EvictsLeastRecentlyUsedFirst)
+{
+    ResidencyManager manager;
+    manager.reset(300, 1);
+
+    ResidencyHandle handles[4];
+    for (uint32_t i = 0; i < 4; ++i)
+        handles[i] = manager.track(&objects_[i], 100, ResidencyPriorityNormal);
+    CHECK(manager.stats().residentBytes == 400);
+
+    manager.markUsed(handles[2], 1);
+    manager.markUsed(handles[0], 2);
+    manager.markUsed(handles[3], 3);
+
+    // 1 was never used, so it goes first and one is enough
+    RecordingResidencyBackend backend;
+    CHECK(manager.update(10, backend));
+    CHECK(backend.evicted.size() == 1 && backend.evicted[0] == &objects_[1]);
+    CHECK(manager.stats().residentBytes == 300);
+    CHECK(!manager.stats().overBudget);
+
+    // two more that the frame uses push out the next two in use order
+    const ResidencyHandle a = manager.track(&objects_[4], 100, ResidencyPriorityNormal);
+    const ResidencyHandle b = manager.track(&objects_[5], 100, ResidencyPriorityNormal);
+    manager.markUsed(a, 10);
+    manager.markUsed(b, 10);
+
+    backend.evicted.clear();
+    CHECK(manager.update(10, backend));
+    CHECK(backend.evicted.size() == 2);
+    if (backend.evicted.size() == 2) {
+        CHECK(backend.evicted[0] == &objects_[2]);
+        CHECK(backend.evicted[1] == &objects_[0]);
+    }
+    CHECK(manager.stats().residentBytes == 300);
+    CHECK(manager.stats().evictedCount == 2);
+    CHECK(manager.stats().evictedBytes == 200);
+}
+
+TEST(Residency, EvictsLowPriorityFirst)
+{
+    ResidencyManager manager;
+    manager.reset(200, 0);
+
+    const ResidencyHandle old = manager.track(&objects_[0], 100, ResidencyPriorityNormal);
+    const ResidencyHandle recent = manager.track(&objects_[1], 100, ResidencyPriorityLow);
+    manager.track(&objects_[2], 100, ResidencyPriorityMaximum);
+    manager.track(&objects_[3], 100, ResidencyPriorityHigh);
+    manager.markUsed(old, 2);
+    manager.markUsed(recent, 5);
+
+    // priority goes before recency and maximum is never evicted
+    RecordingResidencyBackend backend;
+    CHECK(manager.update(10, backend));
+    CHECK(backend.evicted.size() == 2);
+    if (backend.evicted.size() == 2) {
+        CHECK(backend.evicted[0] == &objects_[1]);
+        CHECK(backend.evicted[1] == &objects_[0]);
+    }
+
+    manager.setBudget(0);
+    backend.evicted.clear();
+    CHECK(manager.update(11, backend));
+    CHECK(backend.evicted.size() == 1 && backend.evicted[0] == &objects_[3]);
+    CHECK(manager.stats().residentBytes == 100);
+    CHECK(manager.stats().overBudget);
+}
+
+TEST(Residency, KeepsFramesInFlight)
+{
+    ResidencyManager manager;
+    manager.reset(100, 2);
+
+    const ResidencyHandle a = manager.track(&objects_[0], 100, ResidencyPriorityNormal);
+    const ResidencyHandle b = manager.track(&objects_[1], 100, ResidencyPriorityNormal);
+    manager.markUsed(a, 8);
+    manager.markUsed(b, 9);
+
+    // both may still be used by the GPU at frame 10
+    RecordingResidencyBackend backend;
+    CHECK(manager.update(10, backend));
+    CHECK(backend.evicted.empty());
+    CHECK(manager.stats().overBudget);
+
+    // a's last use is done two frames later
+    CHECK(manager.update(11, backend));
+    CHECK(backend.evicted.size() == 1 && backend.evicted[0] == &objects_[0]);
+    CHECK(!manager.stats().overBudget);
+}
+
+TEST(Residency, PagesEvictedResourcesBackIn)
+{
+    ResidencyManager manager;
+    manager.reset(200, 0);
+
+    ResidencyHandle handles[4];
+    for (uint32_t i = 0; i < 4; ++i)
+        handles[i] = manager.track(&objects_[i], 100, ResidencyPriorityNormal);
+    manager.markUsed(handles[2], 1);
+    manager.markUsed(handles[3], 1);
+
+    RecordingResidencyBackend backend;
+    CHECK(manager.update(1, backend));
+    CHECK(backend.evicted.size() == 2);
+    CHECK(backend.evictCalls == 1);
+
+    // the frame needs 0 and 1 again, 2 and 3 make room in one batch
+    manager.markUsed(handles[0], 5);
+    manager.markUsed(handles[1], 5);
+    manager.markUsed(handles[1], 5);
+    backend.evicted.clear();
+    CHECK(manager.update(5, backend));
+    CHECK(backend.evicted.size() == 2);
+    CHECK(backend.evictCalls == 2);
+    CHECK(backend.madeResident.size() == 2);
+    CHECK(backend.makeResidentCalls == 1);
+    CHECK(manager.stats().madeResidentCount == 2);
+    CHECK(manager.stats().madeResidentBytes == 200);
+    CHECK(manager.stats().residentBytes == 200);
+    CHECK(manager.stats().residentCount == 2);
+}
+
+TEST(Residency, UntrackReusesHandles)
+{
+    ResidencyManager manager;
+    manager.reset(1000, 1);
+
+    const ResidencyHandle a = manager.track(&objects_[0], 100, ResidencyPriorityNormal);
+    manager.track(&objects_[1], 50, ResidencyPriorityNormal);
+    manager.untrack(a);
+    manager.untrack(a);
+    CHECK(manager.stats().trackedBytes == 50);
+    CHECK(manager.stats().residentCount == 1);
+
+    CHECK(manager.track(&objects_[2], 10, ResidencyPriorityNormal) == a);
+    CHECK(manager.stats().trackedBytes == 60);
+}
+
+TEST(Residency, ReplaysRecordedTraces)
+{
+    ResidencyTrace trace;
+    ResidencyManager manager;
+    manager.reset(200, 1);
+    manager.recordTrace(&trace);
+
+    ResidencyHandle handles[3];
+    for (uint32_t i = 0; i < 3; ++i)
+        handles[i] = manager.track(&objects_[i], 100, ResidencyPriorityNormal);
+
+    // two alternate and fit the budget, the third is only used at the end
+    for (uint64_t frame = 1; frame <= 20; ++frame)
+        manager.markUsed(handles[frame % 2 == 0 ? 0 : 2], frame);
+    manager.markUsed(handles[1], 20);
+    manager.recordTrace(nullptr);
+
+    CHECK(trace.resources.size() == 3);
+    CHECK(trace.uses.size() == 21);
+
+    const ResidencySimulationResult generous = simulateResidency(trace, 300, 1);
+    CHECK(generous.frames == 20);
+    CHECK(generous.evictions == 0);
+    CHECK(generous.pageIns == 0);
+    CHECK(generous.peakResidentBytes == 300);
+
+    // the first frame and the last, which needs all three while one is
+    // still in flight, can not fit
+    const ResidencySimulationResult tight = simulateResidency(trace, 200, 1);
+    CHECK(tight.evictions == 1);
+    CHECK(tight.pageIns == 1);
+    CHECK(tight.pagedInBytes == 100);
+    CHECK(tight.overBudgetFrames == 2);
+}
+
+TEST(Residency, EstimatesTextureSizes)
+{
+    // 64KB placement alignment
+    CHECK(estimateTextureSize(1, 1, 1, 1, 32) == 64 * 1024);
+    CHECK(estimateTextureSize(256, 256, 1, 1, 32) == 256 * 1024);
+
+    // a full mip chain adds a third, rounded up
+    CHECK(estimateTextureSize(256, 256, 1, 9, 32) == 384 * 1024);
+    CHECK(estimateTextureSize(256, 256, 6, 1, 32) == 6 * 256 * 1024);
+}
@@ -0,0 +1,25 @@
+#if !defined(TEST_H)
+#define TEST_H
+
+// A small test runner for the parts of the renderer that need no GPU.
+// TEST(suite, name) registers a test, CHECK() reports a condition that does
+// not hold and carries on with the test. dx12_tests runs every suite, or
+// only the ones named on the command line.
+
+typedef void (*TestFunction)();
+
+bool registerTest(const char* suite, const char* name, TestFunction function);
+void reportFailure(const char* file, int line, const char* condition);
+
+#define TEST(suite, name) \
+    static void suite##_##name(); \
+    static const bool suite##_##name##Registered_ = registerTest(#suite, #name, suite##_##name); \
+    static void suite##_##name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) \
+            reportFailure(__FILE__, __LINE__, #condition); \
+    } while (0)
+
+#endif // TEST_H
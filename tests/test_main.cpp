@@ -0,0 +1,74 @@
+#include "test.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// usage: dx12_tests [suite ...]
+
+struct RegisteredTest
+{
+    const char* suite;
+    const char* name;
+    TestFunction function;
+};
+
+// filled by static initializers, so it has to be constructed on first use
+static std::vector<RegisteredTest>& registeredTests()
+{
+    static std::vector<RegisteredTest> tests;
+    return tests;
+}
+
+static uint32_t failures_ = 0;
+
+bool registerTest(const char* suite, const char* name, TestFunction function)
+{
+    registeredTests().push_back({ suite, name, function });
+    return true;
+}
+
+void reportFailure(const char* file, int line, const char* condition)
+{
+    printf("%s:%d: CHECK(%s) failed\n", file, line, condition);
+    failures_++;
+}
+
+static bool isSelected(const char* suite, int argc, char** argv)
+{
+    if (argc < 2)
+        return true;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], suite) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t testCount = 0;
+    uint32_t failedCount = 0;
+
+    for (const RegisteredTest& test : registeredTests()) {
+        if (!isSelected(test.suite, argc, argv))
+            continue;
+
+        const uint32_t failuresBefore = failures_;
+        test.function();
+        testCount++;
+
+        if (failures_ != failuresBefore) {
+            printf("FAILED %s.%s\n", test.suite, test.name);
+            failedCount++;
+        }
+    }
+
+    printf("%u tests, %u failed\n", testCount, failedCount);
+
+    // a suite that matched nothing is a typo in the test list
+    return testCount > 0 && failedCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+#include "timeline_fence.h"
+
+#include "test.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST(TimelineFence, TicketsAreOrdered)
+{
+    CpuTimelineFence fence;
+    CHECK(fence.lastSignaled().value == 0);
+
+    const FenceTicket first = fence.signal();
+    const FenceTicket second = fence.signal();
+    CHECK(first.isValid());
+    CHECK(first.fence == &fence);
+    CHECK(first.value == 1);
+    CHECK(second.value == 2);
+    CHECK(fence.lastSignaled().value == 2);
+
+    // completing a value completes every ticket before it
+    fence.complete(1);
+    CHECK(isComplete(first));
+    CHECK(!isComplete(second));
+    fence.complete(2);
+    CHECK(isComplete(second));
+}
+
+TEST(TimelineFence, CompletedValueNeverGoesBack)
+{
+    CpuTimelineFence fence;
+    fence.signal();
+    fence.signal();
+    fence.signal();
+
+    fence.complete(3);
+    fence.complete(1);
+    CHECK(fence.completedValue() == 3);
+
+    const FenceTicket next = fence.signal();
+    CHECK(!fence.isComplete(next.value));
+    fence.completeAll();
+    CHECK(fence.completedValue() == next.value);
+}
+
+TEST(TimelineFence, EmptyTicketsAreComplete)
+{
+    CpuTimelineFence fence;
+
+    const FenceTicket none = {};
+    CHECK(!none.isValid());
+    CHECK(isComplete(none));
+
+    // value 0 is what lastSignaled() returns before the first signal
+    CHECK(isComplete(fence.lastSignaled()));
+    CHECK(waitForTicket(fence.lastSignaled()));
+    CHECK(waitForTicket(none));
+}
+
+TEST(TimelineFence, ConcurrentSignalsGetUniqueValues)
+{
+    const uint32_t threadCount = 4;
+    const uint32_t perThread = 10000;
+
+    CpuTimelineFence fence;
+    std::vector<std::vector<uint64_t>> values(threadCount);
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&fence, &values, t, perThread]() {
+            for (uint32_t i = 0; i < perThread; ++i)
+                values[t].push_back(fence.signal().value);
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    // each thread sees its own tickets in order, all of them together are
+    // exactly 1..n
+    std::vector<uint64_t> all;
+    bool increasing = true;
+    for (const std::vector<uint64_t>& own : values) {
+        increasing = increasing && std::is_sorted(own.begin(), own.end());
+        all.insert(all.end(), own.begin(), own.end());
+    }
+    CHECK(increasing);
+
+    std::sort(all.begin(), all.end());
+    bool contiguous = all.size() == threadCount * perThread;
+    for (size_t i = 0; i < all.size() && contiguous; ++i)
+        contiguous = all[i] == i + 1;
+    CHECK(contiguous);
+    CHECK(fence.lastSignaled().value == threadCount * perThread);
+}
+
+TEST(TimelineFence, WaitBlocksUntilCompleted)
+{
+    CpuTimelineFence fence;
+    const FenceTicket ticket = fence.signal();
+    fence.signal();
+
+    std::atomic<bool> done(false);
+    std::thread waiter([&fence, &done, ticket]() {
+        fence.waitFor(ticket.value);
+        done = true;
+    });
+
+    // nothing completes the ticket until the GPU side does
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(!done);
+    fence.complete(ticket.value);
+    waiter.join();
+    CHECK(done);
+}
+
+TEST(TimelineFence, WaitsForTicketsOfSeveralFences)
+{
+    CpuTimelineFence graphics;
+    CpuTimelineFence copy;
+
+    FenceTicket tickets[3] = { graphics.signal(), copy.signal(), graphics.signal() };
+
+    std::thread gpu([&graphics, &copy]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        copy.complete(1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        graphics.completeAll();
+    });
+
+    CHECK(waitForTickets(tickets, 3));
+    for (const FenceTicket& ticket : tickets)
+        CHECK(isComplete(ticket));
+
+    gpu.join();
+}
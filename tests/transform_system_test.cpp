@@ -0,0 +1,51 @@
+#include "transform_system.h"
+
+#include "test.h"
+
+#include <cmath>
+
+// how far apart two rotations are, either sign of a quaternion being the
+// same rotation
+static float rotationDistance(const Float4& a, const Float4& b)
+{
+    const float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    return 1.0f - std::fabs(dot);
+}
+
+TEST(TransformSystem, IntegratesSlowAndFastSpins)
+{
+    // a step of 0.1s turns the slow nodes by a fraction of a radian and
+    // the fast ones by up to six, in the same block of four
+    const float speeds[] = { 0.5f, 30.0f, 2.0f, 60.0f, 9.0f };
+    const uint32_t nodeCount = sizeof(speeds) / sizeof(speeds[0]);
+    const Float3 axis = { 0.0f, 0.0f, 1.0f };
+
+    TransformSystem transforms;
+    for (uint32_t i = 0; i < nodeCount; ++i) {
+        const uint32_t node = transforms.create(InvalidTransform);
+        transforms.setLocalRotation(node, quaternionRotationNormal(axis, 0.0f));
+        transforms.setAngularVelocity(node, { 0.0f, 0.0f, speeds[i] });
+    }
+
+    for (uint32_t step = 0; step < 10; ++step)
+        transforms.integrateRotations(0.1f, nullptr);
+
+    for (uint32_t i = 0; i < nodeCount; ++i) {
+        const Float4 expected = quaternionRotationNormal(axis, speeds[i]);
+        CHECK(rotationDistance(transforms.localRotation(i), expected) < 1e-5f);
+    }
+}
+
+TEST(TransformSystem, KeepsRotationsUnitLength)
+{
+    TransformSystem transforms;
+    const uint32_t node = transforms.create(InvalidTransform);
+    transforms.setLocalRotation(node, quaternionRotationNormal({ 1.0f, 0.0f, 0.0f }, 1.0f));
+    transforms.setAngularVelocity(node, { 3.0f, -40.0f, 7.0f });
+
+    for (uint32_t step = 0; step < 1000; ++step)
+        transforms.integrateRotations(1.0f / 30.0f, nullptr);
+
+    const Float4 q = transforms.localRotation(node);
+    CHECK(std::fabs(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w - 1.0f) < 1e-5f);
+}